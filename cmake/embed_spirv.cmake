@@ -0,0 +1,43 @@
+# Converts a SPIR-V binary into a header with a constexpr uint32_t array.
+# Usage: cmake -DINPUT=<file.spv> -DOUTPUT=<file.h> -DSYMBOL=<name> -P embed_spirv.cmake
+
+file(READ "${INPUT}" SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" SPIRV_HEX_LENGTH)
+math(EXPR SPIRV_SIZE "${SPIRV_HEX_LENGTH} / 2")
+math(EXPR SPIRV_REMAINDER "${SPIRV_SIZE} % 4")
+if(SPIRV_SIZE EQUAL 0 OR NOT SPIRV_REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a valid SPIR-V binary (${SPIRV_SIZE} bytes)")
+endif()
+
+# SPIR-V words are stored little-endian; reverse each group of four bytes
+string(REGEX MATCHALL "........" SPIRV_WORDS "${SPIRV_HEX}")
+set(SPIRV_BODY "")
+set(WORDS_ON_LINE 0)
+foreach(WORD ${SPIRV_WORDS})
+    string(SUBSTRING "${WORD}" 0 2 B0)
+    string(SUBSTRING "${WORD}" 2 2 B1)
+    string(SUBSTRING "${WORD}" 4 2 B2)
+    string(SUBSTRING "${WORD}" 6 2 B3)
+    string(APPEND SPIRV_BODY "0x${B3}${B2}${B1}${B0},")
+    math(EXPR WORDS_ON_LINE "${WORDS_ON_LINE} + 1")
+    if(WORDS_ON_LINE EQUAL 8)
+        string(APPEND SPIRV_BODY "\n    ")
+        set(WORDS_ON_LINE 0)
+    else()
+        string(APPEND SPIRV_BODY " ")
+    endif()
+endforeach()
+
+get_filename_component(INPUT_NAME "${INPUT}" NAME)
+file(WRITE "${OUTPUT}.tmp"
+"// Generated by CMake from ${INPUT_NAME}, do not edit
+#pragma once
+#include <cstdint>
+
+alignas(16) inline constexpr uint32_t ${SYMBOL}[] = {
+    ${SPIRV_BODY}
+};
+")
+# Only touch the header when the SPIR-V changed, so pipeline.cpp is not rebuilt needlessly
+execute_process(COMMAND "${CMAKE_COMMAND}" -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
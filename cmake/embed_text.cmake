@@ -0,0 +1,20 @@
+# Converts a text file into a header with a NUL-terminated constexpr unsigned char array.
+# Usage: cmake -DINPUT=<file> -DOUTPUT=<file.h> -DSYMBOL=<name> -P embed_text.cmake
+
+file(READ "${INPUT}" TEXT_HEX HEX)
+# Sixteen bytes per line
+string(REPEAT "[0-9a-f]" 32 LINE_PATTERN)
+string(REGEX REPLACE "(${LINE_PATTERN})" "\\1\n    " TEXT_BODY "${TEXT_HEX}")
+string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1, " TEXT_BODY "${TEXT_BODY}")
+
+get_filename_component(INPUT_NAME "${INPUT}" NAME)
+file(WRITE "${OUTPUT}.tmp"
+"// Generated by CMake from ${INPUT_NAME}, do not edit
+#pragma once
+
+inline constexpr unsigned char ${SYMBOL}[] = {
+    ${TEXT_BODY}0x00
+};
+")
+execute_process(COMMAND "${CMAKE_COMMAND}" -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,350 @@
+#include "capture.hpp"
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+bool parseCaptureFormat(const char* name, CaptureFormat& format) {
+    if (strcmp(name, "rgba") == 0) {
+        format = CaptureFormat::Rgba;
+    } else if (strcmp(name, "y4m") == 0) {
+        format = CaptureFormat::Y4m;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool FrameCapture::supportsFormat(VkFormat format) {
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM ||
+           format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+FrameCapture::FrameCapture(const Device& device, MemoryAllocator& allocator, uint32_t ringSize)
+    : device(device), allocator(allocator), format(CaptureFormat::Y4m), fps(60), streamExtent{0, 0},
+      swapRedBlue(false), headerWritten(false), nextSequence(0), output(nullptr), outputIsPipe(false),
+      stopping(false), active(false), framesWritten(0), framesDropped(0), bytesWritten(0), writeFailed(false),
+      bandwidthBytes(0), bandwidth(0.0) {
+    // Buffers are allocated on first use, once the frame size is known
+    slots.resize(std::max(ringSize, 2u));
+    for (Slot& slot : slots) {
+        slot.capacity = 0;
+        slot.state = SlotState::Free;
+        slot.frameSlot = 0;
+        slot.sequence = 0;
+    }
+}
+
+FrameCapture::~FrameCapture() {
+    if (active) {
+        stop();
+    }
+    for (Slot& slot : slots) {
+        allocator.destroyBuffer(slot.buffer);
+    }
+}
+
+void FrameCapture::start(const std::string& path, CaptureFormat captureFormat, uint32_t framesPerSecond) {
+    if (active) {
+        return;
+    }
+    if (!path.empty() && path[0] == '|') {
+        // A reader that exits early must not take the renderer down with SIGPIPE
+        std::signal(SIGPIPE, SIG_IGN);
+        output = popen(path.c_str() + 1, "w");
+        outputIsPipe = true;
+    } else {
+        output = fopen(path.c_str(), "wb");
+        outputIsPipe = false;
+    }
+    if (!output) {
+        throw std::runtime_error("Failed to open capture output: " + path);
+    }
+    setvbuf(output, nullptr, _IOFBF, 1 << 20);
+
+    format = captureFormat;
+    fps = std::max(framesPerSecond, 1u);
+    streamExtent = {0, 0};
+    headerWritten = false;
+    nextSequence = 0;
+    framesWritten = 0;
+    framesDropped = 0;
+    bytesWritten = 0;
+    writeFailed = false;
+    bandwidthBytes = 0;
+    bandwidthWindowStart = std::chrono::steady_clock::now();
+    bandwidth = 0.0;
+    stopping = false;
+    active = true;
+    writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+void FrameCapture::stop() {
+    if (!active) {
+        return;
+    }
+    // Every recorded copy has to land before the ring is handed to the writer
+    vkDeviceWaitIdle(device.device);
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queueSignal.notify_one();
+    writer.join();
+    active = false;
+
+    int closeResult = outputIsPipe ? pclose(output) : fclose(output);
+    output = nullptr;
+    std::cout << "Capture: " << framesWritten.load() << " frames written, " << framesDropped.load() << " dropped";
+    if (writeFailed || closeResult != 0) {
+        std::cout << " (output failed)";
+    }
+    std::cout << std::endl;
+}
+
+bool FrameCapture::isActive() const {
+    return active;
+}
+
+bool FrameCapture::recordCopy(VkCommandBuffer commandBuffer, uint32_t frameSlot, VkImage image,
+                              VkExtent2D extent, VkFormat imageFormat) {
+    if (!active) {
+        return false;
+    }
+    if (streamExtent.width == 0) {
+        streamExtent = extent;
+        swapRedBlue = imageFormat == VK_FORMAT_B8G8R8A8_SRGB || imageFormat == VK_FORMAT_B8G8R8A8_UNORM;
+    }
+    if (extent.width != streamExtent.width || extent.height != streamExtent.height) {
+        ++framesDropped;
+        return false;
+    }
+
+    Slot* slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Slot& candidate : slots) {
+            if (candidate.state == SlotState::Free) {
+                slot = &candidate;
+                break;
+            }
+        }
+    }
+    if (!slot) {
+        // The writer is behind and every slot is still queued or in flight
+        ++framesDropped;
+        return false;
+    }
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+    if (slot->capacity < size) {
+        allocator.destroyBuffer(slot->buffer);
+        slot->buffer = allocator.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Readback);
+        slot->capacity = size;
+    }
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer.buffer, 1, &region);
+
+    // Make the copy visible to host reads once the frame's fence has signalled
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = slot->buffer.buffer;
+    barrier.size = size;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &barrier, 0, nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    slot->state = SlotState::Recorded;
+    slot->frameSlot = frameSlot;
+    slot->sequence = nextSequence++;
+    return true;
+}
+
+void FrameCapture::queueSlot(Slot& slot) {
+    slot.state = SlotState::Queued;
+    queue.push_back(&slot);
+}
+
+void FrameCapture::frameCompleted(uint32_t frameSlot) {
+    if (!active) {
+        return;
+    }
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Slot& slot : slots) {
+            if (slot.state == SlotState::Recorded && slot.frameSlot == frameSlot) {
+                queueSlot(slot);
+                queued = true;
+            }
+        }
+    }
+    if (queued) {
+        queueSignal.notify_one();
+    }
+}
+
+void FrameCapture::flush() {
+    if (!active) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Slot*> recorded;
+        for (Slot& slot : slots) {
+            if (slot.state == SlotState::Recorded) {
+                recorded.push_back(&slot);
+            }
+        }
+        std::sort(recorded.begin(), recorded.end(), [](const Slot* a, const Slot* b) { return a->sequence < b->sequence; });
+        for (Slot* slot : recorded) {
+            queueSlot(*slot);
+        }
+    }
+    queueSignal.notify_one();
+}
+
+CaptureStats FrameCapture::getStats() {
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - bandwidthWindowStart).count();
+    if (elapsed >= 1.0) {
+        uint64_t bytes = bytesWritten.load();
+        bandwidth = (bytes - bandwidthBytes) / elapsed;
+        bandwidthBytes = bytes;
+        bandwidthWindowStart = now;
+    }
+
+    CaptureStats stats;
+    stats.active = active;
+    stats.framesWritten = framesWritten.load();
+    stats.framesDropped = framesDropped.load();
+    stats.bandwidth = active ? bandwidth : 0.0;
+    return stats;
+}
+
+void FrameCapture::writerLoop() {
+    while (true) {
+        Slot* slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueSignal.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return; // Stopping and drained
+            }
+            slot = queue.front();
+            queue.pop_front();
+        }
+
+        // After a write error the remaining frames are discarded so the ring keeps turning
+        if (!writeFailed) {
+            writeFrame(*slot);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        slot->state = SlotState::Free;
+    }
+}
+
+void FrameCapture::writeFrame(const Slot& slot) {
+    // Readback memory prefers HOST_CACHED, which need not be coherent
+    VkMemoryPropertyFlags memoryFlags = allocator.memProperties.memoryTypes[slot.buffer.allocation.memoryType].propertyFlags;
+    if (!(memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        VkDeviceSize atom = device.properties.limits.nonCoherentAtomSize;
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.buffer.allocation.memory;
+        range.offset = slot.buffer.allocation.offset / atom * atom;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device.device, 1, &range);
+    }
+
+    const uint8_t* pixels = static_cast<const uint8_t*>(slot.buffer.allocation.mapped);
+    uint32_t width = streamExtent.width;
+    uint32_t height = streamExtent.height;
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    // Byte offsets of red and blue within a texel
+    int r = swapRedBlue ? 2 : 0;
+    int b = swapRedBlue ? 0 : 2;
+
+    const uint8_t* data = pixels;
+    size_t size = pixelCount * 4;
+    if (format == CaptureFormat::Rgba) {
+        if (swapRedBlue) {
+            converted.resize(size);
+            for (size_t i = 0; i < pixelCount; ++i) {
+                converted[i * 4 + 0] = pixels[i * 4 + 2];
+                converted[i * 4 + 1] = pixels[i * 4 + 1];
+                converted[i * 4 + 2] = pixels[i * 4 + 0];
+                converted[i * 4 + 3] = pixels[i * 4 + 3];
+            }
+            data = converted.data();
+        }
+    } else {
+        if (!headerWritten) {
+            // C420jpeg: full-range BT.601 with centred chroma, what the sRGB-encoded pixels map to directly
+            char header[96];
+            int length = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+            fwrite(header, 1, length, output);
+            bytesWritten += length;
+            headerWritten = true;
+        }
+
+        uint32_t chromaWidth = (width + 1) / 2;
+        uint32_t chromaHeight = (height + 1) / 2;
+        size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+        size = 6 + pixelCount + chromaSize * 2;
+        converted.resize(size);
+        memcpy(converted.data(), "FRAME\n", 6);
+        uint8_t* yPlane = converted.data() + 6;
+        uint8_t* uPlane = yPlane + pixelCount;
+        uint8_t* vPlane = uPlane + chromaSize;
+
+        for (size_t i = 0; i < pixelCount; ++i) {
+            const uint8_t* p = pixels + i * 4;
+            yPlane[i] = static_cast<uint8_t>((77 * p[r] + 150 * p[1] + 29 * p[b] + 128) >> 8);
+        }
+        // Chroma from the average of each 2x2 block; odd edges repeat the last row/column
+        for (uint32_t cy = 0; cy < chromaHeight; ++cy) {
+            uint32_t y0 = cy * 2;
+            uint32_t y1 = std::min(y0 + 1, height - 1);
+            for (uint32_t cx = 0; cx < chromaWidth; ++cx) {
+                uint32_t x0 = cx * 2;
+                uint32_t x1 = std::min(x0 + 1, width - 1);
+                const uint8_t* quad[4] = {pixels + (static_cast<size_t>(y0) * width + x0) * 4,
+                                          pixels + (static_cast<size_t>(y0) * width + x1) * 4,
+                                          pixels + (static_cast<size_t>(y1) * width + x0) * 4,
+                                          pixels + (static_cast<size_t>(y1) * width + x1) * 4};
+                int sumR = 0, sumG = 0, sumB = 0;
+                for (const uint8_t* p : quad) {
+                    sumR += p[r];
+                    sumG += p[1];
+                    sumB += p[b];
+                }
+                // Offsets keep the sums positive so the shifts are plain divisions
+                int u = (-43 * sumR - 85 * sumG + 128 * sumB + 4 * 32896) >> 10;
+                int v = (128 * sumR - 107 * sumG - 21 * sumB + 4 * 32896) >> 10;
+                uPlane[cy * chromaWidth + cx] = static_cast<uint8_t>(std::min(u, 255));
+                vPlane[cy * chromaWidth + cx] = static_cast<uint8_t>(std::min(v, 255));
+            }
+        }
+        data = converted.data();
+    }
+
+    if (fwrite(data, 1, size, output) != size) {
+        std::cerr << "Capture: write failed, discarding further frames" << std::endl;
+        writeFailed = true;
+        return;
+    }
+    bytesWritten += size;
+    ++framesWritten;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "device.hpp"
+#include "memory.hpp"
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat {
+    Rgba, // Raw RGBA8 frames back to back, e.g. ffmpeg -f rawvideo -pix_fmt rgba -s WxH -i -
+    Y4m   // YUV4MPEG2 4:2:0 (full range), self-describing
+};
+
+// Returns false for an unknown name
+bool parseCaptureFormat(const char* name, CaptureFormat& format);
+
+struct CaptureStats {
+    bool active;
+    uint64_t framesWritten;
+    uint64_t framesDropped; // Ring full (writer behind) or frame size changed mid-recording
+    double bandwidth;       // Bytes per second written over the last second
+};
+
+// Records presented frames without stalling the render thread. Each frame is copied on the
+// GPU into one of a ring of host-visible buffers; the slot is only read once the fence of the
+// frame that wrote it has signalled, framesInFlight frames later. A writer thread converts and
+// streams the frames to a file or, for an output starting with '|', to a command's stdin.
+// When every slot is still busy the frame is dropped rather than waited for.
+struct FrameCapture {
+    const Device& device;
+    MemoryAllocator& allocator;
+
+    FrameCapture(const Device& device, MemoryAllocator& allocator, uint32_t ringSize);
+    ~FrameCapture();
+
+    // 8-bit RGBA/BGRA images only
+    static bool supportsFormat(VkFormat format);
+
+    // Opens the output; frames follow from the next recordCopy(). fps only goes into the Y4M header.
+    void start(const std::string& output, CaptureFormat format, uint32_t fps);
+    // Waits for the GPU, then blocks until every recorded frame is written and the output is closed
+    void stop();
+    bool isActive() const;
+
+    // Render thread, while recording the frame for frameSlot: records a copy of image (in
+    // TRANSFER_SRC_OPTIMAL) into a free ring slot. Returns false if the frame was dropped.
+    bool recordCopy(VkCommandBuffer commandBuffer, uint32_t frameSlot, VkImage image, VkExtent2D extent, VkFormat format);
+    // Render thread, once frameSlot's fence has signalled: hands that slot's copies to the writer
+    void frameCompleted(uint32_t frameSlot);
+    // After the device went idle (e.g. frames in flight changed): hands over every recorded copy
+    void flush();
+
+    CaptureStats getStats();
+
+private:
+    enum class SlotState { Free, Recorded, Queued };
+    struct Slot {
+        Buffer buffer;
+        VkDeviceSize capacity;
+        SlotState state; // Free/Recorded: render thread; Queued: writer thread
+        uint32_t frameSlot;
+        uint64_t sequence; // Frame order; slots complete in submission order but are found by scan
+    };
+
+    void writerLoop();
+    void writeFrame(const Slot& slot);
+    void queueSlot(Slot& slot);
+
+    std::vector<Slot> slots;
+    CaptureFormat format;
+    uint32_t fps;
+    VkExtent2D streamExtent; // Fixed by the first frame; the formats cannot change size mid-stream
+    bool swapRedBlue;
+    bool headerWritten;
+    uint64_t nextSequence;
+    FILE* output;
+    bool outputIsPipe;
+    std::vector<uint8_t> converted; // Writer thread scratch
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable queueSignal;
+    std::deque<Slot*> queue; // Oldest first
+    bool stopping;
+    bool active;
+
+    std::atomic<uint64_t> framesWritten;
+    std::atomic<uint64_t> framesDropped;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<bool> writeFailed;
+    uint64_t bandwidthBytes; // Render thread: bytesWritten at the start of the window
+    std::chrono::steady_clock::time_point bandwidthWindowStart;
+    double bandwidth;
+};
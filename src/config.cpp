@@ -0,0 +1,431 @@
+#include "config.hpp"
+#include "gridfire_config.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Command line shortcuts for the most common keys; anything else via --section.key=value
+struct CliOption {
+    const char* name;
+    const char* key;        // nullptr for --config
+    const char* fixedValue; // Non-null for switches that take no value
+    const char* help;
+};
+
+const CliOption cliOptions[] = {
+    {"config", nullptr, nullptr, "PATH   Extra settings file, applied after the user file"},
+    {"width", "graphics.resolution_width", nullptr, "N      Window width (0 = monitor's native mode)"},
+    {"height", "graphics.resolution_height", nullptr, "N      Window height (0 = monitor's native mode)"},
+    {"fullscreen", "graphics.fullscreen", "true", "       Fullscreen on the primary monitor"},
+    {"windowed", "graphics.fullscreen", "false", "       Windowed mode"},
+    {"present-mode", "graphics.present_mode", nullptr, "MODE   immediate, mailbox, fifo or fifo_relaxed"},
+    {"fps-limit", "graphics.fps_limit", nullptr, "FPS    Frame rate cap: off, refresh (monitor rate) or frames per second"},
+    {"frames-in-flight", "graphics.frames_in_flight", nullptr, "N      1 to 3"},
+    {"render-scale", "graphics.render_scale", nullptr, "S      Scene resolution scale, 0.25 to 2.0"},
+    {"dirty-regions", "graphics.dirty_regions", "true", "       Re-render only around moving objects while the camera is still"},
+    {"quality", "graphics.quality", nullptr, "Q      low, medium, high or ultra"},
+    {"profile", "graphics.profile", nullptr, "NAME   Tuning profile saved from the tuning panel"},
+    {"grid", "raymarch.grid_mode", nullptr, "MODE   sdf, analytic or compare (split screen)"},
+    {"aa", "raymarch.aa_mode", nullptr, "MODE   off, adaptive or edges (adaptive, supersampled pixels tinted)"},
+    {"precision", "raymarch.precision", nullptr, "MODE   Shader precision: auto, fp32 or fp16"},
+    {"precision-bench", "raymarch.precision_benchmark", "true", "       Benchmark the fp16 shader against fp32 on a camera path and exit"},
+    {"gpu", "gpu.device", nullptr, "G      GPU index or name substring"},
+    {"vk10", "gpu.force_vulkan10", "true", "       Force the Vulkan 1.0 render pass path"},
+    {"overlay", "profiling.overlay", "true", "       Show the F3 debug overlay at startup"},
+    {"tuning", "profiling.tuning_panel", "true", "       Show the F4 tuning panel at startup"},
+    {"step-histogram", "profiling.step_histogram", "true", "       Collect the steps-per-pixel histogram"},
+    {"frame-log", "profiling.frame_log", nullptr, "PATH   Write per-frame timings as CSV"},
+    {"metrics", "metrics.listen", nullptr, "ADDR   Serve Prometheus metrics on host:port or unix:PATH"},
+    {"record", "capture.autostart", "true", "       Start frame capture at startup (F10 toggles)"},
+    {"capture", "capture.output", nullptr, "PATH   Capture file pattern, or |COMMAND to pipe frames into"},
+    {"bodies", "orbits.count", nullptr, "N      Orbiting bodies in the asteroid belt"},
+    {"orbit-bench", "orbits.benchmark", "true", "       Benchmark the Kepler solver at 1k/10k/100k bodies and exit"},
+    {"shader-dir", "dev.shader_dir", nullptr, "DIR    Load .spv files from DIR instead of the embedded shaders"},
+    {"scene", "scene.file", nullptr, "PATH   Scene description to compile into the raymarch shader"},
+    {"scene-bench", "scene.benchmark", "true", "       Compare the compiled scene file with the built-in scene shader and exit"},
+    {"cpu", "cpu.render", "true", "       Raymarch on the CPU instead of the GPU"},
+    {"cpu-headless", "cpu.headless", "true", "       Render the [farm] frames on the CPU without a window and exit"},
+    {"cpu-bench", "cpu.benchmark", "true", "       Benchmark the CPU raymarcher per kernel and thread count and exit"},
+    {"raster", "raster.mode", nullptr, "MODE   Rasterized meshes: off, depth or prepass"},
+    {"stereo", "stereo.mode", nullptr, "MODE   Side-by-side stereo: off, twopass or multiview"},
+    {"stereo-bench", "stereo.benchmark", "true", "       Compare two-pass and multiview stereo frame times and exit"},
+    {"jobs", "jobs.threads", nullptr, "N      Job threads including the main thread (0 = all hardware threads)"},
+    {"jobs-bench", "jobs.benchmark", "true", "       Report job system scaling from 1 to every hardware thread and exit"},
+    {"farm", "farm.role", nullptr, "ROLE   coordinator or worker: render tiled offline frames, no window"},
+    {"farm-connect", "farm.connect", nullptr, "ADDR   Coordinator host:port for a farm worker"},
+    {"farm-workers", "farm.local_workers", nullptr, "N      Worker processes the coordinator starts on this machine"},
+};
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+// One conversion of an index pattern: '%' followed by an optional 0N width and 'd'
+struct IndexConversion {
+    size_t begin;
+    size_t end; // One past the 'd'
+    int width;  // Zero-padded digits, 0 for plain %d
+};
+
+// Finds the index conversion; false if there is none, more than one or anything else after a '%'
+bool parseIndexPattern(const std::string& pattern, IndexConversion& conversion) {
+    int found = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') {
+            continue;
+        }
+        size_t begin = i++;
+        if (i < pattern.size() && pattern[i] == '%') {
+            continue;
+        }
+        int width = 0;
+        if (i < pattern.size() && pattern[i] == '0') {
+            ++i;
+            size_t digits = i;
+            while (i < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[i])) && i - digits < 2) {
+                width = width * 10 + (pattern[i++] - '0');
+            }
+            if (width == 0) {
+                return false;
+            }
+        }
+        if (i >= pattern.size() || pattern[i] != 'd') {
+            return false;
+        }
+        conversion = {begin, i + 1, width};
+        ++found;
+    }
+    return found == 1;
+}
+
+} // namespace
+
+std::string getUserConfigDir() {
+    const char* xdg = std::getenv("XDG_CONFIG_HOME");
+    if (xdg && *xdg) {
+        return std::string(xdg) + "/gridfire";
+    }
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.config/gridfire";
+}
+
+bool isValidIndexPattern(const std::string& pattern) {
+    IndexConversion conversion;
+    return parseIndexPattern(pattern, conversion);
+}
+
+std::string formatIndexPattern(const std::string& pattern, uint32_t index) {
+    IndexConversion conversion;
+    if (!parseIndexPattern(pattern, conversion)) {
+        throw std::runtime_error("Invalid file pattern '" + pattern + "': needs exactly one %d or %0Nd");
+    }
+    std::string number = std::to_string(index);
+    if (number.size() < static_cast<size_t>(conversion.width)) {
+        number.insert(0, conversion.width - number.size(), '0');
+    }
+    std::string result;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (i == conversion.begin) {
+            result += number;
+            i = conversion.end - 1;
+        } else {
+            result += pattern[i];
+            if (pattern[i] == '%') {
+                ++i; // %%
+            }
+        }
+    }
+    return result;
+}
+
+Config Config::load(int argc, char** argv) {
+    struct Override {
+        std::string key, value, source;
+    };
+    std::vector<Override> overrides;
+    std::vector<std::string> extraFiles;
+    Config config;
+
+    // Environment switches predate the config file and still work
+    if (const char* gpu = std::getenv("GRIDFIRE_GPU")) {
+        overrides.push_back({"gpu.device", gpu, "env GRIDFIRE_GPU"});
+    }
+    if (const char* forceVk10 = std::getenv("GRIDFIRE_FORCE_VK10")) {
+        overrides.push_back({"gpu.force_vulkan10", forceVk10, "env GRIDFIRE_FORCE_VK10"});
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            config.helpRequested = true;
+            continue;
+        }
+        if (arg.compare(0, 2, "--") != 0) {
+            throw std::runtime_error("Unexpected argument: " + arg);
+        }
+
+        std::string name = arg.substr(2);
+        std::string value;
+        bool hasValue = false;
+        size_t equals = name.find('=');
+        if (equals != std::string::npos) {
+            value = name.substr(equals + 1);
+            name = name.substr(0, equals);
+            hasValue = true;
+        }
+
+        // Generic form: --section.key=value
+        if (name.find('.') != std::string::npos) {
+            if (!hasValue) {
+                throw std::runtime_error("Expected --" + name + "=value");
+            }
+            overrides.push_back({name, value, "cli"});
+            continue;
+        }
+
+        const CliOption* option = nullptr;
+        for (const CliOption& candidate : cliOptions) {
+            if (name == candidate.name) {
+                option = &candidate;
+            }
+        }
+        if (!option) {
+            throw std::runtime_error("Unknown option: --" + name);
+        }
+        if (option->fixedValue) {
+            if (hasValue) {
+                throw std::runtime_error("--" + name + " does not take a value");
+            }
+            overrides.push_back({option->key, option->fixedValue, "cli"});
+            continue;
+        }
+        if (!hasValue) {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for --" + name);
+            }
+            value = argv[++i];
+        }
+        if (option->key) {
+            overrides.push_back({option->key, value, "cli"});
+        } else {
+            extraFiles.push_back(value);
+        }
+    }
+
+    config.loadFile(std::string(GRIDFIRE_CONFIG_DIR) + "/settings.ini", "system");
+    config.loadFile(getUserConfigDir() + "/settings.ini", "user");
+    for (const std::string& path : extraFiles) {
+        if (!config.loadFile(path, path)) {
+            throw std::runtime_error("Config file not found: " + path);
+        }
+    }
+
+    // A tuning profile is a settings file saved from the tuning panel; it sits above the
+    // files so a site profile wins over the defaults, but below env and command line
+    std::string profile = config.has("graphics.profile") ? config.entries["graphics.profile"].value : "";
+    for (const Override& entry : overrides) {
+        if (entry.key == "graphics.profile") {
+            profile = entry.value;
+        }
+    }
+    if (!profile.empty() && !config.loadFile(getUserConfigDir() + "/profiles/" + profile + ".ini", "profile " + profile)) {
+        std::cerr << "Tuning profile '" << profile << "' not found in " << getUserConfigDir() << "/profiles" << std::endl;
+    }
+
+    for (const Override& entry : overrides) {
+        config.set(entry.key, entry.value, entry.source);
+    }
+
+    // The profile is applied here rather than read later, so record it for print()
+    auto profileEntry = config.entries.find("graphics.profile");
+    if (profileEntry != config.entries.end()) {
+        config.record(profileEntry->first, profileEntry->second.value, profileEntry->second.source);
+    }
+    return config;
+}
+
+void Config::printUsage(std::ostream& out) {
+    out << "Usage: gridfire [options]\n\n"
+        << "Settings are read from " << GRIDFIRE_CONFIG_DIR << "/settings.ini, then\n"
+        << getUserConfigDir() << "/settings.ini, then the options below.\n\n";
+    for (const CliOption& option : cliOptions) {
+        out << "  --" << std::left << std::setw(18) << option.name << option.help << "\n";
+    }
+    out << "  --section.key=VALUE Set any settings.ini key\n"
+        << "  -h, --help          Show this help\n";
+}
+
+bool Config::loadFile(const std::string& path, const std::string& source) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string section;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        if (line.front() == '[' && line.back() == ']') {
+            section = lowercase(trim(line.substr(1, line.size() - 2)));
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            std::cerr << path << ":" << lineNumber << ": expected key=value" << std::endl;
+            continue;
+        }
+        std::string key = lowercase(trim(line.substr(0, equals)));
+        set(section.empty() ? key : section + "." + key, trim(line.substr(equals + 1)), source);
+    }
+    return true;
+}
+
+void Config::set(const std::string& key, const std::string& value, const std::string& source) {
+    entries[key] = {value, source};
+}
+
+bool Config::has(const std::string& key) const {
+    return entries.find(key) != entries.end();
+}
+
+void Config::record(const std::string& key, const std::string& value, const std::string& source) {
+    if (effective.find(key) == effective.end()) {
+        readOrder.push_back(key);
+    }
+    effective[key] = {value, source};
+}
+
+std::string Config::getString(const std::string& key, const std::string& fallback, const char* fallbackSource) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        record(key, fallback, fallbackSource);
+        return fallback;
+    }
+    record(key, it->second.value, it->second.source);
+    return it->second.value;
+}
+
+int Config::getInt(const std::string& key, int fallback, const char* fallbackSource) {
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        char* end = nullptr;
+        long value = std::strtol(it->second.value.c_str(), &end, 10);
+        if (!it->second.value.empty() && *end == '\0') {
+            record(key, it->second.value, it->second.source);
+            return static_cast<int>(value);
+        }
+        std::cerr << key << "=" << it->second.value << " (" << it->second.source << ") is not an integer" << std::endl;
+    }
+    record(key, std::to_string(fallback), fallbackSource);
+    return fallback;
+}
+
+float Config::getFloat(const std::string& key, float fallback, const char* fallbackSource) {
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        char* end = nullptr;
+        float value = std::strtof(it->second.value.c_str(), &end);
+        if (!it->second.value.empty() && *end == '\0') {
+            record(key, it->second.value, it->second.source);
+            return value;
+        }
+        std::cerr << key << "=" << it->second.value << " (" << it->second.source << ") is not a number" << std::endl;
+    }
+    std::ostringstream text;
+    text << fallback;
+    record(key, text.str(), fallbackSource);
+    return fallback;
+}
+
+bool Config::getBool(const std::string& key, bool fallback, const char* fallbackSource) {
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        std::string value = lowercase(it->second.value);
+        if (value == "true" || value == "yes" || value == "on" || value == "1") {
+            record(key, "true", it->second.source);
+            return true;
+        }
+        if (value == "false" || value == "no" || value == "off" || value == "0") {
+            record(key, "false", it->second.source);
+            return false;
+        }
+        std::cerr << key << "=" << it->second.value << " (" << it->second.source << ") is not a boolean" << std::endl;
+    }
+    record(key, fallback ? "true" : "false", fallbackSource);
+    return fallback;
+}
+
+void Config::readRenderSettings(RenderSettings& settings, const char* fallbackSource) {
+    settings.maxSteps = getInt("raymarch.max_steps", settings.maxSteps, fallbackSource);
+    settings.epsilon = getFloat("raymarch.epsilon", settings.epsilon, fallbackSource);
+    settings.farDistance = getFloat("raymarch.far_distance", settings.farDistance, fallbackSource);
+    clampMarchSettings(settings);
+    std::string strategy = getString("raymarch.march_strategy", marchStrategyName(settings.marchStrategy), fallbackSource);
+    if (!parseMarchStrategy(strategy.c_str(), settings.marchStrategy)) {
+        std::cerr << "Unknown march strategy '" << strategy << "', using " << marchStrategyName(settings.marchStrategy) << std::endl;
+    }
+    std::string gridMode = getString("raymarch.grid_mode", gridModeName(settings.gridMode), fallbackSource);
+    if (!parseGridMode(gridMode.c_str(), settings.gridMode)) {
+        std::cerr << "Unknown grid mode '" << gridMode << "', using " << gridModeName(settings.gridMode) << std::endl;
+    }
+    std::string aaMode = getString("raymarch.aa_mode", aaModeName(settings.aaMode), fallbackSource);
+    if (!parseAaMode(aaMode.c_str(), settings.aaMode)) {
+        std::cerr << "Unknown AA mode '" << aaMode << "', using " << aaModeName(settings.aaMode) << std::endl;
+    }
+    settings.aaSamples = std::clamp(getInt("raymarch.aa_samples", settings.aaSamples, fallbackSource), 2, 16);
+    std::string precision = getString("raymarch.precision", shaderPrecisionName(settings.shaderPrecision), fallbackSource);
+    if (!parseShaderPrecision(precision.c_str(), settings.shaderPrecision)) {
+        std::cerr << "Unknown shader precision '" << precision << "', using " << shaderPrecisionName(settings.shaderPrecision) << std::endl;
+    }
+
+    settings.renderScale = getFloat("graphics.render_scale", settings.renderScale, fallbackSource);
+    std::string presentMode = getString("graphics.present_mode", presentModeName(settings.presentMode), fallbackSource);
+    if (!parsePresentMode(presentMode.c_str(), settings.presentMode)) {
+        std::cerr << "Unknown present mode '" << presentMode << "', using " << presentModeName(settings.presentMode) << std::endl;
+    }
+    settings.framesInFlight = static_cast<uint32_t>(std::max(1, getInt("graphics.frames_in_flight", static_cast<int>(settings.framesInFlight), fallbackSource)));
+    std::string fpsLimit = getString("graphics.fps_limit", fpsLimitName(settings.fpsLimit), fallbackSource);
+    if (!parseFpsLimit(fpsLimit.c_str(), settings.fpsLimit)) {
+        std::cerr << "Unknown fps limit '" << fpsLimit << "', using " << fpsLimitName(settings.fpsLimit) << std::endl;
+    }
+    settings.dirtyRegions = getBool("graphics.dirty_regions", settings.dirtyRegions, fallbackSource);
+    settings.cpuRender = getBool("cpu.render", settings.cpuRender, fallbackSource);
+    settings.stepHistogram = getBool("profiling.step_histogram", settings.stepHistogram, fallbackSource);
+}
+
+void Config::print(std::ostream& out) const {
+    out << "Effective configuration:" << std::endl;
+    for (const std::string& key : readOrder) {
+        const Entry& entry = effective.at(key);
+        out << "  " << std::left << std::setw(28) << key << std::setw(16) << (entry.value.empty() ? "\"\"" : entry.value)
+            << "[" << entry.source << "]" << std::endl;
+    }
+    for (const auto& entry : entries) {
+        if (effective.find(entry.first) == effective.end()) {
+            out << "  " << std::left << std::setw(28) << entry.first << std::setw(16) << entry.second.value
+                << "[" << entry.second.source << ", unused]" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "settings.hpp"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Layered ini configuration. Keys are "section.key"; later layers override earlier ones:
+//   defaults < system settings.ini < user settings.ini < --config files < tuning profile < environment < command line
+// Every typed read is recorded so the effective configuration, including defaults and
+// where each value came from, can be printed at startup.
+struct Config {
+    struct Entry {
+        std::string value;
+        std::string source; // "system", "user", "cli", ...
+    };
+
+    std::map<std::string, Entry> entries;
+    std::vector<std::string> readOrder;      // Keys in the order they were first read
+    std::map<std::string, Entry> effective;  // Value actually used for every key that was read
+    bool helpRequested = false;
+
+    // Builds the full layer stack; throws std::runtime_error on malformed command lines
+    static Config load(int argc, char** argv);
+    static void printUsage(std::ostream& out);
+
+    // Returns false if the file does not exist
+    bool loadFile(const std::string& path, const std::string& source);
+    void set(const std::string& key, const std::string& value, const std::string& source);
+    bool has(const std::string& key) const;
+
+    // Malformed values print a warning and fall back; fallbackSource labels defaults in print()
+    std::string getString(const std::string& key, const std::string& fallback, const char* fallbackSource = "default");
+    int getInt(const std::string& key, int fallback, const char* fallbackSource = "default");
+    float getFloat(const std::string& key, float fallback, const char* fallbackSource = "default");
+    bool getBool(const std::string& key, bool fallback, const char* fallbackSource = "default");
+
+    // Reads the [graphics]/[raymarch] knobs, keeping the current value for anything unset
+    void readRenderSettings(RenderSettings& settings, const char* fallbackSource = "default");
+
+    void print(std::ostream& out) const; // Effective values, then keys that were never read
+
+private:
+    void record(const std::string& key, const std::string& value, const std::string& source);
+};
+
+std::string getUserConfigDir(); // $XDG_CONFIG_HOME/gridfire or ~/.config/gridfire
+
+// Output file patterns such as frame_%04d.ppm take a frame or recording index through exactly
+// one %d or %0Nd; %% is a percent sign and every other character is copied as-is. Patterns
+// come from settings files and the command line, so they are never passed to printf.
+bool isValidIndexPattern(const std::string& pattern);
+std::string formatIndexPattern(const std::string& pattern, uint32_t index); // pattern must be valid
@@ -0,0 +1,334 @@
+#include "cpurender.hpp"
+#include "cpurender_kernel.hpp"
+#include "dirty.hpp" // orbitingCubeCenter
+#include "jobs.hpp"
+#include "renderfarm.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(GRIDFIRE_AVX2_KERNEL)
+// cpurender_avx2.cpp, built with AVX2/FMA enabled; only called after the CPU check
+void marchSpanAvx2(const CpuScene& scene, uint32_t x, uint32_t y, uint32_t count, uint32_t* out);
+#endif
+
+CpuScene makeCpuScene(const Camera& camera, float time, const RenderSettings& settings,
+                      uint32_t width, uint32_t height, bool srgb, bool bgra) {
+    CpuScene scene;
+    scene.width = width;
+    scene.height = height;
+    scene.camPos = camera.position;
+    // raymarch.frag: inverse(proj) * vec4(uv, 1, 1), rotated into the world with w = 0
+    glm::mat4 inverseProj = glm::inverse(camera.proj);
+    glm::mat3 toWorld = glm::mat3(glm::inverse(camera.view));
+    scene.rayX = toWorld * glm::vec3(inverseProj[0]);
+    scene.rayY = toWorld * glm::vec3(inverseProj[1]);
+    scene.rayZ = toWorld * (glm::vec3(inverseProj[2]) + glm::vec3(inverseProj[3]));
+    scene.cubeCenter = orbitingCubeCenter(time);
+    scene.maxSteps = settings.maxSteps;
+    scene.epsilon = settings.epsilon;
+    scene.farDistance = settings.farDistance;
+    scene.marchStrategy = settings.marchStrategy;
+    scene.gridMode = settings.gridMode;
+    scene.encode = cpuEncodeTable(srgb);
+    scene.bgra = bgra;
+    return scene;
+}
+
+const uint8_t* cpuEncodeTable(bool srgb) {
+    static const std::vector<uint8_t> tables = [] {
+        std::vector<uint8_t> table(2 * 65536);
+        for (uint32_t i = 0; i < 65536; ++i) {
+            double value = i / 65535.0;
+            double encoded = value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+            table[i] = static_cast<uint8_t>(std::lround(value * 255.0));
+            table[65536 + i] = static_cast<uint8_t>(std::lround(encoded * 255.0));
+        }
+        return table;
+    }();
+    return tables.data() + (srgb ? 65536 : 0);
+}
+
+static void marchSpan(KeplerKernel kernel, const CpuScene& scene, uint32_t x, uint32_t y, uint32_t count, uint32_t* out) {
+    switch (kernel) {
+#if defined(GRIDFIRE_AVX2_KERNEL)
+        case KeplerKernel::Avx2:
+            marchSpanAvx2(scene, x, y, count, out);
+            return;
+#endif
+#if defined(__SSE2__)
+        case KeplerKernel::Sse:
+            marchSpan<SseMarchOps>(scene, x, y, count, out);
+            return;
+#endif
+        default:
+            marchSpan<ScalarMarchOps>(scene, x, y, count, out);
+            return;
+    }
+}
+
+CpuRaymarcher::CpuRaymarcher(JobSystem& jobs) : jobs(jobs), kernel(bestKeplerKernel()), renderSeconds(0.0), steals(0) {
+}
+
+uint32_t CpuRaymarcher::getThreadCount() const {
+    return jobs.getThreadCount();
+}
+
+void CpuRaymarcher::render(const CpuScene& scene, uint32_t* pixels) {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t tilesX = (scene.width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tileCount = tilesX * ((scene.height + TILE_SIZE - 1) / TILE_SIZE);
+    uint64_t stealsBefore = jobs.stealCount.load(std::memory_order_relaxed);
+
+    // Tiles are numbered row by row, so a run keeps each job on neighbouring tiles
+    uint32_t grain = std::max(1u, tileCount / (getThreadCount() * JOBS_PER_THREAD));
+    jobs.parallelFor(tileCount, grain, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t tile = begin; tile < end; ++tile) {
+            uint32_t x0 = (tile % tilesX) * TILE_SIZE;
+            uint32_t y0 = (tile / tilesX) * TILE_SIZE;
+            uint32_t width = std::min(TILE_SIZE, scene.width - x0);
+            uint32_t y1 = std::min(y0 + TILE_SIZE, scene.height);
+            for (uint32_t y = y0; y < y1; ++y) {
+                marchSpan(kernel, scene, x0, y, width, pixels + static_cast<size_t>(y) * scene.width + x0);
+            }
+        }
+    });
+
+    steals = static_cast<uint32_t>(jobs.stealCount.load(std::memory_order_relaxed) - stealsBefore);
+    renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+CpuSceneBuffers::CpuSceneBuffers(MemoryAllocator& allocator, uint32_t framesInFlight)
+    : allocator(allocator), buffers(framesInFlight), extent{0, 0} {
+}
+
+CpuSceneBuffers::~CpuSceneBuffers() {
+    // Only destroyed once the device is idle
+    for (Buffer& buffer : buffers) {
+        if (buffer.buffer != VK_NULL_HANDLE) {
+            allocator.destroyBuffer(buffer);
+        }
+    }
+}
+
+void CpuSceneBuffers::resize(VkExtent2D sceneExtent) {
+    if (sceneExtent.width == extent.width && sceneExtent.height == extent.height) {
+        return;
+    }
+    vkDeviceWaitIdle(allocator.device.device);
+    extent = sceneExtent;
+    // Written once per frame by the CPU and copied once, so Staging keeps BAR free
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+    for (Buffer& buffer : buffers) {
+        if (buffer.buffer != VK_NULL_HANDLE) {
+            allocator.destroyBuffer(buffer);
+        }
+        buffer = allocator.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Staging);
+    }
+}
+
+// Binary PPM as written by the farm; returns false if the file is missing or not a P6 image
+static bool readPpm(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgb) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int maxValue = 0;
+    if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255) {
+        return false;
+    }
+    file.get(); // Single whitespace before the pixels
+    rgb.resize(static_cast<size_t>(width) * height * 3);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(rgb.data()), static_cast<std::streamsize>(rgb.size())));
+}
+
+int runCpuRender(Config& config, const RenderSettings& settings, float fov) {
+    FarmJob job = FarmJob::fromConfig(config, settings, fov);
+    uint32_t threads = static_cast<uint32_t>(std::max(0, config.getInt("cpu.threads", 0)));
+    std::string output = config.getString("cpu.output", "cpu_frame_%04d.ppm");
+    std::string reference = config.getString("cpu.reference", "");
+    if (!isValidIndexPattern(output)) {
+        std::cerr << "cpu.output=" << output << " needs exactly one %d or %0Nd for the frame index, using cpu_frame_%04d.ppm"
+                  << std::endl;
+        output = "cpu_frame_%04d.ppm";
+    }
+    if (!reference.empty() && !isValidIndexPattern(reference)) {
+        std::cerr << "Error: cpu.reference=" << reference << " needs exactly one %d or %0Nd for the frame index" << std::endl;
+        return -1;
+    }
+    int tolerance = std::max(0, config.getInt("cpu.tolerance", 8));
+    float maxMismatch = config.getFloat("cpu.max_mismatch", 3.0f);
+    config.print(std::cout);
+
+    JobSystem jobs(threads);
+    CpuRaymarcher marcher(jobs);
+    std::cout << "CPU raymarcher: " << marcher.getThreadCount() << " threads, " << keplerKernelName(marcher.kernel)
+              << " kernel, " << job.width << "x" << job.height << std::endl;
+    std::vector<uint32_t> pixels(static_cast<size_t>(job.width) * job.height);
+    std::vector<uint8_t> rgb(pixels.size() * 3);
+    std::vector<uint8_t> expected;
+    int exitCode = 0;
+    for (uint32_t frame = 0; frame < job.frames; ++frame) {
+        // Like the farm, the asteroid belt is not drawn
+        CpuScene scene = makeCpuScene(job.camera(), job.startTime + frame / job.fps, job.settings, job.width, job.height, true, false);
+        marcher.render(scene, pixels.data());
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            rgb[i * 3] = static_cast<uint8_t>(pixels[i]);
+            rgb[i * 3 + 1] = static_cast<uint8_t>(pixels[i] >> 8);
+            rgb[i * 3 + 2] = static_cast<uint8_t>(pixels[i] >> 16);
+        }
+
+        std::string path = formatIndexPattern(output, frame);
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: failed to write " << path << std::endl;
+            return -1;
+        }
+        file << "P6\n" << job.width << " " << job.height << "\n255\n";
+        file.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+        char line[1280];
+        std::snprintf(line, sizeof(line), "Wrote %s: %.1f ms, %.1f Mpixel/s, %u steals", path.c_str(), marcher.renderSeconds * 1000.0,
+                      pixels.size() / marcher.renderSeconds * 1e-6, marcher.steals);
+        std::cout << line << std::endl;
+
+        if (reference.empty()) {
+            continue;
+        }
+        path = formatIndexPattern(reference, frame);
+        uint32_t referenceWidth, referenceHeight;
+        if (!readPpm(path, referenceWidth, referenceHeight, expected) || referenceWidth != job.width || referenceHeight != job.height) {
+            std::cerr << "Error: " << path << " is not a " << job.width << "x" << job.height << " P6 image" << std::endl;
+            exitCode = 1;
+            continue;
+        }
+        // Edges and the sub-pixel distant grid lines flip where float rounding differs, so a
+        // pixel only mismatches when no reference pixel in its 3x3 neighbourhood is within tolerance
+        auto pixelError = [&](size_t i, size_t j) {
+            int error = 0;
+            for (size_t c = 0; c < 3; ++c) {
+                error = std::max(error, std::abs(rgb[i * 3 + c] - expected[j * 3 + c]));
+            }
+            return error;
+        };
+        uint64_t mismatched = 0;
+        uint64_t errorSum = 0;
+        int maxError = 0;
+        for (uint32_t y = 0; y < job.height; ++y) {
+            for (uint32_t x = 0; x < job.width; ++x) {
+                size_t i = static_cast<size_t>(y) * job.width + x;
+                int error = pixelError(i, i);
+                errorSum += error;
+                maxError = std::max(maxError, error);
+                for (uint32_t ny = y > 0 ? y - 1 : 0; ny <= std::min(y + 1, job.height - 1) && error > tolerance; ++ny) {
+                    for (uint32_t nx = x > 0 ? x - 1 : 0; nx <= std::min(x + 1, job.width - 1); ++nx) {
+                        error = std::min(error, pixelError(i, static_cast<size_t>(ny) * job.width + nx));
+                    }
+                }
+                mismatched += error > tolerance ? 1 : 0;
+            }
+        }
+        float mismatchPercent = 100.0f * mismatched / pixels.size();
+        bool pass = mismatchPercent <= maxMismatch;
+        std::snprintf(line, sizeof(line), "  vs %s: mean error %.3f, max %d, %.3f%% of pixels off by more than %d: %s", path.c_str(),
+                      static_cast<double>(errorSum) / pixels.size(), maxError, mismatchPercent, tolerance, pass ? "pass" : "FAIL");
+        std::cout << line << std::endl;
+        if (!pass) {
+            exitCode = 1;
+        }
+    }
+    return exitCode;
+}
+
+void runCpuBenchmark(std::ostream& out, const RenderSettings& settings, float fov) {
+    using Clock = std::chrono::steady_clock;
+    const KeplerKernel kernels[] = {KeplerKernel::Scalar, KeplerKernel::Sse, KeplerKernel::Avx2};
+    uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // A fixed view with the sphere, cube, grid and the default asteroid belt in frame
+    FarmJob job;
+    job.width = 1280;
+    job.height = 720;
+    job.fov = fov;
+    job.position = glm::vec3(0.0f, 1.5f, 7.0f);
+    job.pitch = -10.0f;
+    job.settings = settings;
+    OrbitSystem orbits;
+    addAsteroidBelt(orbits, 1000, 1);
+    std::vector<float> bodies(orbits.paddedSize() * 4);
+    orbits.update(1.0, bodies.data());
+    CpuScene scene = makeCpuScene(job.camera(), 1.0f, settings, job.width, job.height, true, false);
+    scene.bodies = bodies.data();
+    scene.bodyCount = static_cast<uint32_t>(orbits.count);
+    scene.bodyBounds = orbits.boundingRadius;
+    std::vector<uint32_t> pixels(static_cast<size_t>(job.width) * job.height);
+
+    // Repeats until half a second has passed; returns seconds per frame
+    auto measure = [&](CpuRaymarcher& marcher, uint32_t& steals) {
+        if (marcher.getThreadCount() > 1) {
+            marcher.render(scene, pixels.data()); // Wake the workers up
+        }
+        uint64_t frames = 0;
+        uint64_t stealTotal = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        while (elapsed < 0.5) {
+            marcher.render(scene, pixels.data());
+            stealTotal += marcher.steals;
+            ++frames;
+            elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+        steals = static_cast<uint32_t>(stealTotal / frames);
+        return elapsed / frames;
+    };
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "CPU raymarcher, %ux%u, %s grid, %zu bodies (%u hardware threads, best kernel %s)",
+                  job.width, job.height, gridModeName(settings.gridMode), orbits.count, hardwareThreads,
+                  keplerKernelName(bestKeplerKernel()));
+    out << line << std::endl;
+    std::snprintf(line, sizeof(line), "  %-7s %7s %10s %10s %8s %10s %7s", "kernel", "threads", "ms/frame", "Mpixel/s", "speedup",
+                  "efficiency", "steals");
+    out << line << std::endl;
+
+    uint32_t steals = 0;
+    double scalarSeconds = 0.0;
+    for (KeplerKernel kernel : kernels) {
+        if (static_cast<int>(kernel) > static_cast<int>(bestKeplerKernel())) {
+            continue;
+        }
+        JobSystem jobs(1);
+        CpuRaymarcher marcher(jobs);
+        marcher.kernel = kernel;
+        double seconds = measure(marcher, steals);
+        if (kernel == KeplerKernel::Scalar) {
+            scalarSeconds = seconds;
+        }
+        std::snprintf(line, sizeof(line), "  %-7s %7u %10.1f %10.2f %7.2fx %10s %7s", keplerKernelName(kernel), 1u, seconds * 1000.0,
+                      pixels.size() / seconds * 1e-6, scalarSeconds / seconds, "-", "-");
+        out << line << std::endl;
+    }
+
+    // Scaling of the best kernel: powers of two, then every hardware thread
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardwareThreads);
+    double singleSeconds = 0.0;
+    for (uint32_t threads : threadCounts) {
+        JobSystem jobs(threads);
+        CpuRaymarcher marcher(jobs);
+        double seconds = measure(marcher, steals);
+        if (threads == 1) {
+            singleSeconds = seconds;
+        }
+        double speedup = singleSeconds / seconds;
+        std::snprintf(line, sizeof(line), "  %-7s %7u %10.1f %10.2f %7.2fx %9.0f%% %7u", keplerKernelName(marcher.kernel), threads,
+                      seconds * 1000.0, pixels.size() / seconds * 1e-6, speedup, speedup / threads * 100.0, steals);
+        out << line << std::endl;
+    }
+}
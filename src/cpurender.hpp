@@ -0,0 +1,85 @@
+#pragma once
+#include "config.hpp"
+#include "memory.hpp"
+#include "orbits.hpp"
+#include "pipeline.hpp"
+#include "settings.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct JobSystem;
+
+// Everything one frame of the CPU raymarcher reads: the raymarch UBO's inputs, with the
+// per-frame constants the shader recomputes per pixel (ray basis, cube position) hoisted
+struct CpuScene {
+    uint32_t width = 1;
+    uint32_t height = 1;
+    glm::vec3 camPos = glm::vec3(0.0f);
+    // Unnormalized ray through fragment uv is rayX * uv.x + rayY * uv.y + rayZ
+    glm::vec3 rayX = glm::vec3(0.0f);
+    glm::vec3 rayY = glm::vec3(0.0f);
+    glm::vec3 rayZ = glm::vec3(0.0f);
+    glm::vec3 cubeCenter = glm::vec3(0.0f);
+    int maxSteps = 100;
+    float epsilon = 0.001f;
+    float farDistance = 400.0f;
+    uint32_t marchStrategy = MARCH_STANDARD;
+    uint32_t gridMode = GRID_ANALYTIC;
+    const float* bodies = nullptr; // vec4(position, radius) each, as in the body buffer
+    uint32_t bodyCount = 0;
+    float bodyBounds = 0.0f;
+    const uint8_t* encode = nullptr; // cpuEncodeTable()
+    bool bgra = false;               // Pack B, G, R, A instead of R, G, B, A
+};
+
+// Fills everything but the bodies for a width x height frame, as Pipeline::updateUBO does.
+// srgb picks the encoding an _SRGB target applies on store; otherwise values are stored linear.
+CpuScene makeCpuScene(const Camera& camera, float time, const RenderSettings& settings,
+                      uint32_t width, uint32_t height, bool srgb, bool bgra);
+// 65536 entries mapping [0, 1] to the 8-bit output value
+const uint8_t* cpuEncodeTable(bool srgb);
+
+// Software backend for machines without a usable GPU: reproduces raymarch.frag's primary
+// pass (no adaptive AA or step histogram) with SIMD ray packets. The frame is cut into
+// tiles, and runs of neighbouring tiles become jobs on the JobSystem; idle threads steal
+// the runs the others have not reached, so expensive screen regions even out.
+struct CpuRaymarcher {
+    static constexpr uint32_t TILE_SIZE = 32;
+    static constexpr uint32_t JOBS_PER_THREAD = 8; // Tile runs per thread and frame, to steal from
+
+    JobSystem& jobs;
+    KeplerKernel kernel; // Same instruction set levels and detection as the Kepler solver
+    double renderSeconds; // Wall time of the last render
+    uint32_t steals;      // Tile runs stolen during the last render
+
+    // render() must be called from the thread that created jobs
+    explicit CpuRaymarcher(JobSystem& jobs);
+
+    // pixels receives width * height packed 8-bit texels, top row first
+    void render(const CpuScene& scene, uint32_t* pixels);
+    uint32_t getThreadCount() const;
+};
+
+// Per-frame host buffers the CPU image is rendered straight into and copied to the
+// offscreen target from; a slot is only written once its fence has signalled
+struct CpuSceneBuffers {
+    MemoryAllocator& allocator;
+    std::vector<Buffer> buffers;
+    VkExtent2D extent;
+
+    CpuSceneBuffers(MemoryAllocator& allocator, uint32_t framesInFlight);
+    ~CpuSceneBuffers();
+
+    // Reallocates every slot when the scene size changed; waits for the device first
+    void resize(VkExtent2D sceneExtent);
+    uint32_t* pixels(uint32_t frameIndex) { return static_cast<uint32_t*>(buffers[frameIndex].allocation.mapped); }
+};
+
+// Headless mode (cpu.headless): renders the [farm] frames on the CPU and writes them as
+// PPM; with cpu.reference set, compares each frame with a reference image (e.g. the farm's
+// GPU output) and fails when too many pixels differ. Returns the exit code.
+int runCpuRender(Config& config, const RenderSettings& settings, float fov);
+// Prints frame times per kernel and the scaling from 1 to every hardware thread
+void runCpuBenchmark(std::ostream& out, const RenderSettings& settings, float fov);
@@ -0,0 +1,8 @@
+// Built with -mavx2 -mfma -ffp-contract=off (see CMakeLists.txt); only reached when the CPU reports both
+#include "cpurender_kernel.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+void marchSpanAvx2(const CpuScene& scene, uint32_t x, uint32_t y, uint32_t count, uint32_t* out) {
+    marchSpan<Avx2MarchOps>(scene, x, y, count, out);
+}
+#endif
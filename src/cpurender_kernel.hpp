@@ -0,0 +1,449 @@
+#pragma once
+// Packet raymarch kernel shared by cpurender.cpp (scalar, SSE2) and cpurender_avx2.cpp (built
+// with AVX2/FMA). Like orbits_kernel.hpp, everything is in an anonymous namespace so each
+// translation unit keeps its own copy compiled for its own instruction set.
+//
+// Each packet is WIDTH horizontally adjacent pixels. The grid walk, body tests, march and
+// normals run across the packet with per-lane masks; picking colors and shading is per lane.
+// Keep in sync with traceScene() in raymarch.frag.
+#include "cpurender.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr float GRID_SPACING = 8.0f;
+constexpr float GRID_LINE_RADIUS = 0.04f;
+constexpr float SMIN_K = 0.5f;
+constexpr uint32_t MAX_WIDTH = 8;
+
+struct ScalarMarchOps {
+    static constexpr size_t WIDTH = 1;
+    using F = float;
+    using M = bool;
+
+    static F set(float value) { return value; }
+    static F load(const float* p) { return *p; }
+    static void store(float* p, F x) { *p = x; }
+    static F min(F a, F b) { return std::min(a, b); }
+    static F max(F a, F b) { return std::max(a, b); }
+    static F abs(F x) { return std::fabs(x); }
+    static F sqrt(F x) { return std::sqrt(x); }
+    static F floor(F x) { return std::floor(x); }
+    static M less(F a, F b) { return a < b; }
+    static M lessEqual(F a, F b) { return a <= b; }
+    static M both(M a, M b) { return a && b; }
+    static M either(M a, M b) { return a || b; }
+    static M andNot(M a, M b) { return a && !b; }
+    static F select(M mask, F a, F b) { return mask ? a : b; }
+    static uint32_t bits(M mask) { return mask ? 1u : 0u; }
+};
+
+#if defined(__SSE2__)
+struct SseMarchOps {
+    static constexpr size_t WIDTH = 4;
+    using F = __m128;
+    using M = __m128;
+
+    static F set(float value) { return _mm_set1_ps(value); }
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, F x) { _mm_storeu_ps(p, x); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F abs(F x) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), x); }
+    static F sqrt(F x) { return _mm_sqrt_ps(x); }
+    static F floor(F x) {
+        // No SSE4.1 round; truncate and step down where that rounded up. Fine for the
+        // scene's coordinates, which stay far below 2^31.
+        F truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+    }
+    static M less(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static M lessEqual(F a, F b) { return _mm_cmple_ps(a, b); }
+    static M both(M a, M b) { return _mm_and_ps(a, b); }
+    static M either(M a, M b) { return _mm_or_ps(a, b); }
+    static M andNot(M a, M b) { return _mm_andnot_ps(b, a); }
+    static F select(M mask, F a, F b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    static uint32_t bits(M mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+};
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+struct Avx2MarchOps {
+    static constexpr size_t WIDTH = 8;
+    using F = __m256;
+    using M = __m256;
+
+    static F set(float value) { return _mm256_set1_ps(value); }
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, F x) { _mm256_storeu_ps(p, x); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F abs(F x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+    static F sqrt(F x) { return _mm256_sqrt_ps(x); }
+    static F floor(F x) { return _mm256_floor_ps(x); }
+    static M less(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M lessEqual(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static M both(M a, M b) { return _mm256_and_ps(a, b); }
+    static M either(M a, M b) { return _mm256_or_ps(a, b); }
+    static M andNot(M a, M b) { return _mm256_andnot_ps(b, a); }
+    static F select(M mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+    static uint32_t bits(M mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask)); }
+};
+#endif
+
+template <class Ops>
+inline typename Ops::F length2(typename Ops::F x, typename Ops::F y) {
+    return Ops::sqrt(x * x + y * y);
+}
+
+template <class Ops>
+inline typename Ops::F gridDistance(typename Ops::F px, typename Ops::F py, typename Ops::F pz) {
+    using F = typename Ops::F;
+    const F spacing = Ops::set(GRID_SPACING);
+    const F invSpacing = Ops::set(1.0f / GRID_SPACING);
+    const F half = Ops::set(0.5f * GRID_SPACING);
+    // GLSL mod(p, s) - s / 2
+    F qx = px - spacing * Ops::floor(px * invSpacing) - half;
+    F qy = py - spacing * Ops::floor(py * invSpacing) - half;
+    F qz = pz - spacing * Ops::floor(pz * invSpacing) - half;
+    F dx = Ops::min(length2<Ops>(qy, qz), length2<Ops>(qy, qz - spacing));
+    F dy = Ops::min(length2<Ops>(qx, qz), length2<Ops>(qx, qz - spacing));
+    F dz = Ops::min(length2<Ops>(qx, qy), length2<Ops>(qx, qy - spacing));
+    return Ops::min(Ops::min(dx, dy), dz) - Ops::set(GRID_LINE_RADIUS);
+}
+
+// sceneSDF().dist; withGrid is per lane since the compare split can cross a packet
+template <class Ops>
+inline typename Ops::F sceneDistance(const CpuScene& scene, typename Ops::F px, typename Ops::F py, typename Ops::F pz,
+                                     typename Ops::M withGrid) {
+    using F = typename Ops::F;
+    const F zero = Ops::set(0.0f);
+    const F one = Ops::set(1.0f);
+    const F k = Ops::set(SMIN_K);
+    F sphere = Ops::sqrt(px * px + py * py + pz * pz) - one;
+
+    const F halfSize = Ops::set(0.5f);
+    F dx = Ops::abs(px - Ops::set(scene.cubeCenter.x)) - halfSize;
+    F dy = Ops::abs(py - Ops::set(scene.cubeCenter.y)) - halfSize;
+    F dz = Ops::abs(pz - Ops::set(scene.cubeCenter.z)) - halfSize;
+    F ox = Ops::max(dx, zero);
+    F oy = Ops::max(dy, zero);
+    F oz = Ops::max(dz, zero);
+    F cube = Ops::sqrt(ox * ox + oy * oy + oz * oz) + Ops::min(Ops::max(dx, Ops::max(dy, dz)), zero);
+
+    // smin(sphere, cube, k)
+    F h = Ops::min(Ops::max(Ops::set(0.5f) + Ops::set(0.5f) * (cube - sphere) / k, zero), one);
+    F dist = cube + (sphere - cube) * h - k * h * (one - h);
+    if (Ops::bits(withGrid)) {
+        dist = Ops::select(withGrid, Ops::min(dist, gridDistance<Ops>(px, py, pz)), dist);
+    }
+    return dist;
+}
+
+// gridLineHit() for one line; the ray origin is shared by every lane
+template <class Ops>
+inline typename Ops::F gridLineHit(float ro0, float ro1, typename Ops::F rd0, typename Ops::F rd1,
+                                   typename Ops::F center0, typename Ops::F center1) {
+    using F = typename Ops::F;
+    F oc0 = Ops::set(ro0) - center0;
+    F oc1 = Ops::set(ro1) - center1;
+    F a = rd0 * rd0 + rd1 * rd1;
+    F b = oc0 * rd0 + oc1 * rd1;
+    F c = oc0 * oc0 + oc1 * oc1 - Ops::set(GRID_LINE_RADIUS * GRID_LINE_RADIUS);
+    F h = b * b - a * c;
+    auto valid = Ops::andNot(Ops::lessEqual(Ops::set(1e-12f), a), Ops::less(h, Ops::set(0.0f)));
+    F t = (Ops::set(0.0f) - b - Ops::sqrt(Ops::max(h, Ops::set(0.0f)))) / Ops::max(a, Ops::set(1e-12f));
+    return Ops::select(valid, t, Ops::set(-1.0f));
+}
+
+// Per lane results of traceGrid(); node and axis give the normal
+struct GridLanes {
+    float t[MAX_WIDTH];
+    float axis[MAX_WIDTH];
+    float node[3][MAX_WIDTH];
+};
+
+// traceGrid() for the lanes in active: each lane walks its own cells, the packet stops once
+// every lane has hit a line or left tMax behind
+template <class Ops>
+void traceGridPacket(const CpuScene& scene, const typename Ops::F rd[3], typename Ops::M active, GridLanes& out) {
+    using F = typename Ops::F;
+    using M = typename Ops::M;
+    const F zero = Ops::set(0.0f);
+    const F spacing = Ops::set(GRID_SPACING);
+    const F eps = Ops::set(1e-4f);
+    const float tMax = scene.farDistance;
+    const float ro[3] = {scene.camPos.x, scene.camPos.y, scene.camPos.z};
+
+    F invDir[3], stepDir[3], cell[3], tDelta[3], tNext[3];
+    for (int a = 0; a < 3; ++a) {
+        F dir = Ops::select(Ops::less(Ops::abs(rd[a]), Ops::set(1e-8f)), Ops::set(1e-8f), rd[a]);
+        invDir[a] = Ops::set(1.0f) / dir;
+        stepDir[a] = Ops::select(Ops::less(dir, zero), Ops::set(-1.0f), Ops::set(1.0f));
+        cell[a] = Ops::set(std::floor(ro[a] / GRID_SPACING));
+        tDelta[a] = Ops::abs(spacing * invDir[a]);
+        tNext[a] = ((cell[a] + Ops::max(stepDir[a], zero)) * spacing - Ops::set(ro[a])) * invDir[a];
+    }
+    F tEnter = zero;
+    F resultT = Ops::set(-1.0f);
+    F resultAxis = Ops::set(-1.0f);
+    F node[3] = {zero, zero, zero};
+
+    int maxCells = std::min(static_cast<int>(tMax / GRID_SPACING) * 3 + 3, 512);
+    active = Ops::both(active, Ops::lessEqual(tEnter, Ops::set(tMax)));
+    for (int i = 0; i < maxCells && Ops::bits(active); ++i) {
+        F n[3];
+        for (int a = 0; a < 3; ++a) {
+            n[a] = (cell[a] + Ops::set(0.5f)) * spacing;
+        }
+        F tExit = Ops::min(tNext[0], Ops::min(tNext[1], tNext[2]));
+
+        F tx = gridLineHit<Ops>(ro[1], ro[2], rd[1], rd[2], n[1], n[2]);
+        F ty = gridLineHit<Ops>(ro[0], ro[2], rd[0], rd[2], n[0], n[2]);
+        F tz = gridLineHit<Ops>(ro[0], ro[1], rd[0], rd[1], n[0], n[1]);
+        F best = tExit + eps;
+        F axis = Ops::set(-1.0f);
+        F floorT = tEnter - eps;
+        M takeX = Ops::both(Ops::lessEqual(floorT, tx), Ops::less(tx, best));
+        best = Ops::select(takeX, tx, best);
+        axis = Ops::select(takeX, zero, axis);
+        M takeY = Ops::both(Ops::lessEqual(floorT, ty), Ops::less(ty, best));
+        best = Ops::select(takeY, ty, best);
+        axis = Ops::select(takeY, Ops::set(1.0f), axis);
+        M takeZ = Ops::both(Ops::lessEqual(floorT, tz), Ops::less(tz, best));
+        best = Ops::select(takeZ, tz, best);
+        axis = Ops::select(takeZ, Ops::set(2.0f), axis);
+
+        // A line in this cell ends the walk, hit or not (beyond tMax)
+        M found = Ops::both(active, Ops::lessEqual(zero, axis));
+        M record = Ops::both(found, Ops::lessEqual(best, Ops::set(tMax)));
+        resultT = Ops::select(record, best, resultT);
+        resultAxis = Ops::select(record, axis, resultAxis);
+        for (int a = 0; a < 3; ++a) {
+            node[a] = Ops::select(record, n[a], node[a]);
+        }
+        active = Ops::andNot(active, found);
+
+        // Step into the neighbour across the nearest boundary
+        M advanceX = Ops::both(Ops::lessEqual(tNext[0], tNext[1]), Ops::lessEqual(tNext[0], tNext[2]));
+        M advanceY = Ops::andNot(Ops::lessEqual(tNext[1], tNext[2]), advanceX);
+        M advanceZ = Ops::andNot(Ops::andNot(Ops::lessEqual(zero, zero), advanceX), advanceY);
+        M advance[3] = {advanceX, advanceY, advanceZ};
+        for (int a = 0; a < 3; ++a) {
+            cell[a] = cell[a] + Ops::select(advance[a], stepDir[a], zero);
+            tNext[a] = tNext[a] + Ops::select(advance[a], tDelta[a], zero);
+        }
+        tEnter = tExit;
+        active = Ops::both(active, Ops::lessEqual(tEnter, Ops::set(tMax)));
+    }
+
+    Ops::store(out.t, resultT);
+    Ops::store(out.axis, resultAxis);
+    for (int a = 0; a < 3; ++a) {
+        Ops::store(out.node[a], node[a]);
+    }
+}
+
+// Scalar sceneSDF() color at a march hit
+inline glm::vec3 sceneColor(const CpuScene& scene, glm::vec3 p, bool withGrid) {
+    float sphere = glm::length(p) - 1.0f;
+    glm::vec3 d = glm::abs(p - scene.cubeCenter) - glm::vec3(0.5f);
+    float cube = glm::length(glm::max(d, 0.0f)) + std::min(std::max(d.x, std::max(d.y, d.z)), 0.0f);
+    float h = std::clamp(0.5f + 0.5f * (cube - sphere) / SMIN_K, 0.0f, 1.0f);
+    float dist = cube + (sphere - cube) * h - SMIN_K * h * (1.0f - h);
+    float grid = withGrid ? gridDistance<ScalarMarchOps>(p.x, p.y, p.z) : dist + 1.0f;
+    if (std::min(dist, grid) == grid) {
+        return glm::vec3(0.0f); // Black grid
+    }
+    // Red cube blended into the teal sphere
+    return glm::mix(glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.08f, 0.6f, 0.5f), h);
+}
+
+inline uint32_t encodePixel(const CpuScene& scene, glm::vec3 color) {
+    auto channel = [&](float value) {
+        return static_cast<uint32_t>(scene.encode[static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f)]);
+    };
+    uint32_t r = channel(color.r);
+    uint32_t g = channel(color.g);
+    uint32_t b = channel(color.b);
+    // Little-endian packing: bytes R, G, B, A in memory (B, G, R, A for bgra)
+    return scene.bgra ? (b | g << 8 | r << 16 | 0xff000000u) : (r | g << 8 | b << 16 | 0xff000000u);
+}
+
+// Pixels [x, x + count) of row y, count <= WIDTH
+template <class Ops>
+void marchPacket(const CpuScene& scene, uint32_t x, uint32_t y, uint32_t count, uint32_t* out) {
+    using F = typename Ops::F;
+    using M = typename Ops::M;
+    constexpr size_t W = Ops::WIDTH;
+    const F zero = Ops::set(0.0f);
+    const M all = Ops::lessEqual(zero, zero);
+
+    // Rays, with lanes past count repeating the last pixel
+    float rayLanes[3][W];
+    float analyticLanes[W];
+    float ndcX[W];
+    float ndcY = (y + 0.5f) * 2.0f / scene.height - 1.0f;
+    for (size_t lane = 0; lane < W; ++lane) {
+        uint32_t px = x + std::min(static_cast<uint32_t>(lane), count - 1);
+        ndcX[lane] = (px + 0.5f) * 2.0f / scene.width - 1.0f;
+        glm::vec3 rd = glm::normalize(scene.rayX * (ndcX[lane] * -0.5f) + scene.rayY * (ndcY * 0.5f) + scene.rayZ);
+        rayLanes[0][lane] = rd.x;
+        rayLanes[1][lane] = rd.y;
+        rayLanes[2][lane] = rd.z;
+        bool analytic = scene.gridMode == GRID_ANALYTIC || (scene.gridMode == GRID_COMPARE && ndcX[lane] > 0.0f);
+        analyticLanes[lane] = analytic ? 1.0f : 0.0f;
+    }
+    F rd[3] = {Ops::load(rayLanes[0]), Ops::load(rayLanes[1]), Ops::load(rayLanes[2])};
+    M analytic = Ops::less(zero, Ops::load(analyticLanes));
+
+    // Exact surfaces first; they bound the march
+    GridLanes grid;
+    std::fill(grid.t, grid.t + W, -1.0f);
+    if (Ops::bits(analytic)) {
+        traceGridPacket<Ops>(scene, rd, analytic, grid);
+    }
+    F surfaceT = Ops::load(grid.t);
+
+    float bodyT[W];
+    float bodyIndex[W];
+    std::fill(bodyT, bodyT + W, -1.0f);
+    std::fill(bodyIndex, bodyIndex + W, 0.0f);
+    if (scene.bodyCount > 0) {
+        // Skip the loop when every ray misses the sphere holding every orbit
+        glm::vec3 ro = scene.camPos;
+        F b = rd[0] * Ops::set(ro.x) + rd[1] * Ops::set(ro.y) + rd[2] * Ops::set(ro.z);
+        F h = b * b - Ops::set(glm::dot(ro, ro) - scene.bodyBounds * scene.bodyBounds);
+        M inBounds = Ops::andNot(Ops::lessEqual(zero, h), Ops::less(Ops::sqrt(Ops::max(h, zero)) - b, zero));
+        if (Ops::bits(inBounds)) {
+            F nearest = Ops::select(Ops::lessEqual(zero, surfaceT), surfaceT, Ops::set(scene.farDistance));
+            F tMax = nearest;
+            F nearestIndex = zero;
+            for (uint32_t i = 0; i < scene.bodyCount; ++i) {
+                const float* body = scene.bodies + i * 4;
+                glm::vec3 oc = ro - glm::vec3(body[0], body[1], body[2]);
+                F bb = rd[0] * Ops::set(oc.x) + rd[1] * Ops::set(oc.y) + rd[2] * Ops::set(oc.z);
+                F hh = bb * bb - Ops::set(glm::dot(oc, oc) - body[3] * body[3]);
+                F t = zero - bb - Ops::sqrt(Ops::max(hh, zero));
+                M closer = Ops::both(Ops::both(Ops::lessEqual(zero, hh), Ops::less(zero, t)), Ops::less(t, nearest));
+                nearest = Ops::select(closer, t, nearest);
+                nearestIndex = Ops::select(closer, Ops::set(static_cast<float>(i)), nearestIndex);
+            }
+            M hit = Ops::both(inBounds, Ops::less(nearest, tMax));
+            Ops::store(bodyT, Ops::select(hit, nearest, Ops::set(-1.0f)));
+            Ops::store(bodyIndex, nearestIndex);
+            surfaceT = Ops::select(hit, nearest, surfaceT);
+        }
+    }
+    F marchLimit = Ops::select(Ops::lessEqual(zero, surfaceT), surfaceT, Ops::set(scene.farDistance));
+
+    // Sphere trace the dynamic objects, lanes dropping out as they hit or pass marchLimit
+    const F ro[3] = {Ops::set(scene.camPos.x), Ops::set(scene.camPos.y), Ops::set(scene.camPos.z)};
+    M withGrid = Ops::andNot(all, analytic);
+    M active = all;
+    M hit = Ops::less(zero, zero);
+    F t = zero;
+    F omega = Ops::set(scene.marchStrategy == MARCH_RELAXED ? 1.6f : 1.0f);
+    F stepLength = zero;
+    F prevRadius = zero;
+    const F one = Ops::set(1.0f);
+    for (int i = 0; i < scene.maxSteps && Ops::bits(active); ++i) {
+        F dist = sceneDistance<Ops>(scene, ro[0] + rd[0] * t, ro[1] + rd[1] * t, ro[2] + rd[2] * t, withGrid);
+
+        M relaxFailed = Ops::both(Ops::less(one, omega), Ops::less(Ops::abs(dist) + prevRadius, stepLength));
+        stepLength = Ops::select(relaxFailed, stepLength - omega * stepLength, dist * omega);
+        omega = Ops::select(relaxFailed, one, omega);
+        prevRadius = Ops::abs(dist);
+
+        F eps = Ops::set(scene.epsilon);
+        if (scene.marchStrategy == MARCH_ADAPTIVE) {
+            eps = eps * Ops::max(one, t);
+        }
+        M newHit = Ops::both(active, Ops::andNot(Ops::less(dist, eps), relaxFailed));
+        hit = Ops::either(hit, newHit);
+        active = Ops::andNot(active, newHit);
+        t = Ops::select(active, t + stepLength, t);
+        active = Ops::andNot(active, Ops::less(marchLimit, t));
+    }
+
+    // calcNormal() at the march hits
+    float normalLanes[3][W];
+    uint32_t hitBits = Ops::bits(hit);
+    if (hitBits) {
+        F p[3] = {ro[0] + rd[0] * t, ro[1] + rd[1] * t, ro[2] + rd[2] * t};
+        const float hs = 0.001f;
+        const float k[4][3] = {{1, -1, -1}, {-1, -1, 1}, {-1, 1, -1}, {1, 1, 1}};
+        F n[3] = {zero, zero, zero};
+        for (int s = 0; s < 4; ++s) {
+            F d = sceneDistance<Ops>(scene, p[0] + Ops::set(k[s][0] * hs), p[1] + Ops::set(k[s][1] * hs),
+                                     p[2] + Ops::set(k[s][2] * hs), withGrid);
+            for (int a = 0; a < 3; ++a) {
+                n[a] = n[a] + Ops::set(k[s][a]) * d;
+            }
+        }
+        for (int a = 0; a < 3; ++a) {
+            Ops::store(normalLanes[a], n[a]);
+        }
+    }
+    float tLanes[W];
+    float surfaceLanes[W];
+    Ops::store(tLanes, t);
+    Ops::store(surfaceLanes, surfaceT);
+
+    // Shade per lane
+    const glm::vec3 lightDir = glm::normalize(glm::vec3(1.0f));
+    for (size_t lane = 0; lane < count; ++lane) {
+        glm::vec3 rayDir(rayLanes[0][lane], rayLanes[1][lane], rayLanes[2][lane]);
+        bool marchHit = (hitBits >> lane) & 1;
+        bool surfaceHit = !marchHit && surfaceLanes[lane] >= 0.0f;
+        glm::vec3 color(1.0f); // White background
+        if (marchHit || surfaceHit) {
+            float hitT = marchHit ? tLanes[lane] : surfaceLanes[lane];
+            glm::vec3 p = scene.camPos + rayDir * hitT;
+            glm::vec3 normal;
+            glm::vec3 albedo;
+            if (marchHit) {
+                albedo = sceneColor(scene, p, analyticLanes[lane] == 0.0f);
+                normal = glm::normalize(glm::vec3(normalLanes[0][lane], normalLanes[1][lane], normalLanes[2][lane]));
+            } else if (bodyT[lane] >= 0.0f) {
+                uint32_t index = static_cast<uint32_t>(bodyIndex[lane]);
+                const float* body = scene.bodies + index * 4;
+                normal = glm::normalize(p - glm::vec3(body[0], body[1], body[2]));
+                // The GPU's sin differs at these arguments, so the shade of a body is not bit-exact
+                float shade = glm::fract(std::sin(static_cast<float>(index) * 12.9898f) * 43758.5453f);
+                albedo = glm::mix(glm::vec3(0.35f, 0.33f, 0.3f), glm::vec3(0.55f, 0.42f, 0.3f), shade);
+            } else {
+                int axis = static_cast<int>(grid.axis[lane]);
+                glm::vec3 offset = p - glm::vec3(grid.node[0][lane], grid.node[1][lane], grid.node[2][lane]);
+                offset[axis] = 0.0f;
+                normal = glm::normalize(offset);
+                albedo = glm::vec3(0.0f);
+            }
+            float diffuse = std::max(glm::dot(normal, lightDir), 0.0f);
+            glm::vec3 lit = albedo * (diffuse * 0.8f + 0.2f);
+            float fog = 1.0f - std::exp(-0.01f * hitT);
+            color = glm::mix(lit, glm::vec3(1.0f), fog);
+        }
+        // Divider between the compare halves, one pixel either side of the centre
+        if (scene.gridMode == GRID_COMPARE && std::fabs(ndcX[lane]) < 2.0f / scene.width) {
+            color = glm::vec3(1.0f, 0.0f, 1.0f);
+        }
+        out[lane] = encodePixel(scene, color);
+    }
+}
+
+// Row span [x, x + count) of row y into out
+template <class Ops>
+void marchSpan(const CpuScene& scene, uint32_t x, uint32_t y, uint32_t count, uint32_t* out) {
+    for (uint32_t i = 0; i < count; i += Ops::WIDTH) {
+        marchPacket<Ops>(scene, x + i, y, std::min<uint32_t>(Ops::WIDTH, count - i), out + i);
+    }
+}
+
+} // namespace
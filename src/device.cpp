@@ -3,6 +3,8 @@
 #include <set>
 #include <cstring>
 #include <iostream>
+#include <cstdlib>
+#include <cstdint>
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -15,7 +17,102 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     return VK_FALSE;
 }
 
-Device::Device(GLFWwindow* window) {
+struct QueueFamilies {
+    uint32_t graphics = UINT32_MAX;
+    uint32_t present = UINT32_MAX;
+    uint32_t compute = UINT32_MAX;  // Compute without graphics (async compute)
+    uint32_t transfer = UINT32_MAX; // Transfer only (DMA engine)
+};
+
+static QueueFamilies findQueueFamilies(VkPhysicalDevice dev, VkSurfaceKHR surface) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(dev, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(dev, &queueFamilyCount, queueFamilies.data());
+
+    QueueFamilies families;
+    for (uint32_t i = 0; i < queueFamilyCount; ++i) {
+        VkQueueFlags flags = queueFamilies[i].queueFlags;
+        VkBool32 presentSupport = false;
+        if (surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupport);
+        }
+
+        // Prefer a single family that can both draw and present
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && presentSupport &&
+            (families.graphics == UINT32_MAX || families.graphics != families.present)) {
+            families.graphics = i;
+            families.present = i;
+        }
+        if ((flags & VK_QUEUE_GRAPHICS_BIT) && families.graphics == UINT32_MAX) {
+            families.graphics = i;
+        }
+        if (presentSupport && families.present == UINT32_MAX) {
+            families.present = i;
+        }
+        if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && families.compute == UINT32_MAX) {
+            families.compute = i;
+        }
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            families.transfer == UINT32_MAX) {
+            families.transfer = i;
+        }
+    }
+    return families;
+}
+
+static bool supportsSwapchain(VkPhysicalDevice dev) {
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(dev, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(dev, nullptr, &extensionCount, extensions.data());
+    for (const auto& ext : extensions) {
+        if (strcmp(ext.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Higher is better. Device type dominates, then device-local memory, then limits.
+static int64_t scoreDevice(VkPhysicalDevice dev) {
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(dev, &props);
+    VkPhysicalDeviceMemoryProperties memProps;
+    vkGetPhysicalDeviceMemoryProperties(dev, &memProps);
+
+    int64_t score = 0;
+    switch (props.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 100000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 10000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 5000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: score += 1000; break;
+        default: break;
+    }
+
+    // One point per 64 MiB of device-local memory
+    VkDeviceSize deviceLocal = 0;
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; ++i) {
+        if (memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            deviceLocal += memProps.memoryHeaps[i].size;
+        }
+    }
+    score += static_cast<int64_t>(deviceLocal >> 26);
+
+    score += props.limits.maxImageDimension2D / 1024;
+    score += props.limits.maxComputeSharedMemorySize / 4096;
+    return score;
+}
+
+Device::Device(GLFWwindow* window, const std::string& gpuSelection, bool forceVulkan10) : window(window) {
+    // Use Vulkan 1.3 when the loader has it; forceVulkan10 selects the 1.0 render pass path
+    uint32_t instanceVersion = VK_API_VERSION_1_0;
+    auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    if (enumerateInstanceVersion) {
+        enumerateInstanceVersion(&instanceVersion);
+    }
+    apiVersion = (instanceVersion >= VK_API_VERSION_1_3 && !forceVulkan10) ? VK_API_VERSION_1_3 : VK_API_VERSION_1_0;
+
     // Create instance
     VkApplicationInfo appInfo = {};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -23,21 +120,25 @@ Device::Device(GLFWwindow* window) {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = apiVersion;
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    // Headless devices (window == nullptr) need no surface extensions
+    std::vector<const char*> extensions;
+    if (window) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 #ifdef USE_VULKAN_VALIDATION
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 #endif
 
     createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-    createInfo.ppEnabledExtensionNames = extensions.data();
+    createInfo.ppEnabledExtensionNames = extensions.empty() ? nullptr : extensions.data();
 
 #ifdef USE_VULKAN_VALIDATION
     const char* validationLayers[] = {"VK_LAYER_KHRONOS_validation"};
@@ -66,11 +167,12 @@ Device::Device(GLFWwindow* window) {
 #endif
 
     // Create surface
-    if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
+    surface = VK_NULL_HANDLE;
+    if (window && glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface");
     }
 
-    // Pick physical device
+    // Pick physical device: score every candidate, honour a user override
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
     if (deviceCount == 0) {
@@ -80,35 +182,33 @@ Device::Device(GLFWwindow* window) {
     vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
     physicalDevice = VK_NULL_HANDLE;
-    for (const auto& dev : devices) {
-        VkPhysicalDeviceProperties properties;
-        vkGetPhysicalDeviceProperties(dev, &properties);
-        VkPhysicalDeviceFeatures features;
-        vkGetPhysicalDeviceFeatures(dev, &features);
-
-        uint32_t queueFamilyCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(dev, &queueFamilyCount, nullptr);
-        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(dev, &queueFamilyCount, queueFamilies.data());
-
-        graphicsFamily = -1;
-        presentFamily = -1;
-        for (uint32_t i = 0; i < queueFamilyCount; ++i) {
-            if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                graphicsFamily = i;
-            }
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupport);
-            if (presentSupport) {
-                presentFamily = i;
-            }
-            if (graphicsFamily != -1 && presentFamily != -1) {
-                physicalDevice = dev;
-                break;
+    int64_t bestScore = -1;
+    for (uint32_t i = 0; i < deviceCount; ++i) {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(devices[i], &props);
+
+        QueueFamilies families = findQueueFamilies(devices[i], surface);
+        bool suitable = families.graphics != UINT32_MAX &&
+                        (!window || (families.present != UINT32_MAX && supportsSwapchain(devices[i])));
+        int64_t score = suitable ? scoreDevice(devices[i]) : -1;
+        std::cout << "GPU " << i << ": " << props.deviceName << " (score " << score << ")" << std::endl;
+        if (!suitable) {
+            continue;
+        }
+
+        // gpuSelection is an index or a case-sensitive name substring
+        if (!gpuSelection.empty()) {
+            char* end = nullptr;
+            unsigned long index = std::strtoul(gpuSelection.c_str(), &end, 10);
+            bool matches = (*end == '\0') ? index == i : std::strstr(props.deviceName, gpuSelection.c_str()) != nullptr;
+            if (matches) {
+                score = INT64_MAX; // Override always wins among suitable devices
             }
         }
-        if (physicalDevice != VK_NULL_HANDLE) {
-            break;
+
+        if (score > bestScore) {
+            bestScore = score;
+            physicalDevice = devices[i];
         }
     }
 
@@ -116,9 +216,28 @@ Device::Device(GLFWwindow* window) {
         throw std::runtime_error("No suitable GPU found");
     }
 
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    std::cout << "Using GPU: " << properties.deviceName << std::endl;
+    if (!gpuSelection.empty() && bestScore != INT64_MAX) {
+        std::cerr << "gpu.device=" << gpuSelection << " matched no suitable GPU, using best score" << std::endl;
+    }
+
+    QueueFamilies families = findQueueFamilies(physicalDevice, surface);
+    graphicsFamily = families.graphics;
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> familyProperties(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, familyProperties.data());
+    timestampValidBits = properties.limits.timestampPeriod > 0.0f ? familyProperties[graphicsFamily].timestampValidBits : 0;
+    presentFamily = window ? families.present : families.graphics;
+    asyncCompute = families.compute != UINT32_MAX;
+    asyncTransfer = families.transfer != UINT32_MAX;
+    computeFamily = asyncCompute ? families.compute : graphicsFamily;
+    transferFamily = asyncTransfer ? families.transfer : graphicsFamily;
+
     // Create logical device
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily, presentFamily};
+    std::set<uint32_t> uniqueQueueFamilies = {graphicsFamily, presentFamily, computeFamily, transferFamily};
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -130,16 +249,78 @@ Device::Device(GLFWwindow* window) {
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    // Optional 1.2/1.3 features need both a 1.3 instance and a 1.3 device that exposes them
+    VkPhysicalDeviceFeatures supportedCore;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedCore);
+    bool vulkan13 = apiVersion >= VK_API_VERSION_1_3 && properties.apiVersion >= VK_API_VERSION_1_3;
+    dynamicRendering = false;
+    descriptorIndexing = false;
+    shaderFloat16 = false;
+    multiview = false;
+    timelineSemaphore = false;
+    if (vulkan13) {
+        VkPhysicalDeviceVulkan11Features supported11 = {};
+        supported11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+        VkPhysicalDeviceVulkan12Features supported12 = {};
+        supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        supported12.pNext = &supported11;
+        VkPhysicalDeviceVulkan13Features supported13 = {};
+        supported13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        supported13.pNext = &supported12;
+        VkPhysicalDeviceFeatures2 supported = {};
+        supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported.pNext = &supported13;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+        dynamicRendering = supported13.dynamicRendering && supported13.synchronization2;
+        descriptorIndexing = supported12.descriptorBindingPartiallyBound &&
+                             supported12.descriptorBindingUpdateUnusedWhilePending &&
+                             supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                             supported12.descriptorBindingStorageImageUpdateAfterBind &&
+                             supported12.descriptorBindingStorageBufferUpdateAfterBind;
+        shaderFloat16 = supported12.shaderFloat16;
+        multiview = supported11.multiview;
+        timelineSemaphore = supported12.timelineSemaphore;
+    }
+
+    VkPhysicalDeviceVulkan11Features features11 = {};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    features11.multiview = multiview;
+
+    VkPhysicalDeviceVulkan12Features features12 = {};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features12.pNext = &features11;
+    features12.descriptorBindingPartiallyBound = descriptorIndexing;
+    features12.descriptorBindingUpdateUnusedWhilePending = descriptorIndexing;
+    features12.descriptorBindingSampledImageUpdateAfterBind = descriptorIndexing;
+    features12.descriptorBindingStorageImageUpdateAfterBind = descriptorIndexing;
+    features12.descriptorBindingStorageBufferUpdateAfterBind = descriptorIndexing;
+    features12.shaderFloat16 = shaderFloat16;
+    features12.timelineSemaphore = timelineSemaphore;
+
+    VkPhysicalDeviceVulkan13Features features13 = {};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    features13.pNext = &features12;
+    features13.dynamicRendering = dynamicRendering;
+    features13.synchronization2 = dynamicRendering;
+
+    // Resource table arrays are indexed with dynamically uniform IDs from scene data
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = supportedCore.shaderSampledImageArrayDynamicIndexing;
+    deviceFeatures.shaderStorageBufferArrayDynamicIndexing = supportedCore.shaderStorageBufferArrayDynamicIndexing;
+    deviceFeatures.shaderStorageImageArrayDynamicIndexing = supportedCore.shaderStorageImageArrayDynamicIndexing;
+    // Debug counters (steps-per-pixel histogram) are written from the fragment shader
+    fragmentStoresAndAtomics = supportedCore.fragmentStoresAndAtomics;
+    deviceFeatures.fragmentStoresAndAtomics = fragmentStoresAndAtomics;
 
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.pNext = vulkan13 ? &features13 : nullptr;
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
     const char* deviceExtensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-    deviceCreateInfo.enabledExtensionCount = 1;
+    deviceCreateInfo.enabledExtensionCount = window ? 1 : 0;
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
     deviceCreateInfo.enabledLayerCount = 0;
 
@@ -149,27 +330,43 @@ Device::Device(GLFWwindow* window) {
 
     vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
     vkGetDeviceQueue(device, presentFamily, 0, &presentQueue);
+    vkGetDeviceQueue(device, computeFamily, 0, &computeQueue);
+    vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
+    std::cout << "Async compute: " << (asyncCompute ? "yes" : "no")
+              << ", async transfer: " << (asyncTransfer ? "yes" : "no") << std::endl;
+
+    cmdBeginRendering = nullptr;
+    cmdEndRendering = nullptr;
+    cmdPipelineBarrier2 = nullptr;
+    if (dynamicRendering) {
+        cmdBeginRendering = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(device, "vkCmdBeginRendering");
+        cmdEndRendering = (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(device, "vkCmdEndRendering");
+        cmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2)vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2");
+        dynamicRendering = cmdBeginRendering && cmdEndRendering && cmdPipelineBarrier2;
+    }
+    waitSemaphores = nullptr;
+    getSemaphoreCounterValue = nullptr;
+    if (timelineSemaphore) {
+        waitSemaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+        getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValue");
+        timelineSemaphore = waitSemaphores && getSemaphoreCounterValue;
+    }
+    std::cout << "Rendering path: " << (dynamicRendering ? "Vulkan 1.3 dynamic rendering" : "Vulkan 1.0 render pass") << std::endl;
+    std::cout << "Descriptor indexing: " << (descriptorIndexing ? "yes" : "no") << std::endl;
+    std::cout << "Float16 shaders: " << (shaderFloat16 ? "yes" : "no") << std::endl;
+    std::cout << "Multiview: " << (multiview ? "yes" : "no") << std::endl;
+    std::cout << "Frame sync: " << (timelineSemaphore ? "timeline semaphores" : "fences") << std::endl;
 
-    // Create descriptor pool for ImGui
+    // Create descriptor pool for ImGui; it only needs the font texture (scene resources live in ResourceTable)
     VkDescriptorPoolSize poolSizes[] = {
-        {VK_DESCRIPTOR_TYPE_SAMPLER, 1000},
-        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000},
-        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000},
-        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000}
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16}
     };
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    poolInfo.maxSets = 1000 * 11; // 11 types
-    poolInfo.poolSizeCount = 11;
+    poolInfo.maxSets = 16;
+    poolInfo.poolSizeCount = 1;
     poolInfo.pPoolSizes = poolSizes;
 
     if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
@@ -186,10 +383,68 @@ Device::~Device() {
     }
 #endif
     vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
     vkDestroyInstance(instance, nullptr);
 }
 
 void Device::waitIdle() {
     vkDeviceWaitIdle(device);
 }
+
+double Device::timestampSeconds(uint64_t begin, uint64_t end) const {
+    uint64_t mask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+    return ((end - begin) & mask) * static_cast<double>(properties.limits.timestampPeriod) * 1e-9;
+}
+
+VkQueue Device::getQueue(QueueType type) const {
+    switch (type) {
+        case QueueType::Compute: return computeQueue;
+        case QueueType::Transfer: return transferQueue;
+        default: return graphicsQueue;
+    }
+}
+
+uint32_t Device::getQueueFamily(QueueType type) const {
+    switch (type) {
+        case QueueType::Compute: return computeFamily;
+        case QueueType::Transfer: return transferFamily;
+        default: return graphicsFamily;
+    }
+}
+
+VkCommandPool Device::createCommandPool(QueueType type, VkCommandPoolCreateFlags flags) const {
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = getQueueFamily(type);
+    poolInfo.flags = flags;
+
+    VkCommandPool pool;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create command pool");
+    }
+    return pool;
+}
+
+void Device::submit(QueueType type, VkCommandBuffer commandBuffer,
+                    VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage,
+                    VkSemaphore signalSemaphore, VkFence fence) const {
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (waitSemaphore != VK_NULL_HANDLE) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &waitSemaphore;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (signalSemaphore != VK_NULL_HANDLE) {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &signalSemaphore;
+    }
+
+    if (vkQueueSubmit(getQueue(type), 1, &submitInfo, fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to submit command buffer");
+    }
+}
@@ -1,22 +1,64 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
+#include <string>
 #include <vector>
 
+enum class QueueType {
+    Graphics,
+    Compute,
+    Transfer
+};
+
 struct Device {
+    GLFWwindow* window;
     VkInstance instance;
     VkPhysicalDevice physicalDevice;
+    VkPhysicalDeviceProperties properties;
     VkDevice device;
     VkQueue graphicsQueue;
     VkQueue presentQueue;
-    VkSurfaceKHR surface;
+    VkQueue computeQueue;  // Same as graphicsQueue unless asyncCompute
+    VkQueue transferQueue; // Same as graphicsQueue unless asyncTransfer
+    VkSurfaceKHR surface;  // VK_NULL_HANDLE when headless
     uint32_t graphicsFamily;
     uint32_t presentFamily;
+    uint32_t computeFamily;
+    uint32_t transferFamily;
+    bool asyncCompute;  // Dedicated compute family without graphics
+    bool asyncTransfer; // Dedicated transfer-only family
+    uint32_t apiVersion;    // Version requested for the instance
+    bool dynamicRendering;  // Vulkan 1.3 dynamic rendering + synchronization2; otherwise render pass fallback
+    bool descriptorIndexing; // Update-after-bind, partially bound descriptor arrays for ResourceTable
+    bool fragmentStoresAndAtomics; // Fragment shaders may write storage buffers (debug counters)
+    bool shaderFloat16; // float16 shader arithmetic (VK_KHR_shader_float16_int8, core in 1.2)
+    bool multiview;     // Several views in one render pass (VK_KHR_multiview, core in 1.1), for stereo
+    bool timelineSemaphore; // Counting semaphores (core in 1.2) for FrameScheduler; fences otherwise
+    uint32_t timestampValidBits; // Of the graphics family; 0 when it cannot write timestamps
+    PFN_vkCmdBeginRendering cmdBeginRendering;
+    PFN_vkCmdEndRendering cmdEndRendering;
+    PFN_vkCmdPipelineBarrier2 cmdPipelineBarrier2;
+    PFN_vkWaitSemaphores waitSemaphores;
+    PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue;
     VkDescriptorPool descriptorPool;
     VkDebugUtilsMessengerEXT debugMessenger;
 
-    Device(GLFWwindow* window);
+    // gpuSelection: device index or name substring, empty for the highest score.
+    // A null window creates a headless device for offscreen rendering (no surface or swapchain).
+    Device(GLFWwindow* window, const std::string& gpuSelection = "", bool forceVulkan10 = false);
     ~Device();
 
     void waitIdle();
+    // Seconds between two graphics queue timestamps, allowing for the counter wrapping
+    double timestampSeconds(uint64_t begin, uint64_t end) const;
+
+    // Submission helpers for work that should overlap with Swapchain::drawFrame.
+    // Resources shared with the graphics queue across families need CONCURRENT sharing
+    // or an ownership transfer; pass the signal semaphore to Swapchain::addWaitSemaphore.
+    VkQueue getQueue(QueueType type) const;
+    uint32_t getQueueFamily(QueueType type) const;
+    VkCommandPool createCommandPool(QueueType type, VkCommandPoolCreateFlags flags = 0) const;
+    void submit(QueueType type, VkCommandBuffer commandBuffer,
+                VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage,
+                VkSemaphore signalSemaphore, VkFence fence) const;
 };
@@ -0,0 +1,173 @@
+#include "dirty.hpp"
+#include <algorithm>
+#include <cmath>
+
+// Keep in sync with sceneSDF in raymarch.frag
+static constexpr float CUBE_SEMI_MAJOR_AXIS = 2.75f;
+static constexpr float CUBE_ECCENTRICITY = 0.8182f;
+static constexpr float CUBE_PERIOD = 6.0f;
+// Half-diagonal of the unit cube plus the smin blend width: the sphere's surface only bends
+// where the cube's distance is below the blend width
+static constexpr float CUBE_DIRTY_RADIUS = 0.8661f + 0.5f;
+// Objects closer than this to the camera plane are not bounded on screen
+static constexpr float NEAR_LIMIT = 0.05f;
+// Pixels added around each object for float error and the AA edge test's neighbours
+static constexpr float PIXEL_MARGIN = 2.0f;
+
+glm::vec3 orbitingCubeCenter(double time) {
+    // Same float math as the shader, which gets the time as a float
+    float M = 2.0f * 3.14159265359f * static_cast<float>(time) / CUBE_PERIOD;
+    float E = M;
+    for (int j = 0; j < 10; ++j) {
+        float delta = (E - CUBE_ECCENTRICITY * std::sin(E) - M) / (1.0f - CUBE_ECCENTRICITY * std::cos(E));
+        E -= delta;
+        if (std::abs(delta) < 1e-6f) break;
+    }
+    float e = CUBE_ECCENTRICITY;
+    float cosV = (std::cos(E) - e) / (1.0f - e * std::cos(E));
+    float sinV = std::sqrt(1.0f - e * e) * std::sin(E) / (1.0f - e * std::cos(E));
+    float v = std::atan2(sinV, cosV);
+    float r = CUBE_SEMI_MAJOR_AXIS * (1.0f - e * e) / (1.0f + e * std::cos(v));
+    // Every orbital angle is zero, so the orbital plane is the scene's XY plane
+    return glm::vec3(r * std::cos(v), r * std::sin(v), 0.0f);
+}
+
+bool DirtyTracker::sameView(const Camera& camera, const RenderSettings& settings, VkExtent2D extent, size_t bodyCount) const {
+    if (!valid || extent.width != lastExtent.width || extent.height != lastExtent.height || bodyCount != lastBodyCount) {
+        return false;
+    }
+    // Interpolating between two identical snapshots can still round differently
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            if (std::abs(camera.view[c][r] - lastView[c][r]) > 1e-6f || std::abs(camera.proj[c][r] - lastProj[c][r]) > 1e-6f) {
+                return false;
+            }
+        }
+    }
+    // Every knob that changes the marched image
+    return settings.maxSteps == lastSettings.maxSteps && settings.epsilon == lastSettings.epsilon &&
+           settings.farDistance == lastSettings.farDistance && settings.marchStrategy == lastSettings.marchStrategy &&
+           settings.gridMode == lastSettings.gridMode && settings.aaMode == lastSettings.aaMode &&
+           settings.aaSamples == lastSettings.aaSamples && settings.shaderPrecision == lastSettings.shaderPrecision;
+}
+
+// Marks the tiles under the sphere's screen bounds. Returns false if it reaches the near
+// plane, where it has no finite bounds.
+bool DirtyTracker::markSphere(glm::vec3 center, float radius, const Camera& camera, VkExtent2D extent) {
+    glm::vec3 c = glm::vec3(camera.view * glm::vec4(center, 1.0f));
+    if (c.z - radius >= 0.0f) {
+        return true; // Entirely behind the camera
+    }
+    if (c.z + radius > -NEAR_LIMIT) {
+        return false;
+    }
+
+    // Project the corners of the view-space bounding box, in front of the camera by now.
+    // The shader maps fragCoord to uv = fragCoord * (-0.5, 0.5) before unprojecting.
+    glm::vec2 lo(1e30f), hi(-1e30f);
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner = c + radius * glm::vec3(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = camera.proj * glm::vec4(corner, 1.0f);
+        glm::vec2 ndc(-2.0f * clip.x / clip.w, 2.0f * clip.y / clip.w);
+        lo = glm::min(lo, ndc);
+        hi = glm::max(hi, ndc);
+    }
+    float x0 = (lo.x + 1.0f) * 0.5f * extent.width - PIXEL_MARGIN;
+    float x1 = (hi.x + 1.0f) * 0.5f * extent.width + PIXEL_MARGIN;
+    float y0 = (lo.y + 1.0f) * 0.5f * extent.height - PIXEL_MARGIN;
+    float y1 = (hi.y + 1.0f) * 0.5f * extent.height + PIXEL_MARGIN;
+    if (x1 < 0.0f || y1 < 0.0f || x0 >= extent.width || y0 >= extent.height) {
+        return true; // Off screen
+    }
+
+    uint32_t tx0 = static_cast<uint32_t>(std::max(x0, 0.0f)) / TILE_SIZE;
+    uint32_t ty0 = static_cast<uint32_t>(std::max(y0, 0.0f)) / TILE_SIZE;
+    uint32_t tx1 = std::min(static_cast<uint32_t>(x1) / TILE_SIZE, tilesX - 1);
+    uint32_t ty1 = std::min(static_cast<uint32_t>(y1) / TILE_SIZE, tilesY - 1);
+    for (uint32_t y = ty0; y <= ty1; ++y) {
+        std::fill(mask.begin() + y * tilesX + tx0, mask.begin() + y * tilesX + tx1 + 1, 1);
+    }
+    return true;
+}
+
+bool DirtyTracker::update(const Camera& camera, const RenderSettings& settings, VkExtent2D sceneExtent, double time,
+                          const float* bodies, size_t bodyCount, std::vector<VkRect2D>& rects) {
+    rects.clear();
+    bool partial = sameView(camera, settings, sceneExtent, bodyCount);
+
+    tilesX = (sceneExtent.width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (sceneExtent.height + TILE_SIZE - 1) / TILE_SIZE;
+    mask.assign(tilesX * tilesY, 0);
+    bool bounded = markSphere(orbitingCubeCenter(time), CUBE_DIRTY_RADIUS, camera, sceneExtent);
+    for (size_t i = 0; i < bodyCount && bounded; ++i) {
+        const float* body = bodies + i * 4;
+        bounded = markSphere(glm::vec3(body[0], body[1], body[2]), body[3], camera, sceneExtent);
+    }
+    partial = partial && bounded && lastMask.size() == mask.size();
+
+    // Pixels showing an object's old position need redrawing as much as its new ones
+    std::vector<uint8_t> dirty = mask;
+    if (partial) {
+        for (size_t i = 0; i < dirty.size(); ++i) {
+            dirty[i] |= lastMask[i];
+        }
+    }
+
+    valid = true;
+    lastView = camera.view;
+    lastProj = camera.proj;
+    lastSettings = settings;
+    lastExtent = sceneExtent;
+    lastBodyCount = bodyCount;
+    // An unbounded object leaves no usable mask, so the next frame has to redraw everything too
+    if (bounded) {
+        lastMask.swap(mask);
+    } else {
+        lastMask.clear();
+    }
+    if (!partial) {
+        return false;
+    }
+
+    // Runs of dirty tiles per row, merged with the same run in the row above
+    uint64_t dirtyPixels = 0;
+    size_t rowStart = 0; // First rect that can still grow downwards
+    for (uint32_t y = 0; y < tilesY; ++y) {
+        size_t rowEnd = rects.size();
+        for (uint32_t x = 0; x < tilesX;) {
+            if (!dirty[y * tilesX + x]) {
+                ++x;
+                continue;
+            }
+            uint32_t start = x;
+            while (x < tilesX && dirty[y * tilesX + x]) {
+                ++x;
+            }
+            VkRect2D rect = {};
+            rect.offset = {static_cast<int32_t>(start * TILE_SIZE), static_cast<int32_t>(y * TILE_SIZE)};
+            rect.extent.width = std::min(x * TILE_SIZE, sceneExtent.width) - start * TILE_SIZE;
+            rect.extent.height = std::min((y + 1) * TILE_SIZE, sceneExtent.height) - y * TILE_SIZE;
+            dirtyPixels += static_cast<uint64_t>(rect.extent.width) * rect.extent.height;
+
+            bool merged = false;
+            for (size_t i = rowStart; i < rowEnd && !merged; ++i) {
+                VkRect2D& above = rects[i];
+                if (above.offset.x == rect.offset.x && above.extent.width == rect.extent.width &&
+                    above.offset.y + static_cast<int32_t>(above.extent.height) == rect.offset.y) {
+                    above.extent.height += rect.extent.height;
+                    merged = true;
+                }
+            }
+            if (!merged) {
+                rects.push_back(rect);
+            }
+        }
+        // Rects that did not reach this row's bottom are finished; keep the open ones at the back
+        uint32_t rowBottom = std::min((y + 1) * TILE_SIZE, sceneExtent.height);
+        auto open = std::stable_partition(rects.begin() + rowStart, rects.end(), [&](const VkRect2D& rect) {
+            return static_cast<uint32_t>(rect.offset.y) + rect.extent.height != rowBottom;
+        });
+        rowStart = static_cast<size_t>(open - rects.begin());
+    }
+    return dirtyPixels <= FULL_REDRAW_FRACTION * sceneExtent.width * sceneExtent.height;
+}
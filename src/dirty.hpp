@@ -0,0 +1,41 @@
+#pragma once
+#include "pipeline.hpp"
+#include "settings.hpp"
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Decides how much of the persistent scene image has to be marched again. While the camera
+// and the render settings stay put, only pixels covered by a moving object (the orbiting cube
+// and the asteroid belt) in this frame or the last one can change: the lighting has no
+// shadows or reflections, so nothing else depends on where they are.
+class DirtyTracker {
+public:
+    static constexpr uint32_t TILE_SIZE = 32; // Dirty mask granularity in scene pixels
+    static constexpr float FULL_REDRAW_FRACTION = 0.6f; // Above this, one fullscreen draw is cheaper
+
+    // Call once per frame. Returns false when the whole scene has to be redrawn (first frame,
+    // camera or settings changed, an object reaching the near plane); otherwise rects holds
+    // the dirty areas in scene pixels, possibly none. bodies is vec4(position, radius) each.
+    bool update(const Camera& camera, const RenderSettings& settings, VkExtent2D sceneExtent, double time,
+                const float* bodies, size_t bodyCount, std::vector<VkRect2D>& rects);
+
+private:
+    bool markSphere(glm::vec3 center, float radius, const Camera& camera, VkExtent2D extent);
+    bool sameView(const Camera& camera, const RenderSettings& settings, VkExtent2D extent, size_t bodyCount) const;
+
+    bool valid = false;
+    glm::mat4 lastView = glm::mat4(1.0f);
+    glm::mat4 lastProj = glm::mat4(1.0f);
+    RenderSettings lastSettings;
+    VkExtent2D lastExtent = {0, 0};
+    size_t lastBodyCount = 0;
+    uint32_t tilesX = 0;
+    uint32_t tilesY = 0;
+    std::vector<uint8_t> mask;     // Tiles covered by a moving object this frame
+    std::vector<uint8_t> lastMask; // The same for the previous frame
+};
+
+// Center of the orbiting cube in raymarch.frag at scene time t
+glm::vec3 orbitingCubeCenter(double time);
@@ -0,0 +1,174 @@
+#include "framelimiter.hpp"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <time.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Spin margin bounds; the margin starts high and settles on what the scheduler needs
+static constexpr double MIN_SPIN_MARGIN = 0.0001;
+static constexpr double MAX_SPIN_MARGIN = 0.004;
+static constexpr double INITIAL_SPIN_MARGIN = 0.002;
+static constexpr double OVERSLEEP_DECAY = 0.995; // Per frame, so a one-off spike fades over seconds
+static constexpr double STATS_WINDOW = 0.5;
+
+static double processCpuTime() {
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) {
+        return 0.0;
+    }
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Package energy counter; usually only readable by root on recent kernels
+static bool readEnergy(const std::string& path, uint64_t& microjoules) {
+    std::ifstream file(path);
+    return static_cast<bool>(file >> microjoules);
+}
+
+static void cpuRelax() {
+#if defined(__SSE2__)
+    _mm_pause();
+#endif
+}
+
+FrameLimiter::FrameLimiter()
+    : interval(0.0), scheduled(false), spinMargin(INITIAL_SPIN_MARGIN), oversleepPeak(0.0),
+      windowStart(Clock::now()), windowCpuStart(processCpuTime()), windowEnergyStart(0),
+      errorSum(0.0), errorMax(0.0), errorCount(0), lateCount(0), lateTotal(0), droppedTotal(0), stats{},
+      energyPath("/sys/class/powercap/intel-rapl:0/energy_uj"), energyRange(0) {
+    stats.packagePower = -1.0f;
+    if (readEnergy(energyPath, windowEnergyStart)) {
+        readEnergy("/sys/class/powercap/intel-rapl:0/max_energy_range_uj", energyRange);
+    } else {
+        energyPath.clear();
+    }
+#if defined(__linux__)
+    // The default 50 us timer slack would be added to every sleep on this thread
+    prctl(PR_SET_TIMERSLACK, 1UL);
+#endif
+}
+
+void FrameLimiter::setTargetFps(double fps) {
+    double newInterval = fps > 0.0 ? 1.0 / fps : 0.0;
+    if (newInterval != interval) {
+        interval = newInterval;
+        scheduled = false;
+    }
+}
+
+double FrameLimiter::wait() {
+    Clock::time_point start = Clock::now();
+    if (interval <= 0.0) {
+        updateWindow(start);
+        return 0.0;
+    }
+
+    // Resync instead of catching up when the last frame overran by a whole interval
+    auto step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval));
+    deadline = scheduled ? deadline + step : start;
+    scheduled = true;
+    if (deadline + step < start) {
+        deadline = start;
+        ++droppedTotal;
+    }
+    if (start >= deadline) {
+        if (start > deadline) {
+            ++lateCount;
+            ++lateTotal;
+        }
+        updateWindow(start);
+        return 0.0;
+    }
+
+    auto sleepUntil = deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spinMargin));
+    if (start < sleepUntil) {
+        std::this_thread::sleep_for(sleepUntil - start);
+        double oversleep = std::chrono::duration<double>(Clock::now() - sleepUntil).count();
+        oversleepPeak = std::max(oversleep, oversleepPeak * OVERSLEEP_DECAY);
+        // Margin of a quarter over the worst recent overshoot
+        spinMargin = std::clamp(oversleepPeak * 1.25, MIN_SPIN_MARGIN, MAX_SPIN_MARGIN);
+    }
+    Clock::time_point now = Clock::now();
+    while (now < deadline) {
+        cpuRelax();
+        now = Clock::now();
+    }
+
+    double error = std::chrono::duration<double>(now - deadline).count();
+    errorSum += error;
+    errorMax = std::max(errorMax, error);
+    ++errorCount;
+    updateWindow(now);
+    return std::chrono::duration<double>(now - start).count();
+}
+
+void FrameLimiter::updateWindow(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - windowStart).count();
+    if (elapsed < STATS_WINDOW) {
+        return;
+    }
+    double cpu = processCpuTime();
+    stats.targetFps = interval > 0.0 ? 1.0 / interval : 0.0;
+    stats.meanError = errorCount > 0 ? errorSum / errorCount : 0.0;
+    stats.maxError = errorMax;
+    stats.lateFrames = lateCount;
+    stats.spinMargin = spinMargin;
+    stats.cpuUsage = static_cast<float>((cpu - windowCpuStart) / elapsed);
+
+    uint64_t energy = 0;
+    if (!energyPath.empty() && readEnergy(energyPath, energy)) {
+        uint64_t used = energy >= windowEnergyStart ? energy - windowEnergyStart : energy + energyRange - windowEnergyStart;
+        stats.packagePower = static_cast<float>(used * 1e-6 / elapsed);
+        windowEnergyStart = energy;
+    }
+
+    windowStart = now;
+    windowCpuStart = cpu;
+    errorSum = 0.0;
+    errorMax = 0.0;
+    errorCount = 0;
+    lateCount = 0;
+}
+
+FrameLimiterStats FrameLimiter::getStats() const {
+    return stats;
+}
+
+int monitorRefreshRate(GLFWwindow* window) {
+    // Fullscreen windows know their monitor; windowed ones pick the largest overlap
+    GLFWmonitor* best = glfwGetWindowMonitor(window);
+    if (!best) {
+        int wx, wy, ww, wh;
+        glfwGetWindowPos(window, &wx, &wy);
+        glfwGetWindowSize(window, &ww, &wh);
+        int count = 0;
+        GLFWmonitor** monitors = glfwGetMonitors(&count);
+        long bestArea = -1;
+        for (int i = 0; i < count; ++i) {
+            const GLFWvidmode* mode = glfwGetVideoMode(monitors[i]);
+            if (!mode) {
+                continue;
+            }
+            int mx, my;
+            glfwGetMonitorPos(monitors[i], &mx, &my);
+            long overlapX = std::max(0, std::min(wx + ww, mx + mode->width) - std::max(wx, mx));
+            long overlapY = std::max(0, std::min(wy + wh, my + mode->height) - std::max(wy, my));
+            if (overlapX * overlapY > bestArea) {
+                bestArea = overlapX * overlapY;
+                best = monitors[i];
+            }
+        }
+    }
+    if (!best) {
+        return 0;
+    }
+    const GLFWvidmode* mode = glfwGetVideoMode(best);
+    return mode ? mode->refreshRate : 0;
+}
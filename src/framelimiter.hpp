@@ -0,0 +1,64 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+struct GLFWwindow;
+
+// Measured over the last half-second window
+struct FrameLimiterStats {
+    double targetFps;     // 0 while uncapped
+    double meanError;     // Mean |frame start - deadline| in seconds, frames that waited only
+    double maxError;
+    uint32_t lateFrames;  // Frames that were already past their deadline
+    double spinMargin;    // Seconds before the deadline at which sleeping stops
+    float cpuUsage;       // Process CPU time / wall time; 1 is one full core
+    float packagePower;   // CPU package watts from RAPL, negative when unreadable
+};
+
+// Caps the render loop at a frame rate with a hybrid wait: the thread sleeps until
+// spinMargin before the deadline and spins for the rest, since a plain sleep overshoots
+// by tens to hundreds of microseconds. The margin follows the worst recent oversleep, so
+// the spin only lasts as long as this machine's scheduler needs. Deadlines advance by a
+// fixed interval from the previous one, so one late wakeup doesn't shift every later frame.
+class FrameLimiter {
+public:
+    FrameLimiter();
+
+    void setTargetFps(double fps); // <= 0 uncaps
+    // Blocks until the next frame is due; returns the seconds spent waiting
+    double wait();
+    FrameLimiterStats getStats() const;
+    // Since startup: frames that started past their deadline, and those that overran a whole
+    // interval so the schedule was restarted (a frame slot was skipped)
+    uint64_t getLateFrames() const { return lateTotal; }
+    uint64_t getDroppedFrames() const { return droppedTotal; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void updateWindow(Clock::time_point now);
+
+    double interval;
+    Clock::time_point deadline; // Start time of the frame being waited for
+    bool scheduled;             // deadline follows on from the last frame
+    double spinMargin;
+    double oversleepPeak; // Decaying maximum of recent sleep overshoots
+
+    // Stats window
+    Clock::time_point windowStart;
+    double windowCpuStart;
+    uint64_t windowEnergyStart; // Microjoules, 0 if RAPL is unreadable
+    double errorSum;
+    double errorMax;
+    uint32_t errorCount;
+    uint32_t lateCount;
+    uint64_t lateTotal;
+    uint64_t droppedTotal;
+    FrameLimiterStats stats;
+    std::string energyPath;
+    uint64_t energyRange; // RAPL counter wraps at this many microjoules
+};
+
+// Refresh rate in Hz of the monitor showing most of the window, 0 if unknown
+int monitorRefreshRate(GLFWwindow* window);
@@ -3,15 +3,114 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <imgui.h>
 #include <imgui_impl_glfw.h>
 
-Input::Input(GLFWwindow* window) 
-    : window(window), 
-      firstMouse(true), 
-      lastF3State(false), 
-      showImGuiWindow(false), 
-      lastF9State(false), 
-      frameTime(0.0f) {
+glm::mat4 perspectiveProjection(float fovDegrees, float aspect) {
+    glm::mat4 proj = glm::perspective(glm::radians(fovDegrees), aspect, 0.1f, 100.0f);
+    // Flip Y for Vulkan's NDC (Y-down)
+    proj[1][1] *= -1.0f;
+    return proj;
+}
+
+// Named keys for [keybinds]; letters, digits and F1-F25 are handled separately
+static const struct {
+    const char* name;
+    int key;
+} NAMED_KEYS[] = {
+    {"SPACE", GLFW_KEY_SPACE}, {"ESCAPE", GLFW_KEY_ESCAPE}, {"ENTER", GLFW_KEY_ENTER}, {"TAB", GLFW_KEY_TAB},
+    {"BACKSPACE", GLFW_KEY_BACKSPACE}, {"INSERT", GLFW_KEY_INSERT}, {"DELETE", GLFW_KEY_DELETE},
+    {"HOME", GLFW_KEY_HOME}, {"END", GLFW_KEY_END}, {"PAGE_UP", GLFW_KEY_PAGE_UP}, {"PAGE_DOWN", GLFW_KEY_PAGE_DOWN},
+    {"UP", GLFW_KEY_UP}, {"DOWN", GLFW_KEY_DOWN}, {"LEFT", GLFW_KEY_LEFT}, {"RIGHT", GLFW_KEY_RIGHT},
+    {"LEFT_SHIFT", GLFW_KEY_LEFT_SHIFT}, {"RIGHT_SHIFT", GLFW_KEY_RIGHT_SHIFT},
+    {"LEFT_CONTROL", GLFW_KEY_LEFT_CONTROL}, {"RIGHT_CONTROL", GLFW_KEY_RIGHT_CONTROL},
+    {"LEFT_ALT", GLFW_KEY_LEFT_ALT}, {"RIGHT_ALT", GLFW_KEY_RIGHT_ALT},
+    {"COMMA", GLFW_KEY_COMMA}, {"PERIOD", GLFW_KEY_PERIOD}, {"SLASH", GLFW_KEY_SLASH}, {"SEMICOLON", GLFW_KEY_SEMICOLON},
+    {"MINUS", GLFW_KEY_MINUS}, {"EQUAL", GLFW_KEY_EQUAL}, {"GRAVE_ACCENT", GLFW_KEY_GRAVE_ACCENT},
+    {"NONE", GLFW_KEY_UNKNOWN},
+};
+
+const char* inputActionName(uint32_t action) {
+    switch (action) {
+        case ACTION_MOVE_FORWARD: return "move_forward";
+        case ACTION_MOVE_BACKWARD: return "move_backward";
+        case ACTION_MOVE_LEFT: return "move_left";
+        case ACTION_MOVE_RIGHT: return "move_right";
+        case ACTION_MOVE_UP: return "move_up";
+        case ACTION_MOVE_DOWN: return "move_down";
+        case ACTION_ROLL_LEFT: return "roll_left";
+        case ACTION_ROLL_RIGHT: return "roll_right";
+        case ACTION_TOGGLE_OVERLAY: return "toggle_overlay";
+        case ACTION_TOGGLE_TUNING: return "toggle_tuning";
+        case ACTION_EXIT: return "exit";
+        case ACTION_TOGGLE_CAPTURE: return "toggle_capture";
+        default: return "unknown";
+    }
+}
+
+bool parseKeyName(const std::string& name, int& key) {
+    std::string upper = name;
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return std::toupper(c); });
+    if (upper.size() == 1 && ((upper[0] >= 'A' && upper[0] <= 'Z') || (upper[0] >= '0' && upper[0] <= '9'))) {
+        key = upper[0]; // GLFW letter and digit codes are their ASCII values
+        return true;
+    }
+    if (upper.size() >= 2 && upper[0] == 'F' && std::all_of(upper.begin() + 1, upper.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        int number = std::atoi(upper.c_str() + 1);
+        if (number >= 1 && number <= 25) {
+            key = GLFW_KEY_F1 + number - 1;
+            return true;
+        }
+        return false;
+    }
+    for (const auto& named : NAMED_KEYS) {
+        if (upper == named.name) {
+            key = named.key;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string keyName(int key) {
+    if ((key >= GLFW_KEY_A && key <= GLFW_KEY_Z) || (key >= GLFW_KEY_0 && key <= GLFW_KEY_9)) {
+        return std::string(1, static_cast<char>(key));
+    }
+    if (key >= GLFW_KEY_F1 && key <= GLFW_KEY_F25) {
+        return "F" + std::to_string(key - GLFW_KEY_F1 + 1);
+    }
+    for (const auto& named : NAMED_KEYS) {
+        if (key == named.key) {
+            return named.name;
+        }
+    }
+    return "NONE";
+}
+
+glm::quat lookRotation(glm::dvec2 motion) {
+    float sensitivity = 0.1f; // Degrees per pixel
+    float yawAngle = glm::radians(static_cast<float>(motion.x) * sensitivity);    // Mouse X for yaw
+    float pitchAngle = glm::radians(static_cast<float>(-motion.y) * sensitivity); // Mouse Y for pitch, reversed
+    return glm::angleAxis(yawAngle, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::angleAxis(-pitchAngle, glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+Input::Input(GLFWwindow* window, float fovDegrees, const KeyBindings& bindings)
+    : window(window),
+      bindings(bindings),
+      rawMouseMotion(glfwRawMouseMotionSupported() == GLFW_TRUE),
+      pressedKeys(0),
+      presses{},
+      firstMouse(true),
+      lastX(0.0),
+      lastY(0.0),
+      lookProduced(0.0),
+      showImGuiWindow(false),
+      showTuningPanel(false),
+      heldKeys(0),
+      lastUpdate(glfwGetTime()),
+      lookConsumed(0.0) {
     player.position = glm::vec3(0.0f, 0.0f, 0.0f); // Start at origin
     player.forward = glm::vec3(0.0f, 0.0f, -1.0f); // Vulkan: -Z forward
     player.up = glm::vec3(0.0f, 1.0f, 0.0f);       // +Y up
@@ -20,15 +119,161 @@ Input::Input(GLFWwindow* window)
     // Compute initial view matrix
     glm::mat4 rotation = glm::toMat4(orientation);
     player.view = glm::inverse(glm::translate(glm::mat4(1.0f), player.position) * rotation);
-    player.proj = glm::perspective(glm::radians(80.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-    // Flip Y for Vulkan's NDC (Y-down)
-    player.proj[1][1] *= -1.0f;
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    player.proj = perspectiveProjection(fovDegrees, height > 0 ? static_cast<float>(width) / height : 1.0f);
 
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    // Unaccelerated, unscaled motion; only applies while the cursor is disabled
+    if (rawMouseMotion) {
+        glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+    }
+    setCursorCaptured(true);
+
+    // Installed after ImGui's, which are called first from ours
+    glfwSetWindowUserPointer(window, this);
+    previousKeyCallback = glfwSetKeyCallback(window, keyCallback);
+    previousCursorCallback = glfwSetCursorPosCallback(window, cursorCallback);
+    previousFocusCallback = glfwSetWindowFocusCallback(window, focusCallback);
+}
+
+Input::~Input() {
+    // Hand the callbacks back unless something (ImGui shutdown) already replaced ours
+    GLFWkeyfun key = glfwSetKeyCallback(window, previousKeyCallback);
+    if (key != keyCallback) {
+        glfwSetKeyCallback(window, key);
+    }
+    GLFWcursorposfun cursor = glfwSetCursorPosCallback(window, previousCursorCallback);
+    if (cursor != cursorCallback) {
+        glfwSetCursorPosCallback(window, cursor);
+    }
+    GLFWwindowfocusfun focus = glfwSetWindowFocusCallback(window, previousFocusCallback);
+    if (focus != focusCallback) {
+        glfwSetWindowFocusCallback(window, focus);
+    }
+    glfwSetWindowUserPointer(window, nullptr);
+}
+
+void Input::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    Input* input = static_cast<Input*>(glfwGetWindowUserPointer(window));
+    if (!input) {
+        return;
+    }
+    if (input->previousKeyCallback) {
+        input->previousKeyCallback(window, key, scancode, action, mods);
+    }
+    if (action == GLFW_REPEAT || key == GLFW_KEY_UNKNOWN) {
+        return;
+    }
+
+    double time = glfwGetTime();
+    for (uint32_t i = 0; i < ACTION_COUNT; ++i) {
+        if (input->bindings.keys[i] != key) {
+            continue;
+        }
+        if (i >= MOVE_ACTION_COUNT) {
+            // Counted rather than compared against the last poll, so no press is missed
+            if (action == GLFW_PRESS) {
+                ++input->presses[i];
+            }
+            continue;
+        }
+
+        uint32_t bit = 1u << i;
+        if (action == GLFW_PRESS) {
+            // Typing into a text field; releases always go through so no key sticks
+            if (ImGui::GetIO().WantCaptureKeyboard || (input->pressedKeys & bit)) {
+                continue;
+            }
+            input->pressedKeys |= bit;
+            input->push({time, INPUT_KEY_DOWN, bit, 0.0f, 0.0f});
+        } else if (input->pressedKeys & bit) {
+            input->pressedKeys &= ~bit;
+            input->push({time, INPUT_KEY_UP, bit, 0.0f, 0.0f});
+        }
+    }
 }
 
-void Input::updateCamera(float deltaTime) {
-    frameTime = deltaTime;
+void Input::cursorCallback(GLFWwindow* window, double x, double y) {
+    Input* input = static_cast<Input*>(glfwGetWindowUserPointer(window));
+    if (!input) {
+        return;
+    }
+    if (input->previousCursorCallback) {
+        input->previousCursorCallback(window, x, y);
+    }
+
+    // A released cursor belongs to the UI, not the camera
+    if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED || ImGui::GetIO().WantCaptureMouse) {
+        input->firstMouse = true;
+        return;
+    }
+    if (input->firstMouse) {
+        input->lastX = x;
+        input->lastY = y;
+        input->firstMouse = false;
+        return;
+    }
+
+    InputEvent event = {glfwGetTime(), INPUT_LOOK, 0, static_cast<float>(x - input->lastX), static_cast<float>(y - input->lastY)};
+    input->lastX = x;
+    input->lastY = y;
+    input->lookProduced += glm::dvec2(event.dx, event.dy);
+    input->push(event);
+}
+
+void Input::focusCallback(GLFWwindow* window, int focused) {
+    Input* input = static_cast<Input*>(glfwGetWindowUserPointer(window));
+    if (!input) {
+        return;
+    }
+    if (input->previousFocusCallback) {
+        input->previousFocusCallback(window, focused);
+    }
+
+    // Releases are not always delivered once another window has focus
+    if (!focused && input->pressedKeys) {
+        input->push({glfwGetTime(), INPUT_KEY_UP, input->pressedKeys, 0.0f, 0.0f});
+        input->pressedKeys = 0;
+    }
+    input->firstMouse = true;
+}
+
+void Input::push(const InputEvent& event) {
+    // Anything left over from a full queue goes first to keep the order
+    flushBacklog();
+    if (!backlog.empty() || !events.push(event)) {
+        backlog.push_back(event);
+    }
+}
+
+void Input::flushBacklog() {
+    size_t flushed = 0;
+    while (flushed < backlog.size() && events.push(backlog[flushed])) {
+        ++flushed;
+    }
+    backlog.erase(backlog.begin(), backlog.begin() + flushed);
+}
+
+void Input::pollEvents() {
+    glfwPollEvents();
+    flushBacklog();
+}
+
+uint32_t Input::consumePresses(InputAction action) {
+    uint32_t count = presses[action];
+    presses[action] = 0;
+    return count;
+}
+
+void Input::setCursorCaptured(bool captured) {
+    glfwSetInputMode(window, GLFW_CURSOR, captured ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+    firstMouse = true;
+}
+
+void Input::integrate(float deltaTime) {
+    if (deltaTime <= 0.0f || heldKeys == 0) {
+        return;
+    }
 
     // Derive local axes from quaternion
     glm::mat4 rotation = glm::toMat4(orientation);
@@ -39,104 +284,117 @@ void Input::updateCamera(float deltaTime) {
     // Keyboard input for movement
     float moveSpeed = 5.0f;
     // Corrected translations
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+    if (heldKeys & MOVE_FORWARD) {
         player.position -= player.forward * moveSpeed * deltaTime; // Forward
     }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+    if (heldKeys & MOVE_BACKWARD) {
         player.position += player.forward * moveSpeed * deltaTime; // Backward
     }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+    if (heldKeys & MOVE_LEFT) {
         player.position += right * moveSpeed * deltaTime; // Left (restored)
     }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+    if (heldKeys & MOVE_RIGHT) {
         player.position -= right * moveSpeed * deltaTime; // Right (restored)
     }
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
+    if (heldKeys & MOVE_UP) {
         player.position += player.up * moveSpeed * deltaTime; // Up
     }
-    if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS) {
+    if (heldKeys & MOVE_DOWN) {
         player.position -= player.up * moveSpeed * deltaTime; // Down
     }
 
     // Roll input (Q/E)
     float rollSpeed = 4.5f; // Reduced to 5% of 90.0f
     float rollAngle = 0.0f;
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
+    if (heldKeys & ROLL_LEFT) {
         rollAngle += rollSpeed * deltaTime; // Counterclockwise (will be negated)
     }
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+    if (heldKeys & ROLL_RIGHT) {
         rollAngle -= rollSpeed * deltaTime; // Clockwise (will be negated)
     }
-
-    // Mouse input for rotation
-    double xpos, ypos;
-    glfwGetCursorPos(window, &xpos, &ypos);
-
-    if (firstMouse) {
-        lastX = xpos;
-        lastY = ypos;
-        firstMouse = false;
+    if (rollAngle != 0.0f) {
+        orientation = glm::normalize(orientation * glm::angleAxis(-rollAngle, glm::vec3(0.0f, 0.0f, 1.0f))); // Roll (reversed)
     }
+}
 
-    if (!ImGui::GetIO().WantCaptureMouse) {
-        float xoffset = static_cast<float>(xpos - lastX);
-        float yoffset = static_cast<float>(lastY - ypos); // Reversed Y
-        lastX = xpos;
-        lastY = ypos;
-
-        float sensitivity = 0.1f;
-        xoffset *= sensitivity;
-        yoffset *= sensitivity;
+void Input::updateCamera(double now) {
+    // Each key moves for exactly the span it was held; after a stall, only the last
+    // quarter second counts instead of jumping the camera
+    double cursor = std::max(lastUpdate, now - 0.25);
+    InputEvent event;
+    while (events.pop(event)) {
+        double eventTime = std::clamp(event.time, cursor, now);
+        integrate(static_cast<float>(eventTime - cursor));
+        cursor = eventTime;
 
-        // Convert to radians
-        float yawAngle = glm::radians(xoffset);   // Mouse X for yaw
-        float pitchAngle = glm::radians(yoffset); // Mouse Y for pitch
+        switch (event.type) {
+            case INPUT_KEY_DOWN:
+                heldKeys |= event.keys;
+                break;
+            case INPUT_KEY_UP:
+                heldKeys &= ~event.keys;
+                break;
+            case INPUT_LOOK:
+                orientation = glm::normalize(orientation * lookRotation(glm::dvec2(event.dx, event.dy)));
+                lookConsumed += glm::dvec2(event.dx, event.dy);
+                break;
+        }
+    }
+    integrate(static_cast<float>(now - cursor));
+    lastUpdate = now;
 
-        // Create quaternions for rotations in local space
-        glm::quat yawQuat = glm::angleAxis(yawAngle, player.up);        // Yaw (correct)
-        glm::quat pitchQuat = glm::angleAxis(-pitchAngle, right);       // Pitch (reversed)
-        glm::quat rollQuat = glm::angleAxis(-rollAngle, player.forward); // Roll (reversed)
+    // Recompute axes to ensure orthogonality
+    glm::mat4 rotation = glm::toMat4(orientation);
+    player.up = glm::normalize(glm::vec3(rotation[1]));
+    player.forward = glm::normalize(glm::vec3(rotation[2]));
 
-        // Apply rotations: yaw, pitch, roll
-        orientation = glm::normalize(yawQuat * pitchQuat * rollQuat * orientation);
+    // Update view matrix: inverse of (translate * rotate)
+    player.view = glm::inverse(glm::translate(glm::mat4(1.0f), player.position) * rotation);
+}
 
-        // Recompute axes to ensure orthogonality
-        rotation = glm::toMat4(orientation);
-        right = glm::normalize(glm::vec3(rotation[0]));
-        player.up = glm::normalize(glm::vec3(rotation[1]));
-        player.forward = glm::normalize(glm::vec3(rotation[2]));
-    } else {
-        lastX = xpos;
-        lastY = ypos;
-    }
+glm::dvec2 Input::getLookConsumed() const {
+    return lookConsumed;
+}
 
-    // Update view matrix: inverse of (translate * rotate)
-    player.view = glm::inverse(glm::translate(glm::mat4(1.0f), player.position) * glm::toMat4(orientation));
+glm::dvec2 Input::getLookProduced() const {
+    return lookProduced;
 }
 
 bool Input::toggleImGuiWindow() {
-    bool currentF3State = glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS;
-    bool toggle = !lastF3State && currentF3State;
-    lastF3State = currentF3State;
-    if (toggle) {
+    if (consumePresses(ACTION_TOGGLE_OVERLAY) % 2) {
         showImGuiWindow = !showImGuiWindow;
     }
     return showImGuiWindow;
 }
 
+bool Input::toggleTuningPanel() {
+    if (consumePresses(ACTION_TOGGLE_TUNING) % 2) {
+        showTuningPanel = !showTuningPanel;
+        setCursorCaptured(!showTuningPanel);
+    }
+    return showTuningPanel;
+}
+
+void Input::setPanelsVisible(bool overlay, bool tuningPanel) {
+    showImGuiWindow = overlay;
+    showTuningPanel = tuningPanel;
+    setCursorCaptured(!showTuningPanel);
+}
+
 bool Input::shouldExit() {
-    bool currentF9State = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
-    bool toggle = !lastF9State && currentF9State;
-    lastF9State = currentF9State;
-    return toggle;
+    return consumePresses(ACTION_EXIT) > 0;
+}
+
+bool Input::toggleCapture() {
+    return consumePresses(ACTION_TOGGLE_CAPTURE) % 2 != 0;
 }
 
 void Input::processImGuiInput() {
     ImGui_ImplGlfw_NewFrame();
 }
 
-float Input::getFrameTime() const {
-    return frameTime;
+glm::quat Input::getOrientation() const {
+    return orientation;
 }
 
 Camera Input::getCamera() const {
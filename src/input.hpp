@@ -5,6 +5,101 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include "pipeline.hpp" // Added for Camera definition
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Movement keys, packed into InputEvent::keys
+enum MoveKey : uint32_t {
+    MOVE_FORWARD  = 1 << 0,
+    MOVE_BACKWARD = 1 << 1,
+    MOVE_LEFT     = 1 << 2,
+    MOVE_RIGHT    = 1 << 3,
+    MOVE_UP       = 1 << 4,
+    MOVE_DOWN     = 1 << 5,
+    ROLL_LEFT     = 1 << 6,
+    ROLL_RIGHT    = 1 << 7
+};
+
+// Everything a key can be bound to in [keybinds]; the movement actions come first, in
+// MoveKey bit order
+enum InputAction : uint32_t {
+    ACTION_MOVE_FORWARD,
+    ACTION_MOVE_BACKWARD,
+    ACTION_MOVE_LEFT,
+    ACTION_MOVE_RIGHT,
+    ACTION_MOVE_UP,
+    ACTION_MOVE_DOWN,
+    ACTION_ROLL_LEFT,
+    ACTION_ROLL_RIGHT,
+    ACTION_TOGGLE_OVERLAY, // F3
+    ACTION_TOGGLE_TUNING,  // F4
+    ACTION_EXIT,           // F9
+    ACTION_TOGGLE_CAPTURE, // F10
+    ACTION_COUNT
+};
+constexpr uint32_t MOVE_ACTION_COUNT = ACTION_ROLL_RIGHT + 1;
+
+// GLFW key per action; GLFW_KEY_UNKNOWN leaves an action unbound
+struct KeyBindings {
+    int keys[ACTION_COUNT] = {
+        GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_LEFT_SHIFT, GLFW_KEY_LEFT_CONTROL, GLFW_KEY_Q, GLFW_KEY_E,
+        GLFW_KEY_F3, GLFW_KEY_F4, GLFW_KEY_F9, GLFW_KEY_F10
+    };
+};
+
+const char* inputActionName(uint32_t action); // [keybinds] key, e.g. "move_forward"
+// Key names as in settings.ini: letters, digits, F1-F25, SPACE, LEFT_SHIFT, ... or NONE; case-insensitive
+bool parseKeyName(const std::string& name, int& key);
+std::string keyName(int key);
+
+// Timestamped input for the simulation thread, produced by the GLFW callbacks
+enum InputEventType : uint32_t {
+    INPUT_KEY_DOWN,   // keys holds the MoveKey bit
+    INPUT_KEY_UP,
+    INPUT_LOOK        // dx, dy in pixels (raw counts when raw motion is on)
+};
+
+struct InputEvent {
+    double time; // glfwGetTime() when GLFW delivered the event
+    uint32_t type;
+    uint32_t keys;
+    float dx, dy;
+};
+
+// Lock-free single-producer/single-consumer ring; push fails instead of blocking when full
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool push(const T& value) { // Producer
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        items[t & (Capacity - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) { // Consumer
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = items[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[Capacity];
+    alignas(64) std::atomic<size_t> head; // Next item to pop, written by the consumer
+    alignas(64) std::atomic<size_t> tail; // Next slot to fill, written by the producer
+};
 
 struct Player {
     glm::vec3 position;
@@ -14,24 +109,72 @@ struct Player {
     glm::mat4 proj;
 };
 
+// Vulkan-style perspective (Y flipped for the Y-down NDC)
+glm::mat4 perspectiveProjection(float fovDegrees, float aspect);
+
+// Key and mouse callbacks push timestamped events into a queue that the simulation thread
+// drains every tick, so presses shorter than a frame are never lost and movement follows the
+// time each key was actually held. Mouse look uses raw motion where the platform has it, and
+// the render thread applies any motion the simulation has not consumed yet right before
+// drawing (Simulation::interpolate adds getLookProduced() minus the snapshot's lookConsumed).
 class Input {
 public:
-    Input(GLFWwindow* window);
-    void updateCamera(float deltaTime);
+    Input(GLFWwindow* window, float fovDegrees = 80.0f, const KeyBindings& bindings = KeyBindings());
+    ~Input();
+
+    // Main thread: runs the GLFW callbacks. Called once per frame, and again right before the
+    // camera is read for rendering so the latest motion makes it into the frame.
+    void pollEvents();
+    void updateCamera(double now); // Simulation thread: applies every event up to now
+    glm::dvec2 getLookConsumed() const; // Simulation thread: total look motion applied so far
+    glm::dvec2 getLookProduced() const; // Main thread: total look motion received so far
     bool toggleImGuiWindow();
+    bool toggleTuningPanel(); // Releases the cursor while the panel is open
+    void setPanelsVisible(bool overlay, bool tuningPanel); // Initial F3/F4 state
     bool shouldExit();
+    bool toggleCapture(); // True after an odd number of presses since the last call
     void processImGuiInput();
-    float getFrameTime() const;
     Camera getCamera() const; // Returns Camera for compatibility with pipeline.hpp
+    glm::quat getOrientation() const;
 
 private:
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+
+    static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void cursorCallback(GLFWwindow* window, double x, double y);
+    static void focusCallback(GLFWwindow* window, int focused);
+
+    void push(const InputEvent& event);
+    void flushBacklog();
+    uint32_t consumePresses(InputAction action);
+    void setCursorCaptured(bool captured);
+    void integrate(float deltaTime); // Simulation thread: movement and roll for the held keys
+
     GLFWwindow* window;
+    KeyBindings bindings;
+    bool rawMouseMotion;
     Player player; // Renamed from camera
     glm::quat orientation; // Quaternion for player orientation
+
+    // Main thread
+    GLFWkeyfun previousKeyCallback; // ImGui's, chained so the UI still sees every event
+    GLFWcursorposfun previousCursorCallback;
+    GLFWwindowfocusfun previousFocusCallback;
+    SpscQueue<InputEvent, QUEUE_CAPACITY> events;
+    std::vector<InputEvent> backlog; // Events that did not fit, pushed first next time
+    uint32_t pressedKeys; // MoveKey bits pushed down and not yet released
+    uint32_t presses[ACTION_COUNT];
     bool firstMouse;
     double lastX, lastY;
-    bool lastF3State;
+    glm::dvec2 lookProduced;
     bool showImGuiWindow;
-    bool lastF9State;
-    float frameTime;
+    bool showTuningPanel;
+
+    // Simulation thread
+    uint32_t heldKeys;
+    double lastUpdate;
+    glm::dvec2 lookConsumed;
 };
+
+// Local rotation for a mouse motion (yaw about local Y, then pitch about local X)
+glm::quat lookRotation(glm::dvec2 motion);
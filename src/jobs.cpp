@@ -0,0 +1,383 @@
+#include "jobs.hpp"
+#include "dirty.hpp"
+#include "memory.hpp"
+#include "orbits.hpp"
+#include "pipeline.hpp"
+#include "resources.hpp"
+#include "swapchain.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+
+// Which JobSystem's worker the current thread is, if any
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local uint32_t currentIndex = 0;
+
+JobSystem::JobSystem(uint32_t threadCount) : jobCount(0), stealCount(0), queuedJobs(0), stopping(false), frameCountersUsed(0) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queues.reset(new WorkerQueue[threadCount]);
+    currentSystem = this;
+    currentIndex = 0;
+    for (uint32_t i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeSignal.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (currentSystem == this) {
+        currentSystem = nullptr;
+    }
+}
+
+uint32_t JobSystem::currentWorker() const {
+    // Any other thread shares the creating thread's deque, which is locked like every other
+    return currentSystem == this ? currentIndex : 0;
+}
+
+void JobSystem::push(uint32_t worker, Job job) {
+    {
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        queues[worker].jobs.push_back(std::move(job));
+    }
+    queuedJobs.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders the notify after a sleeper's check of queuedJobs
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeSignal.notify_one();
+}
+
+void JobSystem::run(JobFunction work, JobCounter* counter, JobCounter* dependency) {
+    if (counter) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    Job job = {std::move(work), counter};
+    if (dependency) {
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->pending.load(std::memory_order_acquire) > 0) {
+            dependency->waiting.push_back(std::move(job));
+            return;
+        }
+    }
+    push(currentWorker(), std::move(job));
+}
+
+bool JobSystem::runOne(uint32_t self) {
+    Job job;
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(queues[self].mutex);
+        if (!queues[self].jobs.empty()) {
+            job = std::move(queues[self].jobs.back());
+            queues[self].jobs.pop_back();
+            found = true;
+        }
+    }
+    uint32_t threadCount = getThreadCount();
+    for (uint32_t i = 1; i < threadCount && !found; ++i) {
+        WorkerQueue& victim = queues[(self + i) % threadCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            found = true;
+            stealCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    job.work(self);
+    jobCount.fetch_add(1, std::memory_order_relaxed);
+    finish(job.counter, self);
+    return true;
+}
+
+void JobSystem::finish(JobCounter* counter, uint32_t self) {
+    if (!counter || counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // Last job of the counter: release its dependents onto this thread's deque
+    std::vector<Job> released;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        released.swap(counter->waiting);
+    }
+    for (Job& job : released) {
+        push(self, std::move(job));
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    uint32_t self = currentWorker();
+    while (counter.pending.load(std::memory_order_acquire) > 0) {
+        if (!runOne(self)) {
+            // What is left is running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t, uint32_t)>& body) {
+    grain = std::max(grain, 1u);
+    JobCounter counter;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    for (uint32_t begin = 0; begin < count; begin += grain) {
+        uint32_t end = std::min(count, begin + grain);
+        run([&, begin, end](uint32_t worker) {
+            try {
+                body(begin, end, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }, &counter);
+    }
+    wait(counter);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+JobCounter* JobSystem::frameCounter() {
+    if (frameCountersUsed == frameCounters.size()) {
+        frameCounters.emplace_back();
+    }
+    JobCounter* counter = &frameCounters[frameCountersUsed++];
+    counter->pending.store(0, std::memory_order_relaxed);
+    counter->waiting.clear();
+    return counter;
+}
+
+void JobSystem::beginFrame() {
+    frameCountersUsed = 0;
+}
+
+void JobSystem::workerLoop(uint32_t self) {
+    currentSystem = this;
+    currentIndex = self;
+    while (true) {
+        if (runOne(self)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeSignal.wait(lock, [this] { return stopping || queuedJobs.load(std::memory_order_acquire) > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+ThreadCommandPools::ThreadCommandPools(const Device& device, uint32_t workerCount, uint32_t frameCount)
+    : device(device), workerCount(workerCount) {
+    pools.resize(static_cast<size_t>(workerCount) * frameCount);
+    for (Pool& pool : pools) {
+        pool.pool = device.createCommandPool(QueueType::Graphics, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        pool.used = 0;
+    }
+}
+
+ThreadCommandPools::~ThreadCommandPools() {
+    for (Pool& pool : pools) {
+        vkDestroyCommandPool(device.device, pool.pool, nullptr);
+    }
+}
+
+void ThreadCommandPools::reset(uint32_t frameIndex) {
+    for (uint32_t worker = 0; worker < workerCount; ++worker) {
+        Pool& pool = pools[static_cast<size_t>(frameIndex) * workerCount + worker];
+        if (pool.used > 0) {
+            vkResetCommandPool(device.device, pool.pool, 0);
+            pool.used = 0;
+        }
+    }
+}
+
+VkCommandBuffer ThreadCommandPools::begin(uint32_t worker, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance) {
+    Pool& pool = pools[static_cast<size_t>(frameIndex) * workerCount + worker];
+    if (pool.used == pool.buffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pool.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate secondary command buffer");
+        }
+        pool.buffers.push_back(commandBuffer);
+    }
+    VkCommandBuffer commandBuffer = pool.buffers[pool.used++];
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin secondary command buffer");
+    }
+    return commandBuffer;
+}
+
+int runJobBenchmark(std::ostream& out, const std::string& gpuSelection, bool forceVulkan10, const std::string& shaderOverrideDir) {
+    using Clock = std::chrono::steady_clock;
+    const uint32_t orbitChunks = 16;
+    const uint32_t bodiesPerChunk = 4096;
+    const uint32_t rectCount = 4096;
+    const uint32_t rectsPerBuffer = 128;
+    const VkExtent2D area = {1920, 1088};
+    const VkFormat format = VK_FORMAT_B8G8R8A8_SRGB;
+    uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    try {
+        Device device(nullptr, gpuSelection, forceVulkan10);
+        MemoryAllocator allocator(device);
+        ResourceTable resources(device);
+        VkRenderPass pass = VK_NULL_HANDLE;
+        if (!device.dynamicRendering) {
+            pass = Swapchain::createColorRenderPass(device.device, format, VK_ATTACHMENT_LOAD_OP_LOAD,
+                                                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        }
+        Pipeline pipeline(device, allocator, resources, pass, format, 1, shaderOverrideDir);
+
+        // Systems without a JobSystem solve on the calling job, so the jobs are the only parallelism
+        std::vector<std::unique_ptr<OrbitSystem>> orbits;
+        for (uint32_t i = 0; i < orbitChunks; ++i) {
+            orbits.push_back(std::make_unique<OrbitSystem>());
+            addAsteroidBelt(*orbits.back(), bodiesPerChunk, i + 1);
+        }
+        std::vector<std::vector<float>> positions(orbitChunks);
+        for (uint32_t i = 0; i < orbitChunks; ++i) {
+            positions[i].resize(orbits[i]->paddedSize() * 4);
+        }
+
+        // Dirty-rect sized tiles over the frame, as a partial frame records them
+        std::vector<VkRect2D> rects(rectCount);
+        uint32_t tilesX = area.width / DirtyTracker::TILE_SIZE;
+        for (uint32_t i = 0; i < rectCount; ++i) {
+            uint32_t tile = i % (tilesX * (area.height / DirtyTracker::TILE_SIZE));
+            rects[i].offset = {static_cast<int32_t>(tile % tilesX * DirtyTracker::TILE_SIZE),
+                               static_cast<int32_t>(tile / tilesX * DirtyTracker::TILE_SIZE)};
+            rects[i].extent = {DirtyTracker::TILE_SIZE, DirtyTracker::TILE_SIZE};
+        }
+
+        VkCommandBufferInheritanceRenderingInfo inheritanceRendering = {};
+        inheritanceRendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+        inheritanceRendering.colorAttachmentCount = 1;
+        inheritanceRendering.pColorAttachmentFormats = &format;
+        inheritanceRendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        VkCommandBufferInheritanceInfo inheritance = {};
+        inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance.pNext = device.dynamicRendering ? &inheritanceRendering : nullptr;
+        inheritance.renderPass = pass;
+
+        // One frame: the orbit chunks, then the recording jobs once every chunk is solved.
+        // The buffers are only recorded, never submitted, so the pools can be reset right away.
+        std::vector<VkCommandBuffer> secondaries(rectCount / rectsPerBuffer);
+        auto frame = [&](JobSystem& jobs, ThreadCommandPools& pools, double time) {
+            jobs.beginFrame();
+            pools.reset(0);
+            JobCounter* solved = jobs.frameCounter();
+            JobCounter* recorded = jobs.frameCounter();
+            for (uint32_t i = 0; i < orbitChunks; ++i) {
+                jobs.run([&, i, time](uint32_t) { orbits[i]->update(time, positions[i].data()); }, solved);
+            }
+            std::atomic<bool> recordFailed(false);
+            for (uint32_t i = 0; i < secondaries.size(); ++i) {
+                jobs.run([&, i](uint32_t worker) {
+                    // Jobs must not throw, so failures are reported through recordFailed
+                    VkCommandBuffer commandBuffer;
+                    try {
+                        commandBuffer = pools.begin(worker, 0, inheritance);
+                    } catch (const std::exception&) {
+                        recordFailed = true;
+                        return;
+                    }
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.graphicsPipeline);
+                    VkViewport viewport = {0.0f, 0.0f, static_cast<float>(area.width), static_cast<float>(area.height), 0.0f, 1.0f};
+                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                    VkDescriptorSet descriptorSets[] = {pipeline.descriptorSets[0], pipeline.resourceSet};
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, 2,
+                                            descriptorSets, 0, nullptr);
+                    pipeline.pushDrawConstants(commandBuffer, DrawConstants());
+                    for (uint32_t r = i * rectsPerBuffer; r < (i + 1) * rectsPerBuffer; ++r) {
+                        vkCmdSetScissor(commandBuffer, 0, 1, &rects[r]);
+                        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+                    }
+                    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                        recordFailed = true;
+                    }
+                    secondaries[i] = commandBuffer;
+                }, recorded, solved);
+            }
+            jobs.wait(recorded);
+            if (recordFailed) {
+                throw std::runtime_error("Failed to record secondary command buffer");
+            }
+        };
+
+        char line[256];
+        std::snprintf(line, sizeof(line), "Job system, %u orbit jobs of %u bodies, then %u rect draws in %zu secondary command buffers",
+                      orbitChunks, bodiesPerChunk, rectCount, secondaries.size());
+        out << line << std::endl;
+        std::snprintf(line, sizeof(line), "  on %s, %u hardware threads", device.properties.deviceName, hardwareThreads);
+        out << line << std::endl;
+        std::snprintf(line, sizeof(line), "  %7s %10s %8s %10s %12s", "workers", "ms/frame", "speedup", "efficiency", "steals/frame");
+        out << line << std::endl;
+
+        // Powers of two, then every hardware thread
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(hardwareThreads);
+        double singleSeconds = 0.0;
+        for (uint32_t threads : threadCounts) {
+            JobSystem jobs(threads);
+            ThreadCommandPools pools(device, threads, 1);
+            frame(jobs, pools, 0.0); // Wake the workers and grow the pools
+
+            // Repeats until half a second has passed
+            uint64_t frames = 0;
+            uint64_t stealsBefore = jobs.stealCount.load();
+            Clock::time_point start = Clock::now();
+            double elapsed = 0.0;
+            while (elapsed < 0.5) {
+                frame(jobs, pools, frames / 60.0);
+                ++frames;
+                elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            }
+            double seconds = elapsed / frames;
+            if (threads == 1) {
+                singleSeconds = seconds;
+            }
+            double speedup = singleSeconds / seconds;
+            std::snprintf(line, sizeof(line), "  %7u %10.3f %7.2fx %9.0f%% %12.1f", threads, seconds * 1000.0, speedup,
+                          speedup / threads * 100.0, static_cast<double>(jobs.stealCount.load() - stealsBefore) / frames);
+            out << line << std::endl;
+        }
+        device.waitIdle();
+        vkDestroyRenderPass(device.device, pass, nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
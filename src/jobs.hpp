@@ -0,0 +1,114 @@
+#pragma once
+#include "device.hpp"
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct JobCounter;
+
+// The argument is the index of the thread running the job, 0 being the thread that created
+// the JobSystem, so jobs can pick per-thread resources such as a ThreadCommandPools pool
+using JobFunction = std::function<void(uint32_t worker)>;
+
+struct Job {
+    JobFunction work;
+    JobCounter* counter = nullptr; // Decremented once work returns
+};
+
+// Jobs still to finish of those added against it. Once it reaches zero the jobs that
+// depend on it are queued; a counter should have all its jobs added before anything
+// depends on it.
+struct JobCounter {
+    std::atomic<uint32_t> pending;
+    std::mutex mutex;         // Guards waiting
+    std::vector<Job> waiting; // Held back until pending reaches zero
+
+    JobCounter() : pending(0) {}
+};
+
+// Work-stealing job system for per-frame CPU work. Every thread has its own deque: it pushes
+// and pops its jobs at the back, so it keeps working on what it just split off, and idle
+// threads steal from the front of the others, taking the oldest and usually largest work.
+// The creating thread is worker 0 and runs jobs while it waits, so it is never idle either.
+// Jobs must not throw; parallelFor forwards exceptions from its body to the caller.
+struct JobSystem {
+    std::atomic<uint64_t> jobCount;   // Jobs run since creation
+    std::atomic<uint64_t> stealCount; // Of those, jobs taken from another thread's deque
+
+    // threadCount includes the calling thread; 0 uses every hardware thread
+    explicit JobSystem(uint32_t threadCount = 0);
+    ~JobSystem();
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+    // Queues work on the calling thread's deque. counter, if set, counts the job until it has
+    // run; with a dependency it is only queued once that counter has reached zero.
+    void run(JobFunction work, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+    // Runs queued jobs on the calling thread until counter reaches zero
+    void wait(JobCounter& counter);
+    // Calls body(begin, end, worker) for ranges of at most grain covering [0, count), in
+    // parallel, and returns once every range is done
+    void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t, uint32_t)>& body);
+
+    // Counters for one frame's job graph, only called from the creating thread. They stay
+    // valid until the next beginFrame, which must come after every one was waited on.
+    JobCounter* frameCounter();
+    void beginFrame();
+
+private:
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    uint32_t currentWorker() const;
+    void push(uint32_t worker, Job job);
+    bool runOne(uint32_t self); // Own deque first, then steals; false when every deque is empty
+    void finish(JobCounter* counter, uint32_t self);
+    void workerLoop(uint32_t self);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<WorkerQueue[]> queues;
+    std::atomic<uint32_t> queuedJobs; // Jobs in all deques, for the sleeping workers
+    std::mutex sleepMutex;
+    std::condition_variable wakeSignal;
+    bool stopping; // Guarded by sleepMutex
+    std::deque<JobCounter> frameCounters; // A deque, so handed-out counters never move
+    size_t frameCountersUsed;
+};
+
+// A command pool per worker and frame slot, so jobs can record secondary command buffers
+// without locking a shared pool. A slot's pools are reset, and their buffers reused, once
+// its fence has signalled.
+struct ThreadCommandPools {
+    struct Pool {
+        VkCommandPool pool;
+        std::vector<VkCommandBuffer> buffers;
+        size_t used; // Buffers handed out since the last reset
+    };
+
+    const Device& device;
+    uint32_t workerCount;
+    std::vector<Pool> pools; // frameIndex * workerCount + worker
+
+    ThreadCommandPools(const Device& device, uint32_t workerCount, uint32_t frameCount);
+    ~ThreadCommandPools();
+
+    void reset(uint32_t frameIndex);
+    // Secondary command buffer from worker's pool, begun to continue the pass in inheritance
+    VkCommandBuffer begin(uint32_t worker, uint32_t frameIndex, const VkCommandBufferInheritanceInfo& inheritance);
+};
+
+// Times a synthetic frame graph on 1 to every hardware thread: orbit updates split into jobs,
+// then scissored raymarch draws recorded into secondary command buffers once the updates are
+// done, as a partial frame records its dirty rects. Needs no window. Returns the exit code.
+int runJobBenchmark(std::ostream& out, const std::string& gpuSelection, bool forceVulkan10, const std::string& shaderOverrideDir);
@@ -1,104 +1,629 @@
 #include "device.hpp"
+#include "memory.hpp"
+#include "resources.hpp"
 #include "swapchain.hpp"
 #include "pipeline.hpp"
 #include "input.hpp"
+#include "simulation.hpp"
+#include "tuning.hpp"
+#include "config.hpp"
+#include "startup.hpp"
+#include "renderfarm.hpp"
+#include "capture.hpp"
+#include "orbits.hpp"
+#include "dirty.hpp"
+#include "framelimiter.hpp"
+#include "cpurender.hpp"
+#include "metrics.hpp"
+#include "mesh.hpp"
+#include "stereo.hpp"
+#include "jobs.hpp"
+#include "scene.hpp"
 #include <GLFW/glfw3.h>
 #include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <fstream>
+#include <memory>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 #include <sstream>
+#include <vector>
 
-int main() {
-    glfwInit();
-
-    // Set up fullscreen window
-    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RED_BITS, mode->redBits);
-    glfwWindowHint(GLFW_GREEN_BITS, mode->greenBits);
-    glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
-    glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
-    GLFWwindow* window = glfwCreateWindow(mode->width, mode->height, "gridfire", monitor, nullptr);
-    if (!window) {
-        glfwTerminate();
-        throw std::runtime_error("Failed to create GLFW window");
+int main(int argc, char** argv) {
+    StartupGraph::Clock::time_point processStart = StartupGraph::Clock::now();
+    Config config;
+    try {
+        config = Config::load(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        Config::printUsage(std::cerr);
+        return 1;
     }
+    if (config.helpRequested) {
+        Config::printUsage(std::cout);
+        return 0;
+    }
+
+    // Window and device
+    int width = config.getInt("graphics.resolution_width", 0);
+    int height = config.getInt("graphics.resolution_height", 0);
+    bool fullscreen = config.getBool("graphics.fullscreen", true);
+    float fov = config.getFloat("graphics.fov", 80.0f);
+    std::string gpuSelection = config.getString("gpu.device", "");
+    bool forceVulkan10 = config.getBool("gpu.force_vulkan10", false);
 
-    // Initialize ImGui
+    // Quality preset first, then any individual knob overrides it
+    RenderSettings settings;
+    std::string quality = config.getString("graphics.quality", "high");
+    if (!applyQualityPreset(quality.c_str(), settings)) {
+        std::cerr << "Unknown quality preset '" << quality << "', using high" << std::endl;
+        quality = "high";
+        applyQualityPreset(quality.c_str(), settings);
+    }
+    config.readRenderSettings(settings, ("preset " + quality).c_str());
+
+    // Profiling
+    bool showOverlay = config.getBool("profiling.overlay", false);
+    bool showTuning = config.getBool("profiling.tuning_panel", false);
+    std::string frameLogPath = config.getString("profiling.frame_log", "");
+    std::string shaderOverrideDir = config.getString("dev.shader_dir", "");
+    bool startupReport = config.getBool("profiling.startup_report", true);
+    std::string metricsListen = config.getString("metrics.listen", "");
+
+    // Key bindings; anything unset keeps its default
+    KeyBindings keyBindings;
+    for (uint32_t action = 0; action < ACTION_COUNT; ++action) {
+        std::string name = config.getString(std::string("keybinds.") + inputActionName(action), keyName(keyBindings.keys[action]));
+        if (!parseKeyName(name, keyBindings.keys[action])) {
+            std::cerr << "Unknown key '" << name << "' for keybinds." << inputActionName(action) << ", using "
+                      << keyName(keyBindings.keys[action]) << std::endl;
+        }
+    }
+
+    // Frame capture
+    bool captureAutostart = config.getBool("capture.autostart", false);
+    std::string captureOutput = config.getString("capture.output", "capture_%03d.y4m");
+    std::string captureFormatName = config.getString("capture.format", "y4m");
+    int captureFps = config.getInt("capture.fps", 60);
+    int captureRingSize = config.getInt("capture.ring_size", 6);
+    CaptureFormat captureFormat;
+    if (!parseCaptureFormat(captureFormatName.c_str(), captureFormat)) {
+        std::cerr << "Unknown capture.format '" << captureFormatName << "', using y4m" << std::endl;
+        captureFormat = CaptureFormat::Y4m;
+    }
+    // Commands after '|' are used verbatim; file paths must take the recording index
+    if (!captureOutput.empty() && captureOutput[0] != '|' && !isValidIndexPattern(captureOutput)) {
+        std::cerr << "capture.output=" << captureOutput << " needs exactly one %d or %0Nd for the recording index, "
+                  << "using capture_%03d.y4m" << std::endl;
+        captureOutput = "capture_%03d.y4m";
+    }
+
+    // Rasterized meshes composited with the raymarch
+    std::string rasterModeName = config.getString("raster.mode", "off");
+    uint32_t rasterMode = RASTER_OFF;
+    if (!parseRasterMode(rasterModeName.c_str(), rasterMode)) {
+        std::cerr << "Unknown raster.mode '" << rasterModeName << "', using off" << std::endl;
+    }
+    int rasterProps = std::max(config.getInt("raster.props", 12), 0);
+
+    // Side-by-side stereo, fixed for the run
+    std::string stereoModeName = config.getString("stereo.mode", "off");
+    uint32_t stereoMode = STEREO_OFF;
+    if (!parseStereoMode(stereoModeName.c_str(), stereoMode)) {
+        std::cerr << "Unknown stereo.mode '" << stereoModeName << "', using off" << std::endl;
+    }
+    float eyeSeparation = std::max(config.getFloat("stereo.eye_separation", 0.2f), 0.0f);
+    if (stereoMode != STEREO_OFF && rasterMode != RASTER_OFF) {
+        std::cout << "Rasterized meshes are not drawn in stereo; raster.mode is off" << std::endl;
+        rasterMode = RASTER_OFF;
+    }
+
+    // Scene file, compiled into the raymarch shaders during startup
+    std::string sceneFile = config.getString("scene.file", "");
+    std::string sceneCacheDir = config.getString("scene.cache_dir", getSceneCacheDir());
+    std::string sceneGlslc = config.getString("scene.glslc", "");
+
+    // Orbiting bodies
+    int orbitCount = std::max(config.getInt("orbits.count", 1000), 0);
+    int orbitDrawLimit = std::max(config.getInt("orbits.draw_limit", 1024), 0);
+    int orbitSeed = config.getInt("orbits.seed", 1);
+    if (config.getBool("orbits.benchmark", false)) {
+        runOrbitBenchmark(std::cout);
+        return 0;
+    }
+
+    // CPU raymarcher benchmark and headless frames need no window either
+    if (config.getBool("cpu.benchmark", false)) {
+        runCpuBenchmark(std::cout, settings, fov);
+        return 0;
+    }
+    if (config.getBool("cpu.headless", false)) {
+        return runCpuRender(config, settings, fov);
+    }
+
+    // The shader precision benchmark renders offscreen on a headless device
+    if (config.getBool("raymarch.precision_benchmark", false)) {
+        return runPrecisionBenchmark(std::cout, settings, fov, gpuSelection, forceVulkan10, shaderOverrideDir);
+    }
+    int jobThreads = std::max(config.getInt("jobs.threads", 0), 0);
+    if (config.getBool("jobs.benchmark", false)) {
+        return runJobBenchmark(std::cout, gpuSelection, forceVulkan10, shaderOverrideDir);
+    }
+    if (config.getBool("stereo.benchmark", false)) {
+        return runStereoBenchmark(std::cout, settings, fov, eyeSeparation, gpuSelection, shaderOverrideDir,
+                                  config.getString("stereo.output", ""));
+    }
+    if (config.getBool("scene.benchmark", false)) {
+        return runSceneBenchmark(std::cout, settings, fov, gpuSelection, forceVulkan10, sceneFile, sceneCacheDir, sceneGlslc);
+    }
+
+    // Render farm roles render offline tiles and never open a window
+    std::string farmRole = config.getString("farm.role", "");
+    if (farmRole == "coordinator" || farmRole == "worker") {
+        return runRenderFarm(config, farmRole, settings, fov, gpuSelection, forceVulkan10, shaderOverrideDir);
+    }
+    if (!farmRole.empty()) {
+        std::cerr << "Unknown farm.role '" << farmRole << "', expected coordinator or worker" << std::endl;
+        return 1;
+    }
+    config.print(std::cout);
+
+    StartupGraph startup(processStart);
+    StartupGraph::TaskId configStage = startup.recordStage("config", processStart);
+
+    // Initialize ImGui; the GLFW and Vulkan backends are set up during startup below
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
     ImGui::StyleColorsDark();
 
-    // Initialize ImGui GLFW backend
-    if (!ImGui_ImplGlfw_InitForVulkan(window, true)) {
-        throw std::runtime_error("Failed to initialize ImGui GLFW backend");
-    }
-
+    GLFWwindow* window = nullptr;
     try {
-        Device device(window);
-        Swapchain swapchain(device);
-        Pipeline pipeline(device, swapchain.renderPass, swapchain.extent, swapchain.MAX_FRAMES_IN_FLIGHT);
-        swapchain.createFramebuffers(pipeline);
-        Input input(window);
+        // Job threads for per-frame CPU work: orbit updates and CPU raymarch tiles. This thread
+        // is worker 0; declared first so the orbits and the CPU raymarcher go before it.
+        JobSystem jobs(static_cast<uint32_t>(jobThreads));
+
+        std::unique_ptr<Device> devicePtr;
+        std::unique_ptr<MemoryAllocator> allocatorPtr;
+        std::unique_ptr<ResourceTable> resourcesPtr;
+        std::unique_ptr<Swapchain> swapchainPtr;
+        std::unique_ptr<Pipeline> pipelinePtr;
+        std::unique_ptr<MeshRenderer> meshesPtr;
+        std::unique_ptr<Input> inputPtr;
+        std::unique_ptr<Simulation> simulationPtr;
+        std::unique_ptr<OrbitSystem> orbitsPtr;
+        VkSurfaceFormatKHR surfaceFormat = {};
+        SceneShaders sceneShaders; // dir stays empty without a scene file or when it fails to compile
+
+        // Startup graph: GLFW, the surface and ImGui stay on the main thread, while the font
+        // atlas and the graphics pipeline are built on workers alongside device/swapchain setup
+        StartupGraph::TaskId windowTask = startup.add("window", [&] {
+            glfwInit();
+
+            // Set up the window; a zero size means the monitor's native mode
+            GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+            const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+            glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+            glfwWindowHint(GLFW_RED_BITS, mode->redBits);
+            glfwWindowHint(GLFW_GREEN_BITS, mode->greenBits);
+            glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
+            glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
+            if (width <= 0 || height <= 0) {
+                width = mode->width;
+                height = mode->height;
+            }
+            window = glfwCreateWindow(width, height, "gridfire", fullscreen ? monitor : nullptr, nullptr);
+            if (!window) {
+                throw std::runtime_error("Failed to create GLFW window");
+            }
+
+            // Initialize ImGui GLFW backend
+            if (!ImGui_ImplGlfw_InitForVulkan(window, true)) {
+                throw std::runtime_error("Failed to initialize ImGui GLFW backend");
+            }
+        }, {configStage});
+        StartupGraph::TaskId fontsTask = startup.add("imgui fonts", [&] {
+            // Rasterizing the atlas is pure CPU work; the Vulkan backend only uploads it
+            io.Fonts->Build();
+        }, {configStage}, false);
+        StartupGraph::TaskId sceneTask = startup.add("scene", [&] {
+            // Only runs glslc when the scene or the raymarch source changed since the last run
+            if (sceneFile.empty()) {
+                return;
+            }
+            try {
+                sceneShaders = compileScene(sceneFile, sceneCacheDir, sceneGlslc);
+                char line[256];
+                std::snprintf(line, sizeof(line), "Scene %s: %u primitives, %u orbits, %u bounds; %s in %.1f ms", sceneFile.c_str(),
+                              sceneShaders.glsl.primitives, sceneShaders.glsl.orbits, sceneShaders.glsl.bounds,
+                              sceneShaders.cached ? "cached" : "compiled", sceneShaders.compileSeconds * 1000.0);
+                std::cout << line << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "; drawing the built-in scene" << std::endl;
+            }
+        }, {configStage}, false);
+        StartupGraph::TaskId deviceTask = startup.add("device", [&] {
+            devicePtr = std::make_unique<Device>(window, gpuSelection, forceVulkan10);
+            surfaceFormat = Swapchain::chooseSurfaceFormat(*devicePtr);
+            stereoMode = supportedStereoMode(*devicePtr, stereoMode, std::cout);
+        }, {windowTask});
+        StartupGraph::TaskId resourcesTask = startup.add("allocator", [&] {
+            allocatorPtr = std::make_unique<MemoryAllocator>(*devicePtr);
+            resourcesPtr = std::make_unique<ResourceTable>(*devicePtr);
+        }, {deviceTask});
+        StartupGraph::TaskId swapchainTask = startup.add("swapchain", [&] {
+            swapchainPtr = std::make_unique<Swapchain>(*devicePtr, *allocatorPtr, rasterMode, stereoMode);
+        }, {resourcesTask, fontsTask});
+        startup.add("pipeline", [&] {
+            // The 1.0 path only needs a compatible render pass, not the swapchain's own
+            VkFormat depthFormat = rasterMode != RASTER_OFF ? Swapchain::chooseDepthFormat(*devicePtr) : VK_FORMAT_UNDEFINED;
+            VkRenderPass compatiblePass = VK_NULL_HANDLE;
+            if (!devicePtr->dynamicRendering) {
+                compatiblePass = Swapchain::createColorRenderPass(devicePtr->device, surfaceFormat.format, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                                  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                                                  depthFormat);
+            }
+            try {
+                pipelinePtr = std::make_unique<Pipeline>(*devicePtr, *allocatorPtr, *resourcesPtr, compatiblePass, surfaceFormat.format,
+                                                         Swapchain::MAX_FRAMES_IN_FLIGHT,
+                                                         sceneShaders.dir.empty() ? shaderOverrideDir : sceneShaders.dir, depthFormat, rasterMode,
+                                                         stereoMode == STEREO_MULTIVIEW ? 0x3u : 0u);
+                if (rasterMode != RASTER_OFF) {
+                    meshesPtr = std::make_unique<MeshRenderer>(*devicePtr, *allocatorPtr, compatiblePass, surfaceFormat.format,
+                                                               depthFormat, shaderOverrideDir);
+                    addRasterProps(*meshesPtr, static_cast<uint32_t>(rasterProps));
+                    meshesPtr->upload();
+                }
+            } catch (...) {
+                vkDestroyRenderPass(devicePtr->device, compatiblePass, nullptr);
+                throw;
+            }
+            vkDestroyRenderPass(devicePtr->device, compatiblePass, nullptr);
+        }, {resourcesTask, sceneTask}, false);
+        startup.add("input", [&] {
+            inputPtr = std::make_unique<Input>(window, fov, keyBindings);
+            inputPtr->setPanelsVisible(showOverlay, showTuning);
+            simulationPtr = std::make_unique<Simulation>(*inputPtr);
+        }, {windowTask});
+        startup.add("orbits", [&] {
+            orbitsPtr = std::make_unique<OrbitSystem>(&jobs);
+            addAsteroidBelt(*orbitsPtr, static_cast<uint32_t>(orbitCount), static_cast<uint32_t>(orbitSeed));
+        }, {configStage}, false);
+        startup.add("settings", [&] {
+            swapchainPtr->sceneFile = !sceneShaders.dir.empty();
+            swapchainPtr->applySettings(settings);
+        }, {swapchainTask, sceneTask});
+        startup.run();
+
+        Device& device = *devicePtr;
+        MemoryAllocator& allocator = *allocatorPtr;
+        ResourceTable& resources = *resourcesPtr;
+        Swapchain& swapchain = *swapchainPtr;
+        Pipeline& pipeline = *pipelinePtr;
+        Input& input = *inputPtr;
+        Simulation& simulation = *simulationPtr;
+        OrbitSystem& orbits = *orbitsPtr;
+
+        // Positions are solved straight into the slot's mapped buffer once its fence has signalled
+        OrbitBuffers orbitBuffers(allocator, resources, orbits, Swapchain::MAX_FRAMES_IN_FLIGHT);
+        double orbitSolveTime = 0.0;
+
+        // Dirty regions and the CPU raymarcher read the positions back, which is slow from the
+        // write-combined buffer, so they are solved into bodyPositions and copied over instead
+        DirtyTracker dirtyTracker;
+        std::vector<VkRect2D> dirtyRects;
+        std::vector<float> bodyPositions;
+
+        // Software backend, started the first time it is switched on
+        std::unique_ptr<CpuRaymarcher> cpuMarcher;
+        CpuSceneBuffers cpuSceneBuffers(allocator, Swapchain::MAX_FRAMES_IN_FLIGHT);
+
+        // Live performance knobs from the config, edited from the F4 tuning panel
+        TuningPanel tuning;
+        uint32_t stepHistogram[Pipeline::STEP_HISTOGRAM_SETS * Pipeline::STEP_HISTOGRAM_BINS];
+
+        // Render thread utilization: time not spent blocked on the GPU/presentation engine
+        float renderUtilization = 0.0f;
+        double renderBusyTime = 0.0;
+        double renderWindowStart = glfwGetTime();
+
+        // Frame rate cap; the monitor's refresh rate is re-read every second in case the
+        // window moved or the mode changed
+        FrameLimiter frameLimiter;
+        int refreshRate = monitorRefreshRate(window);
+        double refreshCheckTime = glfwGetTime();
+        double limiterWait = 0.0;
+
+        std::ofstream frameLog;
+        if (!frameLogPath.empty()) {
+            frameLog.open(frameLogPath);
+            if (!frameLog.is_open()) {
+                throw std::runtime_error("Failed to open frame log: " + frameLogPath);
+            }
+            frameLog << "frame,time_s,frame_ms,wait_ms,limit_ms\n";
+        }
+        uint64_t frameNumber = 0;
+
+        // Prometheus endpoint; the render loop only stores into its atomics
+        Metrics metrics;
+        std::unique_ptr<MetricsServer> metricsServer;
+        uint64_t metricsGpuTimesRead = 0;
+        uint64_t metricsCaptureDropped = 0; // Each recording restarts the capture's own count
+        if (!metricsListen.empty()) {
+            try {
+                metricsServer = std::make_unique<MetricsServer>(metrics, metricsListen);
+                std::cout << "Metrics: serving on " << metricsListen << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+        }
+
+        // The ring needs more slots than frames in flight, or every frame waits on the writer
+        FrameCapture capture(device, allocator, std::max(captureRingSize, static_cast<int>(Swapchain::MAX_FRAMES_IN_FLIGHT) + 1));
+        swapchain.capture = &capture;
+        swapchain.resources = &resources;
+        swapchain.meshes = meshesPtr.get();
+        swapchain.jobs = &jobs;
+        float aaCoverage = 0.0f; // Fraction of scene pixels supersampled by adaptive AA
+        uint32_t captureIndex = 0;
+        auto toggleCapture = [&] {
+            if (capture.isActive()) {
+                capture.stop();
+                return;
+            }
+            if (!swapchain.captureSupported) {
+                std::cerr << "Capture: the swapchain images cannot be copied on this device" << std::endl;
+                return;
+            }
+            // File paths are index patterns taking the recording index; commands are used verbatim
+            std::string path = captureOutput;
+            if (path.empty()) {
+                std::cerr << "Capture: capture.output is empty" << std::endl;
+                return;
+            }
+            if (path[0] != '|') {
+                path = formatIndexPattern(captureOutput, captureIndex);
+            }
+            ++captureIndex;
+            try {
+                capture.start(path, captureFormat, static_cast<uint32_t>(std::max(captureFps, 1)));
+                std::cout << "Capture: recording to " << path << std::endl;
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+            }
+        };
+        if (captureAutostart) {
+            toggleCapture();
+        }
 
         double lastTime = glfwGetTime();
+        StartupGraph::Clock::time_point firstFrameStart = StartupGraph::Clock::now();
         while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+            // Wait out the frame cap before sampling input, so the frame starts with the latest events
+            if (settings.fpsLimit == FPS_LIMIT_REFRESH && lastTime - refreshCheckTime >= 1.0) {
+                refreshRate = monitorRefreshRate(window);
+                refreshCheckTime = lastTime;
+            }
+            frameLimiter.setTargetFps(settings.fpsLimit == FPS_LIMIT_REFRESH ? refreshRate : settings.fpsLimit);
+            limiterWait = frameLimiter.wait();
+
+            // GLFW events and ImGui stay on the main thread; the camera is integrated
+            // on the simulation thread from the queued input events
+            input.pollEvents();
             double currentTime = glfwGetTime();
             float deltaTime = static_cast<float>(currentTime - lastTime);
             lastTime = currentTime;
 
+            // swapchain.waitTime still refers to the previous frame, which deltaTime spans
+            double frameWait = swapchain.waitTime + limiterWait;
+            renderBusyTime += deltaTime - frameWait;
+            if (currentTime - renderWindowStart >= 0.5) {
+                renderUtilization = static_cast<float>(renderBusyTime / (currentTime - renderWindowStart));
+                renderBusyTime = 0.0;
+                renderWindowStart = currentTime;
+                if (metricsServer) {
+                    MemoryStats memStats = allocator.getStats();
+                    Metrics::set(metrics.memoryReserved, memStats.reserved);
+                    Metrics::set(metrics.memoryUsed, memStats.used);
+                    Metrics::set(metrics.memoryBlocks, memStats.blockCount);
+                    Metrics::set(metrics.memoryAllocations, memStats.allocationCount);
+                    uint64_t captureDropped = capture.getStats().framesDropped;
+                    Metrics::add(metrics.captureDroppedFrames, captureDropped >= metricsCaptureDropped
+                                                                   ? captureDropped - metricsCaptureDropped
+                                                                   : captureDropped);
+                    metricsCaptureDropped = captureDropped;
+                    Metrics::set(metrics.renderUtilization, renderUtilization);
+                    Metrics::set(metrics.simulationRate, simulation.getTickRate());
+                    Metrics::set(metrics.cpuUsage, frameLimiter.getStats().cpuUsage);
+                }
+            }
+            if (metricsServer) {
+                metrics.frameTime.observe(deltaTime);
+                Metrics::add(metrics.frames, 1);
+                Metrics::set(metrics.gpuWaitSeconds, swapchain.scheduler.totalWaitSeconds);
+                Metrics::set(metrics.lateFrames, frameLimiter.getLateFrames());
+                Metrics::set(metrics.droppedFrames, frameLimiter.getDroppedFrames());
+                Metrics::set(metrics.swapchainRecreations, swapchain.recreateCount);
+                if (swapchain.gpuTimesRead != metricsGpuTimesRead) {
+                    metricsGpuTimesRead = swapchain.gpuTimesRead;
+                    metrics.gpuPassTime[GPU_PASS_SCENE].observe(swapchain.gpuSceneTime);
+                    metrics.gpuPassTime[GPU_PASS_POST].observe(swapchain.gpuPostTime);
+                }
+            }
+            tuning.recordFrame(deltaTime * 1000.0f, static_cast<float>(frameWait * 1000.0));
+            if (frameLog.is_open()) {
+                frameLog << frameNumber << "," << currentTime << "," << deltaTime * 1000.0f << "," << swapchain.waitTime * 1000.0
+                         << "," << limiterWait * 1000.0 << "\n";
+            }
+            ++frameNumber;
+
             // Start ImGui frame
             ImGui_ImplGlfw_NewFrame();
             ImGui::NewFrame();
 
             // Check for exit
             bool shouldExit = input.shouldExit();
+            if (input.toggleCapture()) {
+                toggleCapture();
+            }
 
             // Create ImGui debug window if enabled
             bool showImGuiWindow = input.toggleImGuiWindow();
+            bool showTuningPanel = input.toggleTuningPanel();
             if (showImGuiWindow) {
                 ImGui::SetNextWindowPos(ImVec2(swapchain.extent.width - 210.0f, 10.0f), ImGuiCond_Always);
-                ImGui::SetNextWindowSize(ImVec2(200.0f, 150.0f), ImGuiCond_Always);
+                ImGui::SetNextWindowSize(ImVec2(200.0f, 468.0f), ImGuiCond_Always);
                 ImGui::Begin("Debug Info", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoInputs);
 
                 // Frame time and FPS
-                float frameTimeMs = input.getFrameTime() * 1000.0f;
+                float frameTimeMs = deltaTime * 1000.0f;
                 float fps = frameTimeMs > 0.0f ? 1000.0f / frameTimeMs : 0.0f;
                 ImGui::Text("Frame Time: %.2f ms", frameTimeMs);
                 ImGui::Text("FPS: %.1f", fps);
 
                 // Resolution
                 ImGui::Text("Resolution: %ux%u", swapchain.extent.width, swapchain.extent.height);
+                ImGui::Text("Scene: %ux%u (%.2fx)", swapchain.renderExtent.width, swapchain.renderExtent.height, swapchain.renderScale);
 
                 // Swapchain info
                 ImGui::Text("Image Count: %u", swapchain.getImageCount());
-                std::string presentModeStr;
-                switch (swapchain.getPresentMode()) {
-                    case VK_PRESENT_MODE_IMMEDIATE_KHR: presentModeStr = "Immediate"; break;
-                    case VK_PRESENT_MODE_MAILBOX_KHR: presentModeStr = "Mailbox"; break;
-                    case VK_PRESENT_MODE_FIFO_KHR: presentModeStr = "FIFO"; break;
-                    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: presentModeStr = "FIFO Relaxed"; break;
-                    default: presentModeStr = "Unknown"; break;
+                ImGui::Text("Present Mode: %s", presentModeName(swapchain.getPresentMode()));
+                ImGui::Text("Frames in flight: %u", swapchain.framesInFlight);
+                ImGui::Text("March: %s, %d steps", marchStrategyName(settings.marchStrategy), settings.maxSteps);
+                ImGui::Text("Grid: %s", gridModeName(settings.gridMode));
+                if (settings.cpuRender && cpuMarcher) {
+                    ImGui::Text("Backend: cpu %s x%u, %.1f ms", keplerKernelName(cpuMarcher->kernel), cpuMarcher->getThreadCount(),
+                                cpuMarcher->renderSeconds * 1000.0);
+                } else {
+                    // Auto resolves to fp16 whenever the float16 pipeline exists
+                    bool fp16 = pipeline.select(settings.shaderPrecision) == pipeline.fp16Pipeline;
+                    ImGui::Text("Backend: gpu, %s%s", fp16 ? "fp16" : "fp32", swapchain.sceneFile ? ", scene file" : "");
+                }
+                if (settings.aaMode != AA_OFF) {
+                    ImGui::Text("AA: %.1f%% supersampled", aaCoverage * 100.0f);
+                } else {
+                    ImGui::Text("AA: off");
+                }
+                if (settings.dirtyRegions) {
+                    ImGui::Text("Re-rendered: %.1f%%", swapchain.redrawFraction * 100.0f);
+                } else {
+                    ImGui::Text("Re-rendered: all");
+                }
+                ImGui::Text("Bodies: %zu, %.2f ms (%s)", orbits.count, orbitSolveTime * 1000.0, keplerKernelName(orbits.kernel));
+
+                // Thread utilization
+                ImGui::Text("Sim: %.0f Hz, %.0f%% busy", simulation.getTickRate(), simulation.getUtilization() * 100.0f);
+                ImGui::Text("Render: %.0f%% busy", renderUtilization * 100.0f);
+                ImGui::Text("GPU wait: %.2f ms (%s)", swapchain.gpuWaitTime * 1000.0,
+                            swapchain.scheduler.timeline ? "timeline" : "fences");
+
+                // Frame cap pacing and what the process costs
+                FrameLimiterStats limiterStats = frameLimiter.getStats();
+                if (limiterStats.targetFps > 0.0) {
+                    ImGui::Text("Cap: %.0f fps, err %.3f/%.3f ms", limiterStats.targetFps, limiterStats.meanError * 1000.0,
+                                limiterStats.maxError * 1000.0);
+                    ImGui::Text("Spin: %.2f ms, %u late", limiterStats.spinMargin * 1000.0, limiterStats.lateFrames);
+                } else {
+                    ImGui::Text("Cap: off");
+                }
+                if (limiterStats.packagePower >= 0.0f) {
+                    ImGui::Text("CPU: %.0f%% of a core, %.1f W", limiterStats.cpuUsage * 100.0f, limiterStats.packagePower);
+                } else {
+                    ImGui::Text("CPU: %.0f%% of a core", limiterStats.cpuUsage * 100.0f);
+                }
+
+                // Device memory
+                MemoryStats memStats = allocator.getStats();
+                ImGui::Text("VRAM: %.1f / %.1f MiB", memStats.used / 1048576.0, memStats.reserved / 1048576.0);
+                ImGui::Text("Blocks: %u, Allocs: %u", memStats.blockCount, memStats.allocationCount);
+                ImGui::Text("Fragmentation: %.0f%%", memStats.fragmentation * 100.0f);
+                ImGui::Text("Bindless: %u tex, %u buf", resources.getUsedCount(ResourceType::Texture),
+                            resources.getUsedCount(ResourceType::StorageBuffer));
+
+                // Frame capture
+                CaptureStats captureStats = capture.getStats();
+                if (captureStats.active) {
+                    ImGui::Text("REC: %llu frames, %llu dropped", static_cast<unsigned long long>(captureStats.framesWritten),
+                                static_cast<unsigned long long>(captureStats.framesDropped));
+                    ImGui::Text("Capture: %.1f MiB/s", captureStats.bandwidth / 1048576.0);
+                } else {
+                    ImGui::Text("Capture: off (F10)");
                 }
-                ImGui::Text("Present Mode: %s", presentModeStr.c_str());
 
                 ImGui::End();
             }
+            if (showTuningPanel) {
+                tuning.draw(settings, swapchain.supportedPresentModes, swapchain.MAX_FRAMES_IN_FLIGHT, device.fragmentStoresAndAtomics);
+            }
 
             // Render ImGui
             ImGui::Render();
+            swapchain.applySettings(settings);
 
-            // Update game state
-            input.updateCamera(deltaTime);
+            // The slot's UBO and step counters are only safe to touch once its fence has signalled
             input.processImGuiInput();
-            pipeline.updateUBO(input.getCamera());
-            swapchain.drawFrame(pipeline, showImGuiWindow);
+            swapchain.waitForFrame();
+            pipeline.readStepHistogram(swapchain.currentFrame, stepHistogram);
+            uint32_t aaPixels = pipeline.readAaPixelCount(swapchain.currentFrame);
+            aaCoverage = std::min(1.0f, aaPixels / static_cast<float>(swapchain.renderExtent.width * swapchain.renderExtent.height));
+            tuning.setStepHistogram(stepHistogram, settings.maxSteps);
+
+            // Update game state from the latest simulation snapshot. Poll once more after the
+            // fence wait so mouse motion that arrived during it is in this frame.
+            input.pollEvents();
+            double sceneTime;
+            Camera camera = simulation.interpolate(glfwGetTime(), &sceneTime);
+            // Each stereo eye gets half the window
+            uint32_t eyeWidth = stereoMode != STEREO_OFF ? swapchain.extent.width / 2 : swapchain.extent.width;
+            camera.proj = perspectiveProjection(fov, static_cast<float>(eyeWidth) / swapchain.extent.height);
+            double solveStart = glfwGetTime();
+            if (settings.dirtyRegions || settings.cpuRender) {
+                bodyPositions.resize(orbits.paddedSize() * 4);
+                orbits.update(sceneTime, bodyPositions.data());
+                memcpy(orbitBuffers.positions(swapchain.currentFrame), bodyPositions.data(), bodyPositions.size() * sizeof(float));
+            } else {
+                orbits.update(sceneTime, orbitBuffers.positions(swapchain.currentFrame));
+            }
+            orbitSolveTime = glfwGetTime() - solveStart;
+            SceneBodies bodies;
+            bodies.buffer = orbitBuffers.handles[swapchain.currentFrame].index;
+            bodies.count = static_cast<uint32_t>(std::min(orbits.count, static_cast<size_t>(orbitDrawLimit)));
+            bodies.boundingRadius = orbits.boundingRadius;
+            pipeline.updateUBO(camera, static_cast<float>(sceneTime), swapchain.currentFrame, settings, bodies,
+                               stereoMode != STEREO_OFF ? eyeSeparation : 0.0f);
+            bool partialFrame = settings.dirtyRegions &&
+                                dirtyTracker.update(camera, settings, swapchain.renderExtent, sceneTime, bodyPositions.data(),
+                                                    bodies.count, dirtyRects);
+            VkBuffer sceneUpload = VK_NULL_HANDLE;
+            if (settings.cpuRender) {
+                if (!cpuMarcher) {
+                    cpuMarcher = std::make_unique<CpuRaymarcher>(jobs);
+                }
+                cpuSceneBuffers.resize(swapchain.renderExtent);
+                VkFormat format = swapchain.imageFormat;
+                bool srgb = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+                bool bgra = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+                CpuScene scene = makeCpuScene(camera, static_cast<float>(sceneTime), settings, swapchain.renderExtent.width,
+                                              swapchain.renderExtent.height, srgb, bgra);
+                scene.bodies = bodyPositions.data();
+                scene.bodyCount = bodies.count;
+                scene.bodyBounds = bodies.boundingRadius;
+                cpuMarcher->render(scene, cpuSceneBuffers.pixels(swapchain.currentFrame));
+                sceneUpload = cpuSceneBuffers.buffers[swapchain.currentFrame].buffer;
+            }
+            if (meshesPtr) {
+                meshesPtr->setCamera(camera);
+            }
+            swapchain.drawFrame(pipeline, showImGuiWindow || showTuningPanel, partialFrame ? &dirtyRects : nullptr, sceneUpload);
+            if (frameNumber == 1 && startupReport) {
+                startup.recordStage("first frame", firstFrameStart);
+                startup.report(std::cout);
+            }
 
             // Handle exit after rendering to ensure ImGui frame is complete
             if (shouldExit) {
@@ -107,15 +632,20 @@ int main() {
         }
 
         device.waitIdle();
+        capture.stop();
 
         // Cleanup ImGui
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        ImGui_ImplGlfw_Shutdown();
+        if (io.BackendPlatformUserData) {
+            ImGui_ImplGlfw_Shutdown();
+        }
         ImGui::DestroyContext();
-        glfwDestroyWindow(window);
+        if (window) {
+            glfwDestroyWindow(window);
+        }
         glfwTerminate();
         return -1;
     }
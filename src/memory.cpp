@@ -0,0 +1,333 @@
+#include "memory.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+struct MemoryBlock {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void* mapped;
+    bool dedicated;
+    std::map<VkDeviceSize, VkDeviceSize> freeRanges; // Offset -> size, coalesced
+    VkDeviceSize used;
+    uint32_t allocationCount;
+};
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static uint32_t popcount(uint32_t bits) {
+    uint32_t count = 0;
+    for (; bits; bits &= bits - 1) {
+        ++count;
+    }
+    return count;
+}
+
+MemoryAllocator::MemoryAllocator(const Device& device, VkDeviceSize blockSize)
+    : device(device), blockSize(blockSize), deviceAllocationCount(0) {
+    vkGetPhysicalDeviceMemoryProperties(device.physicalDevice, &memProperties);
+    bufferImageGranularity = device.properties.limits.bufferImageGranularity;
+    blocks.resize(memProperties.memoryTypeCount);
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    for (auto& typeBlocks : blocks) {
+        for (auto& block : typeBlocks) {
+            if (block->mapped) {
+                vkUnmapMemory(device.device, block->memory);
+            }
+            vkFreeMemory(device.device, block->memory, nullptr);
+        }
+    }
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required,
+                                         VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags avoided) const {
+    uint32_t best = UINT32_MAX;
+    int bestScore = -1;
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+        VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+        if (!(typeBits & (1u << i)) || (flags & required) != required) {
+            continue;
+        }
+        int score = static_cast<int>(popcount(flags & preferred)) * 2 - static_cast<int>(popcount(flags & avoided)) * 3;
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+bool MemoryAllocator::allocateFromType(uint32_t memoryType, VkDeviceSize size, VkDeviceSize alignment, Allocation& out) {
+    bool hostVisible = memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+    auto carve = [&](MemoryBlock* block) -> bool {
+        for (auto it = block->freeRanges.begin(); it != block->freeRanges.end(); ++it) {
+            VkDeviceSize rangeOffset = it->first;
+            VkDeviceSize rangeSize = it->second;
+            VkDeviceSize offset = alignUp(rangeOffset, alignment);
+            if (offset + size > rangeOffset + rangeSize) {
+                continue;
+            }
+            // Split off the unused head and tail of the free range
+            block->freeRanges.erase(it);
+            if (offset > rangeOffset) {
+                block->freeRanges[rangeOffset] = offset - rangeOffset;
+            }
+            if (offset + size < rangeOffset + rangeSize) {
+                block->freeRanges[offset + size] = rangeOffset + rangeSize - (offset + size);
+            }
+            block->used += size;
+            block->allocationCount++;
+
+            out.memory = block->memory;
+            out.offset = offset;
+            out.size = size;
+            out.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+            out.memoryType = memoryType;
+            out.block = block;
+            return true;
+        }
+        return false;
+    };
+
+    // Large requests get a dedicated block so they don't fragment the shared ones
+    bool dedicated = size > blockSize / 2;
+    if (!dedicated) {
+        for (auto& block : blocks[memoryType]) {
+            if (!block->dedicated && carve(block.get())) {
+                return true;
+            }
+        }
+    }
+
+    if (deviceAllocationCount >= device.properties.limits.maxMemoryAllocationCount) {
+        throw std::runtime_error("Exceeded maxMemoryAllocationCount");
+    }
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = dedicated ? size : blockSize;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    auto block = std::make_unique<MemoryBlock>();
+    if (vkAllocateMemory(device.device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+        return false; // Heap exhausted; caller tries the next candidate type
+    }
+    deviceAllocationCount++;
+    block->size = allocInfo.allocationSize;
+    block->mapped = nullptr;
+    block->dedicated = dedicated;
+    block->used = 0;
+    block->allocationCount = 0;
+    block->freeRanges[0] = block->size;
+    if (hostVisible && vkMapMemory(device.device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+        vkFreeMemory(device.device, block->memory, nullptr);
+        deviceAllocationCount--;
+        throw std::runtime_error("Failed to map memory block");
+    }
+
+    MemoryBlock* raw = block.get();
+    blocks[memoryType].push_back(std::move(block));
+    return carve(raw);
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear) {
+    VkMemoryPropertyFlags required = 0;
+    VkMemoryPropertyFlags preferred = 0;
+    VkMemoryPropertyFlags avoided = 0;
+    switch (usage) {
+        case MemoryUsage::GpuOnly:
+            required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            break;
+        case MemoryUsage::Upload:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case MemoryUsage::Staging:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            break;
+        case MemoryUsage::Readback:
+            required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+            preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            break;
+    }
+
+    // Optimal-tiling images must not share a bufferImageGranularity page with linear resources
+    VkDeviceSize alignment = requirements.alignment;
+    VkDeviceSize size = requirements.size;
+    if (!linear) {
+        alignment = std::max(alignment, bufferImageGranularity);
+        size = alignUp(size, bufferImageGranularity);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t typeBits = requirements.memoryTypeBits;
+    while (true) {
+        uint32_t memoryType = findMemoryType(typeBits, required, preferred, avoided);
+        if (memoryType == UINT32_MAX) {
+            throw std::runtime_error("Failed to find suitable memory type");
+        }
+        Allocation allocation;
+        if (allocateFromType(memoryType, size, alignment, allocation)) {
+            return allocation;
+        }
+        typeBits &= ~(1u << memoryType); // e.g. BAR heap full, fall back to the next best type
+    }
+}
+
+void MemoryAllocator::free(Allocation& allocation) {
+    if (!allocation.block) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryBlock* block = allocation.block;
+
+    // Insert the range and coalesce with its neighbours
+    VkDeviceSize offset = allocation.offset;
+    VkDeviceSize size = allocation.size;
+    auto next = block->freeRanges.lower_bound(offset);
+    if (next != block->freeRanges.end() && offset + size == next->first) {
+        size += next->second;
+        next = block->freeRanges.erase(next);
+    }
+    if (next != block->freeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            block->freeRanges.erase(prev);
+        }
+    }
+    block->freeRanges[offset] = size;
+    block->used -= allocation.size;
+    block->allocationCount--;
+
+    // Release dedicated blocks right away; keep one empty shared block per type around
+    auto& typeBlocks = blocks[allocation.memoryType];
+    if (block->allocationCount == 0) {
+        size_t emptyShared = std::count_if(typeBlocks.begin(), typeBlocks.end(), [](const auto& b) {
+            return !b->dedicated && b->allocationCount == 0;
+        });
+        if (block->dedicated || emptyShared > 1) {
+            auto it = std::find_if(typeBlocks.begin(), typeBlocks.end(), [block](const auto& b) { return b.get() == block; });
+            if (block->mapped) {
+                vkUnmapMemory(device.device, block->memory);
+            }
+            vkFreeMemory(device.device, block->memory, nullptr);
+            deviceAllocationCount--;
+            typeBlocks.erase(it);
+        }
+    }
+    allocation = Allocation();
+}
+
+Buffer MemoryAllocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage) {
+    Buffer buffer;
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device.device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create buffer");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device.device, buffer.buffer, &memRequirements);
+    buffer.allocation = allocate(memRequirements, memoryUsage);
+
+    if (vkBindBufferMemory(device.device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to bind buffer memory");
+    }
+    return buffer;
+}
+
+void MemoryAllocator::destroyBuffer(Buffer& buffer) {
+    if (buffer.buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device.device, buffer.buffer, nullptr);
+        buffer.buffer = VK_NULL_HANDLE;
+    }
+    free(buffer.allocation);
+}
+
+MemoryStats MemoryAllocator::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryStats stats = {};
+    VkDeviceSize totalFree = 0;
+    VkDeviceSize largestFree = 0;
+    for (const auto& typeBlocks : blocks) {
+        for (const auto& block : typeBlocks) {
+            stats.blockCount++;
+            stats.allocationCount += block->allocationCount;
+            stats.reserved += block->size;
+            stats.used += block->used;
+            for (const auto& range : block->freeRanges) {
+                totalFree += range.second;
+                largestFree = std::max(largestFree, range.second);
+            }
+        }
+    }
+    stats.fragmentation = totalFree > 0 ? 1.0f - static_cast<float>(largestFree) / static_cast<float>(totalFree) : 0.0f;
+    return stats;
+}
+
+LinearAllocator::LinearAllocator(MemoryAllocator& allocator, VkDeviceSize capacity, VkBufferUsageFlags usage)
+    : allocator(allocator), capacity(capacity), head(0) {
+    buffer = allocator.createBuffer(capacity, usage, MemoryUsage::Upload);
+}
+
+LinearAllocator::~LinearAllocator() {
+    allocator.destroyBuffer(buffer);
+}
+
+void* LinearAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    VkDeviceSize start = alignUp(head, alignment);
+    if (start + size > capacity) {
+        return nullptr;
+    }
+    head = start + size;
+    offset = start;
+    return static_cast<char*>(buffer.allocation.mapped) + start;
+}
+
+void LinearAllocator::reset() {
+    head = 0;
+}
+
+RingAllocator::RingAllocator(MemoryAllocator& allocator, VkDeviceSize capacity, VkBufferUsageFlags usage, uint32_t framesInFlight)
+    : allocator(allocator), capacity(alignUp(capacity, 256)), headPos(0), tailPos(0),
+      frameEnds(framesInFlight, 0), currentSlot(0) {
+    buffer = allocator.createBuffer(this->capacity, usage, MemoryUsage::Upload);
+}
+
+RingAllocator::~RingAllocator() {
+    allocator.destroyBuffer(buffer);
+}
+
+void RingAllocator::beginFrame(uint32_t slot) {
+    frameEnds[currentSlot] = headPos;
+    tailPos = std::max(tailPos, frameEnds[slot]);
+    currentSlot = slot;
+}
+
+void* RingAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+    uint64_t start = alignUp(headPos, alignment);
+    // Allocations never straddle the end of the buffer
+    if (start % capacity + size > capacity) {
+        start = (start / capacity + 1) * capacity;
+    }
+    if (start + size - tailPos > capacity) {
+        return nullptr;
+    }
+    headPos = start + size;
+    offset = start % capacity;
+    return static_cast<char*>(buffer.allocation.mapped) + offset;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "device.hpp"
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// What the memory is used for; drives memory type selection
+enum class MemoryUsage {
+    GpuOnly,  // DEVICE_LOCAL, never mapped
+    Upload,   // HOST_VISIBLE|COHERENT, prefers DEVICE_LOCAL (BAR/ReBAR) for per-frame data
+    Staging,  // HOST_VISIBLE|COHERENT, avoids DEVICE_LOCAL so BAR stays free for Upload
+    Readback  // HOST_VISIBLE, prefers HOST_CACHED
+};
+
+struct MemoryBlock; // Owned by MemoryAllocator
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr; // Persistently mapped pointer for host-visible memory
+    uint32_t memoryType = UINT32_MAX;
+    MemoryBlock* block = nullptr;
+};
+
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    Allocation allocation;
+};
+
+struct MemoryStats {
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    VkDeviceSize reserved; // Bytes obtained from vkAllocateMemory
+    VkDeviceSize used;     // Bytes handed out to resources
+    float fragmentation;   // 1 - largest free range / total free bytes
+};
+
+// Sub-allocates resources out of large per-memory-type blocks instead of one
+// vkAllocateMemory per resource. Host-visible blocks are mapped once for their lifetime.
+struct MemoryAllocator {
+    const Device& device;
+    VkPhysicalDeviceMemoryProperties memProperties;
+    VkDeviceSize blockSize;
+    VkDeviceSize bufferImageGranularity;
+    std::vector<std::vector<std::unique_ptr<MemoryBlock>>> blocks; // Indexed by memory type
+    uint32_t deviceAllocationCount;
+    mutable std::mutex mutex;
+
+    MemoryAllocator(const Device& device, VkDeviceSize blockSize = 64ull << 20);
+    ~MemoryAllocator();
+
+    // Returns UINT32_MAX if no type satisfies typeBits and required
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required,
+                            VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags avoided = 0) const;
+
+    Allocation allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear = true);
+    void free(Allocation& allocation);
+
+    Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage);
+    void destroyBuffer(Buffer& buffer);
+
+    MemoryStats getStats() const;
+
+private:
+    bool allocateFromType(uint32_t memoryType, VkDeviceSize size, VkDeviceSize alignment, Allocation& out);
+};
+
+// Bump allocator over one persistently mapped buffer. Reset once the GPU is done
+// with everything handed out since the last reset (e.g. one per frame in flight).
+struct LinearAllocator {
+    MemoryAllocator& allocator;
+    Buffer buffer;
+    VkDeviceSize capacity;
+    VkDeviceSize head;
+
+    LinearAllocator(MemoryAllocator& allocator, VkDeviceSize capacity, VkBufferUsageFlags usage);
+    ~LinearAllocator();
+
+    // Returns nullptr when out of space
+    void* allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    void reset();
+};
+
+// Ring allocator shared by all frames in flight. beginFrame(slot) must only be called
+// after that slot's fence has signalled; it releases everything the slot allocated.
+struct RingAllocator {
+    MemoryAllocator& allocator;
+    Buffer buffer;
+    VkDeviceSize capacity;
+    uint64_t headPos; // Unwrapped positions; offset = pos % capacity
+    uint64_t tailPos;
+    std::vector<uint64_t> frameEnds;
+    uint32_t currentSlot;
+
+    RingAllocator(MemoryAllocator& allocator, VkDeviceSize capacity, VkBufferUsageFlags usage, uint32_t framesInFlight);
+    ~RingAllocator();
+
+    void beginFrame(uint32_t slot);
+    // Returns nullptr when the ring is full. Alignment must be a power of two <= 256.
+    void* allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+};
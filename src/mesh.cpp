@@ -0,0 +1,233 @@
+#include "mesh.hpp"
+#include "mesh_vert_spv.h"
+#include "mesh_frag_spv.h"
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+MeshRenderer::MeshRenderer(const Device& device, MemoryAllocator& allocator, VkRenderPass renderPass, VkFormat colorFormat,
+                           VkFormat depthFormat, const std::string& shaderOverrideDir)
+    : device(device), allocator(allocator), indexCount(0), constants() {
+    VkShaderModule vertShaderModule = createShaderModule(device.device, "mesh.vert.spv", mesh_vert_spv,
+                                                         sizeof(mesh_vert_spv), shaderOverrideDir);
+    VkShaderModule fragShaderModule = createShaderModule(device.device, "mesh.frag.spv", mesh_frag_spv,
+                                                         sizeof(mesh_frag_spv), shaderOverrideDir);
+
+    VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
+    VkVertexInputBindingDescription binding = {};
+    binding.binding = 0;
+    binding.stride = sizeof(MeshVertex);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription attributes[3] = {};
+    attributes[0].location = 0;
+    attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributes[0].offset = offsetof(MeshVertex, position);
+    attributes[1].location = 1;
+    attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributes[1].offset = offsetof(MeshVertex, normal);
+    attributes[2].location = 2;
+    attributes[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributes[2].offset = offsetof(MeshVertex, color);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &binding;
+    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputInfo.pVertexAttributeDescriptions = attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    // Viewport and scissor are set at record time, as for the raymarch pipeline
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    // Triangles are counter-clockwise seen from outside; the mirrored projection turns
+    // them clockwise on screen
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.size = sizeof(MeshConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create mesh pipeline layout");
+    }
+
+    VkPipelineRenderingCreateInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = device.dynamicRendering ? &renderingInfo : nullptr;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = device.dynamicRendering ? VK_NULL_HANDLE : renderPass;
+    pipelineInfo.subpass = 0;
+
+    if (vkCreateGraphicsPipelines(device.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create mesh pipeline");
+    }
+
+    vkDestroyShaderModule(device.device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device.device, vertShaderModule, nullptr);
+}
+
+MeshRenderer::~MeshRenderer() {
+    vkDestroyPipeline(device.device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device.device, pipelineLayout, nullptr);
+    allocator.destroyBuffer(vertexBuffer);
+    allocator.destroyBuffer(indexBuffer);
+}
+
+void MeshRenderer::addBox(const glm::vec3& center, const glm::vec3& size, const glm::vec3& color) {
+    glm::vec3 half = size * 0.5f;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (float side : {-1.0f, 1.0f}) {
+            glm::vec3 normal(0.0f);
+            normal[axis] = side;
+            glm::vec3 u(0.0f);
+            glm::vec3 v(0.0f);
+            u[(axis + 1) % 3] = half[(axis + 1) % 3];
+            v[(axis + 2) % 3] = half[(axis + 2) % 3];
+
+            // Counter-clockwise around u x v, which is the +axis normal; reversed on the - side
+            glm::vec3 corners[4] = {-u - v, u - v, u + v, -u + v};
+            if (side < 0.0f) {
+                std::swap(corners[1], corners[3]);
+            }
+            uint32_t base = static_cast<uint32_t>(vertices.size());
+            for (const glm::vec3& corner : corners) {
+                vertices.push_back({center + normal * half[axis] + corner, normal, color});
+            }
+            for (uint32_t index : {0u, 1u, 2u, 0u, 2u, 3u}) {
+                indices.push_back(base + index);
+            }
+        }
+    }
+}
+
+void MeshRenderer::upload() {
+    allocator.destroyBuffer(vertexBuffer);
+    allocator.destroyBuffer(indexBuffer);
+    indexCount = static_cast<uint32_t>(indices.size());
+    if (indexCount == 0) {
+        return;
+    }
+
+    // Small and written once, so it stays in host-visible (ideally BAR) memory rather than
+    // going through a staging copy
+    vertexBuffer = allocator.createBuffer(vertices.size() * sizeof(MeshVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryUsage::Upload);
+    memcpy(vertexBuffer.allocation.mapped, vertices.data(), vertices.size() * sizeof(MeshVertex));
+    indexBuffer = allocator.createBuffer(indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryUsage::Upload);
+    memcpy(indexBuffer.allocation.mapped, indices.data(), indices.size() * sizeof(uint32_t));
+    vertices.clear();
+    indices.clear();
+}
+
+void MeshRenderer::setCamera(const Camera& camera) {
+    // traceScene's ray through screen position s is proj's ray through s * (-0.5, 0.5)
+    glm::mat4 framing(1.0f);
+    framing[0][0] = -2.0f;
+    framing[1][1] = 2.0f;
+    constants.viewProj = framing * camera.proj * camera.view;
+    constants.camPos = glm::vec4(camera.position, 0.0f);
+}
+
+void MeshRenderer::draw(VkCommandBuffer commandBuffer, VkExtent2D area) const {
+    if (indexCount == 0) {
+        return;
+    }
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    VkViewport viewport = {};
+    viewport.width = static_cast<float>(area.width);
+    viewport.height = static_cast<float>(area.height);
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = {};
+    scissor.extent = area;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                       sizeof(MeshConstants), &constants);
+    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+}
+
+void addRasterProps(MeshRenderer& meshes, uint32_t count) {
+    // The cube's apoapsis is at 5, so the ring stays clear of it while the belt's bodies
+    // pass between the pillars
+    const float ringRadius = 7.0f;
+    for (uint32_t i = 0; i < count; ++i) {
+        float angle = 2.0f * 3.14159265f * (i + 0.5f) / count;
+        float height = 3.0f + 2.0f * ((i * 7) % 5) / 4.0f;
+        glm::vec3 color = (i % 2 == 0) ? glm::vec3(0.75f, 0.68f, 0.55f) : glm::vec3(0.35f, 0.45f, 0.7f);
+        meshes.addBox(glm::vec3(ringRadius * std::cos(angle), ringRadius * std::sin(angle), 0.0f),
+                      glm::vec3(0.6f, 0.6f, height), color);
+    }
+}
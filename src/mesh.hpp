@@ -0,0 +1,55 @@
+#pragma once
+#include "device.hpp"
+#include "memory.hpp"
+#include "pipeline.hpp"
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+struct MeshVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 color;
+};
+
+// Push constants for the mesh draws, must match mesh.vert and mesh.frag
+struct MeshConstants {
+    glm::mat4 viewProj;
+    glm::vec4 camPos; // w unused
+};
+
+// Indexed triangle geometry rasterized into the scene target alongside the raymarch. Both
+// share the scene depth buffer: the march writes its hit depth, so the two occlude each other
+// per pixel, and in RASTER_PREPASS the meshes go first and cut the march short behind them.
+struct MeshRenderer {
+    const Device& device;
+    MemoryAllocator& allocator;
+    VkPipeline pipeline;
+    VkPipelineLayout pipelineLayout;
+    std::vector<MeshVertex> vertices; // Geometry added since the last upload
+    std::vector<uint32_t> indices;
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    uint32_t indexCount; // Uploaded indices
+    MeshConstants constants;
+
+    // renderPass is ignored (may be VK_NULL_HANDLE) when the device uses dynamic rendering
+    MeshRenderer(const Device& device, MemoryAllocator& allocator, VkRenderPass renderPass, VkFormat colorFormat,
+                 VkFormat depthFormat, const std::string& shaderOverrideDir = "");
+    ~MeshRenderer();
+
+    // Axis-aligned box with flat-shaded faces
+    void addBox(const glm::vec3& center, const glm::vec3& size, const glm::vec3& color);
+    // Replaces the uploaded geometry with what was added; the device must be idle
+    void upload();
+    // The raymarch casts its rays through proj with X mirrored and the half-size framing of
+    // traceScene, so the meshes are projected the same way to line up with it
+    void setCamera(const Camera& camera);
+    // Records into an open pass on a target with the scene depth attachment
+    void draw(VkCommandBuffer commandBuffer, VkExtent2D area) const;
+};
+
+// Pillars standing through the orbital plane on a ring outside the cube's orbit, for the
+// hybrid raster demo
+void addRasterProps(MeshRenderer& meshes, uint32_t count);
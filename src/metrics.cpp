@@ -0,0 +1,267 @@
+#include "metrics.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// From 240 Hz frames to hitches; GPU passes share them
+const double MetricsHistogram::BOUNDS[BUCKET_COUNT] = {
+    0.001, 0.002, 0.004, 0.006, 0.008, 0.010, 0.012, 0.014,
+    0.0167, 0.020, 0.025, 0.0333, 0.050, 0.100, 0.250, 1.0
+};
+
+namespace {
+
+void writeNumber(std::ostream& out, double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", value);
+    out << text;
+}
+
+void writeHeader(std::ostream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+void writeCounter(std::ostream& out, const char* name, const char* help, const std::atomic<uint64_t>& value) {
+    writeHeader(out, name, "counter", help);
+    out << name << " " << value.load(std::memory_order_relaxed) << "\n";
+}
+
+void writeCounter(std::ostream& out, const char* name, const char* help, const std::atomic<double>& value) {
+    writeHeader(out, name, "counter", help);
+    out << name << " ";
+    writeNumber(out, value.load(std::memory_order_relaxed));
+    out << "\n";
+}
+
+template <typename T>
+void writeGauge(std::ostream& out, const char* name, const char* help, const std::atomic<T>& value) {
+    writeHeader(out, name, "gauge", help);
+    out << name << " ";
+    writeNumber(out, static_cast<double>(value.load(std::memory_order_relaxed)));
+    out << "\n";
+}
+
+// Blocks until everything is written or the peer stops reading for a second
+bool sendAll(int socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t result = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            pollfd fd = {socket, POLLOUT, 0};
+            if (poll(&fd, 1, 1000) <= 0) {
+                return false;
+            }
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+} // namespace
+
+MetricsHistogram::MetricsHistogram() : sum(0.0) {
+    for (std::atomic<uint64_t>& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricsHistogram::observe(double seconds) {
+    // Prometheus buckets are inclusive upper bounds
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT && seconds > BOUNDS[bucket]) {
+        ++bucket;
+    }
+    buckets[bucket].store(buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    sum.store(sum.load(std::memory_order_relaxed) + seconds, std::memory_order_relaxed);
+}
+
+void MetricsHistogram::write(std::ostream& out, const char* name, const char* labels) const {
+    // The count is the +Inf bucket, so the two always agree even if a frame lands mid-scrape
+    const char* separator = labels[0] != '\0' ? "," : "";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= BUCKET_COUNT; ++i) {
+        cumulative += buckets[i].load(std::memory_order_relaxed);
+        out << name << "_bucket{" << labels << separator << "le=\"";
+        if (i < BUCKET_COUNT) {
+            writeNumber(out, BOUNDS[i]);
+        } else {
+            out << "+Inf";
+        }
+        out << "\"} " << cumulative << "\n";
+    }
+    const char* open = labels[0] != '\0' ? "{" : "";
+    const char* close = labels[0] != '\0' ? "}" : "";
+    out << name << "_sum" << open << labels << close << " ";
+    writeNumber(out, sum.load(std::memory_order_relaxed));
+    out << "\n" << name << "_count" << open << labels << close << " " << cumulative << "\n";
+}
+
+Metrics::Metrics()
+    : frames(0), lateFrames(0), droppedFrames(0), captureDroppedFrames(0), swapchainRecreations(0), gpuWaitSeconds(0.0),
+      memoryReserved(0), memoryUsed(0), memoryBlocks(0), memoryAllocations(0),
+      renderUtilization(0.0), simulationRate(0.0), cpuUsage(0.0) {
+}
+
+void Metrics::write(std::ostream& out) const {
+    writeHeader(out, "gridfire_frame_seconds", "histogram", "Render loop time from one frame start to the next");
+    frameTime.write(out, "gridfire_frame_seconds", "");
+    writeHeader(out, "gridfire_gpu_pass_seconds", "histogram", "GPU time per frame pass from timestamp queries");
+    gpuPassTime[GPU_PASS_SCENE].write(out, "gridfire_gpu_pass_seconds", "pass=\"scene\"");
+    gpuPassTime[GPU_PASS_POST].write(out, "gridfire_gpu_pass_seconds", "pass=\"post\"");
+
+    writeCounter(out, "gridfire_frames_total", "Frames rendered", frames);
+    writeCounter(out, "gridfire_frames_late_total", "Frames that started after the frame cap's deadline", lateFrames);
+    writeCounter(out, "gridfire_frames_dropped_total", "Frame cap intervals skipped because a frame overran a whole interval",
+                 droppedFrames);
+    writeCounter(out, "gridfire_capture_frames_dropped_total", "Recorded frames dropped by frame capture",
+                 captureDroppedFrames);
+    writeCounter(out, "gridfire_swapchain_recreations_total", "Swapchain recreations (resize, out of date, present mode)",
+                 swapchainRecreations);
+    writeCounter(out, "gridfire_gpu_wait_seconds_total", "Render thread time blocked waiting for the GPU to finish a frame slot",
+                 gpuWaitSeconds);
+
+    writeGauge(out, "gridfire_device_memory_reserved_bytes", "Device memory allocated from the driver", memoryReserved);
+    writeGauge(out, "gridfire_device_memory_used_bytes", "Device memory handed out to resources", memoryUsed);
+    writeGauge(out, "gridfire_device_memory_blocks", "Device memory blocks", memoryBlocks);
+    writeGauge(out, "gridfire_device_memory_allocations", "Live sub-allocations", memoryAllocations);
+    writeGauge(out, "gridfire_render_thread_utilization", "Render thread time not blocked on the GPU, 0 to 1",
+               renderUtilization);
+    writeGauge(out, "gridfire_simulation_tick_rate_hertz", "Simulation ticks per second", simulationRate);
+    writeGauge(out, "gridfire_process_cpu_usage_ratio", "Process CPU time per wall time; 1 is one full core", cpuUsage);
+}
+
+MetricsServer::MetricsServer(const Metrics& metrics, const std::string& address)
+    : metrics(metrics), listenSocket(-1), stopping(false) {
+    int error = 0; // errno of the last failed call; close() and freeaddrinfo() may overwrite errno
+    if (address.compare(0, 5, "unix:") == 0) {
+        socketPath = address.substr(5);
+        sockaddr_un local = {};
+        local.sun_family = AF_UNIX;
+        if (socketPath.empty() || socketPath.size() >= sizeof(local.sun_path)) {
+            throw std::runtime_error("Invalid metrics socket path: " + socketPath);
+        }
+        memcpy(local.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        unlink(socketPath.c_str()); // Left behind by a previous run that did not exit cleanly
+        listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenSocket < 0) {
+            error = errno;
+        } else if (bind(listenSocket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+                   listen(listenSocket, 8) != 0) {
+            error = errno;
+            close(listenSocket);
+            listenSocket = -1;
+        }
+    } else {
+        size_t colon = address.rfind(':');
+        if (colon == std::string::npos || colon + 1 == address.size()) {
+            throw std::runtime_error("Expected host:port or unix:PATH for metrics, got " + address);
+        }
+        std::string host = address.substr(0, colon);
+        std::string port = address.substr(colon + 1);
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+            throw std::runtime_error("Failed to resolve metrics address " + address);
+        }
+        for (addrinfo* candidate = addresses; candidate && listenSocket < 0; candidate = candidate->ai_next) {
+            listenSocket = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+            if (listenSocket < 0) {
+                error = errno;
+                continue;
+            }
+            int reuse = 1;
+            setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (bind(listenSocket, candidate->ai_addr, candidate->ai_addrlen) != 0 || listen(listenSocket, 8) != 0) {
+                error = errno;
+                close(listenSocket);
+                listenSocket = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+    }
+    if (listenSocket < 0) {
+        throw std::runtime_error("Failed to listen for metrics on " + address + ": " + strerror(error));
+    }
+    thread = std::thread(&MetricsServer::serveLoop, this);
+}
+
+MetricsServer::~MetricsServer() {
+    stopping = true;
+    thread.join();
+    close(listenSocket);
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+}
+
+void MetricsServer::serveLoop() {
+    while (!stopping) {
+        // Wakes up regularly to notice shutdown
+        pollfd fd = {listenSocket, POLLIN, 0};
+        if (poll(&fd, 1, 200) <= 0) {
+            continue;
+        }
+        int client = accept(listenSocket, nullptr, nullptr);
+        if (client >= 0) {
+            // Non-blocking, so a scraper that stops reading times out in sendAll instead of
+            // holding this thread (and the destructor's join) forever
+            fcntl(client, F_SETFL, fcntl(client, F_GETFL, 0) | O_NONBLOCK);
+            serveClient(client);
+            close(client);
+        }
+    }
+}
+
+void MetricsServer::serveClient(int client) {
+    // Only the request line matters; give slow clients a second to send the headers
+    std::string request;
+    char chunk[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        pollfd fd = {client, POLLIN, 0};
+        if (poll(&fd, 1, 1000) <= 0) {
+            return;
+        }
+        ssize_t received = recv(client, chunk, sizeof(chunk), 0);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        }
+        if (received <= 0) {
+            break;
+        }
+        request.append(chunk, static_cast<size_t>(received));
+    }
+
+    std::string status = "200 OK";
+    std::ostringstream body;
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+        metrics.write(body);
+    } else if (request.compare(0, 4, "GET ") == 0) {
+        status = "404 Not Found";
+        body << "Metrics are served at /metrics\n";
+    } else {
+        status = "405 Method Not Allowed";
+    }
+    std::string content = body.str();
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << "\r\n"
+             << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+             << "Content-Length: " << content.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << content;
+    sendAll(client, response.str());
+}
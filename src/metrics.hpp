@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Latency histogram with fixed buckets. One thread observes while the metrics server reads,
+// so every field is an atomic; the single writer updates them with relaxed load/store pairs
+// rather than read-modify-writes, which costs about as much as plain stores.
+struct MetricsHistogram {
+    static constexpr size_t BUCKET_COUNT = 16;
+    static const double BOUNDS[BUCKET_COUNT]; // Upper bounds in seconds, ascending; +Inf follows
+
+    std::atomic<uint64_t> buckets[BUCKET_COUNT + 1]; // Not cumulative; the last one is above every bound
+    std::atomic<double> sum;
+
+    MetricsHistogram();
+
+    void observe(double seconds);
+    // Prometheus _bucket, _sum and _count lines; labels is empty or e.g. pass="scene"
+    void write(std::ostream& out, const char* name, const char* labels) const;
+};
+
+// Swapchain GPU timestamps split the frame into these passes
+enum GpuPass : uint32_t {
+    GPU_PASS_SCENE = 0, // Scene upload or march, AA resolve
+    GPU_PASS_POST = 1,  // Upscale blit, ImGui, capture copy
+    GPU_PASS_COUNT
+};
+
+// Everything the metrics endpoint exports. The render thread is the only writer and never
+// waits on a reader; a scrape taken mid-frame may mix two frames' values, which Prometheus
+// tolerates. Gauges that are costly to gather are refreshed a few times a second.
+struct Metrics {
+    MetricsHistogram frameTime;
+    MetricsHistogram gpuPassTime[GPU_PASS_COUNT];
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> lateFrames;    // Frame cap: started past the deadline
+    std::atomic<uint64_t> droppedFrames; // Frame cap: overran a whole interval
+    std::atomic<uint64_t> captureDroppedFrames;
+    std::atomic<uint64_t> swapchainRecreations;
+    std::atomic<double> gpuWaitSeconds; // Render thread time blocked on the GPU timeline
+    std::atomic<uint64_t> memoryReserved; // Device memory bytes from vkAllocateMemory
+    std::atomic<uint64_t> memoryUsed;     // Bytes handed out to resources
+    std::atomic<uint64_t> memoryBlocks;
+    std::atomic<uint64_t> memoryAllocations;
+    std::atomic<double> renderUtilization; // Render thread time not blocked on the GPU, 0 to 1
+    std::atomic<double> simulationRate;    // Simulation ticks per second
+    std::atomic<double> cpuUsage;          // Process CPU time / wall time
+
+    Metrics();
+
+    // Single-writer increment
+    static void add(std::atomic<uint64_t>& counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    static void set(std::atomic<uint64_t>& gauge, uint64_t value) { gauge.store(value, std::memory_order_relaxed); }
+    static void set(std::atomic<double>& gauge, double value) { gauge.store(value, std::memory_order_relaxed); }
+
+    // Prometheus text exposition format 0.0.4
+    void write(std::ostream& out) const;
+};
+
+// Serves Metrics at /metrics over HTTP from a background thread. address is host:port for
+// TCP (e.g. 127.0.0.1:9464) or unix:PATH for a Unix socket. Requests are answered one at a
+// time from the atomics, so the render thread never blocks on a scrape.
+class MetricsServer {
+public:
+    MetricsServer(const Metrics& metrics, const std::string& address);
+    ~MetricsServer();
+
+private:
+    void serveLoop();
+    void serveClient(int client);
+
+    const Metrics& metrics;
+    int listenSocket;
+    std::string socketPath; // Unix socket file, removed on shutdown
+    std::atomic<bool> stopping;
+    std::thread thread;
+};
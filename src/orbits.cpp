@@ -0,0 +1,231 @@
+#include "orbits.hpp"
+#include "orbits_kernel.hpp"
+#include "jobs.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#if defined(GRIDFIRE_AVX2_KERNEL)
+// orbits_avx2.cpp, built with AVX2/FMA enabled; only called after the CPU check
+void solveKeplerAvx2(const OrbitArrays& arrays, size_t begin, size_t end, float dt, float* out);
+#endif
+
+const char* keplerKernelName(KeplerKernel kernel) {
+    switch (kernel) {
+        case KeplerKernel::Scalar: return "scalar";
+        case KeplerKernel::Sse: return "sse2";
+        case KeplerKernel::Avx2: return "avx2";
+        default: return "unknown";
+    }
+}
+
+static bool kernelSupported(KeplerKernel kernel) {
+    switch (kernel) {
+        case KeplerKernel::Scalar:
+            return true;
+        case KeplerKernel::Sse:
+#if defined(__SSE2__)
+            return true;
+#else
+            return false;
+#endif
+        case KeplerKernel::Avx2:
+#if defined(GRIDFIRE_AVX2_KERNEL)
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+KeplerKernel bestKeplerKernel() {
+    if (kernelSupported(KeplerKernel::Avx2)) {
+        return KeplerKernel::Avx2;
+    }
+    return kernelSupported(KeplerKernel::Sse) ? KeplerKernel::Sse : KeplerKernel::Scalar;
+}
+
+OrbitSystem::OrbitSystem(JobSystem* jobs)
+    : count(0), baseTime(0.0), boundingRadius(0.0f), kernel(bestKeplerKernel()), jobs(jobs) {
+}
+
+uint32_t OrbitSystem::getThreadCount() const {
+    return jobs ? jobs->getThreadCount() : 1;
+}
+
+void OrbitSystem::add(const OrbitalElements& elements) {
+    if (count == paddedSize()) {
+        // Padding bodies stay all zero: at the origin with radius 0
+        size_t padded = count + LANES;
+        for (std::vector<float>* array : {&arrays.eccentricity, &arrays.meanMotion, &arrays.meanAnomaly,
+                                          &arrays.px, &arrays.py, &arrays.pz, &arrays.qx, &arrays.qy, &arrays.qz,
+                                          &arrays.radius}) {
+            array->resize(padded, 0.0f);
+        }
+        epochMeanAnomaly.resize(padded, 0.0);
+        epochMeanMotion.resize(padded, 0.0);
+    }
+
+    // Classical elements are Z-up; the scene is Y-up, so the reference plane is XZ
+    double a = elements.semiMajorAxis;
+    double e = elements.eccentricity;
+    double b = a * std::sqrt(1.0 - e * e);
+    double cosO = std::cos(elements.longAscNode), sinO = std::sin(elements.longAscNode);
+    double cosW = std::cos(elements.argPeriapsis), sinW = std::sin(elements.argPeriapsis);
+    double cosI = std::cos(elements.inclination), sinI = std::sin(elements.inclination);
+    double p[3] = {cosO * cosW - sinO * sinW * cosI, sinO * cosW + cosO * sinW * cosI, sinW * sinI};
+    double q[3] = {-cosO * sinW - sinO * cosW * cosI, -sinO * sinW + cosO * cosW * cosI, cosW * sinI};
+
+    size_t i = count++;
+    arrays.eccentricity[i] = elements.eccentricity;
+    epochMeanMotion[i] = 2.0 * M_PI / elements.period;
+    arrays.meanMotion[i] = static_cast<float>(epochMeanMotion[i]);
+    arrays.px[i] = static_cast<float>(a * p[0]);
+    arrays.py[i] = static_cast<float>(a * p[2]);
+    arrays.pz[i] = static_cast<float>(a * p[1]);
+    arrays.qx[i] = static_cast<float>(b * q[0]);
+    arrays.qy[i] = static_cast<float>(b * q[2]);
+    arrays.qz[i] = static_cast<float>(b * q[1]);
+    arrays.radius[i] = elements.radius;
+    epochMeanAnomaly[i] = elements.meanAnomalyAtEpoch;
+    arrays.meanAnomaly[i] = static_cast<float>(std::remainder(epochMeanAnomaly[i] + epochMeanMotion[i] * baseTime, 2.0 * M_PI));
+    boundingRadius = std::max(boundingRadius, static_cast<float>(a * (1.0 + e)) + elements.radius);
+}
+
+void OrbitSystem::rebase(double time) {
+    for (size_t i = 0; i < count; ++i) {
+        arrays.meanAnomaly[i] = static_cast<float>(std::remainder(epochMeanAnomaly[i] + epochMeanMotion[i] * time, 2.0 * M_PI));
+    }
+    baseTime = time;
+}
+
+void OrbitSystem::solveRange(size_t begin, size_t end, float dt, float* out) const {
+    switch (kernel) {
+#if defined(GRIDFIRE_AVX2_KERNEL)
+        case KeplerKernel::Avx2:
+            solveKeplerAvx2(arrays, begin, end, dt, out);
+            return;
+#endif
+#if defined(__SSE2__)
+        case KeplerKernel::Sse:
+            solveKepler<SseOps>(arrays, begin, end, dt, out);
+            return;
+#endif
+        default:
+            solveKepler<ScalarOps>(arrays, begin, end, dt, out);
+            return;
+    }
+}
+
+void OrbitSystem::update(double time, float* out) {
+    // A float phase n * dt loses about 1e-7 of dt per radian, so keep dt short
+    if (std::abs(time - baseTime) > 30.0) {
+        rebase(time);
+    }
+    float dt = static_cast<float>(time - baseTime);
+
+    if (count < PARALLEL_THRESHOLD || getThreadCount() == 1) {
+        solveRange(0, paddedSize(), dt, out);
+        return;
+    }
+
+    // A chunk per job; this thread works through them too while it waits
+    uint32_t chunks = static_cast<uint32_t>((paddedSize() + CHUNK - 1) / CHUNK);
+    jobs->parallelFor(chunks, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            solveRange(chunk * CHUNK, std::min((chunk + 1) * CHUNK, paddedSize()), dt, out);
+        }
+    });
+}
+
+void addAsteroidBelt(OrbitSystem& system, uint32_t count, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (uint32_t i = 0; i < count; ++i) {
+        OrbitalElements elements;
+        elements.semiMajorAxis = 6.0f + 18.0f * unit(rng);
+        elements.eccentricity = 0.25f * unit(rng) * unit(rng);
+        elements.inclination = 0.3f * (unit(rng) - 0.5f);
+        elements.longAscNode = 2.0f * static_cast<float>(M_PI) * unit(rng);
+        elements.argPeriapsis = 2.0f * static_cast<float>(M_PI) * unit(rng);
+        elements.period = static_cast<float>(2.0 * M_PI * std::sqrt(std::pow(elements.semiMajorAxis, 3.0) / SCENE_GM));
+        elements.meanAnomalyAtEpoch = 2.0f * static_cast<float>(M_PI) * unit(rng);
+        elements.radius = 0.03f + 0.09f * unit(rng) * unit(rng);
+        system.add(elements);
+    }
+}
+
+void runOrbitBenchmark(std::ostream& out) {
+    using Clock = std::chrono::steady_clock;
+    const uint32_t counts[] = {1000, 10000, 100000};
+    const KeplerKernel kernels[] = {KeplerKernel::Scalar, KeplerKernel::Sse, KeplerKernel::Avx2};
+    uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "Kepler solver throughput (%u hardware threads, best kernel %s)",
+                  hardwareThreads, keplerKernelName(bestKeplerKernel()));
+    out << line << std::endl;
+    std::snprintf(line, sizeof(line), "  %8s %-7s %7s %12s %10s %12s", "bodies", "kernel", "threads", "us/update", "ns/body", "Mbodies/s");
+    out << line << std::endl;
+
+    for (uint32_t count : counts) {
+        std::vector<uint32_t> threadCounts = {1};
+        if (hardwareThreads > 1 && count >= OrbitSystem::PARALLEL_THRESHOLD) {
+            threadCounts.push_back(hardwareThreads); // Below the threshold it would run single-threaded anyway
+        }
+        for (uint32_t threads : threadCounts) {
+            JobSystem jobs(threads);
+            OrbitSystem system(&jobs);
+            addAsteroidBelt(system, count, 1);
+            std::vector<float> positions(system.paddedSize() * 4);
+
+            for (KeplerKernel kernel : kernels) {
+                if (!kernelSupported(kernel)) {
+                    continue;
+                }
+                system.kernel = kernel;
+                double time = 0.0;
+                system.update(time, positions.data()); // Warm up caches and workers
+
+                // Repeat until at least a quarter second has passed
+                uint64_t updates = 0;
+                Clock::time_point start = Clock::now();
+                double elapsed = 0.0;
+                while (elapsed < 0.25) {
+                    for (int i = 0; i < 8; ++i) {
+                        time += 1.0 / 60.0;
+                        system.update(time, positions.data());
+                    }
+                    updates += 8;
+                    elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+                }
+                double perUpdate = elapsed / updates;
+                std::snprintf(line, sizeof(line), "  %8u %-7s %7u %12.1f %10.2f %12.1f", count, keplerKernelName(kernel),
+                              system.getThreadCount(), perUpdate * 1e6, perUpdate * 1e9 / count, count / perUpdate * 1e-6);
+                out << line << std::endl;
+            }
+        }
+    }
+}
+
+OrbitBuffers::OrbitBuffers(MemoryAllocator& allocator, ResourceTable& resources, const OrbitSystem& system, uint32_t framesInFlight)
+    : allocator(allocator), resources(resources) {
+    // Written once per frame by the CPU and read once by the GPU, so Upload (BAR when available)
+    VkDeviceSize size = std::max<VkDeviceSize>(system.paddedSize(), 1) * 4 * sizeof(float);
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        buffers.push_back(allocator.createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::Upload));
+        handles.push_back(resources.registerStorageBuffer(buffers.back().buffer));
+    }
+}
+
+OrbitBuffers::~OrbitBuffers() {
+    // Only destroyed once the device is idle
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        resources.release(handles[i], 0);
+        allocator.destroyBuffer(buffers[i]);
+    }
+}
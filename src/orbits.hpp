@@ -0,0 +1,97 @@
+#pragma once
+#include "device.hpp"
+#include "memory.hpp"
+#include "resources.hpp"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct JobSystem;
+
+// Gravitational parameter of the central body in scene units; matches the cube's orbit in
+// raymarch.frag (a = 2.75, period 6 s)
+constexpr double SCENE_GM = 4.0 * 3.14159265358979323846 * 3.14159265358979323846 * 2.75 * 2.75 * 2.75 / 36.0;
+
+struct OrbitalElements {
+    float semiMajorAxis;
+    float eccentricity;        // 0 <= e < 1
+    float inclination;         // Radians
+    float longAscNode;         // Radians
+    float argPeriapsis;        // Radians
+    float period;              // Seconds
+    float meanAnomalyAtEpoch;  // Radians at scene time 0
+    float radius;              // Body size, for rendering
+};
+
+enum class KeplerKernel {
+    Scalar,
+    Sse, // 4 lanes, SSE2
+    Avx2 // 8 lanes, AVX2 + FMA, chosen at runtime when the CPU has it
+};
+
+const char* keplerKernelName(KeplerKernel kernel);
+KeplerKernel bestKeplerKernel();
+
+// Structure-of-arrays storage for the orbits of many bodies; the per-body constants are what
+// the solver needs, so the per-frame work is just the Kepler solve and two FMAs per axis
+struct OrbitArrays {
+    std::vector<float> eccentricity;
+    std::vector<float> meanMotion;  // Radians per second
+    std::vector<float> meanAnomaly; // At baseTime, wrapped to [-pi, pi]
+    std::vector<float> px, py, pz;  // a * periapsis direction
+    std::vector<float> qx, qy, qz;  // b * direction of motion at periapsis
+    std::vector<float> radius;
+};
+
+// Solves Kepler's equation for every body each update with fixed-count Newton iterations
+// vectorized across bodies, split into jobs on the frame's JobSystem once there are enough
+// bodies. Output is one vec4 per body (position, radius), ready for a storage buffer.
+struct OrbitSystem {
+    static constexpr size_t LANES = 8;             // Arrays are padded to the widest kernel
+    static constexpr size_t CHUNK = 4096;          // Bodies per job
+    static constexpr size_t PARALLEL_THRESHOLD = 16384;
+
+    OrbitArrays arrays;
+    // Double-precision phase terms for rebasing, so float error never grows with scene time
+    std::vector<double> epochMeanAnomaly; // At scene time 0
+    std::vector<double> epochMeanMotion;
+    size_t count;
+    double baseTime; // meanAnomaly is relative to this, so the float phase n * (t - baseTime) stays small
+    float boundingRadius; // Largest apoapsis distance plus body radius
+    KeplerKernel kernel;
+    JobSystem* jobs; // Runs large updates; without it the calling thread solves every body
+
+    // update() must be called from the thread that created jobs
+    explicit OrbitSystem(JobSystem* jobs = nullptr);
+
+    void add(const OrbitalElements& elements);
+    size_t paddedSize() const { return arrays.eccentricity.size(); }
+    uint32_t getThreadCount() const;
+
+    // Writes paddedSize() vec4s to out (padding bodies land at the origin with radius 0)
+    void update(double time, float* out);
+
+private:
+    void rebase(double time);
+    void solveRange(size_t begin, size_t end, float dt, float* out) const;
+};
+
+// Asteroid belt around the origin outside the sphere and cube, deterministic for a seed
+void addAsteroidBelt(OrbitSystem& system, uint32_t count, uint32_t seed);
+
+// Prints update throughput for 1k, 10k and 100k bodies per kernel, single and multithreaded
+void runOrbitBenchmark(std::ostream& out);
+
+// Per-frame storage buffers the positions are written straight into (host-visible, ideally
+// BAR), registered in the global resource table for the raymarch shader
+struct OrbitBuffers {
+    MemoryAllocator& allocator;
+    ResourceTable& resources;
+    std::vector<Buffer> buffers;
+    std::vector<ResourceHandle> handles;
+
+    OrbitBuffers(MemoryAllocator& allocator, ResourceTable& resources, const OrbitSystem& system, uint32_t framesInFlight);
+    ~OrbitBuffers();
+
+    float* positions(uint32_t frameIndex) { return static_cast<float*>(buffers[frameIndex].allocation.mapped); }
+};
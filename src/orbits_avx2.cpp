@@ -0,0 +1,8 @@
+// Built with -mavx2 -mfma (see CMakeLists.txt); only reached when the CPU reports both
+#include "orbits_kernel.hpp"
+
+#if defined(__AVX2__) && defined(__FMA__)
+void solveKeplerAvx2(const OrbitArrays& arrays, size_t begin, size_t end, float dt, float* out) {
+    solveKepler<Avx2Ops>(arrays, begin, end, dt, out);
+}
+#endif
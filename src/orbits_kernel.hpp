@@ -0,0 +1,162 @@
+#pragma once
+// Kepler solver kernel shared by orbits.cpp (scalar, SSE2) and orbits_avx2.cpp (built with
+// AVX2/FMA). Everything is in an anonymous namespace so each translation unit keeps its own
+// copy compiled for its own instruction set.
+#include "orbits.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr float TWO_PI = 6.28318530717958647692f;
+constexpr float INV_TWO_PI = 0.15915494309189533577f;
+constexpr float TWO_OVER_PI = 0.63661977236758134308f;
+// pi/2 split for exact-ish range reduction (Cody-Waite)
+constexpr float HALF_PI_1 = 1.5703125f;
+constexpr float HALF_PI_2 = 4.837512969970703125e-4f;
+constexpr float HALF_PI_3 = 7.54978995489188216e-8f;
+// Danby's start E0 = M + 0.85 e sign(M) converges quadratically for every e < 1; five
+// steps reach float precision up to e = 0.95
+constexpr int NEWTON_ITERATIONS = 5;
+
+struct ScalarOps {
+    static constexpr size_t WIDTH = 1;
+    using F = float;
+    using I = int32_t;
+
+    static F set(float value) { return value; }
+    static F load(const float* p) { return *p; }
+    static I roundToInt(F x) { return static_cast<I>(std::lrintf(x)); }
+    static F toFloat(I x) { return static_cast<float>(x); }
+    static I addInt(I a, int32_t b) { return a + b; }
+    static F copySign(F magnitude, F sign) { return std::copysign(magnitude, sign); }
+    static F selectOdd(I q, F odd, F even) { return (q & 1) ? odd : even; }
+    static F flipIfBit1(F x, I q) { return (q & 2) ? -x : x; }
+    static void storeBodies(float* out, F x, F y, F z, F r) {
+        out[0] = x;
+        out[1] = y;
+        out[2] = z;
+        out[3] = r;
+    }
+};
+
+#if defined(__SSE2__)
+struct SseOps {
+    static constexpr size_t WIDTH = 4;
+    using F = __m128;
+    using I = __m128i;
+
+    static F set(float value) { return _mm_set1_ps(value); }
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+    static I roundToInt(F x) { return _mm_cvtps_epi32(x); }
+    static F toFloat(I x) { return _mm_cvtepi32_ps(x); }
+    static I addInt(I a, int32_t b) { return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+    static F copySign(F magnitude, F sign) {
+        F signBit = _mm_set1_ps(-0.0f);
+        return _mm_or_ps(_mm_andnot_ps(signBit, magnitude), _mm_and_ps(signBit, sign));
+    }
+    static F selectOdd(I q, F odd, F even) {
+        F mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+        return _mm_or_ps(_mm_and_ps(mask, odd), _mm_andnot_ps(mask, even));
+    }
+    static F flipIfBit1(F x, I q) {
+        return _mm_xor_ps(x, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30)));
+    }
+    static void storeBodies(float* out, F x, F y, F z, F r) {
+        _MM_TRANSPOSE4_PS(x, y, z, r);
+        _mm_storeu_ps(out, x);
+        _mm_storeu_ps(out + 4, y);
+        _mm_storeu_ps(out + 8, z);
+        _mm_storeu_ps(out + 12, r);
+    }
+};
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+struct Avx2Ops {
+    static constexpr size_t WIDTH = 8;
+    using F = __m256;
+    using I = __m256i;
+
+    static F set(float value) { return _mm256_set1_ps(value); }
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+    static I roundToInt(F x) { return _mm256_cvtps_epi32(x); }
+    static F toFloat(I x) { return _mm256_cvtepi32_ps(x); }
+    static I addInt(I a, int32_t b) { return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+    static F copySign(F magnitude, F sign) {
+        F signBit = _mm256_set1_ps(-0.0f);
+        return _mm256_or_ps(_mm256_andnot_ps(signBit, magnitude), _mm256_and_ps(signBit, sign));
+    }
+    static F selectOdd(I q, F odd, F even) {
+        I one = _mm256_set1_epi32(1);
+        F mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one));
+        return _mm256_blendv_ps(even, odd, mask);
+    }
+    static F flipIfBit1(F x, I q) {
+        return _mm256_xor_ps(x, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30)));
+    }
+    static void storeBodies(float* out, F x, F y, F z, F r) {
+        // Two 4x4 transposes: lanes 0-3, then 4-7
+        __m128 lo[4] = {_mm256_castps256_ps128(x), _mm256_castps256_ps128(y), _mm256_castps256_ps128(z), _mm256_castps256_ps128(r)};
+        __m128 hi[4] = {_mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1), _mm256_extractf128_ps(z, 1), _mm256_extractf128_ps(r, 1)};
+        _MM_TRANSPOSE4_PS(lo[0], lo[1], lo[2], lo[3]);
+        _MM_TRANSPOSE4_PS(hi[0], hi[1], hi[2], hi[3]);
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_ps(out + i * 4, lo[i]);
+            _mm_storeu_ps(out + 16 + i * 4, hi[i]);
+        }
+    }
+};
+#endif
+
+// sin and cos for |x| up to a few pi: reduce to [-pi/4, pi/4] by quadrant, then minimax polynomials
+template <class Ops>
+inline void sinCos(typename Ops::F x, typename Ops::F& sinOut, typename Ops::F& cosOut) {
+    using F = typename Ops::F;
+    typename Ops::I quadrant = Ops::roundToInt(x * Ops::set(TWO_OVER_PI));
+    F q = Ops::toFloat(quadrant);
+    F r = x - q * Ops::set(HALF_PI_1);
+    r = r - q * Ops::set(HALF_PI_2);
+    r = r - q * Ops::set(HALF_PI_3);
+    F z = r * r;
+    F s = r + r * z * (Ops::set(-1.6666654611e-1f) + z * (Ops::set(8.3321608736e-3f) + z * Ops::set(-1.9515295891e-4f)));
+    F c = Ops::set(1.0f) - Ops::set(0.5f) * z +
+          z * z * (Ops::set(4.166664568298827e-2f) + z * (Ops::set(-1.388731625493765e-3f) + z * Ops::set(2.443315711809948e-5f)));
+    // Quadrant q: sin = (s, c, -s, -c)[q & 3], cos = (c, -s, -c, s)[q & 3]
+    sinOut = Ops::flipIfBit1(Ops::selectOdd(quadrant, c, s), quadrant);
+    cosOut = Ops::flipIfBit1(Ops::selectOdd(quadrant, s, c), Ops::addInt(quadrant, 1));
+}
+
+// Bodies [begin, end), both multiples of Ops::WIDTH, at dt seconds after the arrays' base time
+template <class Ops>
+void solveKepler(const OrbitArrays& arrays, size_t begin, size_t end, float dt, float* out) {
+    using F = typename Ops::F;
+    const F one = Ops::set(1.0f);
+    const F dtv = Ops::set(dt);
+    for (size_t i = begin; i < end; i += Ops::WIDTH) {
+        F e = Ops::load(arrays.eccentricity.data() + i);
+        F m = Ops::load(arrays.meanAnomaly.data() + i) + Ops::load(arrays.meanMotion.data() + i) * dtv;
+        m = m - Ops::set(TWO_PI) * Ops::toFloat(Ops::roundToInt(m * Ops::set(INV_TWO_PI)));
+
+        F ecc = m + Ops::set(0.85f) * Ops::copySign(e, m);
+        F s, c;
+        for (int k = 0; k < NEWTON_ITERATIONS; ++k) {
+            sinCos<Ops>(ecc, s, c);
+            ecc = ecc - (ecc - e * s - m) / (one - e * c);
+        }
+        sinCos<Ops>(ecc, s, c);
+
+        // Perifocal (a (cos E - e), b sin E), with a and b folded into the direction vectors
+        F u = c - e;
+        F x = u * Ops::load(arrays.px.data() + i) + s * Ops::load(arrays.qx.data() + i);
+        F y = u * Ops::load(arrays.py.data() + i) + s * Ops::load(arrays.qy.data() + i);
+        F z = u * Ops::load(arrays.pz.data() + i) + s * Ops::load(arrays.qz.data() + i);
+        Ops::storeBodies(out + i * 4, x, y, z, Ops::load(arrays.radius.data() + i));
+    }
+}
+
+} // namespace
@@ -1,5 +1,9 @@
 #include "pipeline.hpp"
-#include "gridfire_config.h"
+#include "raymarch_vert_spv.h"
+#include "raymarch_frag_spv.h"
+#include "raymarch_fp16_frag_spv.h"
+#include "raymarch_multiview_frag_spv.h"
+#include "raymarch_multiview_fp16_frag_spv.h"
 #include <stdexcept>
 #include <fstream>
 #include <glm/gtc/matrix_transform.hpp>
@@ -7,64 +11,85 @@
 #include <iostream>
 
 struct UniformBufferObject {
-    alignas(16) glm::mat4 view;
+    alignas(16) glm::mat4 view[2];
     alignas(16) glm::mat4 proj;
-    alignas(16) glm::vec3 camPos;
+    alignas(16) glm::vec4 camPos[2];
     float time;
+    int32_t maxSteps;
+    float epsilon;
+    float farDistance;
+    uint32_t marchStrategy;
+    uint32_t flags;
+    uint32_t gridMode;
+    uint32_t bodyBuffer;
+    uint32_t bodyCount;
+    float bodyBounds;
+    uint32_t aaMode;
+    uint32_t aaSamples;
 };
 
-static std::vector<char> readFile(const std::string& filename) {
-    // Try local development path first (build/shaders/)
-    std::string devPath = "shaders/" + filename;
-    std::cout << "Attempting to load shader (dev): " << devPath << std::endl;
-    std::ifstream file(devPath, std::ios::ate | std::ios::binary);
-    if (file.is_open()) {
-        size_t fileSize = static_cast<size_t>(file.tellg());
-        std::vector<char> buffer(fileSize);
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-        file.close();
-        return buffer;
-    }
-
-    // Fall back to installed path
-    std::string fullPath = std::string(GRIDFIRE_SHADER_DIR) + "/" + filename;
-    std::cout << "Attempting to load shader (installed): " << fullPath << std::endl;
-    file.open(fullPath, std::ios::ate | std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open file: " + fullPath + " (also tried " + devPath + ")");
+VkShaderModule createShaderModule(VkDevice device, const char* name, const uint32_t* embedded, size_t embeddedSize,
+                                  const std::string& overrideDir) {
+    std::vector<uint32_t> overrideCode;
+    if (!overrideDir.empty()) {
+        std::string path = overrideDir + "/" + name;
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            size_t fileSize = static_cast<size_t>(file.tellg());
+            if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0) {
+                throw std::runtime_error("Invalid SPIR-V size in " + path);
+            }
+            overrideCode.resize(fileSize / sizeof(uint32_t));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(overrideCode.data()), fileSize);
+            if (overrideCode[0] != 0x07230203) {
+                throw std::runtime_error("Invalid SPIR-V magic in " + path);
+            }
+            std::cout << "Using shader override: " << path << std::endl;
+        } else {
+            std::cerr << "Shader override " << path << " not found, using embedded " << name << std::endl;
+        }
     }
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-    return buffer;
-}
-
-Pipeline::Pipeline(const Device& device, VkRenderPass renderPass, VkExtent2D extent, uint32_t maxFramesInFlight) 
-    : device(device), currentFrame(0) {
-    // Load shaders
-    auto vertShaderCode = readFile("raymarch.vert.spv");
-    auto fragShaderCode = readFile("raymarch.frag.spv");
-
-    VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
 
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = vertShaderCode.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(vertShaderCode.data());
+    createInfo.codeSize = overrideCode.empty() ? embeddedSize : overrideCode.size() * sizeof(uint32_t);
+    createInfo.pCode = overrideCode.empty() ? embedded : overrideCode.data();
 
-    if (vkCreateShaderModule(device.device, &createInfo, nullptr, &vertShaderModule) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create vertex shader module");
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS) {
+        throw std::runtime_error(std::string("Failed to create shader module ") + name);
     }
+    return module;
+}
 
-    createInfo.codeSize = fragShaderCode.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(fragShaderCode.data());
+Camera eyeCamera(const Camera& camera, uint32_t eye, float eyeSeparation) {
+    float offset = (eye == 0 ? 0.5f : -0.5f) * eyeSeparation;
+    Camera eyeView = camera;
+    eyeView.position = camera.position + glm::vec3(glm::inverse(camera.view)[0]) * offset;
+    eyeView.view = glm::translate(glm::mat4(1.0f), glm::vec3(-offset, 0.0f, 0.0f)) * camera.view;
+    return eyeView;
+}
 
-    if (vkCreateShaderModule(device.device, &createInfo, nullptr, &fragShaderModule) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create fragment shader module");
+Pipeline::Pipeline(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+                   VkRenderPass renderPass, VkFormat colorFormat, uint32_t maxFramesInFlight,
+                   const std::string& shaderOverrideDir, VkFormat depthFormat, uint32_t rasterMode, uint32_t viewMask)
+    : device(device), allocator(allocator), viewMask(viewMask), resourceSet(resources.set) {
+    // Shaders are embedded in the executable; no file I/O unless an override directory is set
+    VkShaderModule vertShaderModule = createShaderModule(device.device, "raymarch.vert.spv", raymarch_vert_spv,
+                                                         sizeof(raymarch_vert_spv), shaderOverrideDir);
+    VkShaderModule fragShaderModule = viewMask != 0
+        ? createShaderModule(device.device, "raymarch_multiview.frag.spv", raymarch_multiview_frag_spv,
+                             sizeof(raymarch_multiview_frag_spv), shaderOverrideDir)
+        : createShaderModule(device.device, "raymarch.frag.spv", raymarch_frag_spv,
+                             sizeof(raymarch_frag_spv), shaderOverrideDir);
+    VkShaderModule fp16ShaderModule = VK_NULL_HANDLE;
+    if (device.shaderFloat16) {
+        fp16ShaderModule = viewMask != 0
+            ? createShaderModule(device.device, "raymarch_multiview_fp16.frag.spv", raymarch_multiview_fp16_frag_spv,
+                                 sizeof(raymarch_multiview_fp16_frag_spv), shaderOverrideDir)
+            : createShaderModule(device.device, "raymarch_fp16.frag.spv", raymarch_fp16_frag_spv,
+                                 sizeof(raymarch_fp16_frag_spv), shaderOverrideDir);
     }
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
@@ -73,13 +98,29 @@ Pipeline::Pipeline(const Device& device, VkRenderPass renderPass, VkExtent2D ext
     vertShaderStageInfo.module = vertShaderModule;
     vertShaderStageInfo.pName = "main";
 
+    // Resource table array sizes are specialization constants
+    VkSpecializationMapEntry specEntries[] = {
+        resources.getSpecializationEntry(ResourceType::Texture),
+        resources.getSpecializationEntry(ResourceType::Volume),
+        resources.getSpecializationEntry(ResourceType::StorageBuffer),
+        resources.getSpecializationEntry(ResourceType::StorageImage)
+    };
+    VkSpecializationInfo specInfo = {};
+    specInfo.mapEntryCount = 4;
+    specInfo.pMapEntries = specEntries;
+    specInfo.dataSize = 4 * sizeof(uint32_t);
+    specInfo.pData = resources.getCapacities();
+
     VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
     fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    VkPipelineShaderStageCreateInfo fp16ShaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+    fp16ShaderStages[1].module = fp16ShaderModule;
 
     // Vertex input (empty, since we use a full-screen triangle)
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
@@ -92,24 +133,17 @@ Pipeline::Pipeline(const Device& device, VkRenderPass renderPass, VkExtent2D ext
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(extent.width);
-    viewport.height = static_cast<float>(extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = extent;
-
+    // Viewport and scissor are set at record time so the pipeline is independent of the extent
     VkPipelineViewportStateCreateInfo viewportState = {};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
 
     VkPipelineRasterizationStateCreateInfo rasterizer = {};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -136,36 +170,61 @@ Pipeline::Pipeline(const Device& device, VkRenderPass renderPass, VkExtent2D ext
     colorBlending.attachmentCount = 1;
     colorBlending.pAttachments = &colorBlendAttachment;
 
+    // The fragment depth is the march's hit. It is written for the meshes drawn afterwards, unless
+    // they were drawn first: then it is only tested, and the depth stays readable by the march.
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = rasterMode == RASTER_PREPASS ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = rasterMode == RASTER_PREPASS ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_ALWAYS;
+
     // Create descriptor set layout
-    VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    uboLayoutBinding.pImmutableSamplers = nullptr;
+    VkDescriptorSetLayoutBinding layoutBindings[2] = {};
+    layoutBindings[0].binding = 0;
+    layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    layoutBindings[0].descriptorCount = 1;
+    layoutBindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    layoutBindings[1].binding = 1;
+    layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layoutBindings[1].descriptorCount = 1;
+    layoutBindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = layoutBindings;
 
-    VkDescriptorSetLayout descriptorSetLayout;
     if (vkCreateDescriptorSetLayout(device.device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor set layout");
     }
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    VkDescriptorSetLayout setLayouts[] = {descriptorSetLayout, resources.layout};
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DrawConstants);
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
     if (vkCreatePipelineLayout(device.device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create pipeline layout");
     }
 
+    // With dynamic rendering the pipeline only needs the attachment formats
+    VkPipelineRenderingCreateInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    renderingInfo.viewMask = viewMask;
+
     VkGraphicsPipelineCreateInfo pipelineInfo = {};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = device.dynamicRendering ? &renderingInfo : nullptr;
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -174,74 +233,56 @@ Pipeline::Pipeline(const Device& device, VkRenderPass renderPass, VkExtent2D ext
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = depthFormat != VK_FORMAT_UNDEFINED ? &depthStencil : nullptr;
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.renderPass = device.dynamicRendering ? VK_NULL_HANDLE : renderPass;
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(device.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+    // The float16 variant differs only in its fragment stage and is created in the same call
+    VkGraphicsPipelineCreateInfo pipelineInfos[] = {pipelineInfo, pipelineInfo};
+    pipelineInfos[1].pStages = fp16ShaderStages;
+    VkPipeline pipelines[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    uint32_t pipelineCount = device.shaderFloat16 ? 2 : 1;
+    if (vkCreateGraphicsPipelines(device.device, VK_NULL_HANDLE, pipelineCount, pipelineInfos, nullptr, pipelines) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create graphics pipeline");
     }
+    graphicsPipeline = pipelines[0];
+    fp16Pipeline = pipelines[1];
 
+    if (fp16ShaderModule != VK_NULL_HANDLE) {
+        vkDestroyShaderModule(device.device, fp16ShaderModule, nullptr);
+    }
     vkDestroyShaderModule(device.device, fragShaderModule, nullptr);
     vkDestroyShaderModule(device.device, vertShaderModule, nullptr);
 
-    // Create uniform buffers
+    // Create uniform buffers, sub-allocated from host-visible (ideally BAR) memory
     uniformBuffers.resize(maxFramesInFlight);
-    uniformBuffersMemory.resize(maxFramesInFlight);
-
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
     for (size_t i = 0; i < maxFramesInFlight; ++i) {
-        VkBufferCreateInfo bufferInfo = {};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = bufferSize;
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-        if (vkCreateBuffer(device.device, &bufferInfo, nullptr, &uniformBuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create uniform buffer");
-        }
-
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device.device, uniformBuffers[i], &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(device.physicalDevice, &memProperties);
-        uint32_t memoryTypeIndex = -1;
-        for (uint32_t j = 0; j < memProperties.memoryTypeCount; ++j) {
-            if ((memRequirements.memoryTypeBits & (1 << j)) &&
-                (memProperties.memoryTypes[j].propertyFlags & (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))) {
-                memoryTypeIndex = j;
-                break;
-            }
-        }
-
-        allocInfo.memoryTypeIndex = memoryTypeIndex;
-
-        if (vkAllocateMemory(device.device, &allocInfo, nullptr, &uniformBuffersMemory[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate uniform buffer memory");
-        }
+        uniformBuffers[i] = allocator.createBuffer(sizeof(UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, MemoryUsage::Upload);
+    }
 
-        vkBindBufferMemory(device.device, uniformBuffers[i], uniformBuffersMemory[i], 0);
+    // Histogram counters are read on the CPU, so keep them out of BAR memory
+    histogramBuffers.resize(maxFramesInFlight);
+    for (size_t i = 0; i < maxFramesInFlight; ++i) {
+        histogramBuffers[i] = allocator.createBuffer(COUNTER_COUNT * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::Staging);
+        memset(histogramBuffers[i].allocation.mapped, 0, COUNTER_COUNT * sizeof(uint32_t));
     }
 
     // Create descriptor pool
-    VkDescriptorPoolSize poolSize = {};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(maxFramesInFlight);
+    VkDescriptorPoolSize poolSizes[2] = {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(maxFramesInFlight);
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(maxFramesInFlight);
 
     VkDescriptorPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
     poolInfo.maxSets = static_cast<uint32_t>(maxFramesInFlight);
 
-    VkDescriptorPool descriptorPool;
     if (vkCreateDescriptorPool(device.device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create descriptor pool");
     }
@@ -262,43 +303,99 @@ Pipeline::Pipeline(const Device& device, VkRenderPass renderPass, VkExtent2D ext
     // Update descriptor sets
     for (size_t i = 0; i < maxFramesInFlight; ++i) {
         VkDescriptorBufferInfo bufferInfo = {};
-        bufferInfo.buffer = uniformBuffers[i];
+        bufferInfo.buffer = uniformBuffers[i].buffer;
         bufferInfo.offset = 0;
         bufferInfo.range = sizeof(UniformBufferObject);
 
-        VkWriteDescriptorSet descriptorWrite = {};
-        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrite.dstSet = descriptorSets[i];
-        descriptorWrite.dstBinding = 0;
-        descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrite.descriptorCount = 1;
-        descriptorWrite.pBufferInfo = &bufferInfo;
-
-        vkUpdateDescriptorSets(device.device, 1, &descriptorWrite, 0, nullptr);
+        VkDescriptorBufferInfo histogramInfo = {};
+        histogramInfo.buffer = histogramBuffers[i].buffer;
+        histogramInfo.offset = 0;
+        histogramInfo.range = COUNTER_COUNT * sizeof(uint32_t);
+
+        VkWriteDescriptorSet descriptorWrites[2] = {};
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = descriptorSets[i];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = descriptorSets[i];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &histogramInfo;
+
+        vkUpdateDescriptorSets(device.device, 2, descriptorWrites, 0, nullptr);
     }
 }
 
-void Pipeline::updateUBO(const Camera& camera) {
+void Pipeline::updateUBO(const Camera& camera, float time, uint32_t frameIndex, const RenderSettings& settings,
+                         const SceneBodies& bodies, float eyeSeparation) {
     UniformBufferObject ubo = {};
-    ubo.view = camera.view;
+    for (uint32_t eye = 0; eye < 2; ++eye) {
+        Camera eyeView = eyeCamera(camera, eye, eyeSeparation);
+        ubo.view[eye] = eyeView.view;
+        ubo.camPos[eye] = glm::vec4(eyeView.position, 0.0f);
+    }
     ubo.proj = camera.proj;
-    ubo.camPos = camera.position;
-    ubo.time = static_cast<float>(glfwGetTime());
+    ubo.time = time;
+    ubo.maxSteps = settings.maxSteps;
+    ubo.epsilon = settings.epsilon;
+    ubo.farDistance = settings.farDistance;
+    ubo.marchStrategy = settings.marchStrategy;
+    ubo.gridMode = settings.gridMode;
+    ubo.bodyBuffer = bodies.buffer;
+    ubo.bodyCount = bodies.count;
+    ubo.bodyBounds = bodies.boundingRadius;
+    ubo.aaMode = settings.aaMode;
+    ubo.aaSamples = static_cast<uint32_t>(settings.aaSamples);
+    ubo.flags = 0;
+    if (settings.stepHistogram && device.fragmentStoresAndAtomics) {
+        ubo.flags |= UBO_FLAG_STEP_HISTOGRAM;
+    }
 
-    void* data;
-    vkMapMemory(device.device, uniformBuffersMemory[currentFrame], 0, sizeof(ubo), 0, &data);
-    memcpy(data, &ubo, sizeof(ubo));
-    vkUnmapMemory(device.device, uniformBuffersMemory[currentFrame]);
+    memcpy(uniformBuffers[frameIndex].allocation.mapped, &ubo, sizeof(ubo));
+}
+
+void Pipeline::readStepHistogram(uint32_t frameIndex, uint32_t* bins) {
+    void* mapped = histogramBuffers[frameIndex].allocation.mapped;
+    memcpy(bins, mapped, STEP_HISTOGRAM_SETS * STEP_HISTOGRAM_BINS * sizeof(uint32_t));
+    memset(mapped, 0, STEP_HISTOGRAM_SETS * STEP_HISTOGRAM_BINS * sizeof(uint32_t));
+}
+
+uint32_t Pipeline::readAaPixelCount(uint32_t frameIndex) {
+    uint32_t* counters = static_cast<uint32_t*>(histogramBuffers[frameIndex].allocation.mapped);
+    uint32_t count = counters[COUNTER_COUNT - 1];
+    counters[COUNTER_COUNT - 1] = 0;
+    return count * AA_PIXEL_SAMPLING;
+}
 
-    currentFrame = (currentFrame + 1) % uniformBuffers.size();
+void Pipeline::pushDrawConstants(VkCommandBuffer commandBuffer, const DrawConstants& constants) const {
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DrawConstants), &constants);
+}
+
+VkPipeline Pipeline::select(uint32_t precision) const {
+    if (precision != SHADER_PRECISION_FP32 && fp16Pipeline != VK_NULL_HANDLE) {
+        return fp16Pipeline;
+    }
+    return graphicsPipeline;
 }
 
 Pipeline::~Pipeline() {
     vkDestroyPipeline(device.device, graphicsPipeline, nullptr);
+    if (fp16Pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device.device, fp16Pipeline, nullptr);
+    }
     vkDestroyPipelineLayout(device.device, pipelineLayout, nullptr);
-    for (size_t i = 0; i < uniformBuffers.size(); ++i) {
-        vkDestroyBuffer(device.device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device.device, uniformBuffersMemory[i], nullptr);
+    vkDestroyDescriptorPool(device.device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device.device, descriptorSetLayout, nullptr);
+    for (auto& buffer : uniformBuffers) {
+        allocator.destroyBuffer(buffer);
+    }
+    for (auto& buffer : histogramBuffers) {
+        allocator.destroyBuffer(buffer);
     }
 }
@@ -1,7 +1,11 @@
 #pragma once
 #include "device.hpp"
+#include "memory.hpp"
+#include "resources.hpp"
+#include "settings.hpp"
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
+#include <string>
 #include <vector>
 
 struct Camera {
@@ -12,17 +16,83 @@ struct Camera {
     glm::mat4 proj;
 };
 
+// Stereo eyes sit eyeSeparation apart along the view's x axis. The march mirrors X on screen,
+// so view-space +x is the left of the image: the left eye (0) is moved that way.
+Camera eyeCamera(const Camera& camera, uint32_t eye, float eyeSeparation);
+
+// UniformBufferObject::flags
+enum UboFlag : uint32_t {
+    UBO_FLAG_STEP_HISTOGRAM = 1 << 0 // Count march steps per pixel into the histogram buffer
+};
+
+// Orbiting bodies for the shader to draw: a storage buffer of vec4(position, radius) in the
+// resource table. The default draws none.
+struct SceneBodies {
+    uint32_t buffer = UINT32_MAX; // ResourceHandle index
+    uint32_t count = 0;
+    float boundingRadius = 0.0f; // Every body lies inside this sphere around the origin
+};
+
+// Which of the two fullscreen draws is recorded; the resolve draw only runs with adaptive AA
+enum DrawPass : uint32_t {
+    DRAW_PASS_PRIMARY = 0, // One ray per pixel; also stores the edge keys when edgeImage is set
+    DRAW_PASS_RESOLVE = 1  // Discards all but edge pixels, which get UBO aaSamples extra rays
+};
+
+// Push constants for one draw, must match raymarch.frag
+struct DrawConstants {
+    uint32_t pass = DRAW_PASS_PRIMARY;
+    uint32_t edgeImage = UINT32_MAX; // Storage image (ResourceHandle index) for the edge keys
+    uint32_t rasterDepth = UINT32_MAX; // Texture (ResourceHandle index) of the raster prepass depth
+    uint32_t view = 0; // Eye of a two-pass stereo draw; multiview draws take gl_ViewIndex instead
+};
+
+// Loads name from overrideDir when it is set and the file exists, otherwise uses the
+// SPIR-V embedded at build time. The override is for iterating on shaders without a rebuild.
+VkShaderModule createShaderModule(VkDevice device, const char* name, const uint32_t* embedded, size_t embeddedSize,
+                                  const std::string& overrideDir);
+
 struct Pipeline {
+    static constexpr uint32_t STEP_HISTOGRAM_BINS = 64; // Must match raymarch.frag
+    // Set 0 counts the whole frame, or the SDF half in grid compare mode; set 1 the analytic half
+    static constexpr uint32_t STEP_HISTOGRAM_SETS = 2;
+    // The histogram buffer ends with the supersampled pixel counter, which only counts one
+    // pixel in every 4x4 block
+    static constexpr uint32_t COUNTER_COUNT = STEP_HISTOGRAM_SETS * STEP_HISTOGRAM_BINS + 1;
+    static constexpr uint32_t AA_PIXEL_SAMPLING = 16;
+
     const Device& device; // Store reference to Device
+    MemoryAllocator& allocator;
     VkPipeline graphicsPipeline;
+    VkPipeline fp16Pipeline; // raymarch_fp16.frag variant; VK_NULL_HANDLE without device.shaderFloat16
+    uint32_t viewMask;       // Multiview views every draw covers, 0 for single-view targets
     VkPipelineLayout pipelineLayout;
-    std::vector<VkDescriptorSet> descriptorSets;
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
-    uint32_t currentFrame; // Track current frame for UBO updates
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorPool descriptorPool;
+    std::vector<VkDescriptorSet> descriptorSets; // Set 0: per-frame UBO and step histogram
+    VkDescriptorSet resourceSet;                 // Set 1: global ResourceTable
+    std::vector<Buffer> uniformBuffers; // Persistently mapped, one per frame in flight
+    std::vector<Buffer> histogramBuffers; // Steps-per-pixel and AA counters, one per frame in flight
 
-    Pipeline(const Device& device, VkRenderPass renderPass, VkExtent2D extent, uint32_t maxFramesInFlight);
+    // renderPass is ignored (may be VK_NULL_HANDLE) when the device uses dynamic rendering.
+    // shaderOverrideDir, if set, is searched for .spv files before the embedded SPIR-V.
+    // With a depthFormat the draws write (RASTER_DEPTH) or only test (RASTER_PREPASS) the
+    // scene depth that rasterized meshes share. A viewMask (dynamic rendering and
+    // device.multiview only) builds the raymarch_multiview variants for layered stereo targets.
+    Pipeline(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+             VkRenderPass renderPass, VkFormat colorFormat, uint32_t maxFramesInFlight,
+             const std::string& shaderOverrideDir = "", VkFormat depthFormat = VK_FORMAT_UNDEFINED,
+             uint32_t rasterMode = RASTER_OFF, uint32_t viewMask = 0);
     ~Pipeline();
 
-    void updateUBO(const Camera& camera);
+    // The update and read calls must only be made once the frame slot's fence has signalled.
+    // A non-zero eyeSeparation fills the two eye views for stereo; otherwise both hold camera.
+    void updateUBO(const Camera& camera, float time, uint32_t frameIndex, const RenderSettings& settings,
+                   const SceneBodies& bodies = SceneBodies(), float eyeSeparation = 0.0f);
+    void readStepHistogram(uint32_t frameIndex, uint32_t* bins); // Copies SETS * BINS counters and clears them
+    uint32_t readAaPixelCount(uint32_t frameIndex); // Estimated supersampled pixels, cleared after reading
+
+    void pushDrawConstants(VkCommandBuffer commandBuffer, const DrawConstants& constants) const;
+    // Pipeline for a ShaderPrecision: auto and fp16 take the float16 variant when there is one
+    VkPipeline select(uint32_t precision) const;
 };
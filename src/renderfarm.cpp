@@ -0,0 +1,807 @@
+#define GLM_ENABLE_EXPERIMENTAL
+#include "renderfarm.hpp"
+#include "input.hpp" // perspectiveProjection
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+// Wire format: u32 type, u32 payload size, payload. Integers little-endian, floats as their bits.
+enum MessageType : uint32_t {
+    MSG_HELLO = 1,  // worker -> coordinator: worker name
+    MSG_JOB = 2,    // coordinator -> worker: frame size, camera and render settings
+    MSG_TILE = 3,   // coordinator -> worker: tile id, frame, time, rectangle
+    MSG_RESULT = 4, // worker -> coordinator: tile id, frame, render microseconds, RGB8 pixels
+    MSG_DONE = 5    // coordinator -> worker: no more work
+};
+
+constexpr size_t HEADER_SIZE = 8;
+constexpr uint32_t MAX_PAYLOAD = 64u << 20;
+constexpr uint32_t JOB_PAYLOAD = 14 * 4;  // MSG_JOB fields
+constexpr uint32_t TILE_PAYLOAD = 7 * 4;  // MSG_TILE fields
+constexpr uint32_t MAX_FRAME_SIZE = 65536; // Per side; a job asking for more is rejected
+constexpr uint32_t RESULT_HEADER = 3 * 4;  // MSG_RESULT fields before the pixels
+constexpr int POLL_TIMEOUT_MS = 1000;      // Coordinator poll, and how long a send may stall
+constexpr int RECONNECT_SECONDS = 30;      // Mid-frame wait for a worker once every one is gone
+
+struct MessageWriter {
+    std::vector<uint8_t> data;
+
+    explicit MessageWriter(MessageType type) : data(HEADER_SIZE) { put(0, type); }
+
+    void put(size_t offset, uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            data[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+    void u32(uint32_t value) {
+        data.resize(data.size() + 4);
+        put(data.size() - 4, value);
+    }
+    void f32(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        u32(bits);
+    }
+    void bytes(const void* source, size_t size) {
+        const uint8_t* begin = static_cast<const uint8_t*>(source);
+        data.insert(data.end(), begin, begin + size);
+    }
+    const std::vector<uint8_t>& finish() {
+        put(4, static_cast<uint32_t>(data.size() - HEADER_SIZE));
+        return data;
+    }
+};
+
+struct MessageReader {
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+
+    uint32_t u32() {
+        if (offset + 4 > size) {
+            throw std::runtime_error("Truncated farm message");
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            value |= static_cast<uint32_t>(data[offset + i]) << (8 * i);
+        }
+        offset += 4;
+        return value;
+    }
+    float f32() {
+        uint32_t bits = u32();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+uint32_t readU32(const uint8_t* data) {
+    MessageReader reader{data, 4};
+    return reader.u32();
+}
+
+// Blocks until everything is written, also on non-blocking sockets. With a timeout it gives
+// up once that many milliseconds have passed, so a peer that stops reading can be dropped.
+bool sendAll(int socket, const std::vector<uint8_t>& data, int timeoutMs = -1) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t result = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result > 0) {
+            sent += static_cast<size_t>(result);
+        } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            int wait = 1000;
+            if (timeoutMs >= 0) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (remaining.count() <= 0) {
+                    return false;
+                }
+                wait = static_cast<int>(std::min<long long>(wait, remaining.count()));
+            }
+            pollfd fd = {socket, POLLOUT, 0};
+            poll(&fd, 1, wait);
+        } else if (result < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool recvAll(int socket, uint8_t* data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        ssize_t result = recv(socket, data + received, size - received, 0);
+        if (result > 0) {
+            received += static_cast<size_t>(result);
+        } else if (result < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void setNoDelay(int socket) {
+    int enable = 1;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+bool parseVec3(const std::string& text, glm::vec3& out) {
+    return std::sscanf(text.c_str(), "%f , %f , %f", &out.x, &out.y, &out.z) == 3;
+}
+
+void splitAddress(const std::string& address, std::string& host, uint16_t& port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size()) {
+        throw std::runtime_error("Expected host:port, got " + address);
+    }
+    host = address.substr(0, colon);
+    port = static_cast<uint16_t>(std::stoul(address.substr(colon + 1)));
+}
+
+} // namespace
+
+FarmJob FarmJob::fromConfig(Config& config, const RenderSettings& settings, float fov) {
+    FarmJob job;
+    // Workers reject frames above MAX_FRAME_SIZE per side
+    job.width = static_cast<uint32_t>(std::clamp(config.getInt("farm.width", static_cast<int>(job.width)), 1,
+                                                 static_cast<int>(MAX_FRAME_SIZE)));
+    job.height = static_cast<uint32_t>(std::clamp(config.getInt("farm.height", static_cast<int>(job.height)), 1,
+                                                  static_cast<int>(MAX_FRAME_SIZE)));
+    job.tileSize = static_cast<uint32_t>(std::clamp(config.getInt("farm.tile_size", static_cast<int>(job.tileSize)), 16, 4096));
+    job.frames = static_cast<uint32_t>(std::max(1, config.getInt("farm.frames", static_cast<int>(job.frames))));
+    job.startTime = config.getFloat("farm.time", job.startTime);
+    job.fps = std::max(1.0f, config.getFloat("farm.fps", job.fps));
+    job.fov = fov;
+    std::string position = config.getString("farm.camera_position", "0,0,0");
+    if (!parseVec3(position, job.position)) {
+        std::cerr << "farm.camera_position=" << position << " is not x,y,z, using the origin" << std::endl;
+        job.position = glm::vec3(0.0f);
+    }
+    job.yaw = config.getFloat("farm.camera_yaw", job.yaw);
+    job.pitch = config.getFloat("farm.camera_pitch", job.pitch);
+    job.settings = settings;
+    std::string output = config.getString("farm.output", job.output);
+    if (isValidIndexPattern(output)) {
+        job.output = output;
+    } else {
+        std::cerr << "farm.output=" << output << " needs exactly one %d or %0Nd for the frame index, using "
+                  << job.output << std::endl;
+    }
+    return job;
+}
+
+Camera FarmJob::camera() const {
+    glm::quat orientation = glm::angleAxis(glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f)) *
+                            glm::angleAxis(glm::radians(pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+    Camera camera;
+    camera.position = position;
+    camera.forward = orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+    camera.up = orientation * glm::vec3(0.0f, 1.0f, 0.0f);
+    camera.view = glm::inverse(glm::translate(glm::mat4(1.0f), position) * glm::toMat4(orientation));
+    camera.proj = perspectiveProjection(fov, static_cast<float>(width) / height);
+    return camera;
+}
+
+FarmCoordinator::FarmCoordinator(const FarmJob& job, uint16_t port, uint32_t prefetch)
+    : job(job), port(port), prefetch(std::max(1u, prefetch)), currentFrame(0), tilesRemaining(0), elapsedSeconds(0.0) {
+    for (uint32_t y = 0; y < job.height; y += job.tileSize) {
+        for (uint32_t x = 0; x < job.width; x += job.tileSize) {
+            tiles.push_back({x, y, std::min(job.tileSize, job.width - x), std::min(job.tileSize, job.height - y)});
+        }
+    }
+
+    listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        throw std::runtime_error("Failed to create farm socket");
+    }
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, 64) != 0) {
+        int error = errno; // Before close() can overwrite it
+        close(listenSocket);
+        throw std::runtime_error("Failed to listen on farm port " + std::to_string(port) + ": " + strerror(error));
+    }
+    std::cout << "Farm coordinator listening on port " << port << ", " << tiles.size() << " tiles of "
+              << job.tileSize << " px per " << job.width << "x" << job.height << " frame" << std::endl;
+}
+
+FarmCoordinator::~FarmCoordinator() {
+    for (WorkerState& worker : workers) {
+        if (worker.connected) {
+            close(worker.socket);
+        }
+    }
+    close(listenSocket);
+}
+
+void FarmCoordinator::acceptWorker() {
+    sockaddr_in peer = {};
+    socklen_t peerSize = sizeof(peer);
+    int socket = accept(listenSocket, reinterpret_cast<sockaddr*>(&peer), &peerSize);
+    if (socket < 0) {
+        return;
+    }
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+    setNoDelay(socket);
+
+    WorkerState worker = {};
+    worker.socket = socket;
+    char peerName[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &peer.sin_addr, peerName, sizeof(peerName));
+    worker.name = std::string(peerName) + ":" + std::to_string(ntohs(peer.sin_port));
+    worker.connected = true;
+
+    MessageWriter message(MSG_JOB);
+    Camera camera = job.camera();
+    message.u32(job.width);
+    message.u32(job.height);
+    message.u32(job.tileSize);
+    message.f32(job.fov);
+    message.f32(camera.position.x);
+    message.f32(camera.position.y);
+    message.f32(camera.position.z);
+    message.f32(job.yaw);
+    message.f32(job.pitch);
+    message.u32(static_cast<uint32_t>(job.settings.maxSteps));
+    message.f32(job.settings.epsilon);
+    message.f32(job.settings.farDistance);
+    message.u32(job.settings.marchStrategy);
+    message.u32(job.settings.gridMode);
+    if (!sendAll(socket, message.finish(), POLL_TIMEOUT_MS)) {
+        close(socket);
+        return;
+    }
+    workers.push_back(std::move(worker));
+    std::cout << "Farm worker connected: " << workers.back().name << std::endl;
+
+    // A late joiner has no run of its own and starts by stealing
+    if (tilesRemaining > 0) {
+        topUp(static_cast<uint32_t>(workers.size() - 1));
+    }
+}
+
+void FarmCoordinator::beginFrame(uint32_t frame) {
+    currentFrame = frame;
+    tilesRemaining = static_cast<uint32_t>(tiles.size());
+    tileDone.assign(tiles.size(), 0);
+    tileDuplicated.assign(tiles.size(), 0);
+    tileSentAt.assign(tiles.size(), std::chrono::steady_clock::time_point());
+    image.assign(static_cast<size_t>(job.width) * job.height * 3, 0);
+
+    // Contiguous runs keep neighbouring (similarly expensive) tiles on one worker
+    std::vector<uint32_t> live;
+    for (uint32_t i = 0; i < workers.size(); ++i) {
+        workers[i].queue.clear();
+        workers[i].inFlight.clear(); // Late copies from the last frame come back as duplicates
+        if (workers[i].connected) {
+            live.push_back(i);
+        }
+    }
+    for (uint32_t i = 0; i < live.size(); ++i) {
+        size_t begin = tiles.size() * i / live.size();
+        size_t end = tiles.size() * (i + 1) / live.size();
+        for (size_t tile = begin; tile < end; ++tile) {
+            workers[live[i]].queue.push_back(static_cast<uint32_t>(tile));
+        }
+    }
+    for (uint32_t worker : live) {
+        topUp(worker);
+    }
+}
+
+bool FarmCoordinator::takeTile(uint32_t worker, uint32_t& tile) {
+    std::deque<uint32_t>& own = workers[worker].queue;
+    while (!own.empty()) {
+        tile = own.front();
+        own.pop_front();
+        if (!tileDone[tile]) {
+            return true;
+        }
+    }
+
+    // Steal from the back of the longest run; the back is furthest from where its owner is working
+    uint32_t victim = UINT32_MAX;
+    for (uint32_t i = 0; i < workers.size(); ++i) {
+        if (i != worker && !workers[i].queue.empty() &&
+            (victim == UINT32_MAX || workers[i].queue.size() > workers[victim].queue.size())) {
+            victim = i;
+        }
+    }
+    if (victim != UINT32_MAX) {
+        tile = workers[victim].queue.back();
+        workers[victim].queue.pop_back();
+        ++workers[worker].stolen;
+        return true;
+    }
+
+    // Nothing left to hand out: an idle worker re-renders the oldest tile still out elsewhere
+    if (!workers[worker].inFlight.empty()) {
+        return false;
+    }
+    bool found = false;
+    for (uint32_t i = 0; i < workers.size(); ++i) {
+        for (uint32_t candidate : workers[i].inFlight) {
+            if (i != worker && !tileDone[candidate] && !tileDuplicated[candidate] &&
+                (!found || tileSentAt[candidate] < tileSentAt[tile])) {
+                tile = candidate;
+                found = true;
+            }
+        }
+    }
+    if (found) {
+        tileDuplicated[tile] = 1;
+    }
+    return found;
+}
+
+void FarmCoordinator::sendTile(uint32_t worker, uint32_t tile) {
+    const TileRect& rect = tiles[tile];
+    MessageWriter message(MSG_TILE);
+    message.u32(tile);
+    message.u32(currentFrame);
+    message.f32(job.startTime + currentFrame / job.fps);
+    message.u32(rect.x);
+    message.u32(rect.y);
+    message.u32(rect.width);
+    message.u32(rect.height);
+
+    if (tileSentAt[tile] == std::chrono::steady_clock::time_point()) {
+        tileSentAt[tile] = std::chrono::steady_clock::now();
+    }
+    workers[worker].inFlight.push_back(tile);
+    if (!sendAll(workers[worker].socket, message.finish(), POLL_TIMEOUT_MS)) {
+        dropWorker(worker);
+    }
+}
+
+void FarmCoordinator::topUp(uint32_t worker) {
+    uint32_t tile;
+    while (workers[worker].connected && workers[worker].inFlight.size() < prefetch && takeTile(worker, tile)) {
+        sendTile(worker, tile);
+    }
+}
+
+void FarmCoordinator::dropWorker(uint32_t worker) {
+    WorkerState& state = workers[worker];
+    if (!state.connected) {
+        return;
+    }
+    close(state.socket);
+    state.connected = false;
+    std::cerr << "Farm worker disconnected: " << state.name << std::endl;
+
+    // Its unfinished tiles go back to the front of its run, where the others steal them
+    for (auto it = state.inFlight.rbegin(); it != state.inFlight.rend(); ++it) {
+        if (!tileDone[*it]) {
+            state.queue.push_front(*it);
+            tileDuplicated[*it] = 0;
+        }
+    }
+    state.inFlight.clear();
+    for (uint32_t i = 0; i < workers.size(); ++i) {
+        if (workers[i].connected) {
+            topUp(i);
+        }
+    }
+}
+
+void FarmCoordinator::handleResult(uint32_t worker, const uint8_t* payload, size_t size) {
+    if (size < RESULT_HEADER) {
+        // Its tiles go back to the others rather than failing the whole render
+        std::cerr << "Truncated tile result from " << workers[worker].name << std::endl;
+        dropWorker(worker);
+        return;
+    }
+    MessageReader reader{payload, size};
+    uint32_t tile = reader.u32();
+    uint32_t frame = reader.u32();
+    uint32_t renderMicros = reader.u32();
+    WorkerState& state = workers[worker];
+    state.renderSeconds += renderMicros * 1e-6;
+
+    auto inFlight = std::find(state.inFlight.begin(), state.inFlight.end(), tile);
+    if (inFlight != state.inFlight.end()) {
+        state.inFlight.erase(inFlight);
+    }
+
+    if (frame != currentFrame || tile >= tiles.size() || tileDone[tile]) {
+        ++state.duplicates; // Lost the race against a speculative copy
+    } else {
+        const TileRect& rect = tiles[tile];
+        size_t rowBytes = static_cast<size_t>(rect.width) * 3;
+        if (size - reader.offset != rowBytes * rect.height) {
+            std::cerr << "Tile result size mismatch from " << state.name << std::endl;
+            dropWorker(worker);
+            return;
+        }
+        for (uint32_t row = 0; row < rect.height; ++row) {
+            memcpy(&image[(static_cast<size_t>(rect.y + row) * job.width + rect.x) * 3],
+                   payload + reader.offset + row * rowBytes, rowBytes);
+        }
+        tileDone[tile] = 1;
+        --tilesRemaining;
+        ++state.tiles;
+        state.pixels += static_cast<uint64_t>(rect.width) * rect.height;
+    }
+    topUp(worker);
+}
+
+bool FarmCoordinator::receive(uint32_t worker) {
+    WorkerState& state = workers[worker];
+    uint8_t chunk[65536];
+    while (true) {
+        ssize_t result = recv(state.socket, chunk, sizeof(chunk), 0);
+        if (result > 0) {
+            state.receiveBuffer.insert(state.receiveBuffer.end(), chunk, chunk + result);
+            continue;
+        }
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false; // Closed or failed
+    }
+
+    size_t consumed = 0;
+    std::vector<uint8_t>& buffer = state.receiveBuffer;
+    while (buffer.size() - consumed >= HEADER_SIZE) {
+        uint32_t type = readU32(&buffer[consumed]);
+        uint32_t size = readU32(&buffer[consumed + 4]);
+        if (size > MAX_PAYLOAD) {
+            return false;
+        }
+        if (buffer.size() - consumed < HEADER_SIZE + size) {
+            break;
+        }
+        const uint8_t* payload = &buffer[consumed + HEADER_SIZE];
+        if (type == MSG_HELLO) {
+            state.name = std::string(reinterpret_cast<const char*>(payload), size);
+        } else if (type == MSG_RESULT) {
+            handleResult(worker, payload, size);
+            if (!workers[worker].connected) {
+                return false;
+            }
+        }
+        consumed += HEADER_SIZE + size;
+    }
+    buffer.erase(buffer.begin(), buffer.begin() + consumed);
+    return true;
+}
+
+void FarmCoordinator::writeFrame() const {
+    std::string path = formatIndexPattern(job.output, currentFrame);
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error(std::string("Failed to write ") + path);
+    }
+    file << "P6\n" << job.width << " " << job.height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+    std::cout << "Wrote " << path << std::endl;
+}
+
+void FarmCoordinator::run(uint32_t minWorkers) {
+    auto connectedCount = [this] {
+        return static_cast<uint32_t>(std::count_if(workers.begin(), workers.end(),
+                                                   [](const WorkerState& worker) { return worker.connected; }));
+    };
+    auto pollOnce = [this] {
+        std::vector<pollfd> fds;
+        std::vector<uint32_t> owners;
+        fds.push_back({listenSocket, POLLIN, 0});
+        for (uint32_t i = 0; i < workers.size(); ++i) {
+            if (workers[i].connected) {
+                fds.push_back({workers[i].socket, POLLIN, 0});
+                owners.push_back(i);
+            }
+        }
+        if (poll(fds.data(), fds.size(), POLL_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !receive(owners[i - 1])) {
+                dropWorker(owners[i - 1]);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            acceptWorker();
+        }
+    };
+
+    std::cout << "Waiting for " << minWorkers << " farm worker(s)" << std::endl;
+    while (connectedCount() < minWorkers) {
+        pollOnce();
+    }
+
+    startTime = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < job.frames; ++frame) {
+        beginFrame(frame);
+        auto lastConnected = std::chrono::steady_clock::now();
+        while (tilesRemaining > 0) {
+            pollOnce();
+            // Dropped workers' tiles wait in their runs for a worker to reconnect and steal them
+            if (connectedCount() > 0) {
+                lastConnected = std::chrono::steady_clock::now();
+            } else if (std::chrono::steady_clock::now() - lastConnected > std::chrono::seconds(RECONNECT_SECONDS)) {
+                throw std::runtime_error("Every farm worker disconnected with " + std::to_string(tilesRemaining) +
+                                         " tile(s) of frame " + std::to_string(frame) + " left");
+            }
+        }
+        writeFrame();
+    }
+    elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    MessageWriter done(MSG_DONE);
+    const std::vector<uint8_t>& message = done.finish();
+    for (WorkerState& worker : workers) {
+        if (worker.connected) {
+            sendAll(worker.socket, message, POLL_TIMEOUT_MS);
+        }
+    }
+}
+
+void FarmCoordinator::report(std::ostream& out) const {
+    uint64_t totalPixels = static_cast<uint64_t>(job.width) * job.height * job.frames;
+    char line[256];
+    std::snprintf(line, sizeof(line), "Farm: %u frame(s) of %ux%u in %.2f s, %.2f Mpix/s", job.frames, job.width,
+                  job.height, elapsedSeconds, elapsedSeconds > 0.0 ? totalPixels / elapsedSeconds * 1e-6 : 0.0);
+    out << line << std::endl;
+    std::snprintf(line, sizeof(line), "  %-28s %7s %6s %8s %8s %6s %5s", "worker", "tiles", "share", "busy s",
+                  "Mpix/s", "stolen", "dup");
+    out << line << std::endl;
+    for (const WorkerState& worker : workers) {
+        double share = totalPixels ? 100.0 * worker.pixels / totalPixels : 0.0;
+        double rate = worker.renderSeconds > 0.0 ? worker.pixels / worker.renderSeconds * 1e-6 : 0.0;
+        std::snprintf(line, sizeof(line), "  %-28s %7llu %5.1f%% %8.2f %8.2f %6llu %5llu", worker.name.c_str(),
+                      static_cast<unsigned long long>(worker.tiles), share, worker.renderSeconds, rate,
+                      static_cast<unsigned long long>(worker.stolen), static_cast<unsigned long long>(worker.duplicates));
+        out << line << std::endl;
+    }
+}
+
+FarmWorker::FarmWorker(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+                       const std::string& shaderOverrideDir, const std::string& address)
+    : device(device), allocator(allocator), resources(resources), shaderOverrideDir(shaderOverrideDir) {
+    splitAddress(address, host, port);
+}
+
+void FarmWorker::run() {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        throw std::runtime_error("Failed to resolve farm coordinator " + host);
+    }
+
+    // Workers on other nodes may start before the coordinator; keep trying for a while
+    int socket = -1;
+    for (int attempt = 0; attempt < 60 && socket < 0; ++attempt) {
+        for (addrinfo* address = addresses; address && socket < 0; address = address->ai_next) {
+            socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (socket >= 0 && connect(socket, address->ai_addr, address->ai_addrlen) != 0) {
+                close(socket);
+                socket = -1;
+            }
+        }
+        if (socket < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        }
+    }
+    freeaddrinfo(addresses);
+    if (socket < 0) {
+        throw std::runtime_error("Failed to connect to farm coordinator " + host + ":" + std::to_string(port));
+    }
+    setNoDelay(socket);
+
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+    std::string name = std::string(hostname) + ":" + std::to_string(getpid());
+    MessageWriter hello(MSG_HELLO);
+    hello.bytes(name.data(), name.size());
+    sendAll(socket, hello.finish());
+
+    uint32_t frameWidth = 0;
+    uint32_t frameHeight = 0;
+    Camera camera = {};
+    RenderSettings settings;
+    std::unique_ptr<TileRenderer> renderer;
+    std::vector<uint8_t> rgba;
+    uint64_t tilesRendered = 0;
+
+    uint8_t header[HEADER_SIZE];
+    std::vector<uint8_t> payload;
+    while (recvAll(socket, header, HEADER_SIZE)) {
+        uint32_t type = readU32(header);
+        uint32_t size = readU32(header + 4);
+        if (size > MAX_PAYLOAD) {
+            break;
+        }
+        payload.resize(size);
+        if (size > 0 && !recvAll(socket, payload.data(), size)) {
+            break;
+        }
+        MessageReader reader{payload.data(), payload.size()};
+
+        // Messages are checked before use: a bad one is rejected and the worker keeps serving
+        if (type == MSG_JOB) {
+            if (size < JOB_PAYLOAD) {
+                std::cerr << "Farm: ignoring a truncated job" << std::endl;
+                continue;
+            }
+            FarmJob job;
+            job.width = reader.u32();
+            job.height = reader.u32();
+            job.tileSize = reader.u32();
+            job.fov = reader.f32();
+            job.position.x = reader.f32();
+            job.position.y = reader.f32();
+            job.position.z = reader.f32();
+            job.yaw = reader.f32();
+            job.pitch = reader.f32();
+            settings.maxSteps = static_cast<int>(std::min<uint32_t>(reader.u32(), INT_MAX));
+            settings.epsilon = reader.f32();
+            settings.farDistance = reader.f32();
+            clampMarchSettings(settings);
+            settings.marchStrategy = static_cast<MarchStrategy>(std::min<uint32_t>(reader.u32(), MARCH_STRATEGY_COUNT - 1));
+            // The compare split would be per tile rather than per frame
+            settings.gridMode = reader.u32() == GRID_SDF ? GRID_SDF : GRID_ANALYTIC;
+            if (job.width == 0 || job.height == 0 || job.width > MAX_FRAME_SIZE || job.height > MAX_FRAME_SIZE) {
+                // Without a frame every tile is rejected until a valid job arrives
+                std::cerr << "Farm: rejecting a " << job.width << "x" << job.height << " job" << std::endl;
+                frameWidth = frameHeight = 0;
+                continue;
+            }
+            frameWidth = job.width;
+            frameHeight = job.height;
+            job.tileSize = std::clamp(job.tileSize, 16u, 4096u);
+            job.fov = std::fmin(std::fmax(job.fov, 1.0f), 179.0f);
+            camera = job.camera();
+            if (!renderer || renderer->maxTileSize < job.tileSize) {
+                renderer.reset();
+                renderer = std::make_unique<TileRenderer>(device, allocator, resources, job.tileSize, shaderOverrideDir);
+            }
+            std::cout << "Farm job: " << frameWidth << "x" << frameHeight << ", " << job.tileSize << " px tiles" << std::endl;
+        } else if (type == MSG_TILE) {
+            if (size < TILE_PAYLOAD) {
+                std::cerr << "Farm: ignoring a truncated tile" << std::endl;
+                continue;
+            }
+            uint32_t tile = reader.u32();
+            uint32_t frame = reader.u32();
+            float time = reader.f32();
+            TileRect rect;
+            rect.x = reader.u32();
+            rect.y = reader.u32();
+            rect.width = reader.u32();
+            rect.height = reader.u32();
+            // Dropped unanswered: only a broken coordinator sends these, and the worker stays up for the rest
+            if (!renderer || frameWidth == 0 || rect.width == 0 || rect.height == 0 ||
+                rect.width > renderer->maxTileSize || rect.height > renderer->maxTileSize ||
+                static_cast<uint64_t>(rect.x) + rect.width > frameWidth ||
+                static_cast<uint64_t>(rect.y) + rect.height > frameHeight) {
+                std::cerr << "Farm: rejecting tile " << tile << " (" << rect.x << "," << rect.y << " " << rect.width
+                          << "x" << rect.height << ")" << std::endl;
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            renderer->render(camera, time, settings, frameWidth, frameHeight, rect, rgba);
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+            // Alpha is always 1; send RGB only
+            MessageWriter result(MSG_RESULT);
+            result.u32(tile);
+            result.u32(frame);
+            result.u32(static_cast<uint32_t>(std::min<long long>(micros, UINT32_MAX)));
+            size_t pixelCount = static_cast<size_t>(rect.width) * rect.height;
+            result.data.reserve(result.data.size() + pixelCount * 3);
+            for (size_t i = 0; i < pixelCount; ++i) {
+                result.bytes(&rgba[i * 4], 3);
+            }
+            if (!sendAll(socket, result.finish())) {
+                break;
+            }
+            ++tilesRendered;
+        } else if (type == MSG_DONE) {
+            break;
+        }
+    }
+    close(socket);
+    std::cout << "Farm worker done, " << tilesRendered << " tiles rendered" << std::endl;
+}
+
+int runRenderFarm(Config& config, const std::string& role, const RenderSettings& settings, float fov,
+                  const std::string& gpuSelection, bool forceVulkan10, const std::string& shaderOverrideDir) {
+    uint16_t port = static_cast<uint16_t>(config.getInt("farm.port", 7070));
+    if (role == "worker") {
+        std::string address = config.getString("farm.connect", "127.0.0.1:" + std::to_string(port));
+        config.print(std::cout);
+        try {
+            Device device(nullptr, gpuSelection, forceVulkan10);
+            MemoryAllocator allocator(device);
+            ResourceTable resources(device);
+            FarmWorker worker(device, allocator, resources, shaderOverrideDir, address);
+            worker.run();
+            device.waitIdle();
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    FarmJob job = FarmJob::fromConfig(config, settings, fov);
+    uint32_t localWorkers = static_cast<uint32_t>(std::max(0, config.getInt("farm.local_workers", 0)));
+    uint32_t minWorkers = static_cast<uint32_t>(std::max(1, config.getInt("farm.min_workers", std::max(1, static_cast<int>(localWorkers)))));
+    uint32_t prefetch = static_cast<uint32_t>(std::max(1, config.getInt("farm.prefetch", 2)));
+    config.print(std::cout);
+
+    std::vector<pid_t> children;
+    int exitCode = 0;
+    try {
+        FarmCoordinator coordinator(job, port, prefetch);
+
+        // Local workers make the whole farm testable on one machine; they read the same
+        // settings files, so GPU selection and shader overrides carry over
+        std::string connect = "--farm.connect=127.0.0.1:" + std::to_string(port);
+        for (uint32_t i = 0; i < localWorkers; ++i) {
+            char roleArg[] = "--farm=worker";
+            char* args[] = {const_cast<char*>("gridfire"), roleArg, const_cast<char*>(connect.c_str()), nullptr};
+            pid_t pid;
+            if (posix_spawn(&pid, "/proc/self/exe", nullptr, nullptr, args, environ) == 0) {
+                children.push_back(pid);
+            } else {
+                std::cerr << "Failed to start local farm worker " << i << std::endl;
+            }
+        }
+
+        coordinator.run(minWorkers);
+        coordinator.report(std::cout);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        for (pid_t pid : children) {
+            kill(pid, SIGTERM);
+        }
+        exitCode = -1;
+    }
+    for (pid_t pid : children) {
+        waitpid(pid, nullptr, 0);
+    }
+    return exitCode;
+}
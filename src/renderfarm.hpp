@@ -0,0 +1,105 @@
+#pragma once
+#include "config.hpp"
+#include "settings.hpp"
+#include "tilerender.hpp"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Offline frames, identical for every tile of a frame except for the tile rectangle
+struct FarmJob {
+    uint32_t width = 7680;
+    uint32_t height = 4320;
+    uint32_t tileSize = 256;
+    uint32_t frames = 1;
+    float startTime = 0.0f; // Scene time of the first frame, as passed to Pipeline::updateUBO
+    float fps = 30.0f;      // Time step between frames
+    float fov = 80.0f;
+    glm::vec3 position = glm::vec3(0.0f);
+    float yaw = 0.0f;   // Degrees about +Y
+    float pitch = 0.0f; // Degrees about the camera's X axis
+    RenderSettings settings;
+    std::string output = "frame_%04d.ppm"; // Index pattern (see formatIndexPattern) taking the frame index
+
+    // Reads the [farm] keys; render settings come from the caller (quality preset and overrides)
+    static FarmJob fromConfig(Config& config, const RenderSettings& settings, float fov);
+    Camera camera() const; // proj covers the whole frame
+};
+
+// Splits frames into tiles and hands them to workers over TCP. Each worker gets a
+// contiguous run of tiles; an idle worker steals from the back of the longest run and,
+// once nothing is left to steal, re-renders the oldest tile still out on a slower worker
+// so one slow node cannot hold up the frame. Pixels stream back and are assembled in memory.
+struct FarmCoordinator {
+    struct WorkerState {
+        int socket;
+        std::string name;
+        bool connected;
+        std::deque<uint32_t> queue;    // Tiles of the current frame reserved for this worker
+        std::vector<uint32_t> inFlight; // Tiles sent and not yet returned, oldest first
+        std::vector<uint8_t> receiveBuffer;
+        uint64_t tiles;
+        uint64_t pixels;
+        uint64_t stolen;     // Tiles taken from another worker's run
+        uint64_t duplicates; // Speculative re-renders that arrived second
+        double renderSeconds; // GPU time reported by the worker
+    };
+
+    FarmJob job;
+    uint16_t port;
+    uint32_t prefetch; // Tiles kept in flight per worker to hide network latency
+    int listenSocket;
+    std::vector<WorkerState> workers;
+    std::vector<TileRect> tiles;       // Tiles of one frame
+    std::vector<uint8_t> tileDone;     // Per tile, for the current frame
+    std::vector<uint8_t> tileDuplicated;
+    std::vector<std::chrono::steady_clock::time_point> tileSentAt; // First send, picks the oldest tile to duplicate
+    std::vector<uint8_t> image;        // RGB8, width * height
+    uint32_t currentFrame;
+    uint32_t tilesRemaining;
+    std::chrono::steady_clock::time_point startTime;
+    double elapsedSeconds;
+
+    FarmCoordinator(const FarmJob& job, uint16_t port, uint32_t prefetch);
+    ~FarmCoordinator();
+
+    // Blocks until minWorkers are connected, renders every frame and writes it to disk. Throws
+    // if every worker is gone mid-frame and none reconnects within 30 s.
+    void run(uint32_t minWorkers);
+    void report(std::ostream& out) const;
+
+private:
+    void acceptWorker();
+    void beginFrame(uint32_t frame);
+    void topUp(uint32_t worker);
+    bool takeTile(uint32_t worker, uint32_t& tile);
+    void sendTile(uint32_t worker, uint32_t tile);
+    bool receive(uint32_t worker); // Returns false once the connection is gone
+    void handleResult(uint32_t worker, const uint8_t* payload, size_t size);
+    void dropWorker(uint32_t worker);
+    void writeFrame() const;
+};
+
+// Connects to a coordinator and renders the tiles it sends on a headless device until told to stop
+struct FarmWorker {
+    const Device& device;
+    MemoryAllocator& allocator;
+    const ResourceTable& resources;
+    std::string shaderOverrideDir;
+    std::string host;
+    uint16_t port;
+
+    // address is host:port
+    FarmWorker(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+               const std::string& shaderOverrideDir, const std::string& address);
+    void run();
+};
+
+// Entry point for farm.role=coordinator|worker: reads the [farm] keys, prints the effective
+// configuration and runs to completion without opening a window. Returns the exit code.
+int runRenderFarm(Config& config, const std::string& role, const RenderSettings& settings, float fov,
+                  const std::string& gpuSelection, bool forceVulkan10, const std::string& shaderOverrideDir);
@@ -0,0 +1,227 @@
+#include "resources.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+static constexpr uint32_t TYPE_COUNT = static_cast<uint32_t>(ResourceType::Count);
+
+static VkDescriptorType descriptorType(ResourceType type) {
+    switch (type) {
+        case ResourceType::StorageBuffer: return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        case ResourceType::StorageImage: return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        default: return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    }
+}
+
+ResourceTable::ResourceTable(const Device& device) : device(device) {
+    // Size the arrays from the per-stage limits; textures and volumes share the sampler budget
+    uint32_t samplerBudget, bufferBudget, storageImageBudget;
+    if (device.descriptorIndexing) {
+        VkPhysicalDeviceVulkan12Properties props12 = {};
+        props12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+        VkPhysicalDeviceProperties2 props = {};
+        props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        props.pNext = &props12;
+        vkGetPhysicalDeviceProperties2(device.physicalDevice, &props);
+        samplerBudget = std::min(props12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                 props12.maxPerStageDescriptorUpdateAfterBindSamplers);
+        bufferBudget = props12.maxPerStageDescriptorUpdateAfterBindStorageBuffers;
+        storageImageBudget = props12.maxPerStageDescriptorUpdateAfterBindStorageImages;
+    } else {
+        const VkPhysicalDeviceLimits& limits = device.properties.limits;
+        samplerBudget = std::min(limits.maxPerStageDescriptorSampledImages, limits.maxPerStageDescriptorSamplers);
+        bufferBudget = limits.maxPerStageDescriptorStorageBuffers;
+        storageImageBudget = limits.maxPerStageDescriptorStorageImages;
+    }
+    uint32_t volumes = std::min(256u, samplerBudget / 4);
+    capacity[static_cast<uint32_t>(ResourceType::Texture)] = std::min(4096u, samplerBudget - volumes);
+    capacity[static_cast<uint32_t>(ResourceType::Volume)] = volumes;
+    capacity[static_cast<uint32_t>(ResourceType::StorageBuffer)] = std::min(1024u, bufferBudget);
+    capacity[static_cast<uint32_t>(ResourceType::StorageImage)] = std::min(256u, storageImageBudget);
+    std::fill(nextIndex, nextIndex + TYPE_COUNT, 0u);
+
+    // Create descriptor set layout
+    VkDescriptorSetLayoutBinding bindings[TYPE_COUNT] = {};
+    VkDescriptorBindingFlags bindingFlags[TYPE_COUNT] = {};
+    VkDescriptorPoolSize poolSizes[TYPE_COUNT] = {};
+    for (uint32_t i = 0; i < TYPE_COUNT; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = descriptorType(static_cast<ResourceType>(i));
+        bindings[i].descriptorCount = capacity[i];
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        bindingFlags[i] = device.descriptorIndexing
+            ? VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+              VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+            : 0;
+        poolSizes[i].type = bindings[i].descriptorType;
+        poolSizes[i].descriptorCount = capacity[i];
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = TYPE_COUNT;
+    bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = device.descriptorIndexing ? &bindingFlagsInfo : nullptr;
+    layoutInfo.flags = device.descriptorIndexing ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
+    layoutInfo.bindingCount = TYPE_COUNT;
+    layoutInfo.pBindings = bindings;
+
+    if (vkCreateDescriptorSetLayout(device.device, &layoutInfo, nullptr, &layout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create resource table layout");
+    }
+
+    // Create descriptor pool
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = device.descriptorIndexing ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = TYPE_COUNT;
+    poolInfo.pPoolSizes = poolSizes;
+
+    if (vkCreateDescriptorPool(device.device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create resource table pool");
+    }
+
+    // Allocate the single global set
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    if (vkAllocateDescriptorSets(device.device, &allocInfo, &set) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate resource table set");
+    }
+}
+
+ResourceTable::~ResourceTable() {
+    vkDestroyDescriptorPool(device.device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device.device, layout, nullptr);
+}
+
+ResourceHandle ResourceTable::allocate(ResourceType type) {
+    uint32_t t = static_cast<uint32_t>(type);
+    ResourceHandle handle;
+    handle.type = type;
+    if (!freeIndices[t].empty()) {
+        handle.index = freeIndices[t].back();
+        freeIndices[t].pop_back();
+    } else if (nextIndex[t] < capacity[t]) {
+        handle.index = nextIndex[t]++;
+    } else {
+        throw std::runtime_error("Resource table is full");
+    }
+    return handle;
+}
+
+void ResourceTable::writeImage(ResourceHandle handle, VkImageView view, VkSampler sampler, VkImageLayout layout) {
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = view;
+    imageInfo.imageLayout = layout;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = static_cast<uint32_t>(handle.type);
+    descriptorWrite.dstArrayElement = handle.index;
+    descriptorWrite.descriptorType = descriptorType(handle.type);
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(device.device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void ResourceTable::writeBuffer(ResourceHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = offset;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = static_cast<uint32_t>(handle.type);
+    descriptorWrite.dstArrayElement = handle.index;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+
+    vkUpdateDescriptorSets(device.device, 1, &descriptorWrite, 0, nullptr);
+}
+
+ResourceHandle ResourceTable::registerTexture(VkImageView view, VkSampler sampler, VkImageLayout layout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ResourceHandle handle = allocate(ResourceType::Texture);
+    writeImage(handle, view, sampler, layout);
+    return handle;
+}
+
+ResourceHandle ResourceTable::registerVolume(VkImageView view, VkSampler sampler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ResourceHandle handle = allocate(ResourceType::Volume);
+    writeImage(handle, view, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    return handle;
+}
+
+ResourceHandle ResourceTable::registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ResourceHandle handle = allocate(ResourceType::StorageBuffer);
+    writeBuffer(handle, buffer, offset, range);
+    return handle;
+}
+
+ResourceHandle ResourceTable::registerStorageImage(VkImageView view) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ResourceHandle handle = allocate(ResourceType::StorageImage);
+    writeImage(handle, view, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL);
+    return handle;
+}
+
+void ResourceTable::updateImage(ResourceHandle handle, VkImageView view, VkSampler sampler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeImage(handle, view, sampler, handle.type == ResourceType::StorageImage
+        ? VK_IMAGE_LAYOUT_GENERAL
+        : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void ResourceTable::updateStorageBuffer(ResourceHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeBuffer(handle, buffer, offset, range);
+}
+
+void ResourceTable::release(ResourceHandle handle, uint64_t frameNumber) {
+    if (!handle.valid()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    pendingFree.emplace_back(frameNumber, handle);
+}
+
+void ResourceTable::collect(uint64_t completedFrame) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::remove_if(pendingFree.begin(), pendingFree.end(), [&](const auto& entry) {
+        if (entry.first > completedFrame) {
+            return false;
+        }
+        freeIndices[static_cast<uint32_t>(entry.second.type)].push_back(entry.second.index);
+        return true;
+    });
+    pendingFree.erase(it, pendingFree.end());
+}
+
+uint32_t ResourceTable::getUsedCount(ResourceType type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t t = static_cast<uint32_t>(type);
+    return nextIndex[t] - static_cast<uint32_t>(freeIndices[t].size());
+}
+
+VkSpecializationMapEntry ResourceTable::getSpecializationEntry(ResourceType type) const {
+    VkSpecializationMapEntry entry = {};
+    entry.constantID = static_cast<uint32_t>(type);
+    entry.offset = static_cast<uint32_t>(type) * sizeof(uint32_t);
+    entry.size = sizeof(uint32_t);
+    return entry;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "device.hpp"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Arrays in the global resource set; the enum value is the binding number
+enum class ResourceType : uint32_t {
+    Texture = 0,       // sampler2D textures[]
+    Volume = 1,        // sampler3D volumes[]
+    StorageBuffer = 2, // buffers[]
+    StorageImage = 3,  // image2D storageImages[]
+    Count = 4
+};
+
+// Stable index into one of the resource arrays. Shaders receive the index through
+// scene data and never need a per-resource descriptor set.
+struct ResourceHandle {
+    ResourceType type = ResourceType::Texture;
+    uint32_t index = UINT32_MAX;
+
+    bool valid() const { return index != UINT32_MAX; }
+};
+
+// One large descriptor set (set = 1) holding every scene resource, bound once per
+// command buffer. With descriptor indexing the set is update-after-bind and partially
+// bound, so resources can be registered while frames are in flight. Without it,
+// register everything up front and make sure every slot a shader reads is written.
+struct ResourceTable {
+    static constexpr uint32_t SET_INDEX = 1;
+
+    const Device& device;
+    VkDescriptorSetLayout layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    uint32_t capacity[static_cast<uint32_t>(ResourceType::Count)];
+    uint32_t nextIndex[static_cast<uint32_t>(ResourceType::Count)];
+    std::vector<uint32_t> freeIndices[static_cast<uint32_t>(ResourceType::Count)];
+    std::vector<std::pair<uint64_t, ResourceHandle>> pendingFree; // Released at frame N, reusable once N completes
+    std::mutex mutex;
+
+    ResourceTable(const Device& device);
+    ~ResourceTable();
+
+    // layout is the one the image is in whenever a shader samples it (e.g. read-only depth)
+    ResourceHandle registerTexture(VkImageView view, VkSampler sampler,
+                                   VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    ResourceHandle registerVolume(VkImageView view, VkSampler sampler);
+    ResourceHandle registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+    ResourceHandle registerStorageImage(VkImageView view);
+
+    // Points an existing handle at a different resource (e.g. after a resize)
+    void updateImage(ResourceHandle handle, VkImageView view, VkSampler sampler);
+    void updateStorageBuffer(ResourceHandle handle, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    void release(ResourceHandle handle, uint64_t frameNumber);
+    void collect(uint64_t completedFrame);
+
+    uint32_t getUsedCount(ResourceType type);
+    VkSpecializationMapEntry getSpecializationEntry(ResourceType type) const; // constant_id == binding
+    const uint32_t* getCapacities() const { return capacity; }
+
+private:
+    ResourceHandle allocate(ResourceType type);
+    void writeImage(ResourceHandle handle, VkImageView view, VkSampler sampler, VkImageLayout layout);
+    void writeBuffer(ResourceHandle handle, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+};
@@ -0,0 +1,939 @@
+#include "scene.hpp"
+#include "tilerender.hpp"
+#include "input.hpp" // perspectiveProjection
+#include "gridfire_config.h"
+#include "raymarch_frag_glsl.h"
+#include "bindless_glsl.h"
+#include "raymarch_vert_spv.h"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+// One line of a scene file: a keyword, bare operands and key=value parameters
+struct Statement {
+    std::string path;
+    int line;
+    std::string keyword;
+    std::vector<std::string> operands;
+    std::map<std::string, std::string> params;
+    std::set<std::string> read;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error(path + ":" + std::to_string(line) + ": " + message);
+    }
+
+    float toNumber(const std::string& text, const std::string& what) const {
+        char* end = nullptr;
+        float value = std::strtof(text.c_str(), &end);
+        if (text.empty() || *end != '\0' || !std::isfinite(value)) {
+            fail("expected a number for " + what + ", got '" + text + "'");
+        }
+        return value;
+    }
+
+    bool has(const std::string& key) const { return params.find(key) != params.end(); }
+
+    std::string word(const std::string& key, const std::string& fallback) {
+        read.insert(key);
+        auto it = params.find(key);
+        return it == params.end() ? fallback : it->second;
+    }
+
+    float number(const std::string& key, float fallback) {
+        read.insert(key);
+        auto it = params.find(key);
+        return it == params.end() ? fallback : toNumber(it->second, key);
+    }
+
+    float required(const std::string& key) {
+        if (!has(key)) {
+            fail(keyword + " needs " + key + "=");
+        }
+        return number(key, 0.0f);
+    }
+
+    // "x,y,z", or a single value for all three
+    glm::vec3 vector(const std::string& key, glm::vec3 fallback) {
+        read.insert(key);
+        auto it = params.find(key);
+        if (it == params.end()) {
+            return fallback;
+        }
+        std::vector<float> values;
+        std::stringstream parts(it->second);
+        for (std::string part; std::getline(parts, part, ',');) {
+            values.push_back(toNumber(part, key));
+        }
+        if (values.size() == 1) {
+            return glm::vec3(values[0]);
+        }
+        if (values.size() != 3) {
+            fail("expected x,y,z for " + key);
+        }
+        return glm::vec3(values[0], values[1], values[2]);
+    }
+
+    // Rejects parameters the statement has no use for, which are most likely typos
+    void finish() const {
+        for (const auto& param : params) {
+            if (read.find(param.first) == read.end()) {
+                fail("unknown parameter " + param.first + " for " + keyword);
+            }
+        }
+    }
+};
+
+// Sphere around everything a node draws; the node's distance is never below the distance
+// to it, so far away the march can step by it instead of evaluating the node
+struct Bound {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    bool finite = true;
+    bool isStatic = true; // Nothing in it moves along an orbit
+    uint32_t primitives = 0;
+};
+
+// Smallest sphere around two spheres
+Bound mergeBounds(const Bound& a, const Bound& b) {
+    Bound merged;
+    merged.finite = a.finite && b.finite;
+    merged.isStatic = a.isStatic && b.isStatic;
+    merged.primitives = a.primitives + b.primitives;
+    float d = glm::length(b.center - a.center);
+    if (d + b.radius <= a.radius) {
+        merged.center = a.center;
+        merged.radius = a.radius;
+    } else if (d + a.radius <= b.radius) {
+        merged.center = b.center;
+        merged.radius = b.radius;
+    } else {
+        merged.radius = 0.5f * (d + a.radius + b.radius);
+        merged.center = a.center + (b.center - a.center) * ((merged.radius - a.radius) / d);
+    }
+    return merged;
+}
+
+Bound computeBound(const SceneDescription& scene, int index) {
+    const SceneNode& node = scene.nodes[index];
+    Bound bound;
+    switch (node.type) {
+    case SceneNodeType::Sphere:
+    case SceneNodeType::Box:
+    case SceneNodeType::Torus:
+    case SceneNodeType::Plane:
+        bound.center = node.center;
+        bound.isStatic = node.orbit < 0;
+        bound.primitives = 1;
+        bound.finite = node.type != SceneNodeType::Plane;
+        bound.radius = node.type == SceneNodeType::Sphere ? node.radius
+                     : node.type == SceneNodeType::Box   ? 0.5f * glm::length(node.size)
+                                                         : node.radius + node.thickness;
+        return bound;
+    case SceneNodeType::Union:
+    case SceneNodeType::SmoothUnion:
+        bound = computeBound(scene, node.children[0]);
+        for (size_t i = 1; i < node.children.size(); ++i) {
+            bound = mergeBounds(bound, computeBound(scene, node.children[i]));
+            // smin() is at most k / 4 below min()
+            if (node.type == SceneNodeType::SmoothUnion) {
+                bound.radius += 0.25f * node.k;
+            }
+        }
+        return bound;
+    case SceneNodeType::Intersect:
+    case SceneNodeType::Subtract: {
+        // Never larger than the first child; an intersection not larger than any child either
+        bound = computeBound(scene, node.children[0]);
+        for (size_t i = 1; i < node.children.size(); ++i) {
+            Bound child = computeBound(scene, node.children[i]);
+            bound.isStatic = bound.isStatic && child.isStatic;
+            bound.primitives += child.primitives;
+            if (node.type == SceneNodeType::Intersect && child.finite && (!bound.finite || child.radius < bound.radius)) {
+                bound.center = child.center;
+                bound.radius = child.radius;
+                bound.finite = true;
+            }
+        }
+        return bound;
+    }
+    }
+    return bound;
+}
+
+// Shortest text that reads back as the same float, always a GLSL float literal
+std::string glslFloat(float value) {
+    char text[32];
+    for (int digits = 6; digits <= 9; ++digits) {
+        std::snprintf(text, sizeof(text), "%.*g", digits, value);
+        if (std::strtof(text, nullptr) == value) {
+            break;
+        }
+    }
+    std::string literal = text;
+    if (literal.find_first_of(".e") == std::string::npos) {
+        literal += ".0";
+    }
+    return literal;
+}
+
+std::string glslVec3(glm::vec3 v) {
+    if (v.x == v.y && v.y == v.z) {
+        return "vec3(" + glslFloat(v.x) + ")";
+    }
+    return "vec3(" + glslFloat(v.x) + ", " + glslFloat(v.y) + ", " + glslFloat(v.z) + ")";
+}
+
+// Writes the distance (and color) statements for nodes into d<N> (and c<N>) variables
+struct SceneWriter {
+    const SceneDescription& scene;
+    std::vector<Bound> bounds;        // Per node
+    std::vector<int> orbitSlots;      // Per orbit, its sceneOrbit<N> or -1 when unused
+    int usedOrbits = 0;
+    std::ostringstream out;
+    uint32_t nextVar = 0;
+    uint32_t boundCount = 0;
+
+    explicit SceneWriter(const SceneDescription& scene) : scene(scene), orbitSlots(scene.orbits.size(), -1) {
+        for (size_t i = 0; i < scene.nodes.size(); ++i) {
+            bounds.push_back(computeBound(scene, static_cast<int>(i)));
+        }
+    }
+
+    // With colors the node's color goes into c<N> too; the distance-only version instead puts
+    // static subtrees of two or more primitives behind their bounding sphere. boundable is
+    // false under the carved-out side of a subtraction, where a smaller distance would make
+    // the result larger rather than smaller.
+    uint32_t emit(int index, bool colors, bool boundable, const std::string& indent) {
+        const Bound& bound = bounds[index];
+        if (colors || !boundable || !bound.finite || !bound.isStatic || bound.primitives < 2) {
+            return emitNode(index, colors, boundable, indent);
+        }
+        uint32_t var = nextVar++;
+        glm::vec3 c = bound.center;
+        out << indent << "float d" << var << " = length(" << (c == glm::vec3(0.0f) ? "p" : "p - " + glslVec3(c)) << ") - "
+            << glslFloat(bound.radius) << "; // Bounds " << scene.nodes[index].name << "\n";
+        out << indent << "if (d" << var << " < SCENE_BOUND_MARGIN) {\n";
+        uint32_t inner = emitNode(index, colors, boundable, indent + "    ");
+        out << indent << "    d" << var << " = d" << inner << ";\n";
+        out << indent << "}\n";
+        ++boundCount;
+        return var;
+    }
+
+    uint32_t emitNode(int index, bool colors, bool boundable, const std::string& indent) {
+        const SceneNode& node = scene.nodes[index];
+        if (node.children.empty()) {
+            return emitPrimitive(node, colors, indent);
+        }
+
+        uint32_t acc = emit(node.children[0], colors, boundable, indent);
+        for (size_t i = 1; i < node.children.size(); ++i) {
+            bool carved = node.type == SceneNodeType::Subtract;
+            uint32_t next = emit(node.children[i], colors, boundable && !carved, indent);
+            uint32_t var = nextVar++;
+            std::string a = "d" + std::to_string(acc);
+            std::string b = "d" + std::to_string(next);
+            std::string ca = "c" + std::to_string(acc);
+            std::string cb = "c" + std::to_string(next);
+            std::string d = "d" + std::to_string(var);
+            switch (node.type) {
+            case SceneNodeType::Union:
+                out << indent << "float " << d << " = min(" << a << ", " << b << ");\n";
+                if (colors) {
+                    out << indent << "vec3 c" << var << " = " << a << " <= " << b << " ? " << ca << " : " << cb << ";\n";
+                }
+                break;
+            case SceneNodeType::SmoothUnion: {
+                // smin() with 0.5 / k folded
+                std::string h = "h" + std::to_string(var);
+                out << indent << "float " << h << " = clamp(0.5 + (" << b << " - " << a << ") * " << glslFloat(0.5f / node.k)
+                    << ", 0.0, 1.0);\n";
+                out << indent << "float " << d << " = mix(" << b << ", " << a << ", " << h << ") - " << glslFloat(node.k) << " * "
+                    << h << " * (1.0 - " << h << ");\n";
+                if (colors) {
+                    out << indent << "vec3 c" << var << " = mix(" << cb << ", " << ca << ", " << h << ");\n";
+                }
+                break;
+            }
+            case SceneNodeType::Intersect:
+                out << indent << "float " << d << " = max(" << a << ", " << b << ");\n";
+                if (colors) {
+                    out << indent << "vec3 c" << var << " = " << a << " >= " << b << " ? " << ca << " : " << cb << ";\n";
+                }
+                break;
+            case SceneNodeType::Subtract:
+                out << indent << "float " << d << " = max(" << a << ", -" << b << ");\n";
+                if (colors) {
+                    out << indent << "vec3 c" << var << " = " << a << " >= -" << b << " ? " << ca << " : " << cb << ";\n";
+                }
+                break;
+            default:
+                break;
+            }
+            acc = var;
+        }
+        return acc;
+    }
+
+    uint32_t emitPrimitive(const SceneNode& node, bool colors, const std::string& indent) {
+        uint32_t var = nextVar++;
+        std::string d = "d" + std::to_string(var);
+        std::string q = "q" + std::to_string(var);
+
+        // Position relative to the primitive's center, with zero offsets folded away
+        std::string position = "p";
+        if (node.orbit >= 0) {
+            position += " - sceneOrbit" + std::to_string(orbitSlots[node.orbit]);
+        }
+        if (node.center != glm::vec3(0.0f)) {
+            position += " - " + glslVec3(node.center);
+        }
+        std::string grouped = position == "p" ? position : "(" + position + ")";
+
+        switch (node.type) {
+        case SceneNodeType::Sphere:
+            out << indent << "float " << d << " = length(" << position << ") - " << glslFloat(node.radius) << ";\n";
+            break;
+        case SceneNodeType::Box:
+            out << indent << "vec3 " << q << " = abs(" << position << ") - " << glslVec3(0.5f * node.size) << ";\n";
+            out << indent << "float " << d << " = length(max(" << q << ", 0.0)) + min(max(" << q << ".x, max(" << q << ".y, "
+                << q << ".z)), 0.0);\n";
+            break;
+        case SceneNodeType::Torus:
+            out << indent << "vec3 " << q << " = " << position << ";\n";
+            out << indent << "float " << d << " = length(vec2(length(" << q << ".xz) - " << glslFloat(node.radius) << ", " << q
+                << ".y)) - " << glslFloat(node.thickness) << ";\n";
+            break;
+        case SceneNodeType::Plane: {
+            // Axis-aligned planes only need one coordinate
+            std::string distance = "dot(" + grouped + ", " + glslVec3(node.normal) + ")";
+            for (int axis = 0; axis < 3; ++axis) {
+                if (std::abs(node.normal[axis]) == 1.0f) {
+                    distance = std::string(node.normal[axis] < 0.0f ? "-" : "") + grouped + "." + "xyz"[axis];
+                }
+            }
+            out << indent << "float " << d << " = " << distance;
+            if (node.offset != 0.0f) {
+                out << (node.offset > 0.0f ? " - " : " + ") << glslFloat(std::abs(node.offset));
+            }
+            out << ";\n";
+            break;
+        }
+        default:
+            break;
+        }
+        if (colors) {
+            out << indent << "vec3 c" << var << " = " << glslVec3(node.color) << "; // " << node.name << "\n";
+        }
+        return var;
+    }
+
+    void markOrbits(int index, uint32_t& primitives) {
+        const SceneNode& node = scene.nodes[index];
+        if (node.children.empty()) {
+            ++primitives;
+            if (node.orbit >= 0 && orbitSlots[node.orbit] < 0) {
+                orbitSlots[node.orbit] = usedOrbits++;
+            }
+        }
+        for (int child : node.children) {
+            markOrbits(child, primitives);
+        }
+    }
+
+    // Kepler's equation with every constant of the orbit folded; the orbit is solved with the
+    // eccentric anomaly directly, which gives the same point as the true anomaly in raymarch.frag
+    void emitOrbit(const SceneOrbit& orbit, int slot) {
+        float e = orbit.eccentricity;
+        std::string target = "sceneOrbit" + std::to_string(slot);
+        out << "    // " << orbit.name << "\n";
+        out << "    {\n";
+        out << "        float M = ubo.time * " << glslFloat(glm::two_pi<float>() / orbit.period) << ";\n";
+        std::string position;
+        if (e == 0.0f) {
+            position = "vec3(" + glslFloat(orbit.semiMajorAxis) + " * cos(M), " + glslFloat(orbit.semiMajorAxis) + " * sin(M), 0.0)";
+        } else {
+            out << "        float E = M;\n";
+            out << "        for (int j = 0; j < 10; j++) {\n";
+            out << "            float delta = (E - " << glslFloat(e) << " * sin(E) - M) / (1.0 - " << glslFloat(e) << " * cos(E));\n";
+            out << "            E -= delta;\n";
+            out << "            if (abs(delta) < 1e-6) break;\n";
+            out << "        }\n";
+            position = "vec3(" + glslFloat(orbit.semiMajorAxis) + " * (cos(E) - " + glslFloat(e) + "), " +
+                       glslFloat(orbit.semiMajorAxis * std::sqrt(1.0f - e * e)) + " * sin(E), 0.0)";
+        }
+
+        // The three element rotations as one matrix, with the shader's column-major layout
+        if (orbit.inclination != 0.0f || orbit.longAscNode != 0.0f || orbit.argPeriapsis != 0.0f) {
+            float cn = std::cos(orbit.longAscNode), sn = std::sin(orbit.longAscNode);
+            float ci = std::cos(orbit.inclination), si = std::sin(orbit.inclination);
+            float cp = std::cos(orbit.argPeriapsis), sp = std::sin(orbit.argPeriapsis);
+            glm::mat3 rotOmega(cn, -sn, 0.0f, sn, cn, 0.0f, 0.0f, 0.0f, 1.0f);
+            glm::mat3 rotI(1.0f, 0.0f, 0.0f, 0.0f, ci, -si, 0.0f, si, ci);
+            glm::mat3 rotOmegaPeri(cp, -sp, 0.0f, sp, cp, 0.0f, 0.0f, 0.0f, 1.0f);
+            glm::mat3 rotation = rotOmega * rotI * rotOmegaPeri;
+            std::string matrix = "mat3(";
+            for (int c = 0; c < 3; ++c) {
+                for (int r = 0; r < 3; ++r) {
+                    matrix += glslFloat(rotation[c][r]) + (c == 2 && r == 2 ? ")" : ", ");
+                }
+            }
+            position = matrix + " * " + position;
+        }
+        out << "        " << target << " = " << position << ";\n";
+        out << "    }\n";
+    }
+};
+
+void writeFile(const std::string& path, const void* data, size_t size) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!file) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+uint64_t fnv1a(uint64_t hash, const std::string& text) {
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// The compiled variants, named like the embedded ones so the directory works as a shader override
+struct SceneVariant {
+    const char* name;
+    const char* defines[2]; // glslc arguments, unused ones null
+};
+
+const SceneVariant sceneVariants[] = {
+    {"raymarch.frag.spv", {nullptr, nullptr}},
+    {"raymarch_fp16.frag.spv", {"-DFP16=1", nullptr}},
+    {"raymarch_multiview.frag.spv", {"-DMULTIVIEW=1", nullptr}},
+    {"raymarch_multiview_fp16.frag.spv", {"-DMULTIVIEW=1", "-DFP16=1"}},
+};
+
+// Runs the compiler with its arguments passed straight through, never via a shell, so quotes
+// or $ in the cache directory stay part of the path. stderr is appended to log. Returns true
+// if it exited with status 0.
+bool runCompiler(const std::vector<std::string>& args, const std::string& log) {
+    std::vector<char*> argv;
+    for (const std::string& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, log.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    pid_t pid;
+    // spawnp, so a bare scene.glslc=glslc is looked up on PATH
+    int result = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (result != 0) {
+        return false;
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+SceneDescription parseSceneFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Scene file not found: " + path);
+    }
+
+    SceneDescription scene;
+    scene.path = path;
+    std::vector<bool> used; // Per node, already the child of another
+    std::string rootName;
+    int rootLine = 0;
+
+    auto findNode = [&](const std::string& name) {
+        for (size_t i = 0; i < scene.nodes.size(); ++i) {
+            if (scene.nodes[i].name == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    };
+
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        ++lineNumber;
+        size_t comment = text.find('#');
+        if (comment != std::string::npos) {
+            text.erase(comment);
+        }
+        Statement statement;
+        statement.path = path;
+        statement.line = lineNumber;
+        std::istringstream words(text);
+        if (!(words >> statement.keyword)) {
+            continue;
+        }
+        for (std::string word; words >> word;) {
+            size_t equals = word.find('=');
+            if (equals == std::string::npos) {
+                statement.operands.push_back(word);
+            } else {
+                statement.params[word.substr(0, equals)] = word.substr(equals + 1);
+            }
+        }
+        const std::string& keyword = statement.keyword;
+        const std::vector<std::string>& operands = statement.operands;
+
+        if (keyword == "grid") {
+            if (operands.size() != 1 || (operands[0] != "on" && operands[0] != "off")) {
+                statement.fail("expected grid on or grid off");
+            }
+            scene.grid = operands[0] == "on";
+            statement.finish();
+            continue;
+        }
+        if (keyword == "scene") {
+            if (operands.size() != 1) {
+                statement.fail("expected scene NAME");
+            }
+            rootName = operands[0];
+            rootLine = lineNumber;
+            statement.finish();
+            continue;
+        }
+        if (operands.empty()) {
+            statement.fail(keyword + " needs a name");
+        }
+        const std::string& name = operands[0];
+
+        if (keyword == "material") {
+            if (operands.size() != 4) {
+                statement.fail("expected material NAME R G B");
+            }
+            for (const SceneMaterial& material : scene.materials) {
+                if (material.name == name) {
+                    statement.fail("material " + name + " is already defined");
+                }
+            }
+            glm::vec3 color(statement.toNumber(operands[1], "red"), statement.toNumber(operands[2], "green"),
+                            statement.toNumber(operands[3], "blue"));
+            scene.materials.push_back({name, color});
+            statement.finish();
+            continue;
+        }
+        if (keyword == "orbit") {
+            if (operands.size() != 1) {
+                statement.fail("orbit takes only a name and parameters");
+            }
+            for (const SceneOrbit& orbit : scene.orbits) {
+                if (orbit.name == name) {
+                    statement.fail("orbit " + name + " is already defined");
+                }
+            }
+            SceneOrbit orbit;
+            orbit.name = name;
+            orbit.semiMajorAxis = statement.required("semi_major");
+            orbit.eccentricity = statement.number("eccentricity", 0.0f);
+            orbit.inclination = statement.number("inclination", 0.0f);
+            orbit.longAscNode = statement.number("long_asc_node", 0.0f);
+            orbit.argPeriapsis = statement.number("arg_periapsis", 0.0f);
+            orbit.period = statement.required("period");
+            if (orbit.semiMajorAxis <= 0.0f || orbit.period <= 0.0f) {
+                statement.fail("semi_major and period must be positive");
+            }
+            if (orbit.eccentricity < 0.0f || orbit.eccentricity >= 1.0f) {
+                statement.fail("eccentricity must be in [0, 1)");
+            }
+            scene.orbits.push_back(orbit);
+            statement.finish();
+            continue;
+        }
+
+        SceneNode node;
+        node.name = name;
+        node.line = lineNumber;
+        if (findNode(name) >= 0) {
+            statement.fail(name + " is already defined");
+        }
+        if (keyword == "sphere" || keyword == "box" || keyword == "torus" || keyword == "plane") {
+            if (operands.size() != 1) {
+                statement.fail(keyword + " takes only a name and parameters");
+            }
+            if (keyword == "sphere") {
+                node.type = SceneNodeType::Sphere;
+                node.radius = statement.required("radius");
+            } else if (keyword == "box") {
+                node.type = SceneNodeType::Box;
+                node.size = statement.vector("size", glm::vec3(0.0f));
+                if (!statement.has("size")) {
+                    statement.fail("box needs size=");
+                }
+            } else if (keyword == "torus") {
+                node.type = SceneNodeType::Torus;
+                node.radius = statement.required("radius");
+                node.thickness = statement.required("thickness");
+            } else {
+                node.type = SceneNodeType::Plane;
+                glm::vec3 normal = statement.vector("normal", glm::vec3(0.0f, 1.0f, 0.0f));
+                if (glm::length(normal) == 0.0f) {
+                    statement.fail("plane normal must not be zero");
+                }
+                node.normal = glm::normalize(normal);
+                node.offset = statement.number("offset", 0.0f);
+            }
+            if (node.radius < 0.0f || node.thickness < 0.0f || glm::any(glm::lessThan(node.size, glm::vec3(0.0f)))) {
+                statement.fail(keyword + " sizes must not be negative");
+            }
+            if (node.type != SceneNodeType::Plane) {
+                node.center = statement.vector("at", glm::vec3(0.0f));
+                std::string orbitName = statement.word("orbit", "");
+                if (!orbitName.empty()) {
+                    for (size_t i = 0; i < scene.orbits.size(); ++i) {
+                        if (scene.orbits[i].name == orbitName) {
+                            node.orbit = static_cast<int>(i);
+                        }
+                    }
+                    if (node.orbit < 0) {
+                        statement.fail("unknown orbit " + orbitName);
+                    }
+                }
+            }
+            std::string materialName = statement.word("material", "");
+            if (!materialName.empty()) {
+                auto material = std::find_if(scene.materials.begin(), scene.materials.end(),
+                                             [&](const SceneMaterial& m) { return m.name == materialName; });
+                if (material == scene.materials.end()) {
+                    statement.fail("unknown material " + materialName);
+                }
+                node.color = material->color;
+            }
+        } else if (keyword == "union" || keyword == "smooth_union" || keyword == "intersect" || keyword == "subtract") {
+            node.type = keyword == "union"        ? SceneNodeType::Union
+                      : keyword == "smooth_union" ? SceneNodeType::SmoothUnion
+                      : keyword == "intersect"    ? SceneNodeType::Intersect
+                                                  : SceneNodeType::Subtract;
+            if (node.type == SceneNodeType::SmoothUnion) {
+                node.k = statement.required("k");
+                if (node.k <= 0.0f) {
+                    statement.fail("k must be positive");
+                }
+            }
+            if (operands.size() < 3) {
+                statement.fail(keyword + " needs at least two objects");
+            }
+            // Children must be defined first and belong to one parent, so the scene is a tree
+            for (size_t i = 1; i < operands.size(); ++i) {
+                int child = findNode(operands[i]);
+                if (child < 0) {
+                    statement.fail("unknown object " + operands[i]);
+                }
+                if (used[child]) {
+                    statement.fail(operands[i] + " is already part of another object");
+                }
+                used[child] = true;
+                node.children.push_back(child);
+            }
+        } else {
+            statement.fail("unknown statement " + keyword);
+        }
+        statement.finish();
+        scene.nodes.push_back(node);
+        used.push_back(false);
+    }
+
+    if (!rootName.empty()) {
+        scene.root = findNode(rootName);
+        if (scene.root < 0) {
+            throw std::runtime_error(path + ":" + std::to_string(rootLine) + ": unknown object " + rootName);
+        }
+    } else {
+        scene.root = static_cast<int>(scene.nodes.size()) - 1;
+    }
+    if (scene.root < 0) {
+        throw std::runtime_error(path + ": no objects");
+    }
+    return scene;
+}
+
+SceneGlsl generateSceneGlsl(const SceneDescription& scene) {
+    SceneWriter writer(scene);
+    SceneGlsl glsl = {};
+    writer.markOrbits(scene.root, glsl.primitives);
+    std::ostringstream& out = writer.out;
+
+    // Orbit positions are the same for every pixel
+    std::vector<int> slotOrbits(writer.usedOrbits);
+    for (size_t i = 0; i < scene.orbits.size(); ++i) {
+        if (writer.orbitSlots[i] >= 0) {
+            slotOrbits[writer.orbitSlots[i]] = static_cast<int>(i);
+        }
+    }
+    glsl.orbits = static_cast<uint32_t>(slotOrbits.size());
+    for (size_t slot = 0; slot < slotOrbits.size(); ++slot) {
+        out << "vec3 sceneOrbit" << slot << "; // " << scene.orbits[slotOrbits[slot]].name << ", set by prepareScene\n";
+    }
+    out << "\nvoid prepareScene() {\n";
+    for (size_t slot = 0; slot < slotOrbits.size(); ++slot) {
+        writer.emitOrbit(scene.orbits[slotOrbits[slot]], static_cast<int>(slot));
+    }
+    out << "}\n\n";
+
+    out << "float sceneDistance(vec3 p) {\n";
+    writer.nextVar = 0;
+    uint32_t distance = writer.emit(scene.root, false, true, "    ");
+    out << "    return d" << distance << ";\n";
+    out << "}\n\n";
+    glsl.bounds = writer.boundCount;
+
+    out << "// withGrid is false when the grid is traced analytically instead\n";
+    out << "SceneHit sceneSDF(vec3 p, bool withGrid) {\n";
+    writer.nextVar = 0;
+    uint32_t hit = writer.emit(scene.root, true, false, "    ");
+    if (scene.grid) {
+        out << "    if (withGrid) {\n";
+        out << "        float gridDist = gridSDF(p);\n";
+        out << "        if (gridDist <= d" << hit << ") {\n";
+        out << "            return SceneHit(gridDist, GRID_COLOR, OBJECT_GRID);\n";
+        out << "        }\n";
+        out << "    }\n";
+    }
+    out << "    return SceneHit(d" << hit << ", c" << hit << ", OBJECT_SOLID);\n";
+    out << "}\n\n";
+
+    out << "// Distance the march steps by at p\n";
+    out << "float marchDistance(vec3 p, bool withGrid) {\n";
+    if (scene.grid) {
+        out << "    float dist = sceneDistance(p);\n";
+        out << "    return withGrid ? min(dist, gridSDF(p)) : dist;\n";
+    } else {
+        out << "    return sceneDistance(p);\n";
+    }
+    out << "}\n";
+
+    std::ostringstream header;
+    header << "// Generated from " << std::filesystem::path(scene.path).filename().string() << " by gridfire, do not edit\n";
+    header << "const bool SCENE_GRID = " << (scene.grid ? "true" : "false") << ";\n";
+    if (glsl.bounds > 0) {
+        header << "// Bounding spheres are only stepped by while the march is further than this from them\n";
+        header << "const float SCENE_BOUND_MARGIN = 1.0;\n";
+    }
+    header << "\n";
+    glsl.source = header.str() + out.str();
+    return glsl;
+}
+
+SceneShaders compileScene(const std::string& path, const std::string& cacheDir, const std::string& glslc) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SceneShaders shaders;
+    shaders.glsl = generateSceneGlsl(parseSceneFile(path));
+
+    std::string raymarchSource(reinterpret_cast<const char*>(raymarch_frag_glsl), sizeof(raymarch_frag_glsl) - 1);
+    std::string bindlessSource(reinterpret_cast<const char*>(bindless_glsl), sizeof(bindless_glsl) - 1);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = fnv1a(hash, shaders.glsl.source);
+    hash = fnv1a(hash, raymarchSource);
+    hash = fnv1a(hash, bindlessSource);
+    shaders.hash = hash;
+    char hashName[17];
+    std::snprintf(hashName, sizeof(hashName), "%016llx", static_cast<unsigned long long>(hash));
+    shaders.dir = cacheDir + "/" + hashName;
+
+    std::error_code error;
+    shaders.cached = std::filesystem::exists(shaders.dir + "/raymarch.vert.spv", error);
+    for (const SceneVariant& variant : sceneVariants) {
+        shaders.cached = shaders.cached && std::filesystem::exists(shaders.dir + "/" + variant.name, error);
+    }
+    if (!shaders.cached) {
+        std::filesystem::create_directories(shaders.dir, error);
+        if (error) {
+            throw std::runtime_error("Failed to create " + shaders.dir + ": " + error.message());
+        }
+        writeFile(shaders.dir + "/raymarch.frag", raymarchSource.data(), raymarchSource.size());
+        writeFile(shaders.dir + "/bindless.glsl", bindlessSource.data(), bindlessSource.size());
+        writeFile(shaders.dir + "/scene.glsl", shaders.glsl.source.data(), shaders.glsl.source.size());
+        // The vertex stage does not depend on the scene, but the override directory needs it
+        writeFile(shaders.dir + "/raymarch.vert.spv", raymarch_vert_spv, sizeof(raymarch_vert_spv));
+
+        // Each variant is compiled to a temporary name first, so an interrupted run is never taken
+        // for a cached one
+        std::string compiler = glslc.empty() ? GRIDFIRE_GLSLC : glslc;
+        std::string log = shaders.dir + "/glslc.log";
+        std::filesystem::remove(log, error);
+        for (const SceneVariant& variant : sceneVariants) {
+            std::string output = shaders.dir + "/" + variant.name;
+            std::vector<std::string> args = {compiler, "-DSCENE_FILE=1"};
+            for (const char* define : variant.defines) {
+                if (define) {
+                    args.push_back(define);
+                }
+            }
+            args.insert(args.end(), {shaders.dir + "/raymarch.frag", "-o", output + ".tmp"});
+            if (!runCompiler(args, log)) {
+                throw std::runtime_error("glslc failed to compile " + std::string(variant.name) + ", see " + log);
+            }
+            std::filesystem::rename(output + ".tmp", output, error);
+            if (error) {
+                throw std::runtime_error("Failed to write " + output + ": " + error.message());
+            }
+        }
+    }
+    shaders.compileSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return shaders;
+}
+
+std::string getSceneCacheDir() {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if (xdg && *xdg) {
+        return std::string(xdg) + "/gridfire/scenes";
+    }
+    const char* home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.cache/gridfire/scenes";
+}
+
+int runSceneBenchmark(std::ostream& out, const RenderSettings& settings, float fov, const std::string& gpuSelection,
+                      bool forceVulkan10, const std::string& path, const std::string& cacheDir, const std::string& glslc) {
+    using Clock = std::chrono::steady_clock;
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    const uint32_t frames = 120;
+    const TileRect frame = {0, 0, width, height};
+
+    // The precision benchmark's orbit around the scene
+    auto pathCamera = [&](uint32_t index) {
+        float angle = glm::two_pi<float>() * index / frames;
+        Camera camera;
+        camera.position = glm::vec3(7.0f * std::sin(angle), 1.5f, 7.0f * std::cos(angle));
+        camera.forward = glm::normalize(-camera.position);
+        glm::vec3 right = glm::normalize(glm::cross(camera.forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        camera.up = glm::cross(right, camera.forward);
+        camera.view = glm::lookAt(camera.position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        camera.proj = perspectiveProjection(fov, static_cast<float>(width) / height);
+        return camera;
+    };
+
+    struct Run {
+        const char* name;
+        std::unique_ptr<TileRenderer> renderer;
+        std::vector<double> gpuMs;
+        double wallSeconds = 0.0;
+        std::vector<uint8_t> pixels;
+    };
+
+    if (path.empty()) {
+        std::cerr << "The scene benchmark needs a scene file: set [scene] file, e.g. to resources/scene.txt" << std::endl;
+        return 1;
+    }
+
+    try {
+        SceneShaders shaders = compileScene(path, cacheDir, glslc);
+        char line[256];
+        std::snprintf(line, sizeof(line), "Scene %s: %u primitives, %u orbits, %u bounds; %s in %.1f ms (%016llx)", path.c_str(),
+                      shaders.glsl.primitives, shaders.glsl.orbits, shaders.glsl.bounds, shaders.cached ? "cached" : "compiled",
+                      shaders.compileSeconds * 1000.0, static_cast<unsigned long long>(shaders.hash));
+        out << line << std::endl;
+
+        Device device(nullptr, gpuSelection, forceVulkan10);
+        MemoryAllocator allocator(device);
+        ResourceTable resources(device);
+        Run runs[2];
+        runs[0].name = "built-in";
+        runs[0].renderer = std::make_unique<TileRenderer>(device, allocator, resources, width);
+        runs[1].name = "scene file";
+        runs[1].renderer = std::make_unique<TileRenderer>(device, allocator, resources, width, shaders.dir);
+
+        const Pipeline& builtin = runs[0].renderer->pipeline;
+        bool fp16 = builtin.select(settings.shaderPrecision) == builtin.fp16Pipeline;
+        std::snprintf(line, sizeof(line), "Scene shader, %ux%u, %u frames, %s grid, %s march, %s on %s", width, height, frames,
+                      gridModeName(settings.gridMode), marchStrategyName(settings.marchStrategy), fp16 ? "fp16" : "fp32",
+                      device.properties.deviceName);
+        out << line << std::endl;
+        if (runs[0].renderer->timestampPool == VK_NULL_HANDLE) {
+            out << "  No GPU timestamps on the graphics queue; only wall times are reported" << std::endl;
+        }
+
+        // Warm up both pipelines, then alternate per frame so the two see the same clocks and heat
+        for (Run& run : runs) {
+            run.renderer->render(pathCamera(0), 0.0f, settings, width, height, frame, run.pixels);
+        }
+        uint64_t differing = 0;
+        uint64_t errorSum = 0;
+        int errorMax = 0;
+        for (uint32_t i = 0; i < frames; ++i) {
+            Camera camera = pathCamera(i);
+            float time = i / 30.0f;
+            for (Run& run : runs) {
+                Clock::time_point start = Clock::now();
+                run.renderer->render(camera, time, settings, width, height, frame, run.pixels);
+                run.wallSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+                run.gpuMs.push_back(run.renderer->drawSeconds * 1000.0);
+            }
+            // Largest channel difference per pixel; alpha is always 1
+            for (size_t p = 0; p < runs[0].pixels.size(); p += 4) {
+                int error = 0;
+                for (size_t c = 0; c < 3; ++c) {
+                    error = std::max(error, std::abs(int(runs[0].pixels[p + c]) - int(runs[1].pixels[p + c])));
+                }
+                errorSum += error;
+                errorMax = std::max(errorMax, error);
+                differing += error > 8 ? 1 : 0;
+            }
+        }
+
+        std::snprintf(line, sizeof(line), "  %-10s %12s %12s %12s %8s", "shader", "gpu ms mean", "gpu ms p95", "wall ms", "speedup");
+        out << line << std::endl;
+        double builtinMean = 0.0;
+        for (Run& run : runs) {
+            double mean = 0.0;
+            for (double ms : run.gpuMs) {
+                mean += ms;
+            }
+            mean /= run.gpuMs.size();
+            std::sort(run.gpuMs.begin(), run.gpuMs.end());
+            double p95 = run.gpuMs[std::min(run.gpuMs.size() - 1, run.gpuMs.size() * 95 / 100)];
+            if (&run == &runs[0]) {
+                builtinMean = mean;
+            }
+            std::snprintf(line, sizeof(line), "  %-10s %12.3f %12.3f %12.3f %7.2fx", run.name, mean, p95,
+                          run.wallSeconds * 1000.0 / frames, mean > 0.0 ? builtinMean / mean : 0.0);
+            out << line << std::endl;
+        }
+
+        double pixels = static_cast<double>(width) * height * frames;
+        std::snprintf(line, sizeof(line), "  scene file vs built-in: mean error %.3f, max %d (of 255), %.3f%% of pixels off by more than 8",
+                      errorSum / pixels, errorMax, differing * 100.0 / pixels);
+        out << line << std::endl;
+        device.waitIdle();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "settings.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Scene files describe what the raymarcher draws instead of the sceneSDF written into
+// raymarch.frag: primitives, boolean and smooth unions, materials and Kepler orbits, one
+// statement per line (see resources/scene.txt). They are compiled into a scene.glsl with
+// every constant folded, static subtrees behind bounding spheres and unused features left
+// out, spliced into the embedded raymarch source and turned into SPIR-V by glslc.
+
+struct SceneMaterial {
+    std::string name;
+    glm::vec3 color;
+};
+
+// Orbit around the origin, with the elements of the cube's orbit in raymarch.frag
+struct SceneOrbit {
+    std::string name;
+    float semiMajorAxis;
+    float eccentricity;
+    float inclination;  // Radians
+    float longAscNode;  // Radians
+    float argPeriapsis; // Radians
+    float period;       // Seconds
+};
+
+enum class SceneNodeType {
+    Sphere,
+    Box,
+    Torus, // Around the Y axis
+    Plane,
+    Union,
+    SmoothUnion,
+    Intersect,
+    Subtract // The first child with the others carved out
+};
+
+struct SceneNode {
+    SceneNodeType type;
+    std::string name;
+    int line; // In the scene file, for errors
+    // Primitives
+    glm::vec3 center = glm::vec3(0.0f); // Relative to the orbit position, if any
+    int orbit = -1;                     // Index into SceneDescription::orbits
+    glm::vec3 color = glm::vec3(0.8f);
+    float radius = 0.0f;                // Sphere; torus ring
+    float thickness = 0.0f;             // Torus tube radius
+    glm::vec3 size = glm::vec3(0.0f);   // Box edge lengths
+    glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f); // Plane, unit length
+    float offset = 0.0f;                // Plane distance from the origin along normal
+    // Operators
+    float k = 0.0f;            // Smooth union blend width
+    std::vector<int> children; // Indices into SceneDescription::nodes, defined before this node
+};
+
+struct SceneDescription {
+    std::string path;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneOrbit> orbits;
+    std::vector<SceneNode> nodes;
+    int root = -1; // The scene statement's node, or the last one defined
+    bool grid = true;
+};
+
+// Throws std::runtime_error naming the file and line on malformed input
+SceneDescription parseSceneFile(const std::string& path);
+
+struct SceneGlsl {
+    std::string source;
+    uint32_t primitives; // Reachable from the root; nodes defined but unused are dropped
+    uint32_t orbits;     // Solved once per pixel in prepareScene
+    uint32_t bounds;     // Static subtrees skipped while the march is far from them
+};
+
+SceneGlsl generateSceneGlsl(const SceneDescription& scene);
+
+// A compiled scene: a shader directory to pass as Pipeline's shaderOverrideDir, holding
+// every raymarch variant, named like the embedded ones
+struct SceneShaders {
+    std::string dir; // Empty when no scene file is in use
+    uint64_t hash = 0;
+    bool cached = false; // Found under the hash, glslc did not run
+    double compileSeconds = 0.0;
+    SceneGlsl glsl;
+};
+
+// Parses and compiles a scene file into cacheDir/<hash>, where the hash covers the generated
+// code and the raymarch source, so an unchanged scene is only compiled once per build.
+// glslc empty uses the compiler the executable was built with. Throws std::runtime_error.
+SceneShaders compileScene(const std::string& path, const std::string& cacheDir, const std::string& glslc);
+
+std::string getSceneCacheDir(); // $XDG_CACHE_HOME/gridfire/scenes or ~/.cache/gridfire/scenes
+
+// Renders the precision benchmark's camera path with the built-in shader and the compiled
+// scene file on a headless device and prints GPU draw times, the speedup and how far the
+// images are apart (only expected to match for a file describing the built-in scene).
+// Returns the exit code.
+int runSceneBenchmark(std::ostream& out, const RenderSettings& settings, float fov, const std::string& gpuSelection,
+                      bool forceVulkan10, const std::string& path, const std::string& cacheDir, const std::string& glslc);
@@ -0,0 +1,192 @@
+#include "scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+FrameScheduler::FrameScheduler(const Device& device)
+    : device(device), timeline(device.timelineSemaphore), semaphores{}, submitted{}, completed{}, frameNumber(0),
+      frameWaitSeconds(0.0), totalWaitSeconds(0.0), blockingWaits(0) {
+    if (!timeline) {
+        return;
+    }
+    VkSemaphoreTypeCreateInfo typeInfo = {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    for (VkSemaphore& semaphore : semaphores) {
+        if (vkCreateSemaphore(device.device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timeline semaphore");
+        }
+    }
+}
+
+FrameScheduler::~FrameScheduler() {
+    // The device is idle by now, so every pending release can run
+    for (PendingRelease& pending : releases) {
+        pending.release();
+    }
+    for (VkSemaphore semaphore : semaphores) {
+        vkDestroySemaphore(device.device, semaphore, nullptr);
+    }
+    for (std::deque<SubmitFence>& queueFences : fences) {
+        for (SubmitFence& submitFence : queueFences) {
+            vkDestroyFence(device.device, submitFence.fence, nullptr);
+        }
+    }
+    for (VkFence fence : freeFences) {
+        vkDestroyFence(device.device, fence, nullptr);
+    }
+}
+
+uint64_t FrameScheduler::submit(QueueType queue, const std::vector<VkCommandBuffer>& commandBuffers,
+                                const std::vector<VkSemaphore>& waitSemaphores, const std::vector<VkPipelineStageFlags>& waitStages,
+                                const std::vector<TimelineWait>& timelineWaits, const std::vector<VkSemaphore>& signalSemaphores) {
+    uint32_t index = static_cast<uint32_t>(queue);
+    uint64_t value = submitted[index] + 1;
+
+    // Binary semaphores take a value too, which is ignored
+    std::vector<VkSemaphore> waits = waitSemaphores;
+    std::vector<VkPipelineStageFlags> stages = waitStages;
+    std::vector<uint64_t> waitValues(waits.size(), 0);
+    if (!timelineWaits.empty() && !timeline) {
+        throw std::runtime_error("Waiting on another queue needs timeline semaphores");
+    }
+    for (const TimelineWait& wait : timelineWaits) {
+        waits.push_back(semaphores[static_cast<uint32_t>(wait.queue)]);
+        stages.push_back(wait.stage);
+        waitValues.push_back(wait.value);
+    }
+    std::vector<VkSemaphore> signals = signalSemaphores;
+    std::vector<uint64_t> signalValues(signals.size(), 0);
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (timeline) {
+        signals.push_back(semaphores[index]);
+        signalValues.push_back(value);
+    } else if (!freeFences.empty()) {
+        fence = freeFences.back();
+        freeFences.pop_back();
+    } else {
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device.device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create submit fence");
+        }
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = timeline ? &timelineInfo : nullptr;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waits.size());
+    submitInfo.pWaitSemaphores = waits.data();
+    submitInfo.pWaitDstStageMask = stages.data();
+    submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    submitInfo.pCommandBuffers = commandBuffers.data();
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signals.size());
+    submitInfo.pSignalSemaphores = signals.data();
+
+    if (vkQueueSubmit(device.getQueue(queue), 1, &submitInfo, fence) != VK_SUCCESS) {
+        if (fence != VK_NULL_HANDLE) {
+            freeFences.push_back(fence);
+        }
+        throw std::runtime_error("Failed to submit command buffer");
+    }
+    submitted[index] = value;
+    if (!timeline) {
+        fences[index].push_back({value, fence});
+    }
+    return value;
+}
+
+void FrameScheduler::retireFences(uint32_t queue, uint64_t waitValue) {
+    while (!fences[queue].empty()) {
+        SubmitFence& front = fences[queue].front();
+        if (front.value <= waitValue) {
+            vkWaitForFences(device.device, 1, &front.fence, VK_TRUE, UINT64_MAX);
+        } else if (vkGetFenceStatus(device.device, front.fence) != VK_SUCCESS) {
+            break;
+        }
+        completed[queue] = front.value;
+        vkResetFences(device.device, 1, &front.fence);
+        freeFences.push_back(front.fence);
+        fences[queue].pop_front();
+    }
+}
+
+bool FrameScheduler::isComplete(QueueType queue, uint64_t value) {
+    uint32_t index = static_cast<uint32_t>(queue);
+    if (value <= completed[index]) {
+        return true;
+    }
+    if (timeline) {
+        uint64_t current;
+        if (device.getSemaphoreCounterValue(device.device, semaphores[index], &current) == VK_SUCCESS) {
+            completed[index] = std::max(completed[index], current);
+        }
+    } else {
+        retireFences(index, 0);
+    }
+    return value <= completed[index];
+}
+
+void FrameScheduler::wait(QueueType queue, uint64_t value) {
+    if (isComplete(queue, value)) {
+        return;
+    }
+    uint32_t index = static_cast<uint32_t>(queue);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (timeline) {
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphores[index];
+        waitInfo.pValues = &value;
+        if (device.waitSemaphores(device.device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to wait for timeline semaphore");
+        }
+        completed[index] = std::max(completed[index], value);
+    } else {
+        retireFences(index, value);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    frameWaitSeconds += seconds;
+    totalWaitSeconds += seconds;
+    ++blockingWaits;
+}
+
+void FrameScheduler::waitIdle() {
+    for (uint32_t index = 0; index < QUEUE_COUNT; ++index) {
+        wait(static_cast<QueueType>(index), submitted[index]);
+    }
+}
+
+void FrameScheduler::release(QueueType queue, uint64_t value, std::function<void()> release) {
+    releases.push_back({queue, value, std::move(release)});
+}
+
+void FrameScheduler::collect() {
+    for (auto it = releases.begin(); it != releases.end();) {
+        if (isComplete(it->queue, it->value)) {
+            it->release();
+            it = releases.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void FrameScheduler::beginFrame() {
+    ++frameNumber;
+    frameWaitSeconds = 0.0;
+    collect();
+}
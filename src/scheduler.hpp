@@ -0,0 +1,72 @@
+#pragma once
+#include "device.hpp"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// GPU work on another queue that a submit waits for, by timeline value
+struct TimelineWait {
+    QueueType queue;
+    uint64_t value;
+    VkPipelineStageFlags stage;
+};
+
+// Tracks GPU progress per queue by submission count. With device.timelineSemaphore each
+// QueueType has a timeline semaphore that every submit to it signals with the next value,
+// so the CPU and the other queues can wait for any earlier submit by its value, and
+// per-frame resources need no fences of their own. The Vulkan 1.0 path has no timelines:
+// each submit gets a fence from a pool instead, retired in order, and cross-queue waits
+// are unavailable.
+struct FrameScheduler {
+    static constexpr uint32_t QUEUE_COUNT = 3; // One timeline per QueueType
+
+    const Device& device;
+    bool timeline;
+    VkSemaphore semaphores[QUEUE_COUNT]; // VK_NULL_HANDLE without timelines
+    uint64_t submitted[QUEUE_COUNT];     // Value signalled by the last submit
+    uint64_t completed[QUEUE_COUNT];     // Highest value known to be reached
+    uint64_t frameNumber;                // Frames begun
+    double frameWaitSeconds;             // CPU time blocked in wait() since beginFrame
+    double totalWaitSeconds;
+    uint64_t blockingWaits; // wait() calls that found the GPU behind
+
+    explicit FrameScheduler(const Device& device);
+    ~FrameScheduler();
+
+    // Submits to queue after the binary waitSemaphores (e.g. swapchain acquire) and the
+    // timeline waits, signals the binary signalSemaphores (e.g. for present), and returns the
+    // queue's timeline value the submit reaches once complete
+    uint64_t submit(QueueType queue, const std::vector<VkCommandBuffer>& commandBuffers,
+                    const std::vector<VkSemaphore>& waitSemaphores, const std::vector<VkPipelineStageFlags>& waitStages,
+                    const std::vector<TimelineWait>& timelineWaits, const std::vector<VkSemaphore>& signalSemaphores);
+    bool isComplete(QueueType queue, uint64_t value);
+    // Blocks until queue has reached value
+    void wait(QueueType queue, uint64_t value);
+    void waitIdle(); // Every queue's last submit
+
+    // Calls release from a later collect() once queue has reached value, e.g. to destroy a
+    // resource the GPU may still be reading
+    void release(QueueType queue, uint64_t value, std::function<void()> release);
+    void collect();
+    // Starts the next frame's wait accounting and runs collect()
+    void beginFrame();
+
+private:
+    struct SubmitFence {
+        uint64_t value;
+        VkFence fence;
+    };
+    struct PendingRelease {
+        QueueType queue;
+        uint64_t value;
+        std::function<void()> release;
+    };
+
+    void retireFences(uint32_t queue, uint64_t waitValue); // Fallback; blocks until waitValue, 0 to only poll
+
+    std::deque<SubmitFence> fences[QUEUE_COUNT]; // Fallback: unretired submits in order
+    std::vector<VkFence> freeFences;
+    std::deque<PendingRelease> releases;
+};
@@ -0,0 +1,291 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+enum MarchStrategy : uint32_t {
+    MARCH_STANDARD = 0, // Plain sphere tracing
+    MARCH_RELAXED = 1,  // Over-relaxed sphere tracing with fallback (Keinert et al.)
+    MARCH_ADAPTIVE = 2, // Hit epsilon grows with distance (pixel footprint)
+    MARCH_STRATEGY_COUNT
+};
+
+// How the infinite grid is found; the dynamic objects are always sphere traced
+enum GridMode : uint32_t {
+    GRID_SDF = 0,      // Part of the scene SDF (mod domain repetition), marched with everything else
+    GRID_ANALYTIC = 1, // Cell walk along the ray with exact ray/cylinder tests, merged by nearest hit
+    GRID_COMPARE = 2,  // Split screen: SDF on the left, analytic on the right
+    GRID_MODE_COUNT
+};
+
+// Anti-aliasing of the raymarch. Adaptive traces one ray per pixel, flags pixels whose
+// neighbours differ in object or depth, and supersamples only those in a second pass.
+enum AaMode : uint32_t {
+    AA_OFF = 0,
+    AA_ADAPTIVE = 1,
+    AA_SHOW_EDGES = 2, // Adaptive, with the supersampled pixels tinted
+    AA_MODE_COUNT
+};
+
+// Arithmetic precision of the raymarch shader. fp16 marches near the camera and shades in
+// half precision (raymarch_fp16.frag); it needs shaderFloat16 and falls back to fp32 without.
+enum ShaderPrecision : uint32_t {
+    SHADER_PRECISION_AUTO = 0, // fp16 when the device supports it
+    SHADER_PRECISION_FP32 = 1,
+    SHADER_PRECISION_FP16 = 2,
+    SHADER_PRECISION_COUNT
+};
+
+// Rasterized meshes composited with the raymarched scene through a depth buffer. Fixed at
+// startup, since the scene pipelines and render passes are built for it.
+enum RasterMode : uint32_t {
+    RASTER_OFF = 0,
+    RASTER_DEPTH = 1,   // The march writes its hit depth; meshes are drawn after it, depth tested
+    RASTER_PREPASS = 2, // Meshes first; rays stop at the rasterized depth and are tested against it
+    RASTER_MODE_COUNT
+};
+
+// Stereo output: each eye is rendered into one layer of a two-layer target at half the window
+// width, and the layers are shown side by side. Fixed at startup like RasterMode.
+enum StereoMode : uint32_t {
+    STEREO_OFF = 0,
+    STEREO_TWO_PASS = 1,  // One render pass and draw per eye
+    STEREO_MULTIVIEW = 2, // Both eyes in one pass (VK_KHR_multiview); the shader picks its eye by gl_ViewIndex
+    STEREO_MODE_COUNT
+};
+
+// RenderSettings::fpsLimit values besides a frame rate
+constexpr float FPS_LIMIT_OFF = 0.0f;
+constexpr float FPS_LIMIT_REFRESH = -1.0f; // Follow the refresh rate of the window's monitor
+
+// Performance knobs that can change at runtime without rebuilding pipelines
+struct RenderSettings {
+    int maxSteps = 100;
+    float epsilon = 0.001f;
+    float farDistance = 400.0f;
+    float renderScale = 1.0f;
+    uint32_t marchStrategy = MARCH_STANDARD;
+    uint32_t gridMode = GRID_ANALYTIC;
+    uint32_t aaMode = AA_OFF;
+    int aaSamples = 4; // Extra rays per flagged pixel, 2 to 16
+    uint32_t shaderPrecision = SHADER_PRECISION_AUTO;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    uint32_t framesInFlight = 2;
+    float fpsLimit = FPS_LIMIT_OFF; // Frame rate cap, or FPS_LIMIT_REFRESH
+    bool stepHistogram = false;
+    bool dirtyRegions = false; // While the camera is still, re-march only around moving objects
+    bool cpuRender = false;    // March on the CPU (SIMD, multithreaded) and upload the image
+};
+
+// Keeps the march knobs in ranges the shaders can use: with a zero or negative epsilon no ray
+// ever counts as a hit and each one runs to the step cap, and with no far distance every ray
+// gives up before reaching anything. fmax/fmin also replace NaN, which a settings file or a
+// farm message can carry.
+inline void clampMarchSettings(RenderSettings& settings) {
+    settings.maxSteps = std::clamp(settings.maxSteps, 1, 65536);
+    settings.epsilon = std::fmin(std::fmax(settings.epsilon, 1e-6f), 1.0f);
+    settings.farDistance = std::fmin(std::fmax(settings.farDistance, 1.0f), 1e6f);
+}
+
+inline const char* marchStrategyName(uint32_t strategy) {
+    switch (strategy) {
+        case MARCH_STANDARD: return "standard";
+        case MARCH_RELAXED: return "relaxed";
+        case MARCH_ADAPTIVE: return "adaptive";
+        default: return "unknown";
+    }
+}
+
+inline const char* gridModeName(uint32_t mode) {
+    switch (mode) {
+        case GRID_SDF: return "sdf";
+        case GRID_ANALYTIC: return "analytic";
+        case GRID_COMPARE: return "compare";
+        default: return "unknown";
+    }
+}
+
+inline const char* aaModeName(uint32_t mode) {
+    switch (mode) {
+        case AA_OFF: return "off";
+        case AA_ADAPTIVE: return "adaptive";
+        case AA_SHOW_EDGES: return "edges";
+        default: return "unknown";
+    }
+}
+
+inline const char* shaderPrecisionName(uint32_t precision) {
+    switch (precision) {
+        case SHADER_PRECISION_AUTO: return "auto";
+        case SHADER_PRECISION_FP32: return "fp32";
+        case SHADER_PRECISION_FP16: return "fp16";
+        default: return "unknown";
+    }
+}
+
+inline const char* rasterModeName(uint32_t mode) {
+    switch (mode) {
+        case RASTER_OFF: return "off";
+        case RASTER_DEPTH: return "depth";
+        case RASTER_PREPASS: return "prepass";
+        default: return "unknown";
+    }
+}
+
+inline const char* stereoModeName(uint32_t mode) {
+    switch (mode) {
+        case STEREO_OFF: return "off";
+        case STEREO_TWO_PASS: return "twopass";
+        case STEREO_MULTIVIEW: return "multiview";
+        default: return "unknown";
+    }
+}
+
+inline const char* presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+        default: return "unknown";
+    }
+}
+
+inline std::string fpsLimitName(float limit) {
+    if (limit == FPS_LIMIT_REFRESH) {
+        return "refresh";
+    }
+    if (limit <= 0.0f) {
+        return "off";
+    }
+    char text[32];
+    snprintf(text, sizeof(text), "%g", limit);
+    return text;
+}
+
+// "off", "refresh" or a positive frame rate; returns false if not recognised
+inline bool parseFpsLimit(const char* text, float& limit) {
+    if (strcmp(text, "off") == 0 || strcmp(text, "0") == 0) {
+        limit = FPS_LIMIT_OFF;
+        return true;
+    }
+    if (strcmp(text, "refresh") == 0) {
+        limit = FPS_LIMIT_REFRESH;
+        return true;
+    }
+    char* end = nullptr;
+    float value = strtof(text, &end);
+    if (end == text || *end != '\0' || !(value > 0.0f)) {
+        return false;
+    }
+    limit = value;
+    return true;
+}
+
+// Returns false if the name is not recognised
+inline bool parsePresentMode(const char* name, VkPresentModeKHR& mode) {
+    const VkPresentModeKHR modes[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+                                      VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+    for (VkPresentModeKHR candidate : modes) {
+        if (strcmp(name, presentModeName(candidate)) == 0) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parseMarchStrategy(const char* name, uint32_t& strategy) {
+    for (uint32_t i = 0; i < MARCH_STRATEGY_COUNT; ++i) {
+        if (strcmp(name, marchStrategyName(i)) == 0) {
+            strategy = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parseGridMode(const char* name, uint32_t& mode) {
+    for (uint32_t i = 0; i < GRID_MODE_COUNT; ++i) {
+        if (strcmp(name, gridModeName(i)) == 0) {
+            mode = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parseAaMode(const char* name, uint32_t& mode) {
+    for (uint32_t i = 0; i < AA_MODE_COUNT; ++i) {
+        if (strcmp(name, aaModeName(i)) == 0) {
+            mode = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parseShaderPrecision(const char* name, uint32_t& precision) {
+    for (uint32_t i = 0; i < SHADER_PRECISION_COUNT; ++i) {
+        if (strcmp(name, shaderPrecisionName(i)) == 0) {
+            precision = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parseRasterMode(const char* name, uint32_t& mode) {
+    for (uint32_t i = 0; i < RASTER_MODE_COUNT; ++i) {
+        if (strcmp(name, rasterModeName(i)) == 0) {
+            mode = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parseStereoMode(const char* name, uint32_t& mode) {
+    for (uint32_t i = 0; i < STEREO_MODE_COUNT; ++i) {
+        if (strcmp(name, stereoModeName(i)) == 0) {
+            mode = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Quality presets set the march knobs and render scale; explicit config keys override them.
+// "high" matches the built-in defaults. Returns false if the name is not recognised.
+inline bool applyQualityPreset(const char* name, RenderSettings& settings) {
+    struct Preset {
+        const char* name;
+        int maxSteps;
+        float epsilon;
+        float farDistance;
+        float renderScale;
+        uint32_t marchStrategy;
+    };
+    static const Preset presets[] = {
+        {"low", 64, 0.004f, 150.0f, 0.5f, MARCH_RELAXED},
+        {"medium", 96, 0.002f, 250.0f, 0.75f, MARCH_RELAXED},
+        {"high", 100, 0.001f, 400.0f, 1.0f, MARCH_STANDARD},
+        {"ultra", 256, 0.0005f, 800.0f, 1.0f, MARCH_STANDARD},
+    };
+    for (const Preset& preset : presets) {
+        if (strcmp(name, preset.name) == 0) {
+            settings.maxSteps = preset.maxSteps;
+            settings.epsilon = preset.epsilon;
+            settings.farDistance = preset.farDistance;
+            settings.renderScale = preset.renderScale;
+            settings.marchStrategy = preset.marchStrategy;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,29 @@
+// Global resource table (set 1), filled by ResourceTable in resources.hpp.
+// Array sizes are specialization constants set to the device-dependent capacities;
+// the constant_id matches the binding number.
+layout(constant_id = 0) const uint MAX_TEXTURES = 1;
+layout(constant_id = 1) const uint MAX_VOLUMES = 1;
+layout(constant_id = 2) const uint MAX_STORAGE_BUFFERS = 1;
+layout(constant_id = 3) const uint MAX_STORAGE_IMAGES = 1;
+
+const uint INVALID_RESOURCE = 0xFFFFFFFFu;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[MAX_TEXTURES];
+layout(set = 1, binding = 1) uniform sampler3D volumes[MAX_VOLUMES];
+layout(set = 1, binding = 2) readonly buffer ResourceBuffer {
+    vec4 data[];
+} buffers[MAX_STORAGE_BUFFERS];
+layout(set = 1, binding = 3, rgba16f) uniform image2D storageImages[MAX_STORAGE_IMAGES];
+
+// IDs come from scene data and are dynamically uniform, so no nonuniformEXT is needed
+vec4 sampleTexture(uint id, vec2 uv) {
+    return texture(textures[id], uv);
+}
+
+float sampleVolume(uint id, vec3 uvw) {
+    return texture(volumes[id], uvw).r;
+}
+
+vec4 loadBuffer(uint id, uint element) {
+    return buffers[id].data[element];
+}
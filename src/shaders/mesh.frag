@@ -0,0 +1,19 @@
+#version 450
+layout(location = 0) in vec3 worldPos;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec3 color;
+layout(location = 0) out vec4 outColor;
+
+layout(push_constant) uniform MeshConstants {
+    mat4 viewProj;
+    vec4 camPos;
+} mesh;
+
+void main() {
+    // Same light and fog as raymarch.frag, so meshes sit in the marched scene
+    vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
+    float diffuse = max(dot(normalize(normal), lightDir), 0.0);
+    vec3 litColor = color * (diffuse * 0.8 + 0.2);
+    float fogAmount = 1.0 - exp(-0.01 * distance(worldPos, mesh.camPos.xyz));
+    outColor = vec4(mix(litColor, vec3(1.0), fogAmount), 1.0);
+}
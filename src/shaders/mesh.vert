@@ -0,0 +1,21 @@
+#version 450
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inColor;
+
+layout(location = 0) out vec3 worldPos;
+layout(location = 1) out vec3 normal;
+layout(location = 2) out vec3 color;
+
+// Must match MeshConstants in mesh.hpp
+layout(push_constant) uniform MeshConstants {
+    mat4 viewProj; // Framed like the raymarch's rays, so both agree on every pixel and depth
+    vec4 camPos;
+} mesh;
+
+void main() {
+    worldPos = inPosition;
+    normal = inNormal;
+    color = inColor;
+    gl_Position = mesh.viewProj * vec4(inPosition, 1.0);
+}
@@ -1,14 +1,108 @@
 #version 450
+// Built as is, and with -DFP16 into raymarch_fp16.frag.spv for devices with shaderFloat16.
+// mfloat/mvec* are float16 there and plain float otherwise; they cover shading and the SDF
+// near the camera, while t and far-field distances stay fp32. Both are also built with
+// -DMULTIVIEW for single-pass stereo, where the eye comes from gl_ViewIndex. With -DSCENE_FILE
+// the scene comes from the scene.glsl next to it, generated from a scene file at runtime.
+#ifdef MULTIVIEW
+#extension GL_EXT_multiview : require
+#endif
+#ifdef FP16
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+#define mfloat float16_t
+#define mvec2 f16vec2
+#define mvec3 f16vec3
+#define mvec4 f16vec4
+#else
+#define mfloat float
+#define mvec2 vec2
+#define mvec3 vec3
+#define mvec4 vec4
+#endif
+#extension GL_GOOGLE_include_directive : require
+#include "bindless.glsl"
+
 layout(location = 0) in vec2 fragCoord;
 layout(location = 0) out vec4 outColor;
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 view;
+    mat4 view[2]; // Per eye; mono frames fill both with the same camera
     mat4 proj;
-    vec3 camPos;
+    vec4 camPos[2];
     float time; // Added time uniform for animation
+    int maxSteps;
+    float epsilon;
+    float farDistance;
+    uint marchStrategy;
+    uint flags;
+    uint gridMode;
+    uint bodyBuffer; // Resource table buffer of vec4(position, radius) per orbiting body
+    uint bodyCount;
+    float bodyBounds; // Radius around the origin that holds every body
+    uint aaMode;
+    uint aaSamples;
 } ubo;
 
+layout(push_constant) uniform DrawConstants {
+    uint pass;
+    uint edgeImage; // Storage image of per-pixel edge keys, INVALID_RESOURCE when AA is off
+    uint rasterDepth; // Texture of the depth rasterized before the march, INVALID_RESOURCE without
+    uint view; // Eye of a two-pass stereo draw
+} draw;
+
+#ifdef MULTIVIEW
+#define VIEW_INDEX gl_ViewIndex
+#else
+#define VIEW_INDEX draw.view
+#endif
+
+const uint DRAW_PASS_PRIMARY = 0u;
+const uint DRAW_PASS_RESOLVE = 1u;
+
+const uint AA_OFF = 0u;
+const uint AA_ADAPTIVE = 1u;
+const uint AA_SHOW_EDGES = 2u;
+
+// Edge keys are vec4(object, depth, 0, 0) in rgba16f, so IDs stay below 2048
+const float OBJECT_NONE = 0.0;
+const float OBJECT_SOLID = 1.0; // Sphere and cube, blended into one surface
+const float OBJECT_GRID = 2.0;
+const float OBJECT_BODY = 3.0;  // Plus the body index
+const uint OBJECT_BODY_IDS = 2040u;
+// Neighbours whose depths differ by more than this fraction are an edge
+const float AA_DEPTH_THRESHOLD = 0.05;
+
+// Steps-per-pixel histogram for the tuning panel, only written when enabled. The second
+// set is the analytic half of the grid compare split.
+const uint STEP_HISTOGRAM_BINS = 64;
+const uint STEP_HISTOGRAM_SETS = 2;
+const uint FLAG_STEP_HISTOGRAM = 1u;
+layout(binding = 1) buffer StepHistogram {
+    uint bins[STEP_HISTOGRAM_BINS * STEP_HISTOGRAM_SETS];
+    uint aaPixels; // Supersampled pixels, one in every 4x4 block counted
+} stepHistogram;
+
+const uint MARCH_STANDARD = 0u;
+const uint MARCH_RELAXED = 1u;
+const uint MARCH_ADAPTIVE = 2u;
+
+const uint GRID_SDF = 0u;
+const uint GRID_ANALYTIC = 1u;
+const uint GRID_COMPARE = 2u;
+
+// Lines run along every axis through the nodes (k + 0.5) * GRID_SPACING
+const float GRID_SPACING = 8.0;
+const float GRID_LINE_RADIUS = 0.04;
+const vec3 GRID_COLOR = vec3(0.0, 0.0, 0.0); // Black grid
+
+// The float16 variant evaluates the SDF in half precision within this distance of the camera;
+// further out, the fp32 SDF keeps thin distant grid lines from being stepped over.
+const float FP16_NEAR_RANGE = 16.0;
+// Offsets are clamped to this per axis before the conversion, so their squared lengths stay
+// below half's 65504 wherever the camera is. That only shortens distances to far objects,
+// which makes the march take smaller steps there but never step past a surface.
+const float FP16_MAX_OFFSET = 128.0;
+
 float sphereSDF(vec3 p, vec3 center, float radius) {
     return length(p - center) - radius;
 }
@@ -19,13 +113,135 @@ float cubeSDF(vec3 p, vec3 center, float size) {
 }
 
 float gridSDF(vec3 p) {
-    float gridSpacing = 8.0;
-    float lineThickness = 0.04;
-    vec3 q = mod(p, gridSpacing) - 0.5 * gridSpacing;
-    float dx = min(length(vec2(q.y, q.z)), length(vec2(q.y, q.z - gridSpacing)));
-    float dy = min(length(vec2(q.x, q.z)), length(vec2(q.x, q.z - gridSpacing)));
-    float dz = min(length(vec2(q.x, q.y)), length(vec2(q.x, q.y - gridSpacing)));
-    return min(min(dx, dy), dz) - lineThickness;
+    vec3 q = mod(p, GRID_SPACING) - 0.5 * GRID_SPACING;
+    float dx = min(length(vec2(q.y, q.z)), length(vec2(q.y, q.z - GRID_SPACING)));
+    float dy = min(length(vec2(q.x, q.z)), length(vec2(q.x, q.z - GRID_SPACING)));
+    float dz = min(length(vec2(q.x, q.y)), length(vec2(q.x, q.y - GRID_SPACING)));
+    return min(min(dx, dy), dz) - GRID_LINE_RADIUS;
+}
+
+// Entry distance of the ray into an infinite line of the grid, in the plane across the
+// line (ro2, rd2 and center are the two other coordinates). Negative when it misses.
+float gridLineHit(vec2 ro2, vec2 rd2, vec2 center) {
+    vec2 oc = ro2 - center;
+    float a = dot(rd2, rd2);
+    float b = dot(oc, rd2);
+    float c = dot(oc, oc) - GRID_LINE_RADIUS * GRID_LINE_RADIUS;
+    float h = b * b - a * c;
+    if (a < 1e-12 || h < 0.0) {
+        return -1.0;
+    }
+    return (-b - sqrt(h)) / a;
+}
+
+struct GridHit {
+    float t; // Negative when nothing is hit before tMax
+    vec3 normal;
+    int cells;
+};
+
+// Walks the GRID_SPACING cells along the ray (Amanatides & Woo). Each cell is centred on a
+// lattice node and the lines are far thinner than a cell, so only the three lines through
+// that node can be hit inside it, and the first cell with a hit holds the nearest one.
+GridHit traceGrid(vec3 ro, vec3 rd, float tMax) {
+    GridHit result = GridHit(-1.0, vec3(0.0), 0);
+    vec3 dir = mix(rd, vec3(1e-8), lessThan(abs(rd), vec3(1e-8)));
+    vec3 invDir = 1.0 / dir;
+    vec3 stepDir = sign(dir);
+    vec3 cell = floor(ro / GRID_SPACING);
+    vec3 tDelta = abs(GRID_SPACING * invDir);
+    vec3 tNext = ((cell + max(stepDir, 0.0)) * GRID_SPACING - ro) * invDir;
+    float tEnter = 0.0;
+
+    int maxCells = min(int(tMax / GRID_SPACING) * 3 + 3, 512);
+    for (int i = 0; i < maxCells && tEnter <= tMax; ++i) {
+        result.cells = i + 1;
+        vec3 node = (cell + 0.5) * GRID_SPACING;
+        float tExit = min(tNext.x, min(tNext.y, tNext.z));
+
+        float tx = gridLineHit(ro.yz, rd.yz, node.yz);
+        float ty = gridLineHit(ro.xz, rd.xz, node.xz);
+        float tz = gridLineHit(ro.xy, rd.xy, node.xy);
+        float best = tExit + 1e-4;
+        int axis = -1;
+        if (tx >= tEnter - 1e-4 && tx < best) { best = tx; axis = 0; }
+        if (ty >= tEnter - 1e-4 && ty < best) { best = ty; axis = 1; }
+        if (tz >= tEnter - 1e-4 && tz < best) { best = tz; axis = 2; }
+        if (axis >= 0) {
+            if (best <= tMax) {
+                vec3 offset = ro + rd * best - node;
+                offset[axis] = 0.0;
+                result.t = best;
+                result.normal = normalize(offset);
+            }
+            return result;
+        }
+
+        // Step into the neighbour across the nearest boundary
+        vec3 advance;
+        if (tNext.x <= tNext.y && tNext.x <= tNext.z) {
+            advance = vec3(1.0, 0.0, 0.0);
+        } else if (tNext.y <= tNext.z) {
+            advance = vec3(0.0, 1.0, 0.0);
+        } else {
+            advance = vec3(0.0, 0.0, 1.0);
+        }
+        cell += advance * stepDir;
+        tNext += advance * tDelta;
+        tEnter = tExit;
+    }
+    return result;
+}
+
+struct BodyHit {
+    float t; // Negative when nothing is hit before tMax
+    vec3 normal;
+    vec3 color;
+    uint index;
+};
+
+// Orbiting bodies are spheres solved on the CPU, so they are intersected exactly instead of
+// being added to the SDF, which would cost every march step a loop over all of them
+BodyHit traceBodies(vec3 ro, vec3 rd, float tMax) {
+    BodyHit result = BodyHit(-1.0, vec3(0.0), vec3(0.0), 0u);
+    if (ubo.bodyCount == 0u || ubo.bodyBuffer == INVALID_RESOURCE) {
+        return result;
+    }
+
+    // Skip the loop for rays that miss the sphere holding every orbit
+    float b = dot(ro, rd);
+    float h = b * b - dot(ro, ro) + ubo.bodyBounds * ubo.bodyBounds;
+    if (h < 0.0 || -b + sqrt(h) < 0.0) {
+        return result;
+    }
+
+    float nearest = tMax;
+    uint nearestIndex = 0u;
+    vec3 nearestCenter = vec3(0.0);
+    for (uint i = 0u; i < ubo.bodyCount; ++i) {
+        vec4 body = loadBuffer(ubo.bodyBuffer, i);
+        vec3 oc = ro - body.xyz;
+        float bb = dot(oc, rd);
+        float hh = bb * bb - dot(oc, oc) + body.w * body.w;
+        if (hh >= 0.0) {
+            float t = -bb - sqrt(hh);
+            if (t > 0.0 && t < nearest) {
+                nearest = t;
+                nearestIndex = i;
+                nearestCenter = body.xyz;
+            }
+        }
+    }
+
+    if (nearest < tMax) {
+        // Rocky greys and browns, varied per body
+        float shade = fract(sin(float(nearestIndex) * 12.9898) * 43758.5453);
+        result.t = nearest;
+        result.normal = normalize(ro + rd * nearest - nearestCenter);
+        result.color = vec3(mix(mvec3(0.35, 0.33, 0.3), mvec3(0.55, 0.42, 0.3), mfloat(shade)));
+        result.index = nearestIndex;
+    }
+    return result;
 }
 
 // Smooth minimum function for blending SDFs
@@ -37,13 +253,17 @@ float smin(float a, float b, float k) {
 struct SceneHit {
     float dist;
     vec3 color;
+    float id; // OBJECT_SOLID or OBJECT_GRID
 };
 
-SceneHit sceneSDF(vec3 p) {
-    // Sphere at origin
-    float sphereDist = sphereSDF(p, vec3(0.0, 0.0, 0.0), 1.0);
-    vec3 sphereColor = vec3(0.08, 0.6, 0.5); // Black sphere
+// The scene provides SCENE_GRID, prepareScene(), sceneSDF() and marchDistance()
+#ifdef SCENE_FILE
+#include "scene.glsl"
+#else
+const bool SCENE_GRID = true; // Whether the scene has the line grid
 
+// Position of the cube on its orbit at ubo.time; the same for every pixel
+vec3 orbitingCubeCenter() {
     // Cube orbital parameters
     float cube_semiMajorAxis = 2.75; // Semi-major axis
     float cube_eccentricity = 0.8182; // Eccentricity
@@ -93,85 +313,303 @@ SceneHit sceneSDF(vec3 p) {
     );
 
     // Transform position to world coordinates
-    vec3 cubeCenter = rotOmega * rotI * rotOmegaPeri * pos;
+    return rotOmega * rotI * rotOmegaPeri * pos;
+}
+
+vec3 cubeCenter; // Set once per invocation by prepareScene
+
+void prepareScene() {
+    cubeCenter = orbitingCubeCenter();
+}
+
+// withGrid is false when the grid is traced analytically instead
+SceneHit sceneSDF(vec3 p, bool withGrid) {
+    // Sphere at origin
+    float sphereDist = sphereSDF(p, vec3(0.0, 0.0, 0.0), 1.0);
+    vec3 sphereColor = vec3(0.08, 0.6, 0.5); // Black sphere
 
-    // Cube SDF
+    // Cube SDF, around the center prepareScene solved
     float cubeDist = cubeSDF(p, cubeCenter, 1.0); // Unit cube
     vec3 cubeColor = vec3(1.0, 0.0, 0.0); // Red cube
 
-    // Grid
-    float gridDist = gridSDF(p);
-    vec3 gridColor = vec3(0.0, 0.0, 0.0); // Black grid
-
     // Smoothly blend sphere and cube
     float k = 0.5; // Blending factor
     float dist = smin(sphereDist, cubeDist, k);
+
+    // Grid
+    float gridDist = withGrid ? gridSDF(p) : dist + 1.0;
     dist = min(dist, gridDist);
 
     // Blend colors based on distances
     vec3 color;
+    float id;
     if (dist == gridDist) {
-        color = gridColor;
+        color = GRID_COLOR;
+        id = OBJECT_GRID;
     } else {
         float t = clamp(0.5 + 0.5 * (cubeDist - sphereDist) / k, 0.0, 1.0);
-        color = mix(cubeColor, sphereColor, t);
+        color = vec3(mix(mvec3(cubeColor), mvec3(sphereColor), mfloat(t)));
+        id = OBJECT_SOLID;
     }
 
-    return SceneHit(dist, color);
+    return SceneHit(dist, color, id);
 }
 
-vec3 calcNormal(vec3 p) {
+#ifdef FP16
+// sceneSDF().dist in half precision. Every offset is formed in fp32 before the conversion,
+// so only its few significant units reach float16.
+mfloat sceneDistanceNear(vec3 p, bool withGrid) {
+    mfloat sphereDist = length(mvec3(clamp(p, -FP16_MAX_OFFSET, FP16_MAX_OFFSET))) - mfloat(1.0);
+    mvec3 d = abs(mvec3(clamp(p - cubeCenter, -FP16_MAX_OFFSET, FP16_MAX_OFFSET))) - mvec3(0.5);
+    mfloat cubeDist = length(max(d, mfloat(0.0))) + min(max(d.x, max(d.y, d.z)), mfloat(0.0));
+    mfloat k = mfloat(0.5);
+    mfloat h = clamp(mfloat(0.5) + mfloat(0.5) * (cubeDist - sphereDist) / k, mfloat(0.0), mfloat(1.0));
+    mfloat dist = mix(cubeDist, sphereDist, h) - k * h * (mfloat(1.0) - h);
+    if (withGrid) {
+        vec3 q = mod(p, GRID_SPACING) - 0.5 * GRID_SPACING;
+        mvec3 a = mvec3(q);
+        mvec3 b = mvec3(q - GRID_SPACING);
+        mfloat dx = min(length(mvec2(a.y, a.z)), length(mvec2(a.y, b.z)));
+        mfloat dy = min(length(mvec2(a.x, a.z)), length(mvec2(a.x, b.z)));
+        mfloat dz = min(length(mvec2(a.x, a.y)), length(mvec2(a.x, b.y)));
+        dist = min(dist, min(min(dx, dy), dz) - mfloat(GRID_LINE_RADIUS));
+    }
+    return dist;
+}
+#endif
+
+// Distance the march steps by at p
+float marchDistance(vec3 p, bool withGrid) {
+#ifdef FP16
+    if (length(p - ubo.camPos[VIEW_INDEX].xyz) < FP16_NEAR_RANGE) {
+        return float(sceneDistanceNear(p, withGrid));
+    }
+#endif
+    return sceneSDF(p, withGrid).dist;
+}
+#endif
+
+vec3 calcNormal(vec3 p, bool withGrid) {
     float h = 0.001;
     vec2 k = vec2(1, -1);
     return normalize(
-        k.xyy * sceneSDF(p + k.xyy * h).dist +
-        k.yyx * sceneSDF(p + k.yyx * h).dist +
-        k.yxy * sceneSDF(p + k.yxy * h).dist +
-        k.xxx * sceneSDF(p + k.xxx * h).dist
+        k.xyy * sceneSDF(p + k.xyy * h, withGrid).dist +
+        k.yyx * sceneSDF(p + k.yyx * h, withGrid).dist +
+        k.yxy * sceneSDF(p + k.yxy * h, withGrid).dist +
+        k.xxx * sceneSDF(p + k.xxx * h, withGrid).dist
     );
 }
 
-void main() {
-    float aspectRatio = ubo.proj[1][1] / ubo.proj[0][0];
-    vec2 uv = fragCoord * 0.5;
-    uv.x *= aspectRatio;
-    vec3 ro = ubo.camPos;
-    vec3 rd = normalize((inverse(ubo.view) * inverse(ubo.proj) * vec4(uv, 1.0, 1.0)).xyz);
+// Depth buffer value of p under the camera's projection, as the mesh pipeline rasterizes it
+float sceneDepth(vec3 p) {
+    vec4 clip = ubo.proj * ubo.view[VIEW_INDEX] * vec4(p, 1.0);
+    return clamp(clip.z / clip.w, 0.0, 1.0);
+}
+
+// Distance along the ray through uv (projection space) to the rasterized surface in this
+// pixel, or farDistance where nothing was rasterized
+float rasterDistance(vec2 uv) {
+    float depth = texelFetch(textures[draw.rasterDepth], ivec2(gl_FragCoord.xy), 0).r;
+    if (depth >= 1.0) {
+        return ubo.farDistance;
+    }
+    vec4 viewPos = inverse(ubo.proj) * vec4(uv, depth, 1.0);
+    return min(length(viewPos.xyz / viewPos.w), ubo.farDistance);
+}
+
+struct RaySample {
+    vec4 color;
+    float t;     // Hit distance, farDistance on a miss so every miss has the same depth
+    float depth; // Depth buffer value of the hit, 1.0 on a miss
+    float id;    // OBJECT_*, for the edge test
+    uint steps;  // March steps plus grid cells walked
+    bool analyticGrid;
+};
+
+// One ray through ndc, the fragment position in [-1, 1]. With rasterCap the ray stops at the
+// rasterized depth of the pixel: anything further is hidden and fails the depth test anyway.
+RaySample traceScene(vec2 ndc, bool rasterCap) {
+    // The projection already carries the aspect ratio. Keep the half-size, X-mirrored
+    // framing the camera controls were tuned for, and rotate the view-space ray with
+    // w = 0 so the camera translation does not bend it.
+    vec2 uv = ndc * vec2(-0.5, 0.5);
+    vec3 ro = ubo.camPos[VIEW_INDEX].xyz;
+    vec4 viewRay = inverse(ubo.proj) * vec4(uv, 1.0, 1.0);
+    vec3 rd = normalize((inverse(ubo.view[VIEW_INDEX]) * vec4(viewRay.xyz, 0.0)).xyz);
+    float tMax = rasterCap ? rasterDistance(uv) : ubo.farDistance;
+
+    // Surfaces found exactly (the analytic grid and the orbiting bodies) bound the march, which
+    // then only has to find the dynamic objects. Compare mode puts the SDF grid on the left half
+    // of the screen and the analytic one on the right.
+    bool analyticGrid = SCENE_GRID && (ubo.gridMode == GRID_ANALYTIC || (ubo.gridMode == GRID_COMPARE && ndc.x > 0.0));
+    GridHit grid = GridHit(-1.0, vec3(0.0), 0);
+    float surfaceT = -1.0;
+    vec3 surfaceNormal = vec3(0.0);
+    vec3 surfaceColor = vec3(0.0);
+    float surfaceId = OBJECT_NONE;
+    if (analyticGrid) {
+        grid = traceGrid(ro, rd, tMax);
+        if (grid.t >= 0.0) {
+            surfaceT = grid.t;
+            surfaceNormal = grid.normal;
+            surfaceColor = GRID_COLOR;
+            surfaceId = OBJECT_GRID;
+        }
+    }
+    BodyHit bodies = traceBodies(ro, rd, surfaceT >= 0.0 ? surfaceT : tMax);
+    if (bodies.t >= 0.0) {
+        surfaceT = bodies.t;
+        surfaceNormal = bodies.normal;
+        surfaceColor = bodies.color;
+        surfaceId = OBJECT_BODY + float(bodies.index % OBJECT_BODY_IDS);
+    }
+    float marchLimit = surfaceT >= 0.0 ? surfaceT : tMax;
 
     float t = 0.0;
     vec3 p;
     bool hit = false;
     vec3 color;
-    for (int i = 0; i < 100; ++i) {
+    float id = OBJECT_NONE;
+    int steps = 0;
+    float omega = ubo.marchStrategy == MARCH_RELAXED ? 1.6 : 1.0;
+    float stepLength = 0.0;
+    float prevRadius = 0.0;
+    prepareScene();
+    for (int i = 0; i < ubo.maxSteps; ++i) {
+        steps = i + 1;
         p = ro + rd * t;
-        SceneHit hitInfo = sceneSDF(p);
-        float dist = hitInfo.dist;
-        if (dist < 0.001) {
+        float dist = marchDistance(p, !analyticGrid);
+
+        // Over-relaxation: step omega * dist until the unbound spheres stop overlapping, then back off
+        bool relaxFailed = omega > 1.0 && abs(dist) + prevRadius < stepLength;
+        if (relaxFailed) {
+            stepLength -= omega * stepLength;
+            omega = 1.0;
+        } else {
+            stepLength = dist * omega;
+        }
+        prevRadius = abs(dist);
+
+        // Adaptive: accept hits once the distance is below the pixel footprint at t
+        float eps = ubo.marchStrategy == MARCH_ADAPTIVE ? ubo.epsilon * max(1.0, t) : ubo.epsilon;
+        if (!relaxFailed && dist < eps) {
+            // Colour and object from the full SDF, once per ray
+            SceneHit hitInfo = sceneSDF(p, !analyticGrid);
             hit = true;
             color = hitInfo.color;
+            id = hitInfo.id;
             break;
         }
-        t += dist;
-        if (t > 400.0) break;
+        t += stepLength;
+        if (t > marchLimit) break;
     }
 
-    vec4 bgColor = vec4(1.0, 1.0, 1.0, 1.0); // White background
-    vec4 fogColor = vec4(1.0, 1.0, 1.0, 1.0); // White fog
+    // Nearest hit wins; the march stopped at the exact surface, so a miss there means it is in front
+    bool surfaceHit = !hit && surfaceT >= 0.0;
+    if (surfaceHit) {
+        hit = true;
+        t = surfaceT;
+        p = ro + rd * t;
+        color = surfaceColor;
+        id = surfaceId;
+    }
+
+    mvec4 bgColor = mvec4(1.0, 1.0, 1.0, 1.0); // White background
+    mvec4 fogColor = mvec4(1.0, 1.0, 1.0, 1.0); // White fog
     float fogDensity = 0.01;
 
-    float fogAmount = 1.0 - exp(-fogDensity * t);
+    // The exponent takes the fp32 distance; the result is in [0, 1]
+    mfloat fogAmount = mfloat(1.0 - exp(-fogDensity * t));
+    // Cells walked count as steps so both grid paths are measured by the same loop iterations
+    RaySample result = RaySample(vec4(0.0), hit ? t : ubo.farDistance, hit ? sceneDepth(p) : 1.0, id,
+                                 uint(steps + grid.cells), analyticGrid);
 
     if (hit) {
         // Simple diffuse lighting
-        vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0)); // Directional light from (1, 1, 1)
-        vec3 normal = calcNormal(p);
-        float diffuse = max(dot(normal, lightDir), 0.0); // Lambertian diffuse term
-        float lightIntensity = 0.8; // Adjustable light intensity
-        float ambient = 0.2; // Ambient term to avoid complete darkness
-        vec3 litColor = color * (diffuse * lightIntensity + ambient);
-
-        outColor = mix(vec4(litColor, 1.0), fogColor, fogAmount);
+        mvec3 lightDir = mvec3(normalize(vec3(1.0, 1.0, 1.0))); // Directional light from (1, 1, 1)
+        // The normal's finite differences are below half precision, so it is found in fp32
+        mvec3 normal = mvec3(surfaceHit ? surfaceNormal : calcNormal(p, !analyticGrid));
+        mfloat diffuse = max(dot(normal, lightDir), mfloat(0.0)); // Lambertian diffuse term
+        mfloat lightIntensity = mfloat(0.8); // Adjustable light intensity
+        mfloat ambient = mfloat(0.2); // Ambient term to avoid complete darkness
+        mvec3 litColor = mvec3(color) * (diffuse * lightIntensity + ambient);
+
+        result.color = vec4(mix(mvec4(litColor, 1.0), fogColor, fogAmount));
+    } else {
+        result.color = vec4(mix(bgColor, fogColor, fogAmount));
+    }
+    return result;
+}
+
+// True when a 4-neighbour in the edge keys shows another object (or a hit next to a miss) or
+// a depth step, which is where one ray per pixel aliases
+bool isEdgePixel(ivec2 pixel) {
+    ivec2 size = imageSize(storageImages[draw.edgeImage]);
+    vec2 center = imageLoad(storageImages[draw.edgeImage], pixel).xy;
+    const ivec2 offsets[4] = ivec2[](ivec2(1, 0), ivec2(-1, 0), ivec2(0, 1), ivec2(0, -1));
+    for (int i = 0; i < 4; ++i) {
+        vec2 neighbour = imageLoad(storageImages[draw.edgeImage], clamp(pixel + offsets[i], ivec2(0), size - 1)).xy;
+        if (neighbour.x != center.x || abs(neighbour.y - center.y) > AA_DEPTH_THRESHOLD * min(neighbour.y, center.y)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Second pass of adaptive AA: every pixel not on an edge keeps its primary ray's color, the
+// rest are replaced by the average of aaSamples rays spread over the pixel, at the depth of
+// the nearest one
+vec4 resolveEdgePixel(vec2 pixelSize, out float depth) {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    if (draw.edgeImage == INVALID_RESOURCE || !isEdgePixel(pixel)) {
+        discard;
+    }
+    // Counting every pixel would serialize on one atomic along long edges
+    if (all(equal(pixel & 3, ivec2(0)))) {
+        atomicAdd(stepHistogram.aaPixels, 1u);
+    }
+
+    // R2 low-discrepancy offsets cover the pixel evenly for any sample count
+    // Samples are not capped by the raster depth, which only holds for the pixel centre
+    vec4 sum = vec4(0.0);
+    depth = 1.0;
+    for (uint i = 0u; i < ubo.aaSamples; ++i) {
+        vec2 offset = fract(vec2(0.5) + float(i) * vec2(0.7548776662, 0.5698402910)) - 0.5;
+        RaySample ray = traceScene(fragCoord + offset * pixelSize, false);
+        sum += ray.color;
+        depth = min(depth, ray.depth);
+    }
+    vec4 color = sum / float(ubo.aaSamples);
+    if (ubo.aaMode == AA_SHOW_EDGES) {
+        color = mix(color, vec4(1.0, 0.0, 1.0, 1.0), 0.5);
+    }
+    return color;
+}
+
+void main() {
+    // Size of a pixel in fragCoord units, taken before any branch
+    vec2 pixelSize = abs(vec2(dFdx(fragCoord.x), dFdy(fragCoord.y)));
+
+    if (draw.pass == DRAW_PASS_RESOLVE) {
+        float depth;
+        outColor = resolveEdgePixel(pixelSize, depth);
+        gl_FragDepth = depth;
     } else {
-        outColor = mix(bgColor, fogColor, fogAmount);
+        RaySample primary = traceScene(fragCoord, draw.rasterDepth != INVALID_RESOURCE);
+        if ((ubo.flags & FLAG_STEP_HISTOGRAM) != 0u) {
+            uint bin = min(primary.steps * STEP_HISTOGRAM_BINS / uint(ubo.maxSteps + 1), STEP_HISTOGRAM_BINS - 1u);
+            uint set = ubo.gridMode == GRID_COMPARE && primary.analyticGrid ? 1u : 0u;
+            atomicAdd(stepHistogram.bins[set * STEP_HISTOGRAM_BINS + bin], 1u);
+        }
+        if (draw.edgeImage != INVALID_RESOURCE) {
+            imageStore(storageImages[draw.edgeImage], ivec2(gl_FragCoord.xy), vec4(primary.id, primary.t, 0.0, 0.0));
+        }
+        outColor = primary.color;
+        gl_FragDepth = primary.depth;
+    }
+
+    // Divider between the compare halves
+    if (ubo.gridMode == GRID_COMPARE && abs(fragCoord.x) < pixelSize.x) {
+        outColor = vec4(1.0, 0.0, 1.0, 1.0);
     }
 }
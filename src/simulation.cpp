@@ -0,0 +1,115 @@
+#include "simulation.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+
+Simulation::Simulation(Input& input, double tickRate)
+    : input(input),
+      tickInterval(1.0 / tickRate),
+      latest{},
+      running(true),
+      utilization(0.0f) {
+    // Seed the snapshot before the thread starts so the render thread never reads an empty value
+    Camera camera = input.getCamera();
+    SimSnapshot& snapshot = snapshotBuffer.writeBuffer();
+    snapshot.prevPosition = snapshot.position = camera.position;
+    snapshot.orientation = input.getOrientation();
+    snapshot.lookConsumed = glm::dvec2(0.0);
+    snapshot.proj = camera.proj;
+    snapshot.prevTime = snapshot.time = glfwGetTime();
+    snapshot.tick = 0;
+    snapshotBuffer.publish();
+    snapshotBuffer.update();
+    latest = snapshotBuffer.readBuffer();
+
+    thread = std::thread(&Simulation::run, this, latest);
+}
+
+Simulation::~Simulation() {
+    running.store(false, std::memory_order_release);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Simulation::run(SimSnapshot seed) {
+    Camera camera;
+    glm::vec3 lastPosition = seed.position;
+    double lastTime = seed.time;
+    uint64_t tick = 1;
+
+    double nextTick = lastTime;
+    double windowStart = lastTime;
+    double busyTime = 0.0;
+
+    while (running.load(std::memory_order_acquire)) {
+        double tickStart = glfwGetTime(); // glfwGetTime is safe to call from any thread
+
+        input.updateCamera(tickStart);
+        camera = input.getCamera();
+
+        SimSnapshot& snapshot = snapshotBuffer.writeBuffer();
+        snapshot.prevPosition = lastPosition;
+        snapshot.position = camera.position;
+        snapshot.orientation = input.getOrientation();
+        snapshot.lookConsumed = input.getLookConsumed();
+        snapshot.proj = camera.proj;
+        snapshot.prevTime = lastTime;
+        snapshot.time = tickStart;
+        snapshot.tick = tick++;
+        snapshotBuffer.publish();
+
+        lastPosition = snapshot.position;
+        lastTime = snapshot.time;
+
+        // Utilization over half-second windows
+        double tickEnd = glfwGetTime();
+        busyTime += tickEnd - tickStart;
+        if (tickEnd - windowStart >= 0.5) {
+            utilization.store(static_cast<float>(busyTime / (tickEnd - windowStart)), std::memory_order_relaxed);
+            busyTime = 0.0;
+            windowStart = tickEnd;
+        }
+
+        // Fixed tick; if we fell behind, resync instead of trying to catch up
+        nextTick += tickInterval;
+        if (nextTick < tickEnd) {
+            nextTick = tickEnd;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(nextTick - tickEnd));
+    }
+}
+
+Camera Simulation::interpolate(double now, double* sceneTime) {
+    if (snapshotBuffer.update()) {
+        latest = snapshotBuffer.readBuffer();
+    }
+
+    // Render one tick behind the simulation, blending previous and current tick
+    float alpha = static_cast<float>(std::clamp((now - latest.time) / tickInterval, 0.0, 1.0));
+
+    // Orientation is not interpolated: it is the latest tick's plus the mouse motion that
+    // arrived since, so looking around has no tick of latency. Roll moves in tick steps.
+    glm::quat orientation = glm::normalize(latest.orientation * lookRotation(input.getLookProduced() - latest.lookConsumed));
+    glm::mat4 rotation = glm::toMat4(orientation);
+
+    Camera camera;
+    camera.position = glm::mix(latest.prevPosition, latest.position, alpha);
+    camera.up = glm::normalize(glm::vec3(rotation[1]));
+    camera.forward = glm::normalize(glm::vec3(rotation[2]));
+    camera.view = glm::inverse(glm::translate(glm::mat4(1.0f), camera.position) * rotation);
+    camera.proj = latest.proj;
+
+    if (sceneTime) {
+        *sceneTime = latest.prevTime + (latest.time - latest.prevTime) * alpha;
+    }
+    return camera;
+}
+
+double Simulation::getTickRate() const {
+    return 1.0 / tickInterval;
+}
+
+float Simulation::getUtilization() const {
+    return utilization.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include "input.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Lock-free single-producer/single-consumer triple buffer.
+// The writer fills writeBuffer() and publishes it; the reader always sees the most
+// recently published value. Neither side ever blocks the other.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : buffers{}, middle(1), writeIndex(0), readIndex(2) {}
+
+    // Writer side
+    T& writeBuffer() { return buffers[writeIndex]; }
+    void publish() {
+        writeIndex = middle.exchange(writeIndex | DIRTY_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader side: returns true if a new value was picked up
+    bool update() {
+        if (!(middle.load(std::memory_order_acquire) & DIRTY_BIT)) {
+            return false;
+        }
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& readBuffer() const { return buffers[readIndex]; }
+
+private:
+    static constexpr uint32_t DIRTY_BIT = 4;
+    static constexpr uint32_t INDEX_MASK = 3;
+
+    T buffers[3];
+    std::atomic<uint32_t> middle; // Index of the shared buffer, plus DIRTY_BIT when unread
+    uint32_t writeIndex;          // Owned by the writer
+    uint32_t readIndex;           // Owned by the reader
+};
+
+// State published by the simulation thread once per tick. Carries the previous tick
+// as well so the render thread can interpolate between the two.
+struct SimSnapshot {
+    glm::vec3 prevPosition;
+    glm::vec3 position;
+    glm::quat orientation;
+    glm::dvec2 lookConsumed; // Input::getLookConsumed() after this tick
+    glm::mat4 proj;
+    double prevTime; // Scene time of the previous tick
+    double time;     // Scene time of this tick
+    uint64_t tick;
+};
+
+// Runs camera integration (and later scene updates) on its own thread at a fixed tick.
+// GLFW may only be touched on the main thread, so its callbacks queue timestamped
+// events in Input that each tick drains.
+class Simulation {
+public:
+    Simulation(Input& input, double tickRate = 120.0);
+    ~Simulation();
+
+    Camera interpolate(double now, double* sceneTime); // Render thread, which is the main thread
+
+    double getTickRate() const;
+    float getUtilization() const;
+
+private:
+    void run(SimSnapshot seed);
+
+    Input& input;
+    double tickInterval;
+    TripleBuffer<SimSnapshot> snapshotBuffer;
+    SimSnapshot latest; // Render thread copy of the last consumed snapshot
+    std::atomic<bool> running;
+    std::atomic<float> utilization;
+    std::thread thread;
+};
@@ -0,0 +1,157 @@
+#include "startup.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+StartupGraph::StartupGraph(Clock::time_point processStart) : processStart(processStart) {}
+
+StartupGraph::TaskId StartupGraph::add(const char* name, std::function<void()> work,
+                                       std::initializer_list<TaskId> dependencies, bool mainThread) {
+    Task task;
+    task.name = name;
+    task.work = std::move(work);
+    task.dependencies = dependencies;
+    task.mainThread = mainThread;
+    tasks.push_back(std::move(task));
+    return static_cast<TaskId>(tasks.size() - 1);
+}
+
+double StartupGraph::elapsedMs() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - processStart).count();
+}
+
+bool StartupGraph::isReady(const Task& task) const {
+    if (task.started) {
+        return false;
+    }
+    for (TaskId dependency : task.dependencies) {
+        if (!tasks[dependency].finished) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StartupGraph::execute(TaskId id) {
+    std::exception_ptr taskError;
+    double start = elapsedMs();
+    try {
+        tasks[id].work();
+    } catch (...) {
+        taskError = std::current_exception();
+    }
+    double end = elapsedMs();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks[id].startMs = start;
+    tasks[id].endMs = end;
+    tasks[id].finished = true;
+    if (taskError && !error) {
+        error = taskError;
+    }
+    finishedSignal.notify_all();
+}
+
+void StartupGraph::run() {
+    std::vector<std::thread> workers;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        bool allFinished = true;
+        bool anyRunning = false;
+        for (const Task& task : tasks) {
+            allFinished &= task.finished;
+            anyRunning |= task.started && !task.finished;
+        }
+        if (allFinished || (error && !anyRunning)) {
+            break;
+        }
+
+        // After a failure nothing new starts; just wait for the running tasks
+        TaskId mainTask = static_cast<TaskId>(tasks.size());
+        if (!error) {
+            for (TaskId id = 0; id < tasks.size(); ++id) {
+                if (!isReady(tasks[id])) {
+                    continue;
+                }
+                if (tasks[id].mainThread) {
+                    if (mainTask == tasks.size()) {
+                        mainTask = id;
+                    }
+                    continue;
+                }
+                tasks[id].started = true;
+                workers.emplace_back(&StartupGraph::execute, this, id);
+            }
+        }
+
+        if (mainTask < tasks.size()) {
+            tasks[mainTask].started = true;
+            lock.unlock();
+            execute(mainTask);
+            lock.lock();
+        } else {
+            finishedSignal.wait(lock);
+        }
+    }
+    lock.unlock();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+StartupGraph::TaskId StartupGraph::recordStage(const char* name, Clock::time_point start) {
+    Task task;
+    task.name = name;
+    task.mainThread = true;
+    task.started = true;
+    task.finished = true;
+    task.startMs = std::chrono::duration<double, std::milli>(start - processStart).count();
+    task.endMs = elapsedMs();
+    for (TaskId id = 0; id < tasks.size(); ++id) {
+        task.dependencies.push_back(id);
+    }
+    tasks.push_back(std::move(task));
+    return static_cast<TaskId>(tasks.size() - 1);
+}
+
+void StartupGraph::report(std::ostream& out) const {
+    if (tasks.empty()) {
+        return;
+    }
+    double total = 0.0;
+    for (const Task& task : tasks) {
+        total = std::max(total, task.endMs);
+    }
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "Startup: %.1f ms to first frame", total);
+    out << line << std::endl;
+    for (const Task& task : tasks) {
+        std::snprintf(line, sizeof(line), "  %-16s %8.1f - %8.1f ms %8.1f ms  %s", task.name.c_str(), task.startMs,
+                      task.endMs, task.endMs - task.startMs, task.mainThread ? "main" : "worker");
+        out << line << std::endl;
+    }
+
+    // Critical path: walk back from the last task through whichever dependency finished last
+    std::vector<const Task*> path;
+    const Task* current = &tasks.back();
+    while (current) {
+        path.push_back(current);
+        const Task* latest = nullptr;
+        for (TaskId dependency : current->dependencies) {
+            if (!latest || tasks[dependency].endMs > latest->endMs) {
+                latest = &tasks[dependency];
+            }
+        }
+        current = latest;
+    }
+    out << "  critical path:";
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        out << (it == path.rbegin() ? " " : " > ") << (*it)->name;
+    }
+    out << std::endl;
+}
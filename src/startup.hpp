@@ -0,0 +1,54 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Dependency graph for initialization. Main-thread tasks (GLFW, the window surface,
+// ImGui) run on the thread calling run(); the rest get a worker thread as soon as their
+// dependencies have finished, so independent stages overlap. Every task is timed
+// relative to the process start for the time-to-first-frame report.
+class StartupGraph {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TaskId = uint32_t;
+
+    explicit StartupGraph(Clock::time_point processStart);
+
+    TaskId add(const char* name, std::function<void()> work, std::initializer_list<TaskId> dependencies = {},
+               bool mainThread = true);
+    // Runs every task; on failure lets running tasks finish, skips the rest and rethrows the first error
+    void run();
+    // Records a main-thread stage measured outside the graph (config parsing, the first
+    // frame) that ends now and depends on every task added before it
+    TaskId recordStage(const char* name, Clock::time_point start);
+    void report(std::ostream& out) const;
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> work;
+        std::vector<TaskId> dependencies;
+        bool mainThread;
+        bool started = false;
+        bool finished = false;
+        double startMs = 0.0;
+        double endMs = 0.0;
+    };
+
+    bool isReady(const Task& task) const;
+    void execute(TaskId id); // Called without the lock held
+    double elapsedMs() const;
+
+    Clock::time_point processStart;
+    std::vector<Task> tasks;
+    std::mutex mutex;
+    std::condition_variable finishedSignal;
+    std::exception_ptr error;
+};
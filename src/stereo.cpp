@@ -0,0 +1,432 @@
+#include "stereo.hpp"
+#include "config.hpp" // formatIndexPattern
+#include "input.hpp" // perspectiveProjection
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+using Clock = std::chrono::steady_clock;
+
+uint32_t supportedStereoMode(const Device& device, uint32_t mode, std::ostream& out) {
+    if (mode == STEREO_OFF) {
+        return mode;
+    }
+    if (!device.dynamicRendering) {
+        out << "Stereo needs Vulkan 1.3 dynamic rendering; rendering mono" << std::endl;
+        return STEREO_OFF;
+    }
+    if (mode == STEREO_MULTIVIEW && !device.multiview) {
+        out << "No multiview on " << device.properties.deviceName << "; stereo renders in two passes" << std::endl;
+        return STEREO_TWO_PASS;
+    }
+    return mode;
+}
+
+// Every layer of the stereo target
+static void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                         VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                         VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 2};
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+StereoRenderer::StereoRenderer(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+                               VkExtent2D eyeExtent, const std::string& shaderOverrideDir)
+    : device(device), allocator(allocator), eyeExtent(eyeExtent),
+      pipeline(device, allocator, resources, VK_NULL_HANDLE, FORMAT, 1, shaderOverrideDir),
+      eyeViews{VK_NULL_HANDLE, VK_NULL_HANDLE} {
+    if (!device.dynamicRendering) {
+        throw std::runtime_error("Stereo rendering needs dynamic rendering");
+    }
+    if (device.multiview) {
+        multiviewPipeline = std::make_unique<Pipeline>(device, allocator, resources, VK_NULL_HANDLE, FORMAT, 1, shaderOverrideDir,
+                                                       VK_FORMAT_UNDEFINED, RASTER_OFF, 0x3);
+    }
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = FORMAT;
+    imageInfo.extent = {eyeExtent.width, eyeExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 2;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device.device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create stereo image");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.device, image, &memRequirements);
+    imageAllocation = allocator.allocate(memRequirements, MemoryUsage::GpuOnly, false);
+    vkBindImageMemory(device.device, image, imageAllocation.memory, imageAllocation.offset);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 2;
+
+    if (vkCreateImageView(device.device, &viewInfo, nullptr, &arrayView) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create stereo image view");
+    }
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.subresourceRange.layerCount = 1;
+    for (uint32_t eye = 0; eye < 2; ++eye) {
+        viewInfo.subresourceRange.baseArrayLayer = eye;
+        if (vkCreateImageView(device.device, &viewInfo, nullptr, &eyeViews[eye]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create eye image view");
+        }
+    }
+
+    readback = allocator.createBuffer(static_cast<VkDeviceSize>(eyeExtent.width) * eyeExtent.height * 2 * 4,
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Readback);
+
+    commandPool = device.createCommandPool(QueueType::Graphics, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate stereo command buffer");
+    }
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device.device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create stereo fence");
+    }
+
+    timestampPool = VK_NULL_HANDLE;
+    drawSeconds = 0.0;
+    recordSeconds = 0.0;
+    if (device.timestampValidBits > 0) {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        if (vkCreateQueryPool(device.device, &queryInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create stereo timestamp query pool");
+        }
+    }
+}
+
+void StereoRenderer::render(const Camera& camera, float time, const RenderSettings& settings, float eyeSeparation,
+                            uint32_t mode, std::vector<uint8_t>& pixels) {
+    bool multiview = mode == STEREO_MULTIVIEW;
+    if (multiview && !multiviewPipeline) {
+        throw std::runtime_error("Multiview stereo is not supported on this device");
+    }
+    Pipeline& active = multiview ? *multiviewPipeline : pipeline;
+    RenderSettings eyeSettings = settings;
+    eyeSettings.stepHistogram = false;
+    eyeSettings.aaMode = AA_OFF; // The edge keys are a single layer
+    active.updateUBO(camera, time, 0, eyeSettings, SceneBodies(), eyeSeparation);
+
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin stereo command buffer");
+    }
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, timestampPool, 0, 2);
+    }
+
+    // Only the scene passes count as recording time, as they are all that differs between the modes
+    Clock::time_point recordStart = Clock::now();
+    imageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
+    }
+
+    // The two-pass path records everything once per eye: pass, pipeline, state and descriptors
+    auto recordPass = [&](VkImageView view, uint32_t viewMask, uint32_t eye) {
+        VkRenderingAttachmentInfo colorAttachment = {};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = view;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.extent = eyeExtent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.viewMask = viewMask;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        device.cmdBeginRendering(commandBuffer, &renderingInfo);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, active.select(settings.shaderPrecision));
+        VkViewport viewport = {0.0f, 0.0f, static_cast<float>(eyeExtent.width), static_cast<float>(eyeExtent.height), 0.0f, 1.0f};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        VkRect2D scissor = {{0, 0}, eyeExtent};
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        VkDescriptorSet descriptorSets[] = {active.descriptorSets[0], active.resourceSet};
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, active.pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+        DrawConstants constants;
+        constants.view = eye;
+        active.pushDrawConstants(commandBuffer, constants);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        device.cmdEndRendering(commandBuffer);
+    };
+    if (multiview) {
+        recordPass(arrayView, 0x3, 0);
+    } else {
+        recordPass(eyeViews[0], 0, 0);
+        recordPass(eyeViews[1], 0, 1);
+    }
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 1);
+    }
+    recordSeconds = std::chrono::duration<double>(Clock::now() - recordStart).count();
+
+    imageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    // Each layer goes into its half of the rows, so the buffer holds the side-by-side image
+    VkBufferImageCopy regions[2] = {};
+    for (uint32_t eye = 0; eye < 2; ++eye) {
+        regions[eye].bufferOffset = static_cast<VkDeviceSize>(eye) * eyeExtent.width * 4;
+        regions[eye].bufferRowLength = 2 * eyeExtent.width;
+        regions[eye].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, eye, 1};
+        regions[eye].imageExtent = {eyeExtent.width, eyeExtent.height, 1};
+    }
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 2, regions);
+
+    VkBufferMemoryBarrier hostBarrier = {};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = readback.buffer;
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record stereo command buffer");
+    }
+
+    device.submit(QueueType::Graphics, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, fence);
+    vkWaitForFences(device.device, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device.device, 1, &fence);
+
+    if (timestampPool != VK_NULL_HANDLE) {
+        uint64_t timestamps[2] = {};
+        vkGetQueryPoolResults(device.device, timestampPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        drawSeconds = device.timestampSeconds(timestamps[0], timestamps[1]);
+    }
+
+    // Readback memory prefers HOST_CACHED, which need not be coherent
+    VkMemoryPropertyFlags memoryFlags = allocator.memProperties.memoryTypes[readback.allocation.memoryType].propertyFlags;
+    if (!(memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        VkDeviceSize atom = device.properties.limits.nonCoherentAtomSize;
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = readback.allocation.memory;
+        range.offset = readback.allocation.offset / atom * atom;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device.device, 1, &range);
+    }
+
+    size_t size = static_cast<size_t>(eyeExtent.width) * eyeExtent.height * 2 * 4;
+    pixels.resize(size);
+    memcpy(pixels.data(), readback.allocation.mapped, size);
+}
+
+StereoRenderer::~StereoRenderer() {
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device.device, timestampPool, nullptr);
+    }
+    vkDestroyFence(device.device, fence, nullptr);
+    vkDestroyCommandPool(device.device, commandPool, nullptr);
+    allocator.destroyBuffer(readback);
+    for (VkImageView eyeView : eyeViews) {
+        vkDestroyImageView(device.device, eyeView, nullptr);
+    }
+    vkDestroyImageView(device.device, arrayView, nullptr);
+    vkDestroyImage(device.device, image, nullptr);
+    allocator.free(imageAllocation);
+}
+
+// Binary PPM from RGBA8 texels, as the farm writes its frames
+static bool writePpm(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+    for (size_t i = 0; i < rgb.size() / 3; ++i) {
+        memcpy(&rgb[i * 3], &rgba[i * 4], 3);
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    file.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+    return static_cast<bool>(file);
+}
+
+int runStereoBenchmark(std::ostream& out, const RenderSettings& settings, float fov, float eyeSeparation,
+                       const std::string& gpuSelection, const std::string& shaderOverrideDir, const std::string& output) {
+    const VkExtent2D eyeExtent = {1920, 1080};
+    const uint32_t frames = 120;
+    if (!output.empty() && !isValidIndexPattern(output)) {
+        std::cerr << "Error: stereo.output=" << output << " needs exactly one %d or %0Nd for the frame index" << std::endl;
+        return -1;
+    }
+
+    // The precision benchmark's path: one orbit around the scene at the height of the default view
+    auto pathCamera = [&](uint32_t index) {
+        float angle = glm::two_pi<float>() * index / frames;
+        Camera camera;
+        camera.position = glm::vec3(7.0f * std::sin(angle), 1.5f, 7.0f * std::cos(angle));
+        camera.forward = glm::normalize(-camera.position);
+        glm::vec3 right = glm::normalize(glm::cross(camera.forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        camera.up = glm::cross(right, camera.forward);
+        camera.view = glm::lookAt(camera.position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        camera.proj = perspectiveProjection(fov, static_cast<float>(eyeExtent.width) / eyeExtent.height);
+        return camera;
+    };
+
+    struct Run {
+        const char* name;
+        uint32_t mode;
+        std::vector<double> gpuMs;
+        double recordSeconds = 0.0;
+        double wallSeconds = 0.0;
+        std::vector<uint8_t> pixels;
+    };
+
+    try {
+        Device device(nullptr, gpuSelection, false);
+        if (!device.dynamicRendering) {
+            out << "Stereo benchmark: " << device.properties.deviceName << " has no dynamic rendering" << std::endl;
+            return 1;
+        }
+        MemoryAllocator allocator(device);
+        ResourceTable resources(device);
+        StereoRenderer renderer(device, allocator, resources, eyeExtent, shaderOverrideDir);
+
+        std::vector<Run> runs(renderer.multiviewPipeline ? 2 : 1);
+        runs[0].name = "two-pass";
+        runs[0].mode = STEREO_TWO_PASS;
+        if (runs.size() > 1) {
+            runs[1].name = "multiview";
+            runs[1].mode = STEREO_MULTIVIEW;
+        }
+
+        char line[1280];
+        std::snprintf(line, sizeof(line), "Stereo, 2x %ux%u, %u frames, eye separation %.3f, %s grid on %s", eyeExtent.width,
+                      eyeExtent.height, frames, eyeSeparation, gridModeName(settings.gridMode), device.properties.deviceName);
+        out << line << std::endl;
+        if (renderer.timestampPool == VK_NULL_HANDLE) {
+            out << "  No GPU timestamps on the graphics queue; only CPU times are reported" << std::endl;
+        }
+
+        // Warm up both paths, then alternate per frame so the two see the same clocks and heat
+        for (Run& run : runs) {
+            renderer.render(pathCamera(0), 0.0f, settings, eyeSeparation, run.mode, run.pixels);
+        }
+        int errorMax = 0;
+        uint64_t differing = 0;
+        for (uint32_t i = 0; i < frames; ++i) {
+            Camera camera = pathCamera(i);
+            float time = i / 30.0f;
+            for (Run& run : runs) {
+                Clock::time_point start = Clock::now();
+                renderer.render(camera, time, settings, eyeSeparation, run.mode, run.pixels);
+                run.wallSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+                run.recordSeconds += renderer.recordSeconds;
+                run.gpuMs.push_back(renderer.drawSeconds * 1000.0);
+            }
+            if (!output.empty()) {
+                std::string path = formatIndexPattern(output, i);
+                if (!writePpm(path, 2 * eyeExtent.width, eyeExtent.height, runs.back().pixels)) {
+                    std::cerr << "Error: failed to write " << path << std::endl;
+                    return -1;
+                }
+            }
+            if (runs.size() < 2) {
+                continue;
+            }
+            // Both modes trace the same rays, so any difference is a bug
+            const std::vector<uint8_t>& reference = runs[0].pixels;
+            const std::vector<uint8_t>& candidate = runs[1].pixels;
+            for (size_t p = 0; p < reference.size(); p += 4) {
+                int error = 0;
+                for (size_t c = 0; c < 3; ++c) {
+                    error = std::max(error, std::abs(int(reference[p + c]) - int(candidate[p + c])));
+                }
+                errorMax = std::max(errorMax, error);
+                differing += error > 0 ? 1 : 0;
+            }
+        }
+
+        std::snprintf(line, sizeof(line), "  %-9s %12s %12s %12s %12s %8s", "mode", "gpu ms mean", "gpu ms p95", "record ms",
+                      "wall ms", "speedup");
+        out << line << std::endl;
+        double twoPassMean = 0.0;
+        for (Run& run : runs) {
+            double mean = 0.0;
+            for (double ms : run.gpuMs) {
+                mean += ms;
+            }
+            mean /= run.gpuMs.size();
+            std::sort(run.gpuMs.begin(), run.gpuMs.end());
+            double p95 = run.gpuMs[std::min(run.gpuMs.size() - 1, run.gpuMs.size() * 95 / 100)];
+            if (&run == &runs[0]) {
+                twoPassMean = mean;
+            }
+            std::snprintf(line, sizeof(line), "  %-9s %12.3f %12.3f %12.4f %12.3f %7.2fx", run.name, mean, p95,
+                          run.recordSeconds * 1000.0 / frames, run.wallSeconds * 1000.0 / frames,
+                          mean > 0.0 ? twoPassMean / mean : 0.0);
+            out << line << std::endl;
+        }
+
+        if (runs.size() < 2) {
+            out << "  multiview: " << device.properties.deviceName << " has no multiview; nothing to compare" << std::endl;
+        } else {
+            double pixels = static_cast<double>(eyeExtent.width) * 2 * eyeExtent.height * frames;
+            std::snprintf(line, sizeof(line), "  multiview vs two-pass: max error %d (of 255), %.3f%% of pixels differ",
+                          errorMax, differing * 100.0 / pixels);
+            out << line << std::endl;
+        }
+        device.waitIdle();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
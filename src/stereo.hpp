@@ -0,0 +1,56 @@
+#pragma once
+#include "device.hpp"
+#include "memory.hpp"
+#include "resources.hpp"
+#include "pipeline.hpp"
+#include "settings.hpp"
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The StereoMode the device can run in place of mode: multiview falls back to two passes
+// without device.multiview, and both need dynamic rendering. Reports any fallback to out.
+uint32_t supportedStereoMode(const Device& device, uint32_t mode, std::ostream& out);
+
+// Renders both eyes of a stereo frame into a two-layer offscreen target, either with a pass
+// per eye or in one multiview pass, and reads them back side by side. Needs no window, so it
+// runs on a headless Device; requires dynamic rendering.
+struct StereoRenderer {
+    static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_SRGB; // Same encoding as the swapchain
+
+    const Device& device;
+    MemoryAllocator& allocator;
+    VkExtent2D eyeExtent;
+    Pipeline pipeline;                           // Two-pass: a draw per eye, selected by DrawConstants::view
+    std::unique_ptr<Pipeline> multiviewPipeline; // nullptr without device.multiview
+    VkImage image;
+    VkImageView arrayView;   // Both layers, for the multiview pass
+    VkImageView eyeViews[2]; // One layer each, for the two-pass passes
+    Allocation imageAllocation;
+    Buffer readback;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkQueryPool timestampPool; // VK_NULL_HANDLE when the graphics queue has no timestamps
+    double drawSeconds;        // GPU time of the last frame's scene passes; 0 without timestamps
+    double recordSeconds;      // CPU time spent recording the last frame's scene passes
+
+    StereoRenderer(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+                   VkExtent2D eyeExtent, const std::string& shaderOverrideDir = "");
+    ~StereoRenderer();
+
+    // Blocks until the frame is rendered; pixels receives the two eyes side by side as RGBA8
+    // texels, 2 * eyeExtent.width wide, top row first. mode is STEREO_TWO_PASS or STEREO_MULTIVIEW.
+    void render(const Camera& camera, float time, const RenderSettings& settings, float eyeSeparation,
+                uint32_t mode, std::vector<uint8_t>& pixels);
+};
+
+// Renders the same orbiting camera path in two-pass and multiview stereo on a headless device,
+// 1080p per eye, and prints GPU and recording times for each and how far their images differ.
+// With an output pattern (printf, taking the frame index) the multiview frames are written as
+// side-by-side PPM images. Returns the exit code.
+int runStereoBenchmark(std::ostream& out, const RenderSettings& settings, float fov, float eyeSeparation,
+                       const std::string& gpuSelection, const std::string& shaderOverrideDir, const std::string& output);
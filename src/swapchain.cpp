@@ -1,5 +1,8 @@
 #include "swapchain.hpp"
 #include "pipeline.hpp"
+#include "capture.hpp"
+#include "mesh.hpp"
+#include "jobs.hpp"
 #include <stdexcept>
 #include <algorithm>
 #include <imgui_impl_vulkan.h>
@@ -10,45 +13,288 @@ static PFN_vkVoidFunction ImGui_ImplVulkan_GetInstanceProcAddr(const char* name,
     return vkGetInstanceProcAddr(instance, name);
 }
 
-Swapchain::Swapchain(const Device& device) : device(device), currentFrame(0) {
-    // Query surface capabilities
-    VkSurfaceCapabilitiesKHR capabilities;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device.physicalDevice, device.surface, &capabilities);
+VkRenderPass Swapchain::createColorRenderPass(VkDevice device, VkFormat format, VkAttachmentLoadOp loadOp,
+                                              VkImageLayout initialLayout, VkImageLayout finalLayout,
+                                              VkFormat depthFormat, VkImageLayout depthLayout) {
+    VkAttachmentDescription attachments[2] = {};
+    VkAttachmentDescription& colorAttachment = attachments[0];
+    colorAttachment.format = format;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = loadOp;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = initialLayout;
+    colorAttachment.finalLayout = finalLayout;
 
+    VkAttachmentReference colorAttachmentRef = {};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    // Depth is loaded or cleared with the color and left in depthLayout; barriers around the
+    // passes do any transitions
+    VkAttachmentReference depthAttachmentRef = {};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = depthLayout;
+    if (depthFormat != VK_FORMAT_UNDEFINED) {
+        VkAttachmentDescription& depthAttachment = attachments[1];
+        depthAttachment.format = depthFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = loadOp;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = depthLayout;
+        depthAttachment.finalLayout = depthLayout;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+    }
+
+    VkSubpassDependency dependency = {};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    if (loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+        dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+    }
+    if (depthFormat != VK_FORMAT_UNDEFINED) {
+        dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        if (depthLayout != VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL) {
+            dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        }
+    }
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = depthFormat != VK_FORMAT_UNDEFINED ? 2 : 1;
+    renderPassInfo.pAttachments = attachments;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create render pass");
+    }
+    return renderPass;
+}
+
+VkSurfaceFormatKHR Swapchain::chooseSurfaceFormat(const Device& device) {
     uint32_t formatCount;
     vkGetPhysicalDeviceSurfaceFormatsKHR(device.physicalDevice, device.surface, &formatCount, nullptr);
     std::vector<VkSurfaceFormatKHR> formats(formatCount);
     vkGetPhysicalDeviceSurfaceFormatsKHR(device.physicalDevice, device.surface, &formatCount, formats.data());
 
-    uint32_t presentModeCount;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device.physicalDevice, device.surface, &presentModeCount, nullptr);
-    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(device.physicalDevice, device.surface, &presentModeCount, presentModes.data());
-
-    // Choose surface format
-    VkSurfaceFormatKHR surfaceFormat = formats[0];
     for (const auto& format : formats) {
         if (format.format == VK_FORMAT_B8G8R8A8_SRGB && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-            surfaceFormat = format;
-            break;
+            return format;
+        }
+    }
+    return formats[0];
+}
+
+VkFormat Swapchain::chooseDepthFormat(const Device& device) {
+    // The prepass march samples the depth, so it needs both uses; D16 is required to have them
+    const VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM};
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    for (VkFormat format : candidates) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device.physicalDevice, format, &formatProperties);
+        if ((formatProperties.optimalTilingFeatures & required) == required) {
+            return format;
         }
     }
+    throw std::runtime_error("No supported depth format");
+}
+
+Swapchain::Swapchain(const Device& device, MemoryAllocator& allocator, uint32_t rasterMode, uint32_t stereoMode)
+    : device(device), allocator(allocator), swapchain(VK_NULL_HANDLE), renderPass(VK_NULL_HANDLE),
+      offscreenRenderPass(VK_NULL_HANDLE), overlayRenderPass(VK_NULL_HANDLE), resolveRenderPass(VK_NULL_HANDLE),
+      scheduler(device), slotValues{}, currentFrame(0), framesInFlight(2), renderScale(1.0f), offscreenImage(VK_NULL_HANDLE),
+      offscreenView(VK_NULL_HANDLE), offscreenFramebuffer(VK_NULL_HANDLE), waitTime(0.0), gpuWaitTime(0.0), recreateCount(0), timestampPool(VK_NULL_HANDLE), timestampsRecorded{},
+      gpuSceneTime(0.0), gpuPostTime(0.0), gpuTimesRead(0), needsRecreate(false), capture(nullptr), resources(nullptr),
+      aaMode(AA_OFF), shaderPrecision(SHADER_PRECISION_AUTO), edgeImage(VK_NULL_HANDLE), edgeView(VK_NULL_HANDLE), rasterMode(rasterMode), meshes(nullptr), depthFormat(VK_FORMAT_UNDEFINED),
+      depthImage(VK_NULL_HANDLE), depthView(VK_NULL_HANDLE), depthSampler(VK_NULL_HANDLE), stereoMode(stereoMode),
+      eyeViews{VK_NULL_HANDLE, VK_NULL_HANDLE}, sceneFile(false), jobs(nullptr), parallelRects(false), persistentScene(false), sceneValid(false),
+      uploadedScene(false), redrawFraction(1.0f) {
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device.physicalDevice, device.surface, &presentModeCount, nullptr);
+    supportedPresentModes.resize(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(device.physicalDevice, device.surface, &presentModeCount, supportedPresentModes.data());
+
+    // Choose surface format
+    VkSurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(device);
     imageFormat = surfaceFormat.format;
+    colorSpace = surfaceFormat.colorSpace;
 
     // Choose present mode
     presentMode = VK_PRESENT_MODE_FIFO_KHR;
-    for (const auto& mode : presentModes) {
+    for (const auto& mode : supportedPresentModes) {
         if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
             presentMode = mode;
             break;
         }
     }
 
+    // Render scale needs a linear blit from the offscreen target into the swapchain image
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device.physicalDevice, device.surface, &capabilities);
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(device.physicalDevice, imageFormat, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    blitSupported = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures &&
+                    (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    captureSupported = (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) &&
+                       FrameCapture::supportsFormat(imageFormat);
+    if (stereoMode != STEREO_OFF && (!blitSupported || !device.dynamicRendering)) {
+        throw std::runtime_error("Stereo needs dynamic rendering and blits into the swapchain images");
+    }
+
+    createSwapchain(VK_NULL_HANDLE);
+
+    if (rasterMode != RASTER_OFF) {
+        depthFormat = chooseDepthFormat(device);
+    }
+    if (rasterMode == RASTER_PREPASS) {
+        // Only read with texelFetch, so the filter does not matter
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        if (vkCreateSampler(device.device, &samplerInfo, nullptr, &depthSampler) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create depth sampler");
+        }
+    }
+
+    // Render passes only on the Vulkan 1.0 path; dynamic rendering needs neither them nor framebuffers.
+    // The scene passes carry the raster depth; the march after a prepass keeps it read-only.
+    if (!device.dynamicRendering) {
+        VkImageLayout loadedDepthLayout = rasterMode == RASTER_PREPASS ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                                                       : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        renderPass = createColorRenderPass(device.device, imageFormat, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                           VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        offscreenRenderPass = createColorRenderPass(device.device, imageFormat, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                    depthFormat);
+        overlayRenderPass = createColorRenderPass(device.device, imageFormat, VK_ATTACHMENT_LOAD_OP_LOAD,
+                                                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        resolveRenderPass = createColorRenderPass(device.device, imageFormat, VK_ATTACHMENT_LOAD_OP_LOAD,
+                                                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                  depthFormat, loadedDepthLayout);
+        createFramebuffers();
+    }
+    createRenderTarget();
+
+    // Create command pool
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = device.graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    if (vkCreateCommandPool(device.device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create command pool");
+    }
+
+    // Allocate command buffers
+    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+    if (vkAllocateCommandBuffers(device.device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate command buffers");
+    }
+
+    // Create sync objects; frame slots are tracked by the scheduler's graphics timeline
+    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        if (vkCreateSemaphore(device.device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create synchronization objects");
+        }
+    }
+    createPresentSemaphores();
+
+    if (device.timestampValidBits > 0) {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = MAX_FRAMES_IN_FLIGHT * TIMESTAMP_QUERIES_PER_FRAME;
+        if (vkCreateQueryPool(device.device, &queryInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timestamp query pool");
+        }
+    }
+
+    // Load Vulkan function pointers for ImGui
+    ImGui_ImplVulkan_LoadFunctions(ImGui_ImplVulkan_GetInstanceProcAddr, (void*)&device.instance);
+
+    // Initialize ImGui Vulkan backend
+    ImGui_ImplVulkan_InitInfo initInfo = {};
+    initInfo.Instance = device.instance;
+    initInfo.PhysicalDevice = device.physicalDevice;
+    initInfo.Device = device.device;
+    initInfo.QueueFamily = device.graphicsFamily;
+    initInfo.Queue = device.graphicsQueue;
+    initInfo.PipelineCache = VK_NULL_HANDLE;
+    initInfo.DescriptorPool = device.descriptorPool;
+    initInfo.Allocator = nullptr;
+    initInfo.MinImageCount = minImageCount;
+    initInfo.ImageCount = static_cast<uint32_t>(images.size());
+    initInfo.RenderPass = renderPass;
+    initInfo.Subpass = 0;
+    initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    if (device.dynamicRendering) {
+        initInfo.UseDynamicRendering = true;
+        initInfo.PipelineRenderingCreateInfo = {};
+        initInfo.PipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        initInfo.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+        initInfo.PipelineRenderingCreateInfo.pColorAttachmentFormats = &imageFormat;
+    }
+    initInfo.CheckVkResultFn = [](VkResult err) {
+        if (err != VK_SUCCESS) throw std::runtime_error("ImGui Vulkan error");
+    };
+    if (!ImGui_ImplVulkan_Init(&initInfo)) {
+        throw std::runtime_error("Failed to initialize ImGui Vulkan backend");
+    }
+
+    // Upload ImGui fonts
+    if (!ImGui_ImplVulkan_CreateFontsTexture()) {
+        throw std::runtime_error("Failed to create ImGui fonts texture");
+    }
+
+    // Note: Fonts texture is automatically destroyed when ImGui_ImplVulkan_Shutdown is called
+}
+
+void Swapchain::createSwapchain(VkSwapchainKHR oldSwapchain) {
+    // Query surface capabilities
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device.physicalDevice, device.surface, &capabilities);
+
     // Choose extent
     if (capabilities.currentExtent.width != UINT32_MAX) {
         extent = capabilities.currentExtent;
     } else {
-        extent = {800, 600};
+        int width, height;
+        glfwGetFramebufferSize(device.window, &width, &height);
+        extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
         extent.width = std::clamp(extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
         extent.height = std::clamp(extent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
     }
@@ -58,16 +304,23 @@ Swapchain::Swapchain(const Device& device) : device(device), currentFrame(0) {
     if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
         imageCount = capabilities.maxImageCount;
     }
+    minImageCount = imageCount;
 
     VkSwapchainCreateInfoKHR createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     createInfo.surface = device.surface;
     createInfo.minImageCount = imageCount;
-    createInfo.imageFormat = surfaceFormat.format;
-    createInfo.imageColorSpace = surfaceFormat.colorSpace;
+    createInfo.imageFormat = imageFormat;
+    createInfo.imageColorSpace = colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (blitSupported) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    if (captureSupported) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
 
     uint32_t queueFamilyIndices[] = {device.graphicsFamily, device.presentFamily};
     if (device.graphicsFamily != device.presentFamily) {
@@ -82,7 +335,7 @@ Swapchain::Swapchain(const Device& device) : device(device), currentFrame(0) {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    createInfo.oldSwapchain = oldSwapchain;
 
     if (vkCreateSwapchainKHR(device.device, &createInfo, nullptr, &swapchain) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create swapchain");
@@ -111,233 +364,893 @@ Swapchain::Swapchain(const Device& device) : device(device), currentFrame(0) {
             throw std::runtime_error("Failed to create image views");
         }
     }
+}
 
-    // Create render pass
-    VkAttachmentDescription colorAttachment = {};
-    colorAttachment.format = imageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentRef = {};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+void Swapchain::destroySwapchainResources() {
+    for (auto framebuffer : framebuffers) {
+        vkDestroyFramebuffer(device.device, framebuffer, nullptr);
+    }
+    framebuffers.clear();
+    for (auto imageView : imageViews) {
+        vkDestroyImageView(device.device, imageView, nullptr);
+    }
+    imageViews.clear();
+}
 
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
+void Swapchain::createFramebuffers() {
+    framebuffers.resize(imageViews.size());
 
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    for (size_t i = 0; i < imageViews.size(); ++i) {
+        VkImageView attachments[] = {imageViews[i]};
 
-    VkRenderPassCreateInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
 
-    if (vkCreateRenderPass(device.device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create render pass");
+        if (vkCreateFramebuffer(device.device, &framebufferInfo, nullptr, &framebuffers[i]) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create framebuffer");
+        }
     }
+}
 
-    // Create command pool
-    VkCommandPoolCreateInfo poolInfo = {};
-    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.queueFamilyIndex = device.graphicsFamily;
-    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-    if (vkCreateCommandPool(device.device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create command pool");
+void Swapchain::createRenderTarget() {
+    // Each stereo eye gets half the window
+    uint32_t eyeCount = stereoMode != STEREO_OFF ? 2 : 1;
+    uint32_t maxDimension = device.properties.limits.maxImageDimension2D;
+    renderExtent.width = std::clamp(static_cast<uint32_t>(extent.width / eyeCount * renderScale + 0.5f), 1u, maxDimension);
+    renderExtent.height = std::clamp(static_cast<uint32_t>(extent.height * renderScale + 0.5f), 1u, maxDimension);
+    sceneValid = false;
+    if (renderExtent.width == extent.width && renderExtent.height == extent.height && !persistentScene && !uploadedScene &&
+        rasterMode == RASTER_OFF && stereoMode == STEREO_OFF) {
+        renderExtent = extent;
+        return;
     }
 
-    // Allocate command buffers
-    commandBuffers.resize(imageViews.size());
-    VkCommandBufferAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = imageFormat;
+    imageInfo.extent = {renderExtent.width, renderExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = eyeCount;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device.device, &imageInfo, nullptr, &offscreenImage) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create offscreen image");
+    }
 
-    if (vkAllocateCommandBuffers(device.device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to allocate command buffers");
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.device, offscreenImage, &memRequirements);
+    offscreenAllocation = allocator.allocate(memRequirements, MemoryUsage::GpuOnly, false);
+    vkBindImageMemory(device.device, offscreenImage, offscreenAllocation.memory, offscreenAllocation.offset);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = offscreenImage;
+    viewInfo.viewType = eyeCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = imageFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = eyeCount;
+
+    if (vkCreateImageView(device.device, &viewInfo, nullptr, &offscreenView) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create offscreen image view");
+    }
+    if (stereoMode == STEREO_TWO_PASS) {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.subresourceRange.layerCount = 1;
+        for (uint32_t eye = 0; eye < 2; ++eye) {
+            viewInfo.subresourceRange.baseArrayLayer = eye;
+            if (vkCreateImageView(device.device, &viewInfo, nullptr, &eyeViews[eye]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create eye image view");
+            }
+        }
+        viewInfo.subresourceRange.baseArrayLayer = 0;
     }
 
-    // Create sync objects
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    if (depthFormat != VK_FORMAT_UNDEFINED) {
+        imageInfo.format = depthFormat;
+        imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (rasterMode == RASTER_PREPASS) {
+            imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+        if (vkCreateImage(device.device, &imageInfo, nullptr, &depthImage) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create depth image");
+        }
+        vkGetImageMemoryRequirements(device.device, depthImage, &memRequirements);
+        depthAllocation = allocator.allocate(memRequirements, MemoryUsage::GpuOnly, false);
+        vkBindImageMemory(device.device, depthImage, depthAllocation.memory, depthAllocation.offset);
+
+        viewInfo.image = depthImage;
+        viewInfo.format = depthFormat;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (vkCreateImageView(device.device, &viewInfo, nullptr, &depthView) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create depth image view");
+        }
+        if (resources && rasterMode == RASTER_PREPASS) {
+            depthHandle = resources->registerTexture(depthView, depthSampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+        }
+    }
 
-    VkSemaphoreCreateInfo semaphoreInfo = {};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    if (offscreenRenderPass != VK_NULL_HANDLE) {
+        VkImageView attachments[] = {offscreenView, depthView};
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = offscreenRenderPass;
+        framebufferInfo.attachmentCount = depthView != VK_NULL_HANDLE ? 2 : 1;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = renderExtent.width;
+        framebufferInfo.height = renderExtent.height;
+        framebufferInfo.layers = 1;
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        if (vkCreateFramebuffer(device.device, &framebufferInfo, nullptr, &offscreenFramebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create offscreen framebuffer");
+        }
+    }
+}
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        if (vkCreateSemaphore(device.device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device.device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device.device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create synchronization objects");
+void Swapchain::destroyRenderTarget() {
+    if (offscreenImage == VK_NULL_HANDLE) {
+        return;
+    }
+    if (offscreenFramebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(device.device, offscreenFramebuffer, nullptr);
+        offscreenFramebuffer = VK_NULL_HANDLE;
+    }
+    for (VkImageView& eyeView : eyeViews) {
+        if (eyeView != VK_NULL_HANDLE) {
+            vkDestroyImageView(device.device, eyeView, nullptr);
+            eyeView = VK_NULL_HANDLE;
+        }
+    }
+    vkDestroyImageView(device.device, offscreenView, nullptr);
+    vkDestroyImage(device.device, offscreenImage, nullptr);
+    allocator.free(offscreenAllocation);
+    offscreenView = VK_NULL_HANDLE;
+    offscreenImage = VK_NULL_HANDLE;
+    if (depthImage != VK_NULL_HANDLE) {
+        // Callers have waited for the device, as for the edge keys
+        if (resources) {
+            resources->release(depthHandle, 0);
         }
+        depthHandle = ResourceHandle();
+        vkDestroyImageView(device.device, depthView, nullptr);
+        vkDestroyImage(device.device, depthImage, nullptr);
+        allocator.free(depthAllocation);
+        depthView = VK_NULL_HANDLE;
+        depthImage = VK_NULL_HANDLE;
     }
+}
 
-    // Load Vulkan function pointers for ImGui
-    ImGui_ImplVulkan_LoadFunctions(ImGui_ImplVulkan_GetInstanceProcAddr, (void*)&device.instance);
+void Swapchain::createEdgeTarget() {
+    if (aaMode == AA_OFF || !resources) {
+        return;
+    }
 
-    // Initialize ImGui Vulkan backend
-    ImGui_ImplVulkan_InitInfo initInfo = {};
-    initInfo.Instance = device.instance;
-    initInfo.PhysicalDevice = device.physicalDevice;
-    initInfo.Device = device.device;
-    initInfo.QueueFamily = device.graphicsFamily;
-    initInfo.Queue = device.graphicsQueue;
-    initInfo.PipelineCache = VK_NULL_HANDLE;
-    initInfo.DescriptorPool = device.descriptorPool;
-    initInfo.Allocator = nullptr;
-    initInfo.MinImageCount = imageCount;
-    initInfo.ImageCount = imageCount;
-    initInfo.RenderPass = renderPass;
-    initInfo.Subpass = 0;
-    initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
-    initInfo.CheckVkResultFn = [](VkResult err) {
-        if (err != VK_SUCCESS) throw std::runtime_error("ImGui Vulkan error");
-    };
-    if (!ImGui_ImplVulkan_Init(&initInfo)) {
-        throw std::runtime_error("Failed to initialize ImGui Vulkan backend");
+    // Keys are written with imageStore and read back with imageLoad, so rgba16f storage is all
+    // it needs; the format is in the resource table's declaration of storageImages
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    imageInfo.extent = {renderExtent.width, renderExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device.device, &imageInfo, nullptr, &edgeImage) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create edge key image");
     }
 
-    // Upload ImGui fonts
-    if (!ImGui_ImplVulkan_CreateFontsTexture()) {
-        throw std::runtime_error("Failed to create ImGui fonts texture");
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.device, edgeImage, &memRequirements);
+    edgeAllocation = allocator.allocate(memRequirements, MemoryUsage::GpuOnly, false);
+    vkBindImageMemory(device.device, edgeImage, edgeAllocation.memory, edgeAllocation.offset);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = edgeImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.device, &viewInfo, nullptr, &edgeView) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create edge key image view");
     }
+    edgeHandle = resources->registerStorageImage(edgeView);
+    sceneValid = false; // Partial frames read the keys around their rectangles
 
-    // Note: Fonts texture is automatically destroyed when ImGui_ImplVulkan_Shutdown is called
 }
 
-void Swapchain::createFramebuffers(const Pipeline& pipeline) {
-    framebuffers.resize(imageViews.size());
+void Swapchain::destroyEdgeTarget() {
+    if (edgeImage == VK_NULL_HANDLE) {
+        return;
+    }
+    // Callers have waited for the device, so the handle can be reused right away
+    resources->release(edgeHandle, 0);
+    edgeHandle = ResourceHandle();
+    vkDestroyImageView(device.device, edgeView, nullptr);
+    vkDestroyImage(device.device, edgeImage, nullptr);
+    allocator.free(edgeAllocation);
+    edgeView = VK_NULL_HANDLE;
+    edgeImage = VK_NULL_HANDLE;
+}
 
-    for (size_t i = 0; i < imageViews.size(); ++i) {
-        VkImageView attachments[] = {imageViews[i]};
+bool Swapchain::recreate() {
+    // A minimized window reports a zero extent; try again on a later frame
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device.physicalDevice, device.surface, &capabilities);
+    if (capabilities.currentExtent.width == 0 || capabilities.currentExtent.height == 0) {
+        needsRecreate = true;
+        return false;
+    }
 
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = extent.width;
-        framebufferInfo.height = extent.height;
-        framebufferInfo.layers = 1;
+    vkDeviceWaitIdle(device.device);
+    ++recreateCount;
+    destroyEdgeTarget();
+    destroyRenderTarget();
+    destroySwapchainResources();
+    VkSwapchainKHR oldSwapchain = swapchain;
+    createSwapchain(oldSwapchain);
+    vkDestroySwapchainKHR(device.device, oldSwapchain, nullptr);
+    if (renderPass != VK_NULL_HANDLE) {
+        createFramebuffers();
+    }
+    createRenderTarget();
+    createEdgeTarget();
 
-        if (vkCreateFramebuffer(device.device, &framebufferInfo, nullptr, &framebuffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create framebuffer");
+    if (renderFinishedSemaphores.size() != images.size()) {
+        destroyPresentSemaphores();
+        createPresentSemaphores();
+    }
+    ImGui_ImplVulkan_SetMinImageCount(minImageCount);
+
+    // Pipelines use dynamic viewport/scissor, so nothing else depends on the extent
+    needsRecreate = false;
+    return true;
+}
+
+void Swapchain::applySettings(RenderSettings& settings) {
+    settings.framesInFlight = std::clamp(settings.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+    settings.renderScale = blitSupported ? std::clamp(settings.renderScale, 0.25f, 2.0f) : 1.0f;
+    if (std::find(supportedPresentModes.begin(), supportedPresentModes.end(), settings.presentMode) == supportedPresentModes.end()) {
+        settings.presentMode = presentMode;
+    }
+    // The edge keys are stored from the fragment shader
+    if (!resources || !device.fragmentStoresAndAtomics) {
+        settings.aaMode = AA_OFF;
+    }
+    settings.aaSamples = std::clamp(settings.aaSamples, 2, 16);
+    // The kept scene reaches the swapchain image by blit, as at other scales
+    settings.dirtyRegions = settings.dirtyRegions && blitSupported;
+    // The CPU image is copied into the offscreen target as 8-bit RGBA or BGRA; it has no edge
+    // keys or partial frames
+    bool byteFormat = imageFormat == VK_FORMAT_B8G8R8A8_SRGB || imageFormat == VK_FORMAT_B8G8R8A8_UNORM ||
+                      imageFormat == VK_FORMAT_R8G8B8A8_SRGB || imageFormat == VK_FORMAT_R8G8B8A8_UNORM;
+    settings.cpuRender = settings.cpuRender && blitSupported && byteFormat;
+    if (settings.cpuRender) {
+        settings.aaMode = AA_OFF;
+        settings.dirtyRegions = false;
+    }
+    // Meshes are composited by the GPU march over whole frames; stereo marches both eyes in full,
+    // and the single-layer edge keys and dirty regions only follow one view
+    if (rasterMode != RASTER_OFF || stereoMode != STEREO_OFF) {
+        settings.cpuRender = false;
+        settings.dirtyRegions = false;
+    }
+    if (stereoMode != STEREO_OFF) {
+        settings.aaMode = AA_OFF;
+    }
+    // Both track the built-in scene's objects
+    if (sceneFile) {
+        settings.cpuRender = false;
+        settings.dirtyRegions = false;
+    }
+    // The float16 variant only exists with shaderFloat16
+    if (settings.shaderPrecision == SHADER_PRECISION_FP16 && !device.shaderFloat16) {
+        settings.shaderPrecision = SHADER_PRECISION_FP32;
+    }
+    shaderPrecision = settings.shaderPrecision;
+
+    if (settings.presentMode != presentMode) {
+        presentMode = settings.presentMode;
+        recreate();
+    }
+    if (settings.framesInFlight != framesInFlight) {
+        // Every slot is idle afterwards, so restarting at slot 0 is safe
+        vkDeviceWaitIdle(device.device);
+        if (capture) {
+            capture->flush();
         }
+        framesInFlight = settings.framesInFlight;
+        currentFrame = 0;
+    }
+    if (settings.renderScale != renderScale || settings.dirtyRegions != persistentScene || settings.cpuRender != uploadedScene) {
+        vkDeviceWaitIdle(device.device);
+        renderScale = settings.renderScale;
+        persistentScene = settings.dirtyRegions;
+        uploadedScene = settings.cpuRender;
+        destroyRenderTarget();
+        createRenderTarget();
+        destroyEdgeTarget();
+        createEdgeTarget();
+    }
+    if ((settings.aaMode != AA_OFF) != (aaMode != AA_OFF)) {
+        vkDeviceWaitIdle(device.device);
+        aaMode = settings.aaMode;
+        destroyEdgeTarget();
+        createEdgeTarget();
     }
+    aaMode = settings.aaMode;
 }
 
 void Swapchain::renderImGui(VkCommandBuffer commandBuffer) {
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
 }
 
-void Swapchain::drawFrame(const Pipeline& pipeline, bool showImGuiWindow) {
-    vkWaitForFences(device.device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+void Swapchain::transitionImage(VkCommandBuffer commandBuffer, VkImage image,
+                                VkImageLayout oldLayout, VkImageLayout newLayout,
+                                VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+                                VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess, VkImageAspectFlags aspect) {
+    if (!device.dynamicRendering) {
+        // Vulkan 1.0: the stage/access bits used here have the same values as their legacy counterparts
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = static_cast<VkAccessFlags>(srcAccess);
+        barrier.dstAccessMask = static_cast<VkAccessFlags>(dstAccess);
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = aspect;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        VkPipelineStageFlags legacySrc = srcStage ? static_cast<VkPipelineStageFlags>(srcStage) : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkPipelineStageFlags legacyDst = dstStage ? static_cast<VkPipelineStageFlags>(dstStage) : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, legacySrc, legacyDst, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        return;
+    }
+
+    VkImageMemoryBarrier2 barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStage;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dstStage;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS; // Both eyes of a stereo target
+
+    VkDependencyInfo dependencyInfo = {};
+    dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependencyInfo.imageMemoryBarrierCount = 1;
+    dependencyInfo.pImageMemoryBarriers = &barrier;
+    device.cmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void Swapchain::createPresentSemaphores() {
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    renderFinishedSemaphores.resize(images.size());
+    for (VkSemaphore& semaphore : renderFinishedSemaphores) {
+        if (vkCreateSemaphore(device.device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create synchronization objects");
+        }
+    }
+}
+
+void Swapchain::destroyPresentSemaphores() {
+    for (VkSemaphore semaphore : renderFinishedSemaphores) {
+        vkDestroySemaphore(device.device, semaphore, nullptr);
+    }
+    renderFinishedSemaphores.clear();
+}
+
+void Swapchain::waitForFrame() {
+    double waitStart = glfwGetTime();
+    scheduler.wait(QueueType::Graphics, slotValues[currentFrame]);
+    waitTime = glfwGetTime() - waitStart;
+}
+
+void Swapchain::beginColorPass(VkCommandBuffer commandBuffer, VkImageView view, VkFramebuffer framebuffer,
+                               VkRenderPass pass, VkExtent2D area, VkAttachmentLoadOp loadOp,
+                               VkImageView depthView, bool depthReadOnly, uint32_t viewMask, bool secondaryContents) {
+    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+    VkClearValue clearDepth = {};
+    clearDepth.depthStencil.depth = 1.0f;
+
+    if (device.dynamicRendering) {
+        VkRenderingAttachmentInfo colorAttachment = {};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = view;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = loadOp;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearColor;
+
+        // The depth buffer follows the color target's load op
+        VkRenderingAttachmentInfo depthAttachment = {};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = depthView;
+        depthAttachment.imageLayout = depthReadOnly ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                                                    : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = loadOp;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.clearValue = clearDepth;
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.flags = secondaryContents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+        renderingInfo.renderArea.offset = {0, 0};
+        renderingInfo.renderArea.extent = area;
+        renderingInfo.layerCount = 1;
+        renderingInfo.viewMask = viewMask;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        if (depthView != VK_NULL_HANDLE) {
+            renderingInfo.pDepthAttachment = &depthAttachment;
+        }
+        device.cmdBeginRendering(commandBuffer, &renderingInfo);
+    } else {
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = pass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = area;
+        VkClearValue clearValues[] = {clearColor, clearDepth};
+        renderPassInfo.clearValueCount = depthView != VK_NULL_HANDLE ? 2 : 1;
+        renderPassInfo.pClearValues = clearValues;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                             secondaryContents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+    }
+}
+
+void Swapchain::endColorPass(VkCommandBuffer commandBuffer) {
+    if (device.dynamicRendering) {
+        device.cmdEndRendering(commandBuffer);
+    } else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+void Swapchain::bindScene(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkExtent2D area, const DrawConstants& constants) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.select(shaderPrecision));
+
+    // Viewport and scissor are dynamic state so the pipeline works at any extent
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(area.width);
+    viewport.height = static_cast<float>(area.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkDescriptorSet descriptorSets[] = {pipeline.descriptorSets[currentFrame], pipeline.resourceSet};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+    pipeline.pushDrawConstants(commandBuffer, constants);
+}
+
+void Swapchain::drawScene(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkExtent2D area, const DrawConstants& constants,
+                          const std::vector<VkRect2D>* rects) {
+    if (rects && parallelRects) {
+        recordRectsInParallel(commandBuffer, pipeline, area, constants, *rects);
+        return;
+    }
+    bindScene(commandBuffer, pipeline, area, constants);
+
+    // The fullscreen triangle is cut down to each rect by the scissor
+    if (rects) {
+        for (const VkRect2D& rect : *rects) {
+            vkCmdSetScissor(commandBuffer, 0, 1, &rect);
+            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        }
+        return;
+    }
+    VkRect2D scissor = {};
+    scissor.offset = {0, 0};
+    scissor.extent = area;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
+
+void Swapchain::recordRectsInParallel(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkExtent2D area,
+                                      const DrawConstants& constants, const std::vector<VkRect2D>& rects) {
+    if (!recordPools) {
+        recordPools = std::make_unique<ThreadCommandPools>(device, jobs->getThreadCount(), MAX_FRAMES_IN_FLIGHT);
+    }
+
+    // Partial frames have no depth attachment or views: raster and stereo turn dirty regions off
+    VkCommandBufferInheritanceRenderingInfo inheritanceRendering = {};
+    inheritanceRendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritanceRendering.colorAttachmentCount = 1;
+    inheritanceRendering.pColorAttachmentFormats = &imageFormat;
+    inheritanceRendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    if (device.dynamicRendering) {
+        inheritance.pNext = &inheritanceRendering;
+    } else {
+        inheritance.renderPass = resolveRenderPass;
+        inheritance.framebuffer = offscreenFramebuffer;
+    }
+
+    // A buffer per thread, unless that would leave too few rects in each
+    uint32_t count = static_cast<uint32_t>(rects.size());
+    uint32_t threadCount = jobs->getThreadCount();
+    uint32_t grain = std::max(RECTS_PER_SECONDARY, (count + threadCount - 1) / threadCount);
+    std::vector<VkCommandBuffer> secondaries((count + grain - 1) / grain);
+    jobs->parallelFor(count, grain, [&](uint32_t begin, uint32_t end, uint32_t worker) {
+        VkCommandBuffer secondary = recordPools->begin(worker, currentFrame, inheritance);
+        bindScene(secondary, pipeline, area, constants);
+        for (uint32_t i = begin; i < end; ++i) {
+            vkCmdSetScissor(secondary, 0, 1, &rects[i]);
+            vkCmdDraw(secondary, 3, 1, 0, 0);
+        }
+        if (vkEndCommandBuffer(secondary) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record secondary command buffer");
+        }
+        secondaries[begin / grain] = secondary;
+    });
+    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+}
+
+void Swapchain::resolveEdges(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkImage target, VkImageLayout targetLayout,
+                             VkImageView view, VkFramebuffer framebuffer, VkRenderPass pass, VkExtent2D area,
+                             const std::vector<VkRect2D>* rects, VkImageView depthAttachment) {
+    endColorPass(commandBuffer);
+
+    // Keys stored by the primary draw are read by the resolve draw's neighbours, and the
+    // resolve only overwrites the pixels it supersamples
+    transitionImage(commandBuffer, edgeImage,
+                    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                    VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT);
+    transitionImage(commandBuffer, target,
+                    targetLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+    if (depthAttachment != VK_NULL_HANDLE && rasterMode == RASTER_DEPTH) {
+        // The resolve rewrites the depth of the pixels it supersamples
+        transitionImage(commandBuffer, depthImage,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                        VK_IMAGE_ASPECT_DEPTH_BIT);
+    }
+
+    beginColorPass(commandBuffer, view, framebuffer, pass, area, VK_ATTACHMENT_LOAD_OP_LOAD,
+                   depthAttachment, rasterMode == RASTER_PREPASS, 0, rects && parallelRects);
+    DrawConstants constants;
+    constants.pass = DRAW_PASS_RESOLVE;
+    constants.edgeImage = edgeHandle.index;
+    drawScene(commandBuffer, pipeline, area, constants, rects);
+}
+
+void Swapchain::drawFrame(const Pipeline& pipeline, bool showImGuiWindow, const std::vector<VkRect2D>* dirtyRects,
+                          VkBuffer sceneUpload) {
+    if (needsRecreate && !recreate()) {
+        return;
+    }
+
+    // Returns immediately if waitForFrame() already waited on this slot
+    scheduler.wait(QueueType::Graphics, slotValues[currentFrame]);
+    if (capture) {
+        // Copies recorded the last time this slot was used are now complete
+        capture->frameCompleted(currentFrame);
+    }
+    if (recordPools) {
+        recordPools->reset(currentFrame);
+    }
+    if (timestampsRecorded[currentFrame]) {
+        uint64_t timestamps[TIMESTAMP_QUERIES_PER_FRAME];
+        if (vkGetQueryPoolResults(device.device, timestampPool, currentFrame * TIMESTAMP_QUERIES_PER_FRAME,
+                                  TIMESTAMP_QUERIES_PER_FRAME, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            gpuSceneTime = device.timestampSeconds(timestamps[0], timestamps[1]);
+            gpuPostTime = device.timestampSeconds(timestamps[1], timestamps[2]);
+            ++gpuTimesRead;
+        }
+        timestampsRecorded[currentFrame] = false;
+    }
 
+    double acquireStart = glfwGetTime();
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR(device.device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    waitTime += glfwGetTime() - acquireStart;
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        // Handle swapchain recreation if needed
+        recreate();
         return;
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         throw std::runtime_error("Failed to acquire swapchain image");
     }
 
-    vkResetFences(device.device, 1, &inFlightFences[currentFrame]);
-
-    vkResetCommandBuffer(commandBuffers[imageIndex], 0);
+    VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
+    vkResetCommandBuffer(commandBuffer, 0);
 
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    if (vkBeginCommandBuffer(commandBuffers[imageIndex], &beginInfo) != VK_SUCCESS) {
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("Failed to begin command buffer");
     }
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, timestampPool, currentFrame * TIMESTAMP_QUERIES_PER_FRAME, TIMESTAMP_QUERIES_PER_FRAME);
+    }
+    writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
+    // A partial frame only marches the dirty rects and keeps the rest of the last frame's scene
+    bool partial = dirtyRects && persistentScene && sceneValid && offscreenImage != VK_NULL_HANDLE;
+    const std::vector<VkRect2D>* sceneRects = partial ? dirtyRects : nullptr;
+    redrawFraction = 1.0f;
+    if (partial) {
+        uint64_t pixels = 0;
+        for (const VkRect2D& rect : *dirtyRects) {
+            pixels += static_cast<uint64_t>(rect.extent.width) * rect.extent.height;
+        }
+        redrawFraction = static_cast<float>(pixels) / (static_cast<float>(renderExtent.width) * renderExtent.height);
+    }
+    parallelRects = partial && jobs && jobs->getThreadCount() > 1 && dirtyRects->size() >= 2 * RECTS_PER_SECONDARY;
+
+    DrawConstants primary;
+    if (edgeImage != VK_NULL_HANDLE) {
+        // A full frame rewrites every key, so the old contents can be dropped; a partial one
+        // reads the kept keys around its rects
+        primary.edgeImage = edgeHandle.index;
+        transitionImage(commandBuffer, edgeImage,
+                        partial ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+    }
 
-    VkRenderPassBeginInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = framebuffers[imageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = extent;
-
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-
-    vkCmdBeginRenderPass(commandBuffers[imageIndex], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.graphicsPipeline);
-
-    VkDescriptorSet descriptorSets[] = {pipeline.descriptorSets[currentFrame]};
-    vkCmdBindDescriptorSets(commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, 1, descriptorSets, 0, nullptr);
-
-    vkCmdDraw(commandBuffers[imageIndex], 3, 1, 0, 0);
+    if (offscreenImage == VK_NULL_HANDLE) {
+        // Native resolution: scene and ImGui straight into the swapchain image
+        if (device.dynamicRendering) {
+            transitionImage(commandBuffer, images[imageIndex],
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+        }
+        VkFramebuffer framebuffer = renderPass != VK_NULL_HANDLE ? framebuffers[imageIndex] : VK_NULL_HANDLE;
+        beginColorPass(commandBuffer, imageViews[imageIndex], framebuffer, renderPass, extent, VK_ATTACHMENT_LOAD_OP_CLEAR);
+        drawScene(commandBuffer, pipeline, extent, primary);
+        if (edgeImage != VK_NULL_HANDLE) {
+            // The fallback's scene pass ends in PRESENT_SRC; the overlay pass takes it back there
+            VkImageLayout sceneLayout = device.dynamicRendering ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            resolveEdges(commandBuffer, pipeline, images[imageIndex], sceneLayout, imageViews[imageIndex], framebuffer,
+                         overlayRenderPass, extent);
+        }
+        writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+    } else {
+        // Scaled: scene into the offscreen target, linear blit to the swapchain image, ImGui at full resolution.
+        // A partial frame with nothing dirty leaves the target as the last blit left it.
+        if (sceneUpload != VK_NULL_HANDLE) {
+            transitionImage(commandBuffer, offscreenImage,
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, 0,
+                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+            VkBufferImageCopy region = {};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = {renderExtent.width, renderExtent.height, 1};
+            vkCmdCopyBufferToImage(commandBuffer, sceneUpload, offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            transitionImage(commandBuffer, offscreenImage,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+        } else if (!partial || !dirtyRects->empty()) {
+            // The last frame's blit left the kept scene in TRANSFER_SRC
+            transitionImage(commandBuffer, offscreenImage,
+                            partial ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, 0,
+                            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+            if (depthImage != VK_NULL_HANDLE) {
+                // Raster frames are never partial, so last frame's depth is dropped
+                transitionImage(commandBuffer, depthImage,
+                                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, 0,
+                                VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                VK_IMAGE_ASPECT_DEPTH_BIT);
+            }
+            if (stereoMode == STEREO_TWO_PASS) {
+                // A pass and draw per eye layer, as recorded without multiview
+                for (uint32_t eye = 0; eye < 2; ++eye) {
+                    beginColorPass(commandBuffer, eyeViews[eye], VK_NULL_HANDLE, VK_NULL_HANDLE, renderExtent,
+                                   VK_ATTACHMENT_LOAD_OP_CLEAR);
+                    primary.view = eye;
+                    drawScene(commandBuffer, pipeline, renderExtent, primary);
+                    endColorPass(commandBuffer);
+                }
+            } else {
+                // Mono, or multiview drawing each eye into its own layer of offscreenView in one pass
+                beginColorPass(commandBuffer, offscreenView, offscreenFramebuffer, partial ? resolveRenderPass : offscreenRenderPass,
+                               renderExtent, partial ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR, depthView, false,
+                               stereoMode == STEREO_MULTIVIEW ? 0x3 : 0, parallelRects);
+                if (rasterMode == RASTER_PREPASS && meshes) {
+                    // Meshes first; the march then reads their depth to stop its rays at them and
+                    // depth tests against it without writing
+                    meshes->draw(commandBuffer, renderExtent);
+                    endColorPass(commandBuffer);
+                    transitionImage(commandBuffer, offscreenImage,
+                                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                                    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+                    transitionImage(commandBuffer, depthImage,
+                                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                    VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                    VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT |
+                                        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT,
+                                    VK_IMAGE_ASPECT_DEPTH_BIT);
+                    if (resources && !depthHandle.valid()) {
+                        // The target was created before the resource table was attached; nothing
+                        // is in flight yet on the first frame
+                        depthHandle = resources->registerTexture(depthView, depthSampler,
+                                                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+                    }
+                    beginColorPass(commandBuffer, offscreenView, offscreenFramebuffer, resolveRenderPass, renderExtent,
+                                   VK_ATTACHMENT_LOAD_OP_LOAD, depthView, true);
+                    primary.rasterDepth = depthHandle.index;
+                }
+                drawScene(commandBuffer, pipeline, renderExtent, primary, sceneRects);
+                if (edgeImage != VK_NULL_HANDLE) {
+                    resolveEdges(commandBuffer, pipeline, offscreenImage, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, offscreenView,
+                                 offscreenFramebuffer, resolveRenderPass, renderExtent, sceneRects, depthView);
+                }
+                if (rasterMode == RASTER_DEPTH && meshes) {
+                    // Depth tested against the march's hits
+                    meshes->draw(commandBuffer, renderExtent);
+                }
+                endColorPass(commandBuffer);
+            }
+
+            transitionImage(commandBuffer, offscreenImage,
+                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+        }
+        sceneValid = true;
+        writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+        transitionImage(commandBuffer, images[imageIndex],
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+        // Stereo eyes go side by side, the left eye from layer 0
+        uint32_t eyeCount = stereoMode != STEREO_OFF ? 2 : 1;
+        VkImageBlit blits[2] = {};
+        for (uint32_t eye = 0; eye < eyeCount; ++eye) {
+            VkImageBlit& blit = blits[eye];
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.baseArrayLayer = eye;
+            blit.srcSubresource.layerCount = 1;
+            blit.srcOffsets[1] = {static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1};
+            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.dstSubresource.layerCount = 1;
+            blit.dstOffsets[0] = {static_cast<int32_t>(extent.width * eye / eyeCount), 0, 0};
+            blit.dstOffsets[1] = {static_cast<int32_t>(extent.width * (eye + 1) / eyeCount), static_cast<int32_t>(extent.height), 1};
+        }
+        vkCmdBlitImage(commandBuffer, offscreenImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       images[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, eyeCount, blits, VK_FILTER_LINEAR);
+
+        transitionImage(commandBuffer, images[imageIndex],
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                        VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+        beginColorPass(commandBuffer, imageViews[imageIndex], renderPass != VK_NULL_HANDLE ? framebuffers[imageIndex] : VK_NULL_HANDLE,
+                       overlayRenderPass, extent, VK_ATTACHMENT_LOAD_OP_LOAD);
+    }
 
     if (showImGuiWindow) {
-        renderImGui(commandBuffers[imageIndex]);
+        renderImGui(commandBuffer);
     }
 
-    vkCmdEndRenderPass(commandBuffers[imageIndex]);
-
-    if (vkEndCommandBuffer(commandBuffers[imageIndex]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to record command buffer");
+    endColorPass(commandBuffer);
+    if (capture && capture->isActive() && captureSupported) {
+        // The render pass fallback has already moved the image to PRESENT_SRC
+        VkImageLayout passLayout = device.dynamicRendering ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        transitionImage(commandBuffer, images[imageIndex],
+                        passLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+        capture->recordCopy(commandBuffer, currentFrame, images[imageIndex], extent, imageFormat);
+        transitionImage(commandBuffer, images[imageIndex],
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                        VK_PIPELINE_STAGE_2_TRANSFER_BIT, 0,
+                        VK_PIPELINE_STAGE_2_NONE, 0);
+    } else if (device.dynamicRendering) {
+        transitionImage(commandBuffer, images[imageIndex],
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_PIPELINE_STAGE_2_NONE, 0);
     }
 
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    writeTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 2);
+    timestampsRecorded[currentFrame] = timestampPool != VK_NULL_HANDLE;
 
-    VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-
-    VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    if (vkQueueSubmit(device.graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to submit draw command buffer");
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record command buffer");
     }
 
+    // Image acquisition plus any async compute/transfer work queued via addWaitSemaphore or
+    // addTimelineWait; the submit's timeline value marks when the slot is free again
+    std::vector<VkSemaphore> waitSemaphores = {imageAvailableSemaphores[currentFrame]};
+    std::vector<VkPipelineStageFlags> waitStages = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    waitSemaphores.insert(waitSemaphores.end(), pendingWaitSemaphores.begin(), pendingWaitSemaphores.end());
+    waitStages.insert(waitStages.end(), pendingWaitStages.begin(), pendingWaitStages.end());
+    VkSemaphore renderFinished = renderFinishedSemaphores[imageIndex];
+    slotValues[currentFrame] = scheduler.submit(QueueType::Graphics, {commandBuffer}, waitSemaphores, waitStages,
+                                                pendingTimelineWaits, {renderFinished});
+    pendingWaitSemaphores.clear();
+    pendingWaitStages.clear();
+    pendingTimelineWaits.clear();
+    gpuWaitTime = scheduler.frameWaitSeconds;
+    scheduler.beginFrame();
+
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinished;
 
     VkSwapchainKHR swapchains[] = {swapchain};
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapchains;
     presentInfo.pImageIndices = &imageIndex;
 
-    vkQueuePresentKHR(device.presentQueue, &presentInfo);
+    result = vkQueuePresentKHR(device.presentQueue, &presentInfo);
+
+    currentFrame = (currentFrame + 1) % framesInFlight;
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        recreate();
+    } else if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to present swapchain image");
+    }
+}
+
+void Swapchain::writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t query) {
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, stage, timestampPool, currentFrame * TIMESTAMP_QUERIES_PER_FRAME + query);
+    }
+}
+
+void Swapchain::addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags stage) {
+    pendingWaitSemaphores.push_back(semaphore);
+    pendingWaitStages.push_back(stage);
+}
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+void Swapchain::addTimelineWait(QueueType queue, uint64_t value, VkPipelineStageFlags stage) {
+    pendingTimelineWaits.push_back({queue, value, stage});
 }
 
 uint32_t Swapchain::getImageCount() const {
@@ -350,18 +1263,26 @@ VkPresentModeKHR Swapchain::getPresentMode() const {
 
 Swapchain::~Swapchain() {
     ImGui_ImplVulkan_Shutdown();
-    for (auto framebuffer : framebuffers) {
-        vkDestroyFramebuffer(device.device, framebuffer, nullptr);
+    destroyEdgeTarget();
+    destroyRenderTarget();
+    destroySwapchainResources();
+    if (renderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(device.device, renderPass, nullptr);
+        vkDestroyRenderPass(device.device, offscreenRenderPass, nullptr);
+        vkDestroyRenderPass(device.device, overlayRenderPass, nullptr);
+        vkDestroyRenderPass(device.device, resolveRenderPass, nullptr);
     }
-    vkDestroyRenderPass(device.device, renderPass, nullptr);
-    vkDestroyCommandPool(device.device, commandPool, nullptr);
-    for (auto imageView : imageViews) {
-        vkDestroyImageView(device.device, imageView, nullptr);
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device.device, timestampPool, nullptr);
     }
+    if (depthSampler != VK_NULL_HANDLE) {
+        vkDestroySampler(device.device, depthSampler, nullptr);
+    }
+    vkDestroyCommandPool(device.device, commandPool, nullptr);
+    recordPools.reset();
     vkDestroySwapchainKHR(device.device, swapchain, nullptr);
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-        vkDestroySemaphore(device.device, imageAvailableSemaphores[i], nullptr);
-        vkDestroySemaphore(device.device, renderFinishedSemaphores[i], nullptr);
-        vkDestroyFence(device.device, inFlightFences[i], nullptr);
+    for (VkSemaphore semaphore : imageAvailableSemaphores) {
+        vkDestroySemaphore(device.device, semaphore, nullptr);
     }
+    destroyPresentSemaphores();
 }
@@ -1,35 +1,186 @@
 #pragma once
 #include "device.hpp"
+#include "memory.hpp"
+#include "resources.hpp"
+#include "settings.hpp"
+#include "scheduler.hpp"
 #include <vulkan/vulkan.h>
+#include <memory>
 #include <vector>
 #include <imgui.h>
 
 struct Pipeline; // Forward declaration
+struct DrawConstants;
+struct FrameCapture;
+struct MeshRenderer;
+struct JobSystem;
+struct ThreadCommandPools;
 
 struct Swapchain {
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3; // Per-frame resources are sized for this
+    static constexpr uint32_t RECTS_PER_SECONDARY = 128; // Fewest dirty rects per parallel-recorded buffer
+
     const Device& device;
+    MemoryAllocator& allocator;
     VkSwapchainKHR swapchain;
     std::vector<VkImage> images;
     std::vector<VkImageView> imageViews;
     VkFormat imageFormat;
+    VkColorSpaceKHR colorSpace;
     VkExtent2D extent;
-    std::vector<VkFramebuffer> framebuffers;
-    VkRenderPass renderPass;
+    uint32_t minImageCount;
+    std::vector<VkFramebuffer> framebuffers; // Render pass fallback only
+    VkRenderPass renderPass;                 // VK_NULL_HANDLE with dynamic rendering
+    VkRenderPass offscreenRenderPass;        // Fallback: scene into the scaled target
+    VkRenderPass overlayRenderPass;          // Fallback: ImGui over the upscaled image
+    VkRenderPass resolveRenderPass;          // Fallback: adaptive AA resolve into the scaled target
     VkCommandPool commandPool;
-    std::vector<VkCommandBuffer> commandBuffers;
-    std::vector<VkSemaphore> imageAvailableSemaphores;
+    // Per-frame resources belong to a frame slot, reused once the graphics timeline has reached
+    // the value of the slot's last submit
+    FrameScheduler scheduler;
+    uint64_t slotValues[MAX_FRAMES_IN_FLIGHT];
+    std::vector<VkCommandBuffer> commandBuffers;       // One per frame slot
+    std::vector<VkSemaphore> imageAvailableSemaphores; // One per frame slot
+    // One per swapchain image: present may still hold it until that image is acquired again
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
     uint32_t currentFrame;
-    const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+    uint32_t framesInFlight; // Active slots, <= MAX_FRAMES_IN_FLIGHT
     VkPresentModeKHR presentMode;
+    std::vector<VkPresentModeKHR> supportedPresentModes;
+    // Scene is rendered at extent * renderScale into an offscreen target and blitted to
+    // the swapchain image; at scale 1 it renders straight into the swapchain image
+    float renderScale;
+    bool blitSupported;
+    VkExtent2D renderExtent;
+    VkImage offscreenImage; // VK_NULL_HANDLE at scale 1, unless persistentScene, uploadedScene, rasterMode or stereoMode
+    VkImageView offscreenView;
+    VkFramebuffer offscreenFramebuffer;
+    Allocation offscreenAllocation;
+    // Dirty regions: the offscreen target is kept at every scale and holds the last frame's
+    // scene, so a frame can re-march only the rectangles that changed
+    bool persistentScene;
+    bool sceneValid;      // Offscreen target holds a complete scene
+    // CPU raymarcher: the scene is copied into the offscreen target from a host buffer
+    bool uploadedScene;
+    float redrawFraction; // Share of scene pixels marched in the last frame
+    double waitTime; // Seconds the last frame spent blocked on the GPU and acquire
+    double gpuWaitTime; // Of waitTime, seconds blocked on the GPU timeline
+    uint64_t recreateCount; // Swapchain recreations since startup
+    // GPU pass timings from TIMESTAMP_QUERIES_PER_FRAME queries per frame slot, read once the
+    // slot's fence has signalled: the scene (upload or march, AA resolve) and the rest (upscale
+    // blit, ImGui, capture copy). gpuTimesRead counts readings, so callers can spot new ones.
+    static constexpr uint32_t TIMESTAMP_QUERIES_PER_FRAME = 3;
+    VkQueryPool timestampPool; // VK_NULL_HANDLE when the graphics queue has no timestamps
+    bool timestampsRecorded[MAX_FRAMES_IN_FLIGHT];
+    double gpuSceneTime;
+    double gpuPostTime;
+    uint64_t gpuTimesRead;
+    std::vector<VkSemaphore> pendingWaitSemaphores; // Extra waits for the next graphics submit
+    std::vector<VkPipelineStageFlags> pendingWaitStages;
+    std::vector<TimelineWait> pendingTimelineWaits;
+    bool needsRecreate; // Set while the window is minimized
+    // Frame capture copies the finished swapchain image, which needs TRANSFER_SRC usage
+    bool captureSupported;
+    FrameCapture* capture; // Optional; recorded frames are copied into it before present
+    // Adaptive AA: the primary draw stores a per-pixel (object, depth) key at renderExtent,
+    // and a second draw supersamples the pixels whose neighbours differ
+    ResourceTable* resources; // Optional; adaptive AA stays off without it
+    uint32_t aaMode;
+    uint32_t shaderPrecision; // Passed to Pipeline::select for the scene draws
+    VkImage edgeImage; // VK_NULL_HANDLE while AA is off
+    VkImageView edgeView;
+    Allocation edgeAllocation;
+    ResourceHandle edgeHandle;
+    // Hybrid raster (a RasterMode, fixed at construction): meshes and the scene share a depth
+    // buffer at renderExtent, so the scene always goes through the offscreen target
+    uint32_t rasterMode;
+    const MeshRenderer* meshes; // Optional; nothing is rasterized without it
+    VkFormat depthFormat;       // VK_FORMAT_UNDEFINED while rasterMode is RASTER_OFF
+    VkImage depthImage;
+    VkImageView depthView;
+    Allocation depthAllocation;
+    VkSampler depthSampler;     // RASTER_PREPASS: the march reads the depth through the resource table
+    ResourceHandle depthHandle; // Registered on first use, as resources is attached after construction
+    // Stereo (a StereoMode, fixed at construction; needs dynamic rendering): the offscreen target has
+    // a layer per eye at half the window width, and the blit puts them side by side. offscreenView
+    // then covers both layers for multiview, and two-pass renders through eyeViews.
+    uint32_t stereoMode;
+    VkImageView eyeViews[2];
+    // The pipeline draws a compiled scene file, which dirty regions and the CPU raymarcher do
+    // not know about; set before the first applySettings
+    bool sceneFile;
+    // Optional; with two or more threads, a partial frame with at least 2 * RECTS_PER_SECONDARY
+    // dirty rects records their draws into secondary command buffers on the job threads
+    JobSystem* jobs;
+    std::unique_ptr<ThreadCommandPools> recordPools; // Created on first use
+    bool parallelRects; // This frame's scene passes hold only secondary command buffers
 
-    Swapchain(const Device& device);
+    Swapchain(const Device& device, MemoryAllocator& allocator, uint32_t rasterMode = RASTER_OFF,
+              uint32_t stereoMode = STEREO_OFF);
     ~Swapchain();
 
-    void createFramebuffers(const Pipeline& pipeline);
-    void drawFrame(const Pipeline& pipeline, bool showImGuiWindow);
+    // Prefers B8G8R8A8_SRGB; the swapchain makes the same choice, so pipelines can be built before it exists
+    static VkSurfaceFormatKHR chooseSurfaceFormat(const Device& device);
+    // Depth attachment format for rasterMode; a static choice, like the surface format
+    static VkFormat chooseDepthFormat(const Device& device);
+    // Single color attachment pass, plus a depth attachment kept in depthLayout when depthFormat is
+    // set; every pass with the same formats is compatible with it
+    static VkRenderPass createColorRenderPass(VkDevice device, VkFormat format, VkAttachmentLoadOp loadOp,
+                                              VkImageLayout initialLayout, VkImageLayout finalLayout,
+                                              VkFormat depthFormat = VK_FORMAT_UNDEFINED,
+                                              VkImageLayout depthLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+    void createSwapchain(VkSwapchainKHR oldSwapchain);
+    void destroySwapchainResources();
+    void createFramebuffers();
+    void createPresentSemaphores(); // renderFinishedSemaphores for the current images
+    void destroyPresentSemaphores();
+    void createRenderTarget();
+    void destroyRenderTarget();
+    void createEdgeTarget();
+    void destroyEdgeTarget();
+    bool recreate();
+    // Applies present mode, frames in flight, render scale, AA mode, dirty regions and the CPU
+    // raymarcher; clamps settings to what is supported
+    void applySettings(RenderSettings& settings);
+    // Blocks until the current frame slot is free so its per-frame buffers can be rewritten
+    void waitForFrame();
+    // dirtyRects (scene pixels) limits the scene draw when the last frame's scene can be kept;
+    // nullptr redraws everything. With uploadedScene, sceneUpload holds the renderExtent scene as
+    // packed texels of imageFormat and replaces the scene draw.
+    void drawFrame(const Pipeline& pipeline, bool showImGuiWindow, const std::vector<VkRect2D>* dirtyRects = nullptr,
+                   VkBuffer sceneUpload = VK_NULL_HANDLE);
+    // depthView adds the scene depth, loaded or cleared with the color; read-only while sampled.
+    // A viewMask renders every draw into each of those layers of view (dynamic rendering only).
+    // secondaryContents begins a pass whose draws are all executed from secondary command buffers.
+    void beginColorPass(VkCommandBuffer commandBuffer, VkImageView view, VkFramebuffer framebuffer,
+                        VkRenderPass pass, VkExtent2D area, VkAttachmentLoadOp loadOp,
+                        VkImageView depthView = VK_NULL_HANDLE, bool depthReadOnly = false, uint32_t viewMask = 0,
+                        bool secondaryContents = false);
+    void endColorPass(VkCommandBuffer commandBuffer);
+    // One draw per rect when rects is set, otherwise one over the whole area. With parallelRects
+    // the rect draws are recorded on the job threads and executed from their secondary buffers.
+    void drawScene(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkExtent2D area, const DrawConstants& constants,
+                   const std::vector<VkRect2D>* rects = nullptr);
+    void bindScene(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkExtent2D area, const DrawConstants& constants);
+    // Into the offscreen target through resolveRenderPass, where every partial frame draws
+    void recordRectsInParallel(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkExtent2D area,
+                               const DrawConstants& constants, const std::vector<VkRect2D>& rects);
+    // Ends the primary pass on target and records the AA resolve draw in a new LOAD pass, left open
+    void resolveEdges(VkCommandBuffer commandBuffer, const Pipeline& pipeline, VkImage target, VkImageLayout targetLayout,
+                      VkImageView view, VkFramebuffer framebuffer, VkRenderPass pass, VkExtent2D area,
+                      const std::vector<VkRect2D>* rects = nullptr, VkImageView depthAttachment = VK_NULL_HANDLE);
+    void transitionImage(VkCommandBuffer commandBuffer, VkImage image,
+                         VkImageLayout oldLayout, VkImageLayout newLayout,
+                         VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess,
+                         VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess,
+                         VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
     void renderImGui(VkCommandBuffer commandBuffer);
+    // Query of the current slot; no-op without timestamps
+    void writeTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t query);
+    void addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags stage);
+    // Makes the next graphics submit wait for a scheduler submit on another queue
+    void addTimelineWait(QueueType queue, uint64_t value, VkPipelineStageFlags stage);
     uint32_t getImageCount() const;
     VkPresentModeKHR getPresentMode() const;
 };
@@ -0,0 +1,416 @@
+#include "tilerender.hpp"
+#include "swapchain.hpp"
+#include "input.hpp" // perspectiveProjection
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+glm::mat4 tileProjection(const glm::mat4& proj, uint32_t frameWidth, uint32_t frameHeight, const TileRect& tile) {
+    // The shader turns tile NDC into a ray with inverse(proj) * (ndc * (-0.5, 0.5), 1, 1).
+    // Map tile NDC to frame NDC (scale s, centre c), then fold that map into the projection.
+    glm::vec2 scale(static_cast<float>(tile.width) / frameWidth, static_cast<float>(tile.height) / frameHeight);
+    glm::vec2 centre(static_cast<float>(2 * tile.x + tile.width) / frameWidth - 1.0f,
+                     static_cast<float>(2 * tile.y + tile.height) / frameHeight - 1.0f);
+    glm::mat4 toFrame = glm::translate(glm::mat4(1.0f), glm::vec3(centre * glm::vec2(-0.5f, 0.5f), 0.0f)) *
+                        glm::scale(glm::mat4(1.0f), glm::vec3(scale, 1.0f));
+    return glm::inverse(toFrame) * proj;
+}
+
+static VkRenderPass createTileRenderPass(const Device& device) {
+    if (device.dynamicRendering) {
+        return VK_NULL_HANDLE;
+    }
+    return Swapchain::createColorRenderPass(device.device, TileRenderer::FORMAT, VK_ATTACHMENT_LOAD_OP_CLEAR,
+                                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+}
+
+static void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                         VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                         VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+TileRenderer::TileRenderer(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+                           uint32_t maxTileSize, const std::string& shaderOverrideDir)
+    : device(device), allocator(allocator), maxTileSize(maxTileSize), renderPass(createTileRenderPass(device)),
+      pipeline(device, allocator, resources, renderPass, FORMAT, 1, shaderOverrideDir), framebuffer(VK_NULL_HANDLE) {
+    // Offscreen target sized for the largest tile; smaller tiles use its top-left corner
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = FORMAT;
+    imageInfo.extent = {maxTileSize, maxTileSize, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device.device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create tile image");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device.device, image, &memRequirements);
+    imageAllocation = allocator.allocate(memRequirements, MemoryUsage::GpuOnly, false);
+    vkBindImageMemory(device.device, image, imageAllocation.memory, imageAllocation.offset);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device.device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create tile image view");
+    }
+
+    if (renderPass != VK_NULL_HANDLE) {
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &view;
+        framebufferInfo.width = maxTileSize;
+        framebufferInfo.height = maxTileSize;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(device.device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create tile framebuffer");
+        }
+    }
+
+    readback = allocator.createBuffer(static_cast<VkDeviceSize>(maxTileSize) * maxTileSize * 4,
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Readback);
+
+    commandPool = device.createCommandPool(QueueType::Graphics, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to allocate tile command buffer");
+    }
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device.device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create tile fence");
+    }
+
+    // Timestamps around the draw measure it without the readback; not every family has them
+    timestampPool = VK_NULL_HANDLE;
+    drawSeconds = 0.0;
+    if (device.timestampValidBits > 0) {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        if (vkCreateQueryPool(device.device, &queryInfo, nullptr, &timestampPool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create tile timestamp query pool");
+        }
+    }
+}
+
+void TileRenderer::render(const Camera& camera, float time, const RenderSettings& settings,
+                          uint32_t frameWidth, uint32_t frameHeight, const TileRect& tile, std::vector<uint8_t>& pixels) {
+    if (tile.width == 0 || tile.height == 0 || tile.width > maxTileSize || tile.height > maxTileSize) {
+        throw std::runtime_error("Tile size out of range");
+    }
+
+    Camera tileCamera = camera;
+    tileCamera.proj = tileProjection(camera.proj, frameWidth, frameHeight, tile);
+    RenderSettings tileSettings = settings;
+    tileSettings.stepHistogram = false;
+    // The edge test reads neighbouring pixels, which a tile border does not have
+    tileSettings.aaMode = AA_OFF;
+    pipeline.updateUBO(tileCamera, time, 0, tileSettings);
+
+    vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to begin tile command buffer");
+    }
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, timestampPool, 0, 2);
+    }
+
+    VkExtent2D area = {tile.width, tile.height};
+    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+    if (device.dynamicRendering) {
+        imageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                     VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0,
+                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+        VkRenderingAttachmentInfo colorAttachment = {};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = view;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearColor;
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.extent = area;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        device.cmdBeginRendering(commandBuffer, &renderingInfo);
+    } else {
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.extent = area;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.select(settings.shaderPrecision));
+    VkViewport viewport = {0.0f, 0.0f, static_cast<float>(tile.width), static_cast<float>(tile.height), 0.0f, 1.0f};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    VkRect2D scissor = {{0, 0}, area};
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    VkDescriptorSet descriptorSets[] = {pipeline.descriptorSets[0], pipeline.resourceSet};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipelineLayout, 0, 2, descriptorSets, 0, nullptr);
+    pipeline.pushDrawConstants(commandBuffer, DrawConstants()); // Primary draw only, no edge keys
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
+    }
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 1);
+    }
+
+    if (device.dynamicRendering) {
+        device.cmdEndRendering(commandBuffer);
+    } else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    // Both paths leave the image in COLOR_ATTACHMENT_OPTIMAL
+    imageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+    VkBufferImageCopy region = {};
+    region.bufferRowLength = tile.width; // Tightly packed rows
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {tile.width, tile.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &region);
+
+    VkBufferMemoryBarrier hostBarrier = {};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hostBarrier.buffer = readback.buffer;
+    hostBarrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record tile command buffer");
+    }
+
+    device.submit(QueueType::Graphics, commandBuffer, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, fence);
+    vkWaitForFences(device.device, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device.device, 1, &fence);
+
+    if (timestampPool != VK_NULL_HANDLE) {
+        uint64_t timestamps[2] = {};
+        vkGetQueryPoolResults(device.device, timestampPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        drawSeconds = device.timestampSeconds(timestamps[0], timestamps[1]);
+    }
+
+    // Readback memory prefers HOST_CACHED, which need not be coherent
+    VkMemoryPropertyFlags memoryFlags = allocator.memProperties.memoryTypes[readback.allocation.memoryType].propertyFlags;
+    if (!(memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        VkDeviceSize atom = device.properties.limits.nonCoherentAtomSize;
+        VkMappedMemoryRange range = {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = readback.allocation.memory;
+        range.offset = readback.allocation.offset / atom * atom;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(device.device, 1, &range);
+    }
+
+    size_t size = static_cast<size_t>(tile.width) * tile.height * 4;
+    pixels.resize(size);
+    memcpy(pixels.data(), readback.allocation.mapped, size);
+}
+
+TileRenderer::~TileRenderer() {
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device.device, timestampPool, nullptr);
+    }
+    vkDestroyFence(device.device, fence, nullptr);
+    vkDestroyCommandPool(device.device, commandPool, nullptr);
+    allocator.destroyBuffer(readback);
+    if (framebuffer != VK_NULL_HANDLE) {
+        vkDestroyFramebuffer(device.device, framebuffer, nullptr);
+    }
+    vkDestroyImageView(device.device, view, nullptr);
+    vkDestroyImage(device.device, image, nullptr);
+    allocator.free(imageAllocation);
+    if (renderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(device.device, renderPass, nullptr);
+    }
+}
+
+int runPrecisionBenchmark(std::ostream& out, const RenderSettings& settings, float fov, const std::string& gpuSelection,
+                          bool forceVulkan10, const std::string& shaderOverrideDir) {
+    using Clock = std::chrono::steady_clock;
+    const uint32_t width = 1920;
+    const uint32_t height = 1080;
+    const uint32_t frames = 120;
+    const TileRect frame = {0, 0, width, height};
+
+    // One orbit around the scene at the height of the default view, one frame per 1/30 s
+    auto pathCamera = [&](uint32_t index) {
+        float angle = glm::two_pi<float>() * index / frames;
+        Camera camera;
+        camera.position = glm::vec3(7.0f * std::sin(angle), 1.5f, 7.0f * std::cos(angle));
+        camera.forward = glm::normalize(-camera.position);
+        glm::vec3 right = glm::normalize(glm::cross(camera.forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+        camera.up = glm::cross(right, camera.forward);
+        camera.view = glm::lookAt(camera.position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        camera.proj = perspectiveProjection(fov, static_cast<float>(width) / height);
+        return camera;
+    };
+
+    struct Run {
+        const char* name;
+        RenderSettings settings;
+        std::vector<double> gpuMs;
+        double wallSeconds = 0.0;
+        std::vector<uint8_t> pixels;
+    };
+
+    try {
+        Device device(nullptr, gpuSelection, forceVulkan10);
+        MemoryAllocator allocator(device);
+        ResourceTable resources(device);
+        TileRenderer renderer(device, allocator, resources, width, shaderOverrideDir);
+
+        std::vector<Run> runs(device.shaderFloat16 ? 2 : 1);
+        runs[0].name = "fp32";
+        runs[0].settings = settings;
+        runs[0].settings.shaderPrecision = SHADER_PRECISION_FP32;
+        if (runs.size() > 1) {
+            runs[1].name = "fp16";
+            runs[1].settings = settings;
+            runs[1].settings.shaderPrecision = SHADER_PRECISION_FP16;
+        }
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "Shader precision, %ux%u, %u frames, %s grid, %s march on %s", width, height, frames,
+                      gridModeName(settings.gridMode), marchStrategyName(settings.marchStrategy), device.properties.deviceName);
+        out << line << std::endl;
+        if (renderer.timestampPool == VK_NULL_HANDLE) {
+            out << "  No GPU timestamps on the graphics queue; only wall times are reported" << std::endl;
+        }
+
+        // Warm up both pipelines, then alternate per frame so the two see the same clocks and heat
+        for (Run& run : runs) {
+            renderer.render(pathCamera(0), 0.0f, run.settings, width, height, frame, run.pixels);
+        }
+        uint64_t differing = 0;
+        uint64_t errorSum = 0;
+        int errorMax = 0;
+        for (uint32_t i = 0; i < frames; ++i) {
+            Camera camera = pathCamera(i);
+            float time = i / 30.0f;
+            for (Run& run : runs) {
+                Clock::time_point start = Clock::now();
+                renderer.render(camera, time, run.settings, width, height, frame, run.pixels);
+                run.wallSeconds += std::chrono::duration<double>(Clock::now() - start).count();
+                run.gpuMs.push_back(renderer.drawSeconds * 1000.0);
+            }
+            if (runs.size() < 2) {
+                continue;
+            }
+            // Largest channel difference per pixel; alpha is always 1
+            const std::vector<uint8_t>& reference = runs[0].pixels;
+            const std::vector<uint8_t>& candidate = runs[1].pixels;
+            for (size_t p = 0; p < reference.size(); p += 4) {
+                int error = 0;
+                for (size_t c = 0; c < 3; ++c) {
+                    error = std::max(error, std::abs(int(reference[p + c]) - int(candidate[p + c])));
+                }
+                errorSum += error;
+                errorMax = std::max(errorMax, error);
+                differing += error > 8 ? 1 : 0;
+            }
+        }
+
+        std::snprintf(line, sizeof(line), "  %-9s %12s %12s %12s %8s", "precision", "gpu ms mean", "gpu ms p95", "wall ms", "speedup");
+        out << line << std::endl;
+        double fp32Mean = 0.0;
+        for (Run& run : runs) {
+            double mean = 0.0;
+            for (double ms : run.gpuMs) {
+                mean += ms;
+            }
+            mean /= run.gpuMs.size();
+            std::sort(run.gpuMs.begin(), run.gpuMs.end());
+            double p95 = run.gpuMs[std::min(run.gpuMs.size() - 1, run.gpuMs.size() * 95 / 100)];
+            if (&run == &runs[0]) {
+                fp32Mean = mean;
+            }
+            std::snprintf(line, sizeof(line), "  %-9s %12.3f %12.3f %12.3f %7.2fx", run.name, mean, p95,
+                          run.wallSeconds * 1000.0 / frames, mean > 0.0 ? fp32Mean / mean : 0.0);
+            out << line << std::endl;
+        }
+
+        // Doubles as the fp16 variant's smoke test: a broken half-precision path shows up as
+        // whole regions off, well past the scattered edge pixels rounding moves
+        int exitCode = 0;
+        if (runs.size() < 2) {
+            out << "  fp16: " << device.properties.deviceName << " has no shaderFloat16; nothing to compare" << std::endl;
+        } else {
+            const double maxMismatchPercent = 1.0;
+            double pixels = static_cast<double>(width) * height * frames;
+            double mismatchPercent = differing * 100.0 / pixels;
+            bool pass = mismatchPercent <= maxMismatchPercent;
+            std::snprintf(line, sizeof(line), "  fp16 vs fp32: mean error %.3f, max %d (of 255), %.3f%% of pixels off by more than 8: %s",
+                          errorSum / pixels, errorMax, mismatchPercent, pass ? "pass" : "FAIL");
+            out << line << std::endl;
+            exitCode = pass ? 0 : 1;
+        }
+        device.waitIdle();
+        return exitCode;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+}
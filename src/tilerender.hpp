@@ -0,0 +1,57 @@
+#pragma once
+#include "device.hpp"
+#include "memory.hpp"
+#include "resources.hpp"
+#include "pipeline.hpp"
+#include "settings.hpp"
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct TileRect {
+    uint32_t x, y, width, height;
+};
+
+// Off-axis projection for one tile of a frameWidth x frameHeight frame: rendering the tile
+// at its own size with this projection gives exactly the pixels of that region of the frame
+glm::mat4 tileProjection(const glm::mat4& proj, uint32_t frameWidth, uint32_t frameHeight, const TileRect& tile);
+
+// Renders tiles of an arbitrarily large virtual frame into a small offscreen target and
+// reads them back. Needs no window or swapchain, so it also runs on a headless Device.
+struct TileRenderer {
+    static constexpr VkFormat FORMAT = VK_FORMAT_R8G8B8A8_SRGB; // Same encoding as the swapchain
+
+    const Device& device;
+    MemoryAllocator& allocator;
+    uint32_t maxTileSize;
+    VkRenderPass renderPass; // Render pass fallback only; declared before pipeline, which is built against it
+    Pipeline pipeline;
+    VkImage image;
+    VkImageView view;
+    VkFramebuffer framebuffer;
+    Allocation imageAllocation;
+    Buffer readback;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkQueryPool timestampPool; // VK_NULL_HANDLE when the graphics queue has no timestamps
+    double drawSeconds;        // GPU time of the last tile's draw; 0 without timestamps
+
+    TileRenderer(const Device& device, MemoryAllocator& allocator, const ResourceTable& resources,
+                 uint32_t maxTileSize, const std::string& shaderOverrideDir = "");
+    ~TileRenderer();
+
+    // Blocks until the tile is rendered; pixels receives tile.width * tile.height RGBA8 texels, top row first.
+    // camera.proj is the projection of the whole frame.
+    void render(const Camera& camera, float time, const RenderSettings& settings,
+                uint32_t frameWidth, uint32_t frameHeight, const TileRect& tile, std::vector<uint8_t>& pixels);
+};
+
+// Renders the same 1080p orbiting camera path with the fp32 and fp16 shaders on a headless
+// device and prints GPU draw times, the speedup and how far the fp16 images are from fp32.
+// Returns the exit code, 1 when over 1% of the fp16 pixels are off by more than 8.
+int runPrecisionBenchmark(std::ostream& out, const RenderSettings& settings, float fov, const std::string& gpuSelection,
+                          bool forceVulkan10, const std::string& shaderOverrideDir);
@@ -0,0 +1,292 @@
+#include "tuning.hpp"
+#include "config.hpp"
+#include <imgui.h>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+TuningPanel::TuningPanel()
+    : historyHead(0), historyCount(0), meanSteps{}, p95Steps{},
+      renderScaleEdit(1.0f), renderScaleActive(false), fpsLimitEdit(60.0f), profileName("default") {
+    std::fill(frameTimes, frameTimes + HISTORY_SIZE, 0.0f);
+    std::fill(busyTimes, busyTimes + HISTORY_SIZE, 0.0f);
+    std::fill(&stepBins[0][0], &stepBins[0][0] + Pipeline::STEP_HISTOGRAM_SETS * Pipeline::STEP_HISTOGRAM_BINS, 0.0f);
+    profiles = listProfiles();
+}
+
+void TuningPanel::recordFrame(float frameTimeMs, float waitTimeMs) {
+    frameTimes[historyHead] = frameTimeMs;
+    busyTimes[historyHead] = std::max(frameTimeMs - waitTimeMs, 0.0f);
+    historyHead = (historyHead + 1) % HISTORY_SIZE;
+    historyCount = std::min(historyCount + 1, HISTORY_SIZE);
+}
+
+void TuningPanel::setStepHistogram(const uint32_t* bins, int maxSteps) {
+    // Bin b counts pixels that took [b, b + 1) * (maxSteps + 1) / BINS steps
+    const uint32_t binCount = Pipeline::STEP_HISTOGRAM_BINS;
+    float binWidth = static_cast<float>(maxSteps + 1) / binCount;
+    for (uint32_t set = 0; set < Pipeline::STEP_HISTOGRAM_SETS; ++set) {
+        const uint32_t* setBins = bins + set * binCount;
+        uint64_t total = 0;
+        double weighted = 0.0;
+        for (uint32_t i = 0; i < binCount; ++i) {
+            total += setBins[i];
+            weighted += setBins[i] * (i + 0.5) * binWidth;
+        }
+        if (total == 0) {
+            continue; // Collection disabled or set unused, keep showing the last histogram
+        }
+        uint64_t running = 0;
+        bool p95Found = false;
+        for (uint32_t i = 0; i < binCount; ++i) {
+            stepBins[set][i] = static_cast<float>(setBins[i]) / total;
+            running += setBins[i];
+            if (!p95Found && running * 100 >= total * 95) {
+                p95Steps[set] = std::min((i + 1) * binWidth, static_cast<float>(maxSteps));
+                p95Found = true;
+            }
+        }
+        meanSteps[set] = static_cast<float>(weighted / total);
+    }
+}
+
+void TuningPanel::draw(RenderSettings& settings, const std::vector<VkPresentModeKHR>& presentModes,
+                       uint32_t maxFramesInFlight, bool stepCountersSupported) {
+    ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(380.0f, 620.0f), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Tuning")) {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::CollapsingHeader("Raymarch", ImGuiTreeNodeFlags_DefaultOpen)) {
+        // Ctrl+click typing is clamped too, so the panel cannot produce values the march can't use
+        ImGui::SliderInt("Max steps", &settings.maxSteps, 8, 512, "%d", ImGuiSliderFlags_AlwaysClamp);
+        ImGui::SliderFloat("Epsilon", &settings.epsilon, 0.00001f, 0.01f, "%.5f",
+                           ImGuiSliderFlags_Logarithmic | ImGuiSliderFlags_AlwaysClamp);
+        ImGui::SliderFloat("Far distance", &settings.farDistance, 10.0f, 1000.0f, "%.0f", ImGuiSliderFlags_AlwaysClamp);
+        if (ImGui::BeginCombo("Strategy", marchStrategyName(settings.marchStrategy))) {
+            for (uint32_t i = 0; i < MARCH_STRATEGY_COUNT; ++i) {
+                if (ImGui::Selectable(marchStrategyName(i), settings.marchStrategy == i)) {
+                    settings.marchStrategy = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        if (ImGui::BeginCombo("Grid", gridModeName(settings.gridMode))) {
+            for (uint32_t i = 0; i < GRID_MODE_COUNT; ++i) {
+                if (ImGui::Selectable(gridModeName(i), settings.gridMode == i)) {
+                    settings.gridMode = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        // The edge pass stores per-pixel keys from the fragment shader
+        ImGui::BeginDisabled(!stepCountersSupported);
+        if (ImGui::BeginCombo("Anti-aliasing", aaModeName(settings.aaMode))) {
+            for (uint32_t i = 0; i < AA_MODE_COUNT; ++i) {
+                if (ImGui::Selectable(aaModeName(i), settings.aaMode == i)) {
+                    settings.aaMode = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::SliderInt("AA samples", &settings.aaSamples, 2, 16);
+        ImGui::EndDisabled();
+        // fp16 without shaderFloat16 runs the fp32 shader; Swapchain::applySettings resolves it
+        if (ImGui::BeginCombo("Precision", shaderPrecisionName(settings.shaderPrecision))) {
+            for (uint32_t i = 0; i < SHADER_PRECISION_COUNT; ++i) {
+                if (ImGui::Selectable(shaderPrecisionName(i), settings.shaderPrecision == i)) {
+                    settings.shaderPrecision = i;
+                }
+            }
+            ImGui::EndCombo();
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Presentation", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (!renderScaleActive) {
+            renderScaleEdit = settings.renderScale;
+        }
+        ImGui::SliderFloat("Render scale", &renderScaleEdit, 0.25f, 2.0f, "%.2fx");
+        renderScaleActive = ImGui::IsItemActive();
+        if (ImGui::IsItemDeactivatedAfterEdit()) {
+            settings.renderScale = renderScaleEdit;
+        }
+
+        if (ImGui::BeginCombo("Present mode", presentModeName(settings.presentMode))) {
+            for (VkPresentModeKHR mode : presentModes) {
+                if (ImGui::Selectable(presentModeName(mode), settings.presentMode == mode)) {
+                    settings.presentMode = mode;
+                }
+            }
+            ImGui::EndCombo();
+        }
+
+        int framesInFlight = static_cast<int>(settings.framesInFlight);
+        if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, static_cast<int>(maxFramesInFlight))) {
+            settings.framesInFlight = static_cast<uint32_t>(framesInFlight);
+        }
+        // Off, the monitor's rate or a fixed rate; the slider keeps the last fixed rate
+        const char* limitNames[] = {"off", "refresh", "fixed"};
+        int limitMode = settings.fpsLimit == FPS_LIMIT_REFRESH ? 1 : settings.fpsLimit > 0.0f ? 2 : 0;
+        if (ImGui::Combo("FPS limit", &limitMode, limitNames, 3)) {
+            settings.fpsLimit = limitMode == 1 ? FPS_LIMIT_REFRESH : limitMode == 2 ? fpsLimitEdit : FPS_LIMIT_OFF;
+        }
+        if (limitMode == 2) {
+            fpsLimitEdit = settings.fpsLimit;
+            if (ImGui::SliderFloat("FPS", &fpsLimitEdit, 10.0f, 480.0f, "%.0f")) {
+                settings.fpsLimit = fpsLimitEdit;
+            }
+        }
+        ImGui::BeginDisabled(settings.cpuRender);
+        ImGui::Checkbox("Dirty regions only", &settings.dirtyRegions);
+        ImGui::EndDisabled();
+        // Turns AA and dirty regions off while it runs
+        ImGui::Checkbox("CPU raymarcher", &settings.cpuRender);
+    }
+
+    if (ImGui::CollapsingHeader("Frame time", ImGuiTreeNodeFlags_DefaultOpen) && historyCount > 0) {
+        // Plot oldest to newest; before the ring fills the samples start at index 0
+        int offset = historyCount == HISTORY_SIZE ? static_cast<int>(historyHead) : 0;
+        std::vector<float> sorted(frameTimes, frameTimes + historyCount);
+        std::sort(sorted.begin(), sorted.end());
+        float average = 0.0f;
+        for (float value : sorted) {
+            average += value;
+        }
+        average /= historyCount;
+        float p99 = sorted[std::min<size_t>(historyCount - 1, historyCount * 99 / 100)];
+        float plotMax = std::max(sorted.back() * 1.1f, 1.0f);
+
+        ImGui::Text("avg %.2f ms  p99 %.2f ms  max %.2f ms", average, p99, sorted.back());
+        char overlay[32];
+        snprintf(overlay, sizeof(overlay), "%.2f ms", frameTimes[(historyHead + HISTORY_SIZE - 1) % HISTORY_SIZE]);
+        ImGui::PlotLines("Frame", frameTimes, static_cast<int>(historyCount), offset, overlay, 0.0f, plotMax, ImVec2(0.0f, 60.0f));
+        ImGui::PlotLines("Busy", busyTimes, static_cast<int>(historyCount), offset, "excl. GPU/present wait", 0.0f, plotMax, ImVec2(0.0f, 60.0f));
+    }
+
+    if (ImGui::CollapsingHeader("Steps per pixel", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (!stepCountersSupported) {
+            ImGui::TextDisabled("Needs fragmentStoresAndAtomics");
+            settings.stepHistogram = false;
+        } else {
+            ImGui::Checkbox("Collect", &settings.stepHistogram);
+            if (settings.gridMode == GRID_COMPARE) {
+                // Left and right halves side by side; analytic grid counts its cell walk as steps too
+                ImGui::Text("SDF grid: mean %.1f  p95 %.0f", meanSteps[0], p95Steps[0]);
+                ImGui::PlotHistogram("##stepsSdf", stepBins[0], static_cast<int>(Pipeline::STEP_HISTOGRAM_BINS), 0,
+                                     "left half", 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+                ImGui::Text("Analytic grid: mean %.1f  p95 %.0f", meanSteps[1], p95Steps[1]);
+                ImGui::PlotHistogram("##stepsAnalytic", stepBins[1], static_cast<int>(Pipeline::STEP_HISTOGRAM_BINS), 0,
+                                     "right half", 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+            } else {
+                ImGui::Text("mean %.1f  p95 %.0f  cap %d", meanSteps[0], p95Steps[0], settings.maxSteps);
+                ImGui::PlotHistogram("##steps", stepBins[0], static_cast<int>(Pipeline::STEP_HISTOGRAM_BINS), 0,
+                                     "0 .. max steps", 0.0f, FLT_MAX, ImVec2(0.0f, 80.0f));
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Profiles")) {
+        ImGui::InputText("Name", profileName, sizeof(profileName));
+        if (ImGui::Button("Save")) {
+            if (saveProfile(profileName, settings)) {
+                status = "Saved " + std::string(profileName);
+                profiles = listProfiles();
+            } else {
+                status = "Could not save " + std::string(profileName);
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Refresh")) {
+            profiles = listProfiles();
+        }
+        for (const std::string& name : profiles) {
+            if (ImGui::Selectable(name.c_str())) {
+                status = loadProfile(name, settings) ? "Loaded " + name : "Could not load " + name;
+                snprintf(profileName, sizeof(profileName), "%s", name.c_str());
+            }
+        }
+        if (!status.empty()) {
+            ImGui::TextUnformatted(status.c_str());
+        }
+        ImGui::TextDisabled("%s", getProfileDir().c_str());
+    }
+
+    ImGui::End();
+}
+
+std::string TuningPanel::getProfileDir() {
+    return getUserConfigDir() + "/profiles";
+}
+
+// Profile names become file names, so keep them to a safe character set
+static bool validProfileName(const std::string& name) {
+    if (name.empty()) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+    });
+}
+
+bool TuningPanel::saveProfile(const std::string& name, const RenderSettings& settings) {
+    if (!validProfileName(name)) {
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(getProfileDir(), error);
+    std::ofstream file(getProfileDir() + "/" + name + ".ini");
+    if (!file.is_open()) {
+        return false;
+    }
+    // Same sections and keys as settings.ini, so a profile can also be passed with --config
+    file << "[graphics]\n";
+    file << "render_scale=" << settings.renderScale << "\n";
+    file << "present_mode=" << presentModeName(settings.presentMode) << "\n";
+    file << "frames_in_flight=" << settings.framesInFlight << "\n";
+    file << "fps_limit=" << fpsLimitName(settings.fpsLimit) << "\n";
+    file << "dirty_regions=" << (settings.dirtyRegions ? "true" : "false") << "\n";
+    file << "\n[raymarch]\n";
+    file << "max_steps=" << settings.maxSteps << "\n";
+    file << "epsilon=" << settings.epsilon << "\n";
+    file << "far_distance=" << settings.farDistance << "\n";
+    file << "march_strategy=" << marchStrategyName(settings.marchStrategy) << "\n";
+    file << "grid_mode=" << gridModeName(settings.gridMode) << "\n";
+    file << "aa_mode=" << aaModeName(settings.aaMode) << "\n";
+    file << "aa_samples=" << settings.aaSamples << "\n";
+    file << "precision=" << shaderPrecisionName(settings.shaderPrecision) << "\n";
+    file << "\n[cpu]\n";
+    file << "render=" << (settings.cpuRender ? "true" : "false") << "\n";
+    return file.good();
+}
+
+bool TuningPanel::loadProfile(const std::string& name, RenderSettings& settings) {
+    if (!validProfileName(name)) {
+        return false;
+    }
+    Config profile;
+    if (!profile.loadFile(getProfileDir() + "/" + name + ".ini", "profile " + name)) {
+        return false;
+    }
+    // Clamps the march knobs like every other settings layer, so a hand-edited profile can't
+    // leave them unusable
+    profile.readRenderSettings(settings);
+    return true;
+}
+
+std::vector<std::string> TuningPanel::listProfiles() const {
+    std::vector<std::string> names;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(getProfileDir(), error)) {
+        if (entry.path().extension() == ".ini") {
+            names.push_back(entry.path().stem().string());
+        }
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "settings.hpp"
+#include "pipeline.hpp"
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+// Interactive ImGui panel for the live performance knobs, with rolling frame-time
+// graphs, the steps-per-pixel histogram and named profiles stored as ini files.
+class TuningPanel {
+public:
+    static constexpr uint32_t HISTORY_SIZE = 240;
+
+    TuningPanel();
+    void recordFrame(float frameTimeMs, float waitTimeMs);
+    void setStepHistogram(const uint32_t* bins, int maxSteps); // STEP_HISTOGRAM_SETS * STEP_HISTOGRAM_BINS counters
+    // Edits settings in place; the caller applies them to the swapchain and UBO
+    void draw(RenderSettings& settings, const std::vector<VkPresentModeKHR>& presentModes,
+              uint32_t maxFramesInFlight, bool stepCountersSupported);
+
+    bool saveProfile(const std::string& name, const RenderSettings& settings);
+    bool loadProfile(const std::string& name, RenderSettings& settings);
+    std::vector<std::string> listProfiles() const;
+    static std::string getProfileDir(); // getUserConfigDir() + "/profiles"
+
+private:
+    float frameTimes[HISTORY_SIZE]; // Ring buffers, oldest sample at historyHead once full
+    float busyTimes[HISTORY_SIZE];  // Frame time minus fence/acquire wait
+    uint32_t historyHead;
+    uint32_t historyCount;
+    float stepBins[Pipeline::STEP_HISTOGRAM_SETS][Pipeline::STEP_HISTOGRAM_BINS];
+    float meanSteps[Pipeline::STEP_HISTOGRAM_SETS];
+    float p95Steps[Pipeline::STEP_HISTOGRAM_SETS];
+    float renderScaleEdit; // Applied on slider release; every change recreates the offscreen target
+    bool renderScaleActive;
+    float fpsLimitEdit; // Last fixed frame rate, kept while the limit is off or follows the monitor
+    char profileName[64];
+    std::string status;
+    std::vector<std::string> profiles;
+};